@@ -1,4 +1,5 @@
 #include "SirEngine/animation/animationClip.h"
+#include "SirEngine/animation/clipCompression.h"
 #include "SirEngine/io/binaryFile.h"
 #include "SirEngine/io/fileUtils.h"
 #include "SirEngine/globals.h"
@@ -8,38 +9,109 @@
 namespace SirEngine {
 
 AnimationClip::~AnimationClip() {
-  globals::PERSISTENT_ALLOCATOR->free(m_poses);
+  if (m_compressedPoses != nullptr) {
+    globals::PERSISTENT_ALLOCATOR->free(m_compressedPoses);
+  }
 }
 
 bool AnimationClip::initialize(const char *path) {
   // load the binary file
   SE_CORE_INFO("Loading animation clip {0}", path);
-  const bool res = fileExists(path);
-  assert(res);
+  if (!fileExists(path)) {
+    SE_CORE_ERROR("Animation clip file {0} does not exist", path);
+    return false;
+  }
 
   uint32_t fileSize;
   const char *binaryData = frameFileLoad(path, fileSize);
+  if (fileSize < sizeof(BinaryFileHeader)) {
+    SE_CORE_ERROR("Animation clip {0} too small to hold a header: {1} bytes",
+                  path, fileSize);
+    return false;
+  }
+  const BinaryFileHeader *header = getHeader(binaryData);
+  if (header->fileType != BinaryFileType::ANIM) {
+    SE_CORE_ERROR(
+        "Expected animation clip binary file but got {0}: {1}",
+        getBinaryFileTypeName(static_cast<BinaryFileType>(header->fileType)),
+        path);
+    return false;
+  }
+  if (header->version != COMPRESSED_CLIP_FILE_VERSION) {
+    SE_CORE_ERROR(
+        "Unsupported animation clip version {0}, expected {1}, recompile {2}",
+        header->version, COMPRESSED_CLIP_FILE_VERSION, path);
+    return false;
+  }
+  if (header->mapperDataOffsetInByte < sizeof(BinaryFileHeader) ||
+      header->mapperDataOffsetInByte > fileSize ||
+      fileSize - header->mapperDataOffsetInByte < sizeof(ClipMapperData)) {
+    SE_CORE_ERROR("Truncated animation clip {0}, {1} bytes", path, fileSize);
+    return false;
+  }
 
+  // the name, the poses and the metadata sit in between the header and the
+  // mapper data, nothing gets copied until all of it is known to fit
   const auto mapper = getMapperData<ClipMapperData>(binaryData);
+  const uint64_t bulkSize =
+      header->mapperDataOffsetInByte - sizeof(BinaryFileHeader);
+  const bool validSizes =
+      (mapper->nameSizeInByte > 0) & (mapper->posesSizeInByte >= 0) &
+      (mapper->keyValueSizeInByte >= 0) &
+      (static_cast<uint64_t>(mapper->posesSizeInByte) >=
+       sizeof(CompressedClipHeader));
+  if (!validSizes ||
+      static_cast<uint64_t>(mapper->nameSizeInByte) +
+              static_cast<uint64_t>(mapper->posesSizeInByte) +
+              static_cast<uint64_t>(mapper->keyValueSizeInByte) >
+          bulkSize) {
+    SE_CORE_ERROR("Corrupted animation clip {0}, data ends past the file",
+                  path);
+    return false;
+  }
+  const char *name = binaryData + sizeof(BinaryFileHeader);
+  const char *poses = name + mapper->nameSizeInByte;
+  const char *keyValues = poses + mapper->posesSizeInByte;
+  if (name[mapper->nameSizeInByte - 1] != '\0') {
+    SE_CORE_ERROR("Corrupted animation clip {0}, bad name", path);
+    return false;
+  }
+  CompressedClipHeader clipHeader;
+  memcpy(&clipHeader, poses, sizeof(CompressedClipHeader));
+  if (clipHeader.jointCount != static_cast<uint32_t>(mapper->bonesPerFrame) ||
+      clipHeader.frameCount != static_cast<uint32_t>(mapper->frameCount) ||
+      clipHeader.sizeInBytes > static_cast<uint32_t>(mapper->posesSizeInByte)) {
+    SE_CORE_ERROR(
+        "Corrupted animation clip {0}, compressed poses for {1} joints and {2} "
+        "frames, expected {3} joints and {4} frames",
+        path, clipHeader.jointCount, clipHeader.frameCount,
+        mapper->bonesPerFrame, mapper->frameCount);
+    return false;
+  }
+  // frame rate, frame and segment counts, segment table and track data,
+  // everything the sampling divides by or reads
+  if (!(mapper->frameRate > 0.0f) ||
+      !validateCompressedClip(poses, clipHeader.sizeInBytes)) {
+    SE_CORE_ERROR("Corrupted animation clip {0}, bad compressed poses", path);
+    return false;
+  }
+
   m_isLoopable = mapper->isLoopable;
   m_bonesPerFrame = mapper->bonesPerFrame;
   m_frameCount = mapper->frameCount;
   m_frameRate = mapper->frameRate;
 
-  m_name = persistentString(binaryData + sizeof(BinaryFileHeader));
-  m_poses = reinterpret_cast<JointPose *>(
-      globals::PERSISTENT_ALLOCATOR->allocate(mapper->posesSizeInByte));
-  memcpy(m_poses,
-         binaryData + sizeof(BinaryFileHeader) + mapper->nameSizeInByte,
-         mapper->posesSizeInByte);
+  m_name = persistentString(name);
+  // the compressed poses are a single relocatable block, a copy is all
+  // the loading there is
+  m_compressedPoses =
+      globals::PERSISTENT_ALLOCATOR->allocate(mapper->posesSizeInByte);
+  memcpy(m_compressedPoses, poses, mapper->posesSizeInByte);
 
   // need to load metadata
   m_metadata = reinterpret_cast<AnimationMetadataKey *>(
       globals::PERSISTENT_ALLOCATOR->allocate(mapper->keyValueSizeInByte));
-  memcpy(m_metadata,
-         binaryData + sizeof(BinaryFileHeader) + mapper->nameSizeInByte +
-             mapper->posesSizeInByte,
-         mapper->keyValueSizeInByte);
+  memcpy(m_metadata, keyValues, mapper->keyValueSizeInByte);
   m_metadataCount = static_cast<int>(mapper->keyValueSizeInByte /
                                      (sizeof(AnimationMetadataKey)));
 
@@ -1,12 +1,11 @@
 #pragma once
+#include <stdint.h>
 
 #include "SirEngine/animation/animationManipulation.h"
 
 namespace SirEngine {
 
 
-struct JointPose;
-
 struct AnimationClip {
 
   AnimationClip() = default;
@@ -16,7 +15,9 @@ struct AnimationClip {
   int findMetadataFrameFromGivenFrame(const ANIM_CLIP_KEYWORDS flag,
                                       const int sourceFrame, bool allowWrapAround =true) const;
 
-  JointPose *m_poses = nullptr;
+  // poses compressed by the clip compiler, sampled in place, see
+  // clipCompression.h
+  void *m_compressedPoses = nullptr;
   const char *m_name = nullptr;
   AnimationMetadataKey *m_metadata = nullptr;
   int m_metadataCount = 0;
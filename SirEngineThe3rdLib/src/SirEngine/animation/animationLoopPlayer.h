@@ -1,7 +1,7 @@
 #pragma once
 #include "SirEngine/animation/animationPlayer.h"
+#include "SirEngine/animation/clipCursor.h"
 #include "nlohmann/json_fwd.hpp"
-#include <glm/glm.hpp>
 
 namespace SirEngine {
 struct SkeletonPose;
@@ -15,13 +15,14 @@ public:
   AnimationLoopPlayer();
   ~AnimationLoopPlayer() override;
   void init(AnimationManager *manager, nlohmann::json &configJson);
-  void evaluate(long long stampNS) override;
+  void evaluate(long long stampNS, StackAllocator &scratch) override;
   uint32_t getJointCount() const override;
 private:
   Skeleton *skeleton;
   AnimationClip *m_clip;
+  // the clip is played a segment at the time
+  ClipCursor m_cursor;
   float m_multiplier = 1.0f;
-  glm::mat4 m_transform;
 };
 
 } // namespace SirEngine
@@ -5,9 +5,14 @@
 #undef max
 #include "SirEngine/animation/animationClip.h"
 #include "SirEngine/animation/animationLoopPlayer.h"
+#include "SirEngine/animation/blendTreePlayer.h"
+#include "SirEngine/animation/poseStreams.h"
 #include "SirEngine/animation/skeleton.h"
+#include "SirEngine/log.h"
+#include "SirEngine/workerPool.h"
 #include "luaStatePlayer.h"
 
+#include <cstring>
 #include <string>
 #include "nlohmann/json.hpp"
 
@@ -19,6 +24,7 @@ static const std::string ANIMATION_CLIP_KEY = "animationClip";
 static const std::string ANIMATION_CONFIG_TYPE_SIMPLE_LOOP =
     "animationLoopPlayer";
 static const std::string ANIMATION_CONFIG_TYPE_LUA_STATE = "luaStatePlayer";
+static const std::string ANIMATION_CONFIG_TYPE_BLEND_TREE = "blendTreePlayer";
 static const std::string ANIMATION_CONFIG_NAME_KEY = "name";
 
 AnimationPlayer *loadAnimationLoopPlayer(AnimationManager *manager,
@@ -33,6 +39,15 @@ AnimationPlayer *loadLuaStatePlayer(AnimationManager *manager,
   loop->init(manager, jObj);
   return loop;
 }
+AnimationPlayer *loadBlendTreePlayer(AnimationManager *manager,
+                                     nlohmann::json &jObj) {
+  auto *tree = new BlendTreePlayer();
+  if (!tree->init(manager, jObj)) {
+    delete tree;
+    return nullptr;
+  }
+  return tree;
+}
 
 AnimationConfigHandle
 AnimationManager::loadAnimationConfig(const char *path, const char *assetName) {
@@ -56,9 +71,15 @@ AnimationManager::loadAnimationConfig(const char *path, const char *assetName) {
     player = loadAnimationLoopPlayer(this, configJson);
   } else if (type == ANIMATION_CONFIG_TYPE_LUA_STATE) {
     player = loadLuaStatePlayer(this, configJson);
+  } else if (type == ANIMATION_CONFIG_TYPE_BLEND_TREE) {
+    player = loadBlendTreePlayer(this, configJson);
   } else {
     assert(0 && "uknown animation player type");
   }
+  if (player == nullptr) {
+    SE_CORE_ERROR("Could not load animation config {0}", path);
+    return {};
+  }
 
   registerState(player);
   //// allocating anim state;
@@ -82,6 +103,7 @@ void AnimationManager::init() {
       "l_foot_down", static_cast<int>(ANIM_CLIP_KEYWORDS::L_FOOT_DOWN));
   m_keywordRegisterMap.insert(
       "r_foot_down", static_cast<int>(ANIM_CLIP_KEYWORDS::R_FOOT_DOWN));
+  m_scratch.initialize(SCRATCH_SIZE_IN_BYTES);
 }
 
 AnimationClip *AnimationManager::loadAnimationClip(const char *name,
@@ -91,9 +113,12 @@ AnimationClip *AnimationManager::loadAnimationClip(const char *name,
   if (clip == nullptr) {
     // TODO fix naked
     clip = new AnimationClip();
-    const bool res = clip->initialize(path);
+    if (!clip->initialize(path)) {
+      delete clip;
+      return nullptr;
+    }
     m_animationClipCache.insert(name, clip);
-    return res ? clip : nullptr;
+    return clip;
   }
   return clip;
 }
@@ -105,7 +130,7 @@ Skeleton *AnimationManager::loadSkeleton(const char *name, const char *path) {
     // TODO fix naked
     auto *sk = new Skeleton();
     const bool res = sk->loadFromFile(path);
-    m_skeletonCache.insert(name, skeleton);
+    m_skeletonCache.insert(name, sk);
     return res ? sk : nullptr;
   }
   return skeleton;
@@ -121,7 +146,8 @@ AnimationManager::getSkeletonPose(const Skeleton *skeleton) const {
   pose->m_skeleton = skeleton;
   const uint32_t jointCount = pose->m_skeleton->m_jointCount;
   const uint32_t totalSize = sizeof(JointPose) * jointCount +
-                             (sizeof(glm::mat4) * jointCount) * 2;
+                             (sizeof(glm::mat4) * jointCount) * 2 +
+                             sizeof(float) * getPoseStreamsSize(jointCount);
   char *memory = reinterpret_cast<char *>(
       globals::PERSISTENT_ALLOCATOR->allocate(totalSize));
   // local pose is the first pointer so we just need to cast it to correct type
@@ -133,14 +159,144 @@ AnimationManager::getSkeletonPose(const Skeleton *skeleton) const {
   // finally the last array is after m_globalPose, the datatype is already of a
   // matrix so we just go and shift by the joint count
   pose->m_worldMat = pose->m_globalPose + jointCount;
+  // and the streams close the block
+  pose->m_localStreams =
+      reinterpret_cast<float *>(pose->m_worldMat + jointCount);
+  // starting from identities, the streams padding needs to be valid
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    pose->m_localPose[i] = JointPose{glm::quat(1, 0, 0, 0), glm::vec3(0), 1};
+  }
+  jointPosesToStreams(pose->m_localPose, jointCount, pose->m_localStreams);
   return pose;
 }
 
+AnimationManager::~AnimationManager() {
+  for (uint32_t i = 0; i < m_playerLods.size(); ++i) {
+    if (m_playerLods[i].history != nullptr) {
+      globals::PERSISTENT_ALLOCATOR->free(m_playerLods[i].history);
+    }
+  }
+}
+
 void AnimationManager::registerState(AnimationPlayer *state) {
   m_activeAnims.pushBack(state);
+  m_playerLods.pushBack(PlayerLod{});
+}
+
+void AnimationManager::setLodTiers(
+    const AnimationLodTier tiers[ANIMATION_LOD_TIER_COUNT]) {
+  for (uint32_t i = 0; i < ANIMATION_LOD_TIER_COUNT; ++i) {
+    assert(tiers[i].updateInterval != 0);
+    assert(i == 0 || tiers[i].maxDistance >= tiers[i - 1].maxDistance);
+    m_lodTiers[i] = tiers[i];
+  }
+  // every player picks its tier again
+  for (uint32_t i = 0; i < m_playerLods.size(); ++i) {
+    m_playerLods[i].tier = ANIMATION_LOD_TIER_COUNT;
+  }
 }
 
-void AnimationManager::evaluate() const {
+void AnimationManager::updatePlayerLod(const uint32_t playerIndex) {
+  AnimationPlayer *player = m_activeAnims[playerIndex];
+  PlayerLod &lod = m_playerLods[playerIndex];
+  const SkeletonPose *pose = player->getOutPose();
+
+  const glm::vec3 position(player->getTransform()[3]);
+  const float distance = glm::length(position - m_lodViewPosition);
+  uint32_t tierIndex = ANIMATION_LOD_TIER_COUNT - 1;
+  for (uint32_t i = 0; i < ANIMATION_LOD_TIER_COUNT - 1; ++i) {
+    if (distance <= m_lodTiers[i].maxDistance) {
+      tierIndex = i;
+      break;
+    }
+  }
+  const AnimationLodTier &tier = m_lodTiers[tierIndex];
+
+  if (lod.tier != tierIndex) {
+    lod.tier = tierIndex;
+    lod.phase = m_lodTierArrivals[tierIndex]++;
+    lod.hasHistory = false;
+    // the joint set changes only with the tier
+    const Skeleton *skeleton = pose != nullptr ? pose->m_skeleton : nullptr;
+    player->setAnimatedJointCount(
+        tier.maxJointDepth < 0 || skeleton == nullptr
+            ? POSE_ALL_JOINTS
+            : skeleton->getJointCountUpToDepth(
+                  static_cast<uint32_t>(tier.maxJointDepth)));
+  }
+
+  const uint32_t interval = tier.updateInterval;
+  const uint32_t frame = (m_lodFrame + lod.phase) % interval;
+  lod.interpolate = tier.interpolate && interval > 1 && pose != nullptr;
+  if (lod.interpolate && lod.history == nullptr) {
+    const uint32_t poseSize =
+        getPoseStreamsSize(pose->m_skeleton->m_jointCount);
+    lod.history = static_cast<float *>(
+        globals::PERSISTENT_ALLOCATOR->allocate(sizeof(float) * poseSize * 2));
+    lod.fromStreams = lod.history;
+    lod.toStreams = lod.history + poseSize;
+  }
+
+  // a player new to the tier has nothing to hold or interpolate, it gets
+  // evaluated straight away
+  if (frame == 0 || !lod.hasHistory) {
+    lod.action = LOD_ACTION::EVALUATE;
+  } else {
+    lod.action = lod.interpolate ? LOD_ACTION::INTERPOLATE : LOD_ACTION::SKIP;
+  }
+  // the last evaluation is reached right before the next one
+  lod.interpolationFactor =
+      static_cast<float>(frame + 1) / static_cast<float>(interval);
+}
+
+void AnimationManager::evaluatePlayer(const uint32_t playerIndex,
+                                      const long long stampNS,
+                                      StackAllocator &scratch) {
+  AnimationPlayer *player = m_activeAnims[playerIndex];
+  PlayerLod &lod = m_playerLods[playerIndex];
+  if (lod.action == LOD_ACTION::SKIP) {
+    return;
+  }
+  SkeletonPose *pose = player->getOutPose();
+  if (lod.action == LOD_ACTION::EVALUATE) {
+    player->evaluate(stampNS, scratch);
+  }
+  if (pose == nullptr) {
+    return;
+  }
+
+  const uint32_t jointCount = pose->m_skeleton->m_jointCount;
+  if (lod.interpolate) {
+    // the new evaluation becomes the target, the previous one the source,
+    // the culled joints get copied along and keep their last pose
+    const size_t poseSizeInBytes =
+        sizeof(float) * getPoseStreamsSize(jointCount);
+    const bool firstEvaluation = !lod.hasHistory;
+    if (lod.action == LOD_ACTION::EVALUATE) {
+      float *previous = lod.toStreams;
+      lod.toStreams = lod.fromStreams;
+      lod.fromStreams = previous;
+      memcpy(lod.toStreams, pose->m_localStreams, poseSizeInBytes);
+      if (firstEvaluation) {
+        memcpy(lod.fromStreams, pose->m_localStreams, poseSizeInBytes);
+      }
+    }
+    if (!firstEvaluation) {
+      interpolatePoseStreams(lod.fromStreams, lod.toStreams,
+                             lod.interpolationFactor, jointCount,
+                             pose->m_localStreams,
+                             player->getAnimatedJointCount());
+    }
+  }
+  lod.hasHistory = true;
+
+  // now that the anim has been blended I will compute the
+  // matrices in world-space (skin ready)
+  pose->updateGlobalFromLocal(player->getTransform());
+  player->setFlags(ANIM_FLAGS::NEW_MATRICES);
+}
+
+void AnimationManager::evaluate(WorkerPool *pool) {
   // animation works on a global clock, it is slightly harder
   // but makes easier to sync animations, we grab the time stamp in
   // nanoseconds and pass it along for update, most likely will be converted
@@ -150,10 +306,34 @@ void AnimationManager::evaluate() const {
   // anim system uses before converting to seconds
   const std::chrono::nanoseconds nano{stamp};
 
-  // evaluates all the animations
+  // anything touching shared state happens here, serially, the lod is
+  // picked once the update had a chance to move the player
   const uint32_t animCount = m_activeAnims.size();
   for (uint32_t i = 0; i < animCount; ++i) {
-    m_activeAnims[i]->evaluate(nano.count());
+    m_activeAnims[i]->update(nano.count());
+    updatePlayerLod(i);
+  }
+  ++m_lodFrame;
+
+  // evaluates all the animations
+  if (pool == nullptr) {
+    for (uint32_t i = 0; i < animCount; ++i) {
+      evaluatePlayer(i, nano.count(), m_scratch);
+    }
+    return;
   }
+  const uint32_t taskCount =
+      (animCount + PLAYERS_PER_TASK - 1) / PLAYERS_PER_TASK;
+  pool->parallelFor(taskCount, [&](const uint32_t task) {
+    StackAllocator &scratch =
+        pool->getScratchAllocator(WorkerPool::getCurrentWorkerIndex());
+    const uint32_t first = task * PLAYERS_PER_TASK;
+    const uint32_t last = first + PLAYERS_PER_TASK < animCount
+                              ? first + PLAYERS_PER_TASK
+                              : animCount;
+    for (uint32_t i = first; i < last; ++i) {
+      evaluatePlayer(i, nano.count(), scratch);
+    }
+  });
 }
 } // namespace SirEngine
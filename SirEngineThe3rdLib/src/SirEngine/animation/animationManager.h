@@ -1,11 +1,14 @@
 #pragma once
 
 
+#include <glm/glm.hpp>
+
 #include "SirEngine/clock.h"
 #include "SirEngine/handle.h"
 #include "SirEngine/hashing.h"
 #include "SirEngine/memory/cpu/hashMap.h"
 #include "SirEngine/memory/cpu/resizableVector.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
 #include "SirEngine/memory/cpu/stringHashMap.h"
 
 namespace SirEngine {
@@ -15,6 +18,7 @@ struct Skeleton;
 struct SkeletonPose;
 struct AnimationClip;
 class AnimationPlayer;
+class WorkerPool;
 
 // struct AnimationConfig {
 //  AnimationClip *m_animationClip = nullptr;
@@ -24,16 +28,42 @@ class AnimationPlayer;
 
 using AnimClock = Clock<std::chrono::nanoseconds>;
 
+// how players get animated depending on how far they are from the view, the
+// distance is measured from the translation of the player transform
+struct AnimationLodTier {
+  // players up to this distance use the tier, in world units. Players past
+  // the last tier use the last tier
+  float maxDistance;
+  // the player gets evaluated once every updateInterval frames, players in
+  // the same tier are spread over those frames
+  uint32_t updateInterval;
+  // in between updates the pose is interpolated between the last two
+  // evaluations, one interval behind, otherwise the last pose is held and no
+  // new matrices are produced
+  bool interpolate;
+  // joints deeper than this in the hierarchy, the root being at depth zero,
+  // are not animated and hold their last pose, negative animates them all
+  int maxJointDepth;
+};
+static constexpr uint32_t ANIMATION_LOD_TIER_COUNT = 4;
+
 class AnimationManager final {
  public:
+  // players evaluated by a single pool task, evaluating a player is in the
+  // tens of microseconds, batching keeps the scheduling overhead negligible
+  static constexpr uint32_t PLAYERS_PER_TASK = 4;
+  // scratch memory used when evaluating without a pool
+  static constexpr size_t SCRATCH_SIZE_IN_BYTES = 256 * 1024;
+
   AnimationManager()
       : m_activeAnims(200),
+        m_playerLods(200),
         m_handleToConfig(500),
         m_nameToConfigHandle(50),
         m_animationClipCache(500),
         m_skeletonCache(50),
         m_keywordRegisterMap(50){};
-  ~AnimationManager() = default;
+  ~AnimationManager();
 
   // loader functions
   // those functions either get an already loaded json file
@@ -65,14 +95,36 @@ class AnimationManager final {
   // evaluates the registered resources which are skins and
   // animations, skins should only be registered for debug
   // purpose, otherwise let the rendering component do the
-  // skinning at render time
-  void evaluate() const;
+  // skinning at render time.
+  // The players get updated on the calling thread first, then their poses
+  // are evaluated in parallel on the pool when one is given. Clips and
+  // skeletons are all loaded when the players get created, during the
+  // evaluation the manager is only read.
+  // Every player gets a lod tier out of its distance from the view, the tier
+  // decides whether the player is evaluated, interpolated or left alone this
+  // frame, see AnimationLodTier
+  void evaluate(WorkerPool *pool = nullptr);
+  // tiers sorted by distance, the defaults animate everything every frame up
+  // to 30 units and the far away players at a quarter of the rate, with no
+  // fingers
+  void setLodTiers(const AnimationLodTier tiers[ANIMATION_LOD_TIER_COUNT]);
+  inline void setLodViewPosition(const glm::vec3 &position) {
+    m_lodViewPosition = position;
+  }
+  [[nodiscard]] uint32_t getPlayerLodTier(const uint32_t playerIndex) const {
+    return m_playerLods[playerIndex].tier;
+  }
   inline const AnimClock &getAnimClock() const { return m_animClock; }
   inline int animationKeywordNameToValue(const char *key) const {
     int value = -1;
     const bool found = m_keywordRegisterMap.get(key, value);
     return found ? value : -1;
   }
+  // keyword names to values, for the state machines resolving their keywords
+  // at load time
+  inline const HashMap<const char *, int, hashString32> &getKeywordMap() const {
+    return m_keywordRegisterMap;
+  }
   [[nodiscard]] Skeleton *loadSkeleton(const char *name, const char *path);
 
   inline const AnimationClip *getAnimationClipByName(const char *name) const {
@@ -111,10 +163,45 @@ class AnimationManager final {
     return found ? skeleton : nullptr;
   };
 
+ private:
+  enum class LOD_ACTION { EVALUATE, INTERPOLATE, SKIP };
+  // lod state of a registered player, same index as in m_activeAnims
+  struct PlayerLod {
+    // the last two evaluations, allocated as a single block the first time
+    // the player lands in an interpolating tier, they swap at every update
+    float *history = nullptr;
+    float *fromStreams = nullptr;
+    float *toStreams = nullptr;
+    // spreads the updates of the players sharing a tier over the frames
+    uint32_t phase = 0;
+    uint32_t tier = ANIMATION_LOD_TIER_COUNT;
+    float interpolationFactor = 0.0f;
+    LOD_ACTION action = LOD_ACTION::EVALUATE;
+    bool interpolate = false;
+    // whether the from and to streams hold evaluations for the current tier
+    bool hasHistory = false;
+  };
+
+  // picks the tier and what to do with the player this frame, main thread
+  void updatePlayerLod(uint32_t playerIndex);
+  // runs the action picked for the player, from any thread
+  void evaluatePlayer(uint32_t playerIndex, long long stampNS,
+                      StackAllocator &scratch);
+
  private:
   typedef uint64_t string64;
   // resources to be evaluated per frame
   ResizableVector<AnimationPlayer *> m_activeAnims;
+  ResizableVector<PlayerLod> m_playerLods;
+  AnimationLodTier m_lodTiers[ANIMATION_LOD_TIER_COUNT] = {
+      {30.0f, 1, false, -1},
+      {60.0f, 2, true, -1},
+      {120.0f, 4, true, 8},
+      {1000000.0f, 4, false, 8}};
+  glm::vec3 m_lodViewPosition{0.0f};
+  uint32_t m_lodFrame = 0;
+  // players that entered each tier so far, gives the next one its phase
+  uint32_t m_lodTierArrivals[ANIMATION_LOD_TIER_COUNT] = {};
 
   AnimClock m_animClock;
   HashMap<uint32_t, AnimationPlayer *, hashUint32> m_handleToConfig;
@@ -124,6 +211,8 @@ class AnimationManager final {
   HashMap<const char *, Skeleton *, hashString32> m_skeletonCache;
 
   HashMap<const char *, int, hashString32> m_keywordRegisterMap;
-  unsigned int configIndex = 0;
+  // zero is the invalid handle
+  unsigned int configIndex = 1;
+  StackAllocator m_scratch;
 };
 }  // namespace SirEngine
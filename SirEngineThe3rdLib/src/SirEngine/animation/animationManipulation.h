@@ -1,10 +1,16 @@
 #pragma once
+#include <stdint.h>
+
 #include <glm/glm.hpp>
 
+#include "SirEngine/animation/poseStreams.h"
+
 namespace SirEngine {
 
 // forward declares
 struct SkeletonPose;
+struct AnimationClip;
+class ClipCursor;
 
 enum class ANIM_CLIP_KEYWORDS { L_FOOT_DOWN = 1, R_FOOT_DOWN = 2, NONE };
 
@@ -22,8 +28,8 @@ struct AnimationMetadataKey {
 enum class TRANSITION_STATUS { NEW, TRANSITIONING, DONE };
 
 struct Transition {
-  const char *m_targetAnimation = nullptr;
-  const char *m_targetState = nullptr;
+  const AnimationClip *m_targetClip = nullptr;
+  long long m_targetState = 0;
   // long long m_destinationOriginalTime = 0;
   int m_transitionFrameSrc = 0;
   int m_transitionFrameDest = 0;
@@ -44,6 +50,7 @@ struct AnimationEvalRequest {
   float m_multiplier = 1.0f;
   bool convertToGlobals = true;
   glm::mat4 m_transform;
+  uint32_t m_animatedJointCount = POSE_ALL_JOINTS;
 };
 
 struct InterpolateTwoPosesRequest {
@@ -57,6 +64,24 @@ struct InterpolateTwoPosesRequest {
 struct AnimationEvalRequest;
 struct InterpolateTwoPosesRequest;
 
+// the frame the clip is at, at the given time, and how far into it
+void getAnimationClipFrame(const AnimationClip *clip, long long stampNS,
+                           long long originTime, float multiplier,
+                           uint32_t &outFrame, float &outFraction);
+
+// samples the clip at the given time, in local space, into pose streams, see
+// poseStreams.h
+void sampleAnimationClip(const AnimationClip *clip, long long stampNS,
+                         long long originTime, float multiplier,
+                         float *outStreams,
+                         uint32_t animatedJointCount = POSE_ALL_JOINTS);
+// same but going through the decoded segments of the cursor, the cursor has
+// to be initialized on the clip
+void sampleAnimationClip(const AnimationClip *clip, long long stampNS,
+                         long long originTime, float multiplier,
+                         ClipCursor &cursor, float *outStreams,
+                         uint32_t animatedJointCount = POSE_ALL_JOINTS);
+
 void evaluateAnim(const AnimationEvalRequest* request);
 
 void interpolateTwoPoses(InterpolateTwoPosesRequest& request);
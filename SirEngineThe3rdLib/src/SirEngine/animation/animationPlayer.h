@@ -1,25 +1,51 @@
 #pragma once
 #include <stdint.h>
 
+#include <glm/glm.hpp>
+
+#include "SirEngine/animation/poseStreams.h"
+
 namespace SirEngine {
 
 enum class ANIM_FLAGS { READY = 1, NEW_MATRICES = 2 };
 
 struct SkeletonPose;
+class StackAllocator;
 // Abstract interface for something that can evaluate animation,
 class AnimationPlayer {
 public:
   AnimationPlayer() = default;
   virtual ~AnimationPlayer() = default;
 
-  // pure function used to evaluate the the animation
-  virtual void evaluate(long long stampNS) = 0;
+  // called on the main thread for every player before any of them gets
+  // evaluated, anything touching shared state, like scripting, input or the
+  // string pools, belongs here
+  virtual void update(long long) {}
+  // pure function used to evaluate the the animation, players get evaluated
+  // in parallel so it must only touch the player own data and read the
+  // animation manager. Temporary memory comes from the scratch allocator, it
+  // belongs to the calling thread and must be freed before returning.
+  // The player only writes the local streams of its out pose, at least the
+  // first getAnimatedJointCount() joints of it, the animation manager turns
+  // them in matrices and decides how often players get evaluated, see
+  // AnimationLodTier
+  virtual void evaluate(long long stampNS, StackAllocator &scratch) = 0;
 
   // getters/setters
   virtual uint32_t getJointCount() const = 0;
   [[nodiscard]] SkeletonPose *getOutPose() const { return m_outPose; };
   inline ANIM_FLAGS getFlags() const { return m_flags; }
   inline void setFlags(const ANIM_FLAGS flag) { m_flags = flag; }
+  [[nodiscard]] const glm::mat4 &getTransform() const { return m_transform; }
+  inline void setTransform(const glm::mat4 &transform) {
+    m_transform = transform;
+  }
+  [[nodiscard]] uint32_t getAnimatedJointCount() const {
+    return m_animatedJointCount;
+  }
+  inline void setAnimatedJointCount(const uint32_t count) {
+    m_animatedJointCount = count;
+  }
 
 protected:
   long long m_startTimeStamp; // high resolution time stamp of when the
@@ -27,6 +53,10 @@ protected:
   SkeletonPose *m_outPose =
       nullptr; // where the evluated matrices will be stored
   ANIM_FLAGS m_flags;
+  // moves the whole skeleton in the world
+  glm::mat4 m_transform{1.0f};
+  // set by the manager, the lod might not need the whole skeleton
+  uint32_t m_animatedJointCount = POSE_ALL_JOINTS;
 };
 
 } // namespace SirEngine
\ No newline at end of file
@@ -0,0 +1,898 @@
+#include "SirEngine/animation/blendTree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <string>
+
+#include "SirEngine/animation/animationClip.h"
+#include "SirEngine/animation/animationManipulation.h"
+#include "SirEngine/log.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "nlohmann/json.hpp"
+
+namespace SirEngine {
+
+static const char *BLEND_TREE_KEY_PARAMETERS = "parameters";
+static const char *BLEND_TREE_KEY_CLIPS = "clips";
+static const char *BLEND_TREE_KEY_MASKS = "masks";
+static const char *BLEND_TREE_KEY_ROOT = "root";
+static const char *BLEND_TREE_KEY_TYPE = "type";
+static const char *BLEND_TREE_KEY_CLIP = "clip";
+static const char *BLEND_TREE_KEY_SPEED = "speed";
+static const char *BLEND_TREE_KEY_WEIGHT = "weight";
+static const char *BLEND_TREE_KEY_INPUTS = "inputs";
+static const char *BLEND_TREE_KEY_NODE = "node";
+static const char *BLEND_TREE_KEY_PARAMETER = "parameter";
+static const char *BLEND_TREE_KEY_POSITION = "position";
+static const char *BLEND_TREE_KEY_BASE = "base";
+static const char *BLEND_TREE_KEY_ADDITIVE = "additive";
+static const char *BLEND_TREE_KEY_REFERENCE = "reference";
+static const char *BLEND_TREE_KEY_MASK = "mask";
+static const char *BLEND_TREE_KEY_OVERLAY = "overlay";
+static const char *BLEND_TREE_KEY_DEFAULT = "default";
+static const char *BLEND_TREE_KEY_JOINTS = "joints";
+
+namespace {
+// computed weight slots come after the constants, whose count is only known
+// at the end, they get marked and patched once the tree is done
+constexpr uint16_t COMPUTED_WEIGHT_FLAG = 0x8000;
+
+struct BlendTreeCompiler {
+  std::vector<BlendTreeInstruction> instructions;
+  std::vector<std::string> parameters;
+  std::vector<std::string> clipNames;
+  std::vector<std::string> clipPaths;
+  std::vector<std::string> maskNames;
+  std::vector<BlendTreeMask> masks;
+  std::vector<BlendTreeMaskEntry> maskEntries;
+  std::vector<float> constants;
+  // blend spaces positions, after the constants in the program
+  std::vector<float> tables;
+  uint16_t computedWeightCount = 0;
+  uint32_t poseSlotCount = 0;
+
+  template <typename T>
+  static int findName(const std::vector<T> &names, const std::string &name) {
+    const auto found = std::find(names.begin(), names.end(), name);
+    return found == names.end() ? -1
+                                : static_cast<int>(found - names.begin());
+  }
+
+  BlendTreeInstruction &emit(const BLEND_TREE_OP op, const uint32_t slot) {
+    BlendTreeInstruction instruction{};
+    instruction.op = op;
+    instruction.pose = static_cast<uint16_t>(slot);
+    instruction.inputPose = BLEND_TREE_NO_POSE;
+    instruction.referencePose = BLEND_TREE_NO_POSE;
+    instruction.speed = 1.0f;
+    instructions.push_back(instruction);
+    return instructions.back();
+  }
+
+  uint16_t allocateWeights(const uint32_t count) {
+    const uint16_t first = COMPUTED_WEIGHT_FLAG | computedWeightCount;
+    computedWeightCount += static_cast<uint16_t>(count);
+    return first;
+  }
+
+  // a number becomes a constant, a string has to be a parameter
+  bool parseWeight(const nlohmann::json &value, uint16_t &outSlot) {
+    if (value.is_number()) {
+      outSlot = static_cast<uint16_t>(parameters.size() + constants.size());
+      constants.push_back(value.get<float>());
+      return true;
+    }
+    if (value.is_string()) {
+      const int parameter = findName(parameters, value.get<std::string>());
+      if (parameter < 0) {
+        SE_CORE_ERROR("[Blend Tree] : unknown parameter {0}",
+                      value.get<std::string>());
+        return false;
+      }
+      outSlot = static_cast<uint16_t>(parameter);
+      return true;
+    }
+    SE_CORE_ERROR("[Blend Tree] : weights are either numbers or parameters");
+    return false;
+  }
+  bool parseWeight(const nlohmann::json &node, const char *key,
+                   const float defaultValue, uint16_t &outSlot) {
+    const auto found = node.find(key);
+    return parseWeight(found != node.end() ? *found
+                                           : nlohmann::json(defaultValue),
+                       outSlot);
+  }
+
+  bool parseMasks(const nlohmann::json &jObj) {
+    const auto found = jObj.find(BLEND_TREE_KEY_MASKS);
+    if (found == jObj.end()) {
+      return true;
+    }
+    for (const auto &mask : found->items()) {
+      const nlohmann::json &maskObj = mask.value();
+      BlendTreeMask out{};
+      out.firstEntry = static_cast<uint32_t>(maskEntries.size());
+      out.defaultWeight = maskObj.value(BLEND_TREE_KEY_DEFAULT, 0.0f);
+      const auto joints = maskObj.find(BLEND_TREE_KEY_JOINTS);
+      if (joints != maskObj.end()) {
+        for (const auto &joint : joints->items()) {
+          const int jointIndex = std::stoi(joint.key());
+          if (jointIndex < 0) {
+            SE_CORE_ERROR("[Blend Tree] : mask {0} has a negative joint",
+                          mask.key());
+            return false;
+          }
+          maskEntries.push_back(BlendTreeMaskEntry{
+              static_cast<uint32_t>(jointIndex), joint.value().get<float>()});
+        }
+      }
+      out.entryCount =
+          static_cast<uint32_t>(maskEntries.size()) - out.firstEntry;
+      maskNames.push_back(mask.key());
+      masks.push_back(out);
+    }
+    return true;
+  }
+
+  // the node result goes in slot, its children use the slots after it
+  bool compileNode(const nlohmann::json &node, const uint32_t slot) {
+    poseSlotCount = std::max(poseSlotCount, slot + 1);
+    if (!node.is_object() || node.find(BLEND_TREE_KEY_TYPE) == node.end()) {
+      SE_CORE_ERROR("[Blend Tree] : nodes need to be objects with a type");
+      return false;
+    }
+    const std::string type = node[BLEND_TREE_KEY_TYPE].get<std::string>();
+    if (type == "clip") {
+      return compileClip(node, slot);
+    }
+    if (type == "lerp") {
+      return compileLerp(node, slot);
+    }
+    if (type == "blend" || type == "blend1d" || type == "blend2d") {
+      return compileBlend(node, type, slot);
+    }
+    if (type == "additive") {
+      return compileAdditive(node, slot);
+    }
+    if (type == "mask") {
+      return compileMask(node, slot);
+    }
+    SE_CORE_ERROR("[Blend Tree] : unknown node type {0}", type);
+    return false;
+  }
+
+  bool compileClip(const nlohmann::json &node, const uint32_t slot) {
+    const std::string clip = node.value(BLEND_TREE_KEY_CLIP, std::string());
+    const int clipIndex = findName(clipNames, clip);
+    if (clipIndex < 0) {
+      SE_CORE_ERROR("[Blend Tree] : unknown clip {0}", clip);
+      return false;
+    }
+    BlendTreeInstruction &sample = emit(BLEND_TREE_OP::SAMPLE_CLIP, slot);
+    sample.data = static_cast<uint32_t>(clipIndex);
+    sample.speed = node.value(BLEND_TREE_KEY_SPEED, 1.0f);
+    return true;
+  }
+
+  bool compileLerp(const nlohmann::json &node, const uint32_t slot) {
+    const auto inputs = node.find(BLEND_TREE_KEY_INPUTS);
+    if (inputs == node.end() || inputs->size() != 2) {
+      SE_CORE_ERROR("[Blend Tree] : lerp nodes need two inputs");
+      return false;
+    }
+    uint16_t weight;
+    if (!parseWeight(node, BLEND_TREE_KEY_WEIGHT, 0.0f, weight) ||
+        !compileNode((*inputs)[0], slot) ||
+        !compileNode((*inputs)[1], slot + 1)) {
+      return false;
+    }
+    BlendTreeInstruction &lerp = emit(BLEND_TREE_OP::LERP, slot);
+    lerp.inputPose = static_cast<uint16_t>(slot + 1);
+    lerp.weight = weight;
+    return true;
+  }
+
+  bool compileBlend(const nlohmann::json &node, const std::string &type,
+                    const uint32_t slot) {
+    const auto inputsIt = node.find(BLEND_TREE_KEY_INPUTS);
+    if (inputsIt == node.end() || inputsIt->empty()) {
+      SE_CORE_ERROR("[Blend Tree] : {0} nodes need inputs", type);
+      return false;
+    }
+    std::vector<const nlohmann::json *> inputs;
+    for (const auto &input : *inputsIt) {
+      if (input.find(BLEND_TREE_KEY_NODE) == input.end()) {
+        SE_CORE_ERROR("[Blend Tree] : {0} inputs need a node", type);
+        return false;
+      }
+      inputs.push_back(&input);
+    }
+    const auto count = static_cast<uint32_t>(inputs.size());
+    const uint16_t firstWeight = allocateWeights(count);
+
+    // the weights first
+    if (type == "blend") {
+      for (uint32_t i = 0; i < count; ++i) {
+        uint16_t source;
+        if (!parseWeight(*inputs[i], BLEND_TREE_KEY_WEIGHT, 1.0f, source)) {
+          return false;
+        }
+        BlendTreeInstruction &copyWeight =
+            emit(BLEND_TREE_OP::COPY_WEIGHT, slot);
+        copyWeight.weight = source;
+        copyWeight.outWeight = static_cast<uint16_t>(firstWeight + i);
+      }
+      BlendTreeInstruction &normalize =
+          emit(BLEND_TREE_OP::NORMALIZE_WEIGHTS, slot);
+      normalize.outWeight = firstWeight;
+      normalize.count = count;
+    } else if (type == "blend1d") {
+      // sorted by position, finding the two inputs around the parameter is
+      // then a walk
+      std::stable_sort(inputs.begin(), inputs.end(),
+                       [](const nlohmann::json *a, const nlohmann::json *b) {
+                         return a->value(BLEND_TREE_KEY_POSITION, 0.0f) <
+                                b->value(BLEND_TREE_KEY_POSITION, 0.0f);
+                       });
+      uint16_t parameter;
+      if (!parseWeight(node.value(BLEND_TREE_KEY_PARAMETER, nlohmann::json()),
+                       parameter)) {
+        return false;
+      }
+      const auto offset = static_cast<uint32_t>(tables.size());
+      for (uint32_t i = 0; i < count; ++i) {
+        const float position = inputs[i]->value(BLEND_TREE_KEY_POSITION, 0.0f);
+        if (i > 0 && position <= tables.back()) {
+          SE_CORE_ERROR("[Blend Tree] : blend1d positions need to differ");
+          return false;
+        }
+        tables.push_back(position);
+      }
+      BlendTreeInstruction &weights = emit(BLEND_TREE_OP::BLEND_SPACE_1D, slot);
+      weights.weight = parameter;
+      weights.outWeight = firstWeight;
+      weights.data = offset;
+      weights.count = count;
+    } else {
+      const auto parametersIt = node.find(BLEND_TREE_KEY_PARAMETERS);
+      if (parametersIt == node.end() || parametersIt->size() != 2) {
+        SE_CORE_ERROR("[Blend Tree] : blend2d nodes need two parameters");
+        return false;
+      }
+      uint16_t parameterX;
+      uint16_t parameterY;
+      if (!parseWeight((*parametersIt)[0], parameterX) ||
+          !parseWeight((*parametersIt)[1], parameterY)) {
+        return false;
+      }
+      // positions, then for every pair the vector between the two divided by
+      // its squared length, which is what the gradient bands are made of
+      const auto offset = static_cast<uint32_t>(tables.size());
+      std::vector<float> positions;
+      for (const nlohmann::json *input : inputs) {
+        const auto position = input->find(BLEND_TREE_KEY_POSITION);
+        if (position == input->end() || position->size() != 2) {
+          SE_CORE_ERROR("[Blend Tree] : blend2d positions need two values");
+          return false;
+        }
+        positions.push_back((*position)[0].get<float>());
+        positions.push_back((*position)[1].get<float>());
+      }
+      tables.insert(tables.end(), positions.begin(), positions.end());
+      for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t j = 0; j < count; ++j) {
+          const float dx = positions[j * 2] - positions[i * 2];
+          const float dy = positions[j * 2 + 1] - positions[i * 2 + 1];
+          const float lengthSq = dx * dx + dy * dy;
+          if (i != j && lengthSq <= 0.0f) {
+            SE_CORE_ERROR("[Blend Tree] : blend2d positions need to differ");
+            return false;
+          }
+          tables.push_back(i != j ? dx / lengthSq : 0.0f);
+          tables.push_back(i != j ? dy / lengthSq : 0.0f);
+        }
+      }
+      BlendTreeInstruction &weights = emit(BLEND_TREE_OP::BLEND_SPACE_2D, slot);
+      weights.weight = parameterX;
+      weights.weight2 = parameterY;
+      weights.outWeight = firstWeight;
+      weights.data = offset;
+      weights.count = count;
+    }
+
+    // then the inputs that matter get accumulated
+    emit(BLEND_TREE_OP::CLEAR, slot);
+    for (uint32_t i = 0; i < count; ++i) {
+      const auto weight = static_cast<uint16_t>(firstWeight + i);
+      const auto skipIndex = static_cast<uint32_t>(instructions.size());
+      emit(BLEND_TREE_OP::SKIP_IF_ZERO, slot).weight = weight;
+      if (!compileNode((*inputs[i])[BLEND_TREE_KEY_NODE], slot + 1)) {
+        return false;
+      }
+      BlendTreeInstruction &accumulate = emit(BLEND_TREE_OP::ACCUMULATE, slot);
+      accumulate.inputPose = static_cast<uint16_t>(slot + 1);
+      accumulate.weight = weight;
+      instructions[skipIndex].data = static_cast<uint32_t>(instructions.size());
+    }
+    emit(BLEND_TREE_OP::NORMALIZE, slot);
+    return true;
+  }
+
+  bool compileAdditive(const nlohmann::json &node, const uint32_t slot) {
+    if (node.find(BLEND_TREE_KEY_BASE) == node.end() ||
+        node.find(BLEND_TREE_KEY_ADDITIVE) == node.end()) {
+      SE_CORE_ERROR("[Blend Tree] : additive nodes need a base and additive");
+      return false;
+    }
+    uint16_t weight;
+    if (!parseWeight(node, BLEND_TREE_KEY_WEIGHT, 1.0f, weight) ||
+        !compileNode(node[BLEND_TREE_KEY_BASE], slot) ||
+        !compileNode(node[BLEND_TREE_KEY_ADDITIVE], slot + 1)) {
+      return false;
+    }
+    const bool hasReference =
+        node.find(BLEND_TREE_KEY_REFERENCE) != node.end();
+    if (hasReference && !compileNode(node[BLEND_TREE_KEY_REFERENCE], slot + 2)) {
+      return false;
+    }
+    BlendTreeInstruction &additive = emit(BLEND_TREE_OP::ADDITIVE, slot);
+    additive.inputPose = static_cast<uint16_t>(slot + 1);
+    additive.referencePose =
+        hasReference ? static_cast<uint16_t>(slot + 2) : BLEND_TREE_NO_POSE;
+    additive.weight = weight;
+    return true;
+  }
+
+  bool compileMask(const nlohmann::json &node, const uint32_t slot) {
+    const std::string mask = node.value(BLEND_TREE_KEY_MASK, std::string());
+    const int maskIndex = findName(maskNames, mask);
+    if (maskIndex < 0) {
+      SE_CORE_ERROR("[Blend Tree] : unknown mask {0}", mask);
+      return false;
+    }
+    if (node.find(BLEND_TREE_KEY_BASE) == node.end() ||
+        node.find(BLEND_TREE_KEY_OVERLAY) == node.end()) {
+      SE_CORE_ERROR("[Blend Tree] : mask nodes need a base and an overlay");
+      return false;
+    }
+    uint16_t weight;
+    if (!parseWeight(node, BLEND_TREE_KEY_WEIGHT, 1.0f, weight) ||
+        !compileNode(node[BLEND_TREE_KEY_BASE], slot) ||
+        !compileNode(node[BLEND_TREE_KEY_OVERLAY], slot + 1)) {
+      return false;
+    }
+    BlendTreeInstruction &masked = emit(BLEND_TREE_OP::MASK, slot);
+    masked.inputPose = static_cast<uint16_t>(slot + 1);
+    masked.weight = weight;
+    masked.data = static_cast<uint32_t>(maskIndex);
+    return true;
+  }
+
+  // the computed weights go after the constants, the tables after the
+  // constants as well
+  void patchSlots() {
+    const auto computedBase =
+        static_cast<uint16_t>(parameters.size() + constants.size());
+    const auto patch = [computedBase](uint16_t &slot) {
+      if ((slot & COMPUTED_WEIGHT_FLAG) != 0) {
+        slot = computedBase + (slot & ~COMPUTED_WEIGHT_FLAG);
+      }
+    };
+    for (BlendTreeInstruction &instruction : instructions) {
+      patch(instruction.weight);
+      patch(instruction.weight2);
+      patch(instruction.outWeight);
+      if (instruction.op == BLEND_TREE_OP::BLEND_SPACE_1D ||
+          instruction.op == BLEND_TREE_OP::BLEND_SPACE_2D) {
+        instruction.data += static_cast<uint32_t>(constants.size());
+      }
+    }
+  }
+};
+
+template <typename T>
+uint32_t appendBlock(std::vector<char> &out, const T *data,
+                     const size_t count) {
+  const auto offset = static_cast<uint32_t>(out.size());
+  out.resize(out.size() + sizeof(T) * count);
+  if (count != 0) {
+    memcpy(out.data() + offset, data, sizeof(T) * count);
+  }
+  return offset;
+}
+
+uint32_t appendString(std::vector<char> &strings, const std::string &value) {
+  const auto offset = static_cast<uint32_t>(strings.size());
+  strings.insert(strings.end(), value.begin(), value.end());
+  strings.push_back('\0');
+  return offset;
+}
+
+const char *getBlendTreeString(const void *program, const uint32_t offset) {
+  return static_cast<const char *>(program) +
+         getBlendTreeHeader(program)->stringsOffset + offset;
+}
+
+template <typename T>
+const T *getBlendTreeBlock(const void *program, const uint32_t offset) {
+  return reinterpret_cast<const T *>(static_cast<const char *>(program) +
+                                     offset);
+}
+
+void computeBlendSpace1DWeights(const float *positions, const uint32_t count,
+                                const float parameter, float *outWeights) {
+  std::fill(outWeights, outWeights + count, 0.0f);
+  if (parameter <= positions[0]) {
+    outWeights[0] = 1.0f;
+    return;
+  }
+  if (parameter >= positions[count - 1]) {
+    outWeights[count - 1] = 1.0f;
+    return;
+  }
+  uint32_t i = 0;
+  while (parameter > positions[i + 1]) {
+    ++i;
+  }
+  const float t =
+      (parameter - positions[i]) / (positions[i + 1] - positions[i]);
+  outWeights[i] = 1.0f - t;
+  outWeights[i + 1] = t;
+}
+
+// gradient band interpolation: every input has a band towards each of the
+// others, going from one on the input to zero on the other one, its weight is
+// the lowest of them. Works with any layout of the inputs and only the
+// neighbours of the parameters end up with a weight
+void computeBlendSpace2DWeights(const float *table, const uint32_t count,
+                                const float x, const float y,
+                                float *outWeights) {
+  const float *positions = table;
+  const float *bands = table + count * 2;
+  float total = 0.0f;
+  for (uint32_t i = 0; i < count; ++i) {
+    const float vx = x - positions[i * 2];
+    const float vy = y - positions[i * 2 + 1];
+    float weight = 1.0f;
+    for (uint32_t j = 0; j < count; ++j) {
+      if (i != j) {
+        const float *band = bands + (i * count + j) * 2;
+        weight = std::min(weight, 1.0f - (vx * band[0] + vy * band[1]));
+      }
+    }
+    outWeights[i] = std::max(weight, 0.0f);
+    total += outWeights[i];
+  }
+  if (total > 0.0f) {
+    for (uint32_t i = 0; i < count; ++i) {
+      outWeights[i] /= total;
+    }
+  } else {
+    // should not happen, the nearest input takes it all
+    uint32_t nearest = 0;
+    float nearestDistance = FLT_MAX;
+    for (uint32_t i = 0; i < count; ++i) {
+      const float vx = x - positions[i * 2];
+      const float vy = y - positions[i * 2 + 1];
+      const float distance = vx * vx + vy * vy;
+      outWeights[i] = 0.0f;
+      if (distance < nearestDistance) {
+        nearestDistance = distance;
+        nearest = i;
+      }
+    }
+    outWeights[nearest] = 1.0f;
+  }
+}
+
+void normalizeWeights(float *weights, const uint32_t count) {
+  float total = 0.0f;
+  for (uint32_t i = 0; i < count; ++i) {
+    weights[i] = std::max(weights[i], 0.0f);
+    total += weights[i];
+  }
+  if (total <= 0.0f) {
+    // nothing to blend, the first input it is
+    std::fill(weights, weights + count, 0.0f);
+    weights[0] = 1.0f;
+    return;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    weights[i] /= total;
+  }
+}
+
+inline float clampWeight(const float weight) {
+  return std::min(std::max(weight, 0.0f), 1.0f);
+}
+}  // namespace
+
+bool compileBlendTree(const nlohmann::json &jObj,
+                      std::vector<char> &outProgram) {
+  BlendTreeCompiler compiler;
+  const auto parameters = jObj.find(BLEND_TREE_KEY_PARAMETERS);
+  if (parameters != jObj.end()) {
+    for (const auto &parameter : *parameters) {
+      compiler.parameters.push_back(parameter.get<std::string>());
+    }
+  }
+  const auto clips = jObj.find(BLEND_TREE_KEY_CLIPS);
+  if (clips != jObj.end()) {
+    for (const auto &clip : clips->items()) {
+      compiler.clipNames.push_back(clip.key());
+      compiler.clipPaths.push_back(clip.value().get<std::string>());
+    }
+  }
+  if (!compiler.parseMasks(jObj)) {
+    return false;
+  }
+  if (jObj.find(BLEND_TREE_KEY_ROOT) == jObj.end()) {
+    SE_CORE_ERROR("[Blend Tree] : the tree has no root");
+    return false;
+  }
+  if (!compiler.compileNode(jObj[BLEND_TREE_KEY_ROOT], 0)) {
+    return false;
+  }
+  compiler.patchSlots();
+
+  // strings, all in one block at the end
+  std::vector<char> strings;
+  std::vector<uint32_t> parameterOffsets;
+  for (const std::string &parameter : compiler.parameters) {
+    parameterOffsets.push_back(appendString(strings, parameter));
+  }
+  std::vector<BlendTreeClip> programClips;
+  for (size_t i = 0; i < compiler.clipNames.size(); ++i) {
+    const uint32_t nameOffset = appendString(strings, compiler.clipNames[i]);
+    const uint32_t pathOffset = appendString(strings, compiler.clipPaths[i]);
+    programClips.push_back(BlendTreeClip{nameOffset, pathOffset});
+  }
+  std::vector<float> values = compiler.constants;
+  values.insert(values.end(), compiler.tables.begin(), compiler.tables.end());
+
+  BlendTreeProgramHeader header{};
+  header.instructionCount =
+      static_cast<uint32_t>(compiler.instructions.size());
+  header.parameterCount = static_cast<uint32_t>(compiler.parameters.size());
+  header.constantCount = static_cast<uint32_t>(compiler.constants.size());
+  header.weightSlotCount = header.parameterCount + header.constantCount +
+                           compiler.computedWeightCount;
+  header.poseSlotCount = compiler.poseSlotCount;
+  header.clipCount = static_cast<uint32_t>(programClips.size());
+  header.maskCount = static_cast<uint32_t>(compiler.masks.size());
+
+  outProgram.clear();
+  outProgram.resize(sizeof(BlendTreeProgramHeader));
+  header.instructionsOffset =
+      appendBlock(outProgram, compiler.instructions.data(),
+                  compiler.instructions.size());
+  header.parametersOffset = appendBlock(outProgram, parameterOffsets.data(),
+                                        parameterOffsets.size());
+  header.clipsOffset =
+      appendBlock(outProgram, programClips.data(), programClips.size());
+  header.masksOffset =
+      appendBlock(outProgram, compiler.masks.data(), compiler.masks.size());
+  header.maskEntriesOffset = appendBlock(
+      outProgram, compiler.maskEntries.data(), compiler.maskEntries.size());
+  header.valuesOffset = appendBlock(outProgram, values.data(), values.size());
+  header.stringsOffset =
+      appendBlock(outProgram, strings.data(), strings.size());
+  header.sizeInBytes = static_cast<uint32_t>(outProgram.size());
+  memcpy(outProgram.data(), &header, sizeof(BlendTreeProgramHeader));
+  return true;
+}
+
+bool validateBlendTreeProgram(const void *program,
+                              const uint32_t sizeInBytes) {
+  if (sizeInBytes < sizeof(BlendTreeProgramHeader)) {
+    return false;
+  }
+  const BlendTreeProgramHeader *header = getBlendTreeHeader(program);
+  // the evaluation indexes (poseSlotCount - 1) pose buffers
+  if ((header->sizeInBytes != sizeInBytes) | (header->poseSlotCount == 0) |
+      (header->weightSlotCount <
+       uint64_t{header->parameterCount} + header->constantCount)) {
+    return false;
+  }
+
+  // the blocks follow each other in the order compileBlendTree appends them,
+  // the mask entries and the values have no count and go up to the next block
+  const uint64_t parametersOffset =
+      header->instructionsOffset +
+      sizeof(BlendTreeInstruction) * uint64_t{header->instructionCount};
+  const uint64_t clipsOffset =
+      parametersOffset + sizeof(uint32_t) * uint64_t{header->parameterCount};
+  const uint64_t masksOffset =
+      clipsOffset + sizeof(BlendTreeClip) * uint64_t{header->clipCount};
+  const uint64_t maskEntriesOffset =
+      masksOffset + sizeof(BlendTreeMask) * uint64_t{header->maskCount};
+  if ((header->instructionsOffset != sizeof(BlendTreeProgramHeader)) |
+      (header->parametersOffset != parametersOffset) |
+      (header->clipsOffset != clipsOffset) |
+      (header->masksOffset != masksOffset) |
+      (header->maskEntriesOffset != maskEntriesOffset) |
+      (header->valuesOffset < maskEntriesOffset) |
+      (header->stringsOffset < header->valuesOffset) |
+      (header->stringsOffset > sizeInBytes)) {
+    return false;
+  }
+  const uint32_t maskEntriesSize =
+      header->valuesOffset - header->maskEntriesOffset;
+  const uint32_t valuesSize = header->stringsOffset - header->valuesOffset;
+  if ((maskEntriesSize % sizeof(BlendTreeMaskEntry) != 0) |
+      (valuesSize % sizeof(float) != 0)) {
+    return false;
+  }
+  const uint32_t maskEntryCount = maskEntriesSize / sizeof(BlendTreeMaskEntry);
+  const uint32_t valueCount = valuesSize / sizeof(float);
+  if (valueCount < header->constantCount) {
+    return false;
+  }
+
+  // with the block ending on a terminator every offset inside it is a string
+  const uint32_t stringsSize = sizeInBytes - header->stringsOffset;
+  const char *strings = getBlendTreeString(program, 0);
+  if ((stringsSize != 0) && (strings[stringsSize - 1] != '\0')) {
+    return false;
+  }
+  const auto *parameters =
+      getBlendTreeBlock<uint32_t>(program, header->parametersOffset);
+  for (uint32_t i = 0; i < header->parameterCount; ++i) {
+    if (parameters[i] >= stringsSize) {
+      return false;
+    }
+  }
+  const auto *clips =
+      getBlendTreeBlock<BlendTreeClip>(program, header->clipsOffset);
+  for (uint32_t i = 0; i < header->clipCount; ++i) {
+    if ((clips[i].nameOffset >= stringsSize) |
+        (clips[i].pathOffset >= stringsSize)) {
+      return false;
+    }
+  }
+  const auto *masks =
+      getBlendTreeBlock<BlendTreeMask>(program, header->masksOffset);
+  for (uint32_t i = 0; i < header->maskCount; ++i) {
+    if (uint64_t{masks[i].firstEntry} + masks[i].entryCount >
+        maskEntryCount) {
+      return false;
+    }
+  }
+
+  const auto *instructions = getBlendTreeBlock<BlendTreeInstruction>(
+      program, header->instructionsOffset);
+  const uint32_t poseSlotCount = header->poseSlotCount;
+  const uint32_t weightSlotCount = header->weightSlotCount;
+  for (uint32_t pc = 0; pc < header->instructionCount; ++pc) {
+    const BlendTreeInstruction &instruction = instructions[pc];
+    const uint64_t count = instruction.count;
+    const bool hasInputPose = instruction.inputPose < poseSlotCount;
+    const bool hasWeight = instruction.weight < weightSlotCount;
+    // the weights written by the n-way blends
+    const bool hasOutWeights =
+        (count != 0) && (instruction.outWeight + count <= weightSlotCount);
+    bool valid = instruction.pose < poseSlotCount;
+    switch (instruction.op) {
+      case BLEND_TREE_OP::SAMPLE_CLIP:
+        valid &= instruction.data < header->clipCount;
+        break;
+      case BLEND_TREE_OP::LERP:
+      case BLEND_TREE_OP::ACCUMULATE:
+        valid &= hasInputPose & hasWeight;
+        break;
+      case BLEND_TREE_OP::ADDITIVE:
+        valid &= hasInputPose & hasWeight &
+                 ((instruction.referencePose == BLEND_TREE_NO_POSE) |
+                  (instruction.referencePose < poseSlotCount));
+        break;
+      case BLEND_TREE_OP::MASK:
+        valid &= hasInputPose & hasWeight &
+                 (instruction.data < header->maskCount);
+        break;
+      case BLEND_TREE_OP::COPY_WEIGHT:
+        valid &= hasWeight & (instruction.outWeight < weightSlotCount);
+        break;
+      case BLEND_TREE_OP::NORMALIZE_WEIGHTS:
+        valid &= hasOutWeights;
+        break;
+      case BLEND_TREE_OP::BLEND_SPACE_1D:
+        valid &= hasWeight & hasOutWeights &
+                 (instruction.data + count <= valueCount);
+        break;
+      case BLEND_TREE_OP::BLEND_SPACE_2D:
+        // the positions then the bands of every pair, the count is checked
+        // first so the squared one can't overflow
+        valid &= hasWeight & (instruction.weight2 < weightSlotCount) &
+                 hasOutWeights && (count <= valueCount) &&
+                 (instruction.data + count * 2 + count * count * 2 <=
+                  valueCount);
+        break;
+      case BLEND_TREE_OP::CLEAR:
+      case BLEND_TREE_OP::NORMALIZE:
+        break;
+      case BLEND_TREE_OP::SKIP_IF_ZERO:
+        // forward only, the program always runs to its end
+        valid &= hasWeight & (instruction.data > pc) &
+                 (instruction.data <= header->instructionCount);
+        break;
+      default:
+        valid = false;
+        break;
+    }
+    if (!valid) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char *getBlendTreeParameterName(const void *program,
+                                      const uint32_t index) {
+  const BlendTreeProgramHeader *header = getBlendTreeHeader(program);
+  assert(index < header->parameterCount);
+  return getBlendTreeString(
+      program,
+      getBlendTreeBlock<uint32_t>(program, header->parametersOffset)[index]);
+}
+
+int getBlendTreeParameterIndex(const void *program, const char *name) {
+  const uint32_t count = getBlendTreeHeader(program)->parameterCount;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (strcmp(getBlendTreeParameterName(program, i), name) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+const char *getBlendTreeClipName(const void *program, const uint32_t index) {
+  const BlendTreeProgramHeader *header = getBlendTreeHeader(program);
+  assert(index < header->clipCount);
+  return getBlendTreeString(
+      program, getBlendTreeBlock<BlendTreeClip>(program, header->clipsOffset)
+                   [index].nameOffset);
+}
+
+const char *getBlendTreeClipPath(const void *program, const uint32_t index) {
+  const BlendTreeProgramHeader *header = getBlendTreeHeader(program);
+  assert(index < header->clipCount);
+  return getBlendTreeString(
+      program, getBlendTreeBlock<BlendTreeClip>(program, header->clipsOffset)
+                   [index].pathOffset);
+}
+
+uint32_t evaluateBlendTree(const void *program,
+                           const AnimationClip *const *clips,
+                           const float *parameters, const long long stampNS,
+                           const long long originTime,
+                           const uint32_t jointCount, float *outStreams,
+                           StackAllocator &scratch,
+                           const uint32_t animatedJointCount) {
+  const BlendTreeProgramHeader *header = getBlendTreeHeader(program);
+  const auto *instructions = getBlendTreeBlock<BlendTreeInstruction>(
+      program, header->instructionsOffset);
+  const auto *masks =
+      getBlendTreeBlock<BlendTreeMask>(program, header->masksOffset);
+  const auto *maskEntries = getBlendTreeBlock<BlendTreeMaskEntry>(
+      program, header->maskEntriesOffset);
+  const float *values =
+      getBlendTreeBlock<float>(program, header->valuesOffset);
+
+  // all the temporary memory in one go: the weights, the poses past the
+  // output one and the per joint factors of the masks
+  const uint32_t poseSize = getPoseStreamsSize(jointCount);
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const uint32_t maskFactorCount = header->maskCount != 0 ? stride : 0;
+  const size_t scratchSizeInBytes =
+      sizeof(float) * (header->weightSlotCount + maskFactorCount +
+                       (header->poseSlotCount - 1) * poseSize);
+  auto *weights = static_cast<float *>(scratch.allocate(scratchSizeInBytes));
+  float *maskFactors = weights + header->weightSlotCount;
+  float *poses = maskFactors + maskFactorCount;
+  const auto getPose = [outStreams, poses, poseSize](const uint16_t slot) {
+    return slot == 0 ? outStreams : poses + (slot - 1) * poseSize;
+  };
+  memcpy(weights, parameters, sizeof(float) * header->parameterCount);
+  memcpy(weights + header->parameterCount, values,
+         sizeof(float) * header->constantCount);
+
+  uint32_t sampledClips = 0;
+  uint32_t pc = 0;
+  while (pc < header->instructionCount) {
+    const BlendTreeInstruction &instruction = instructions[pc++];
+    float *pose = getPose(instruction.pose);
+    switch (instruction.op) {
+      case BLEND_TREE_OP::SAMPLE_CLIP: {
+        assert(instruction.data < header->clipCount);
+        sampleAnimationClip(clips[instruction.data], stampNS, originTime,
+                            instruction.speed, pose, animatedJointCount);
+        ++sampledClips;
+        break;
+      }
+      case BLEND_TREE_OP::LERP: {
+        interpolatePoseStreams(pose, getPose(instruction.inputPose),
+                               clampWeight(weights[instruction.weight]),
+                               jointCount, pose, animatedJointCount);
+        break;
+      }
+      case BLEND_TREE_OP::ADDITIVE: {
+        const float *reference =
+            instruction.referencePose != BLEND_TREE_NO_POSE
+                ? getPose(instruction.referencePose)
+                : nullptr;
+        addPoseStreams(pose, getPose(instruction.inputPose), reference,
+                       clampWeight(weights[instruction.weight]), jointCount,
+                       pose, animatedJointCount);
+        break;
+      }
+      case BLEND_TREE_OP::MASK: {
+        const BlendTreeMask &mask = masks[instruction.data];
+        const float weight = clampWeight(weights[instruction.weight]);
+        std::fill(maskFactors, maskFactors + stride,
+                  mask.defaultWeight * weight);
+        for (uint32_t i = 0; i < mask.entryCount; ++i) {
+          const BlendTreeMaskEntry &entry = maskEntries[mask.firstEntry + i];
+          if (entry.joint < jointCount) {
+            maskFactors[entry.joint] = entry.weight * weight;
+          }
+        }
+        interpolatePoseStreamsMasked(pose, getPose(instruction.inputPose),
+                                     maskFactors, jointCount, pose,
+                                     animatedJointCount);
+        break;
+      }
+      case BLEND_TREE_OP::COPY_WEIGHT: {
+        weights[instruction.outWeight] = weights[instruction.weight];
+        break;
+      }
+      case BLEND_TREE_OP::NORMALIZE_WEIGHTS: {
+        normalizeWeights(weights + instruction.outWeight, instruction.count);
+        break;
+      }
+      case BLEND_TREE_OP::BLEND_SPACE_1D: {
+        computeBlendSpace1DWeights(values + instruction.data,
+                                   instruction.count,
+                                   weights[instruction.weight],
+                                   weights + instruction.outWeight);
+        break;
+      }
+      case BLEND_TREE_OP::BLEND_SPACE_2D: {
+        computeBlendSpace2DWeights(
+            values + instruction.data, instruction.count,
+            weights[instruction.weight], weights[instruction.weight2],
+            weights + instruction.outWeight);
+        break;
+      }
+      case BLEND_TREE_OP::CLEAR: {
+        clearPoseStreams(pose, jointCount, animatedJointCount);
+        break;
+      }
+      case BLEND_TREE_OP::ACCUMULATE: {
+        accumulatePoseStreams(getPose(instruction.inputPose),
+                              weights[instruction.weight], jointCount, pose,
+                              animatedJointCount);
+        break;
+      }
+      case BLEND_TREE_OP::NORMALIZE: {
+        normalizePoseStreams(pose, jointCount, animatedJointCount);
+        break;
+      }
+      case BLEND_TREE_OP::SKIP_IF_ZERO: {
+        if (weights[instruction.weight] <= 0.0f) {
+          pc = instruction.data;
+        }
+        break;
+      }
+      default:
+        assert(0 && "unknown blend tree instruction");
+        break;
+    }
+  }
+
+  scratch.free(scratchSizeInBytes);
+  return sampledClips;
+}
+
+}  // namespace SirEngine
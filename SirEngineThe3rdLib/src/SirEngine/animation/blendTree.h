@@ -0,0 +1,181 @@
+#pragma once
+#include <stdint.h>
+
+#include <vector>
+
+#include "SirEngine/animation/poseStreams.h"
+#include "nlohmann/json_fwd.hpp"
+
+namespace SirEngine {
+
+struct AnimationClip;
+class StackAllocator;
+
+/*
+Blend trees. The tree is authored as json and compiled offline, by the blend
+tree compiler, into a flat program: the nodes are walked depth first and every
+node becomes a few instructions after the ones of its children, so evaluating
+the tree is a single linear pass over the instructions, no recursion and no
+pointer chasing.
+
+{
+  "parameters" : ["speed", "direction", "aim"],
+  "clips" : {"walk" : "../data/anim/walk.clip", "run" : "..."},
+  "masks" : {"upperBody" : {"default" : 0.0, "joints" : {"12" : 1.0}}},
+  "root" : node
+}
+
+Nodes, a weight is either a number or the name of a parameter:
+
+- {"type" : "clip", "clip" : "walk", "speed" : 1.0}
+- {"type" : "lerp", "weight" : "aim", "inputs" : [node, node]}
+- {"type" : "blend", "inputs" : [{"weight" : 0.3, "node" : node}, ...]}
+  N-way blend, the weights get normalized
+- {"type" : "blend1d", "parameter" : "speed",
+   "inputs" : [{"position" : 0.0, "node" : node}, ...]}
+  the two inputs around the parameter get blended
+- {"type" : "blend2d", "parameters" : ["speed", "direction"],
+   "inputs" : [{"position" : [0.0, 1.0], "node" : node}, ...]}
+  free form blend space, weights from gradient band interpolation
+- {"type" : "additive", "weight" : 1.0, "base" : node, "additive" : node,
+   "reference" : node}
+  adds the difference between additive and reference on top of base, without
+  a reference the additive pose is taken as a difference already
+- {"type" : "mask", "mask" : "upperBody", "weight" : 1.0, "base" : node,
+   "overlay" : node}
+  blends the overlay on the base with a weight per joint, masks are keyed by
+  joint index, the joints not listed take the default
+
+Poses live in slots, a node writes its result in the slot it is given and its
+children use the ones after it, the compiler knows how many slots the tree
+needs and the evaluation takes them from the scratch allocator in one go,
+slot zero being the output pose. N-way blends, blend spaces included, first
+compute the weights of their inputs, then the inputs with a zero weight are
+jumped over, a 16 clips locomotion blend space only samples the three or four
+clips around the parameters.
+
+Weights live in slots too: the parameters, the constants found in the tree,
+then the ones computed by the blend nodes.
+*/
+
+enum class BLEND_TREE_OP : uint32_t {
+  // pose = clip sampled at the player time scaled by speed
+  SAMPLE_CLIP = 0,
+  // pose = lerp(pose, inputPose, weight)
+  LERP,
+  // pose = pose + (inputPose - referencePose) * weight, see addPoseStreams
+  ADDITIVE,
+  // pose = lerp(pose, inputPose, weight * mask), per joint
+  MASK,
+  // weights[outWeight] = weights[weight]
+  COPY_WEIGHT,
+  // weights[outWeight, outWeight + count) /= their sum
+  NORMALIZE_WEIGHTS,
+  // weights[outWeight, outWeight + count) from weights[weight] over the
+  // positions in values[data]
+  BLEND_SPACE_1D,
+  // same from weights[weight] and weights[weight2]
+  BLEND_SPACE_2D,
+  // zeroes pose, ready to accumulate
+  CLEAR,
+  // pose += inputPose * weights[weight]
+  ACCUMULATE,
+  // normalizes the rotations of pose
+  NORMALIZE,
+  // jumps to instruction data when weights[weight] is zero
+  SKIP_IF_ZERO,
+  COUNT
+};
+
+static constexpr uint16_t BLEND_TREE_NO_POSE = 0xFFFF;
+// version of the compiled tree binary files, as written by the blend tree
+// compiler, trees with any other version need recompiling
+static constexpr uint32_t BLEND_TREE_FILE_VERSION = (0 << 16) | (1 << 8);
+
+struct BlendTreeInstruction {
+  BLEND_TREE_OP op;
+  uint16_t pose;
+  uint16_t inputPose;
+  uint16_t referencePose;
+  uint16_t weight;
+  uint16_t weight2;
+  uint16_t outWeight;
+  // clip, mask, values offset or jump target depending on the op
+  uint32_t data;
+  uint32_t count;
+  float speed;
+};
+
+// all the offsets are in bytes from the start of the program, the program is
+// a single relocatable block
+struct BlendTreeProgramHeader {
+  uint32_t sizeInBytes;
+  uint32_t instructionCount;
+  uint32_t instructionsOffset;
+  uint32_t parameterCount;
+  // one string offset per parameter
+  uint32_t parametersOffset;
+  uint32_t constantCount;
+  uint32_t weightSlotCount;
+  uint32_t poseSlotCount;
+  uint32_t clipCount;
+  uint32_t clipsOffset;
+  uint32_t maskCount;
+  uint32_t masksOffset;
+  uint32_t maskEntriesOffset;
+  // floats, the constants first then the blend spaces tables
+  uint32_t valuesOffset;
+  uint32_t stringsOffset;
+};
+
+// offsets from the start of the strings
+struct BlendTreeClip {
+  uint32_t nameOffset;
+  uint32_t pathOffset;
+};
+
+struct BlendTreeMask {
+  uint32_t firstEntry;
+  uint32_t entryCount;
+  float defaultWeight;
+};
+
+struct BlendTreeMaskEntry {
+  uint32_t joint;
+  float weight;
+};
+
+// compiles the json description of the tree, errors get logged and make it
+// return false
+bool compileBlendTree(const nlohmann::json &jObj,
+                      std::vector<char> &outProgram);
+
+// checks a program coming from disk before anything evaluates it: the blocks
+// need to follow each other as the compiler lays them out within sizeInBytes,
+// the strings need to be terminated and every instruction needs a known op,
+// pose and weight slots in range, clip, mask and values indices in range and
+// forward jumps only. The program needs the alignment it is evaluated with.
+// The accessors and the evaluation trust the program and only assert
+bool validateBlendTreeProgram(const void *program, uint32_t sizeInBytes);
+
+inline const BlendTreeProgramHeader *getBlendTreeHeader(const void *program) {
+  return static_cast<const BlendTreeProgramHeader *>(program);
+}
+const char *getBlendTreeParameterName(const void *program, uint32_t index);
+// -1 if the tree has no such parameter
+int getBlendTreeParameterIndex(const void *program, const char *name);
+const char *getBlendTreeClipName(const void *program, uint32_t index);
+const char *getBlendTreeClipPath(const void *program, uint32_t index);
+
+// evaluates the tree in local space into pose streams, clips has one entry
+// per clip of the program, in order, and parameters one per parameter.
+// Temporary poses come from the scratch allocator and are freed before
+// returning. Returns the number of clips sampled
+uint32_t evaluateBlendTree(const void *program,
+                           const AnimationClip *const *clips,
+                           const float *parameters, long long stampNS,
+                           long long originTime, uint32_t jointCount,
+                           float *outStreams, StackAllocator &scratch,
+                           uint32_t animatedJointCount = POSE_ALL_JOINTS);
+
+}  // namespace SirEngine
@@ -0,0 +1,172 @@
+#include "SirEngine/animation/blendTreePlayer.h"
+
+#include "SirEngine/animation/animationClip.h"
+#include "SirEngine/animation/animationManager.h"
+#include "SirEngine/animation/blendTree.h"
+#include "SirEngine/animation/skeleton.h"
+#include "SirEngine/globals.h"
+#include "SirEngine/io/binaryFile.h"
+#include "SirEngine/io/fileUtils.h"
+#include "SirEngine/log.h"
+#include "SirEngine/runtimeString.h"
+#include "nlohmann/json.hpp"
+
+namespace SirEngine {
+
+static const std::string SKELETON_KEY = "skeleton";
+static const std::string BLEND_TREE_KEY = "blendTree";
+static const std::string ANIMATION_CONFIG_NAME_KEY = "name";
+
+BlendTreePlayer::~BlendTreePlayer() {
+  // a failed init leaves some of them unallocated
+  for (void *memory : {m_program, static_cast<void *>(m_clips),
+                       static_cast<void *>(m_parameters)}) {
+    if (memory != nullptr) {
+      globals::PERSISTENT_ALLOCATOR->free(memory);
+    }
+  }
+}
+
+bool BlendTreePlayer::init(AnimationManager *manager,
+                           nlohmann::json &configJson) {
+  const std::string empty;
+
+  const std::string configName =
+      getValueIfInJson(configJson, ANIMATION_CONFIG_NAME_KEY, empty);
+  assert(!configName.empty());
+
+  const std::string blendTreeFile =
+      getValueIfInJson(configJson, BLEND_TREE_KEY, empty);
+  const std::string skeletonFile =
+      getValueIfInJson(configJson, SKELETON_KEY, empty);
+  if (blendTreeFile.empty() || !fileExists(blendTreeFile)) {
+    SE_CORE_ERROR("Blend tree player {0} has no compiled tree, got \"{1}\"",
+                  configName, blendTreeFile);
+    return false;
+  }
+
+  uint32_t fileSize;
+  const char *binaryData = frameFileLoad(blendTreeFile.c_str(), fileSize);
+  if (fileSize < sizeof(BinaryFileHeader)) {
+    SE_CORE_ERROR("Blend tree {0} too small to hold a header: {1} bytes",
+                  blendTreeFile, fileSize);
+    return false;
+  }
+  const BinaryFileHeader *fileHeader = getHeader(binaryData);
+  if (fileHeader->fileType != BinaryFileType::BLEND_TREE) {
+    SE_CORE_ERROR(
+        "Expected blend tree binary file but got {0}: {1}",
+        getBinaryFileTypeName(
+            static_cast<BinaryFileType>(fileHeader->fileType)),
+        blendTreeFile);
+    return false;
+  }
+  if (fileHeader->version != BLEND_TREE_FILE_VERSION) {
+    SE_CORE_ERROR(
+        "Unsupported blend tree version {0}, expected {1}, recompile {2}",
+        fileHeader->version, BLEND_TREE_FILE_VERSION, blendTreeFile);
+    return false;
+  }
+  if (fileHeader->mapperDataOffsetInByte < sizeof(BinaryFileHeader) ||
+      fileHeader->mapperDataOffsetInByte > fileSize ||
+      fileSize - fileHeader->mapperDataOffsetInByte <
+          sizeof(BlendTreeMapperData)) {
+    SE_CORE_ERROR("Truncated blend tree {0}, {1} bytes", blendTreeFile,
+                  fileSize);
+    return false;
+  }
+  // the name and the program sit in between the header and the mapper data
+  const auto mapper = getMapperData<BlendTreeMapperData>(binaryData);
+  const uint64_t bulkSize =
+      fileHeader->mapperDataOffsetInByte - sizeof(BinaryFileHeader);
+  const char *program =
+      binaryData + sizeof(BinaryFileHeader) + mapper->nameSizeInByte;
+  BlendTreeProgramHeader programHeader{};
+  if (static_cast<uint64_t>(mapper->nameSizeInByte) +
+              mapper->programSizeInByte >
+          bulkSize ||
+      mapper->programSizeInByte < sizeof(BlendTreeProgramHeader)) {
+    SE_CORE_ERROR("Corrupted blend tree {0}, data ends past the file",
+                  blendTreeFile);
+    return false;
+  }
+  memcpy(&programHeader, program, sizeof(BlendTreeProgramHeader));
+  if (programHeader.sizeInBytes != mapper->programSizeInByte) {
+    SE_CORE_ERROR(
+        "Corrupted blend tree {0}, program of {1} bytes stored in {2} bytes",
+        blendTreeFile, programHeader.sizeInBytes, mapper->programSizeInByte);
+    return false;
+  }
+
+  // the compiled program is a single relocatable block, loading it is a copy
+  m_program =
+      globals::PERSISTENT_ALLOCATOR->allocate(mapper->programSizeInByte);
+  memcpy(m_program, program, mapper->programSizeInByte);
+  // validated once here, the evaluation trusts the program
+  if (!validateBlendTreeProgram(m_program, mapper->programSizeInByte)) {
+    SE_CORE_ERROR("Corrupted blend tree {0}, invalid program", blendTreeFile);
+    return false;
+  }
+  const BlendTreeProgramHeader *header = getBlendTreeHeader(m_program);
+
+  // skeleton
+  // checking if the skeleton is already cached, if not load it
+  const std::string skeletonFileName = getFileName(skeletonFile);
+  skeleton =
+      manager->loadSkeleton(skeletonFileName.c_str(), skeletonFile.c_str());
+  if (skeleton == nullptr) {
+    SE_CORE_ERROR("Blend tree player {0} could not load skeleton {1}",
+                  configName, skeletonFile);
+    return false;
+  }
+
+  // the clips are shared with every other player through the manager cache
+  m_clips = static_cast<const AnimationClip **>(
+      globals::PERSISTENT_ALLOCATOR->allocate(sizeof(AnimationClip *) *
+                                              header->clipCount));
+  for (uint32_t i = 0; i < header->clipCount; ++i) {
+    const char *clipPath = getBlendTreeClipPath(m_program, i);
+    const std::string clipFileName = getFileName(clipPath);
+    m_clips[i] = manager->loadAnimationClip(clipFileName.c_str(), clipPath);
+    if (m_clips[i] == nullptr) {
+      SE_CORE_ERROR("Blend tree player {0} could not load clip {1}",
+                    configName, clipPath);
+      return false;
+    }
+    if (static_cast<uint32_t>(m_clips[i]->m_bonesPerFrame) !=
+        skeleton->m_jointCount) {
+      SE_CORE_ERROR(
+          "Blend tree player {0}, clip {1} has {2} joints, the skeleton {3}",
+          configName, clipPath, m_clips[i]->m_bonesPerFrame,
+          skeleton->m_jointCount);
+      return false;
+    }
+  }
+
+  m_parameterCount = header->parameterCount;
+  m_parameters = static_cast<float *>(globals::PERSISTENT_ALLOCATOR->allocate(
+      sizeof(float) * m_parameterCount));
+  memset(m_parameters, 0, sizeof(float) * m_parameterCount);
+
+  // allocating named pose
+  m_outPose = manager->getSkeletonPose(skeleton);
+  m_startTimeStamp = manager->getAnimClock().getTicks();
+  m_flags = ANIM_FLAGS::READY;
+  return true;
+}
+
+void BlendTreePlayer::evaluate(const long long stampNS,
+                               StackAllocator &scratch) {
+  evaluateBlendTree(m_program, m_clips, m_parameters, stampNS,
+                    m_startTimeStamp, skeleton->m_jointCount,
+                    m_outPose->m_localStreams, scratch, m_animatedJointCount);
+}
+
+uint32_t BlendTreePlayer::getJointCount() const {
+  return skeleton->m_jointCount;
+}
+
+int BlendTreePlayer::getParameterIndex(const char *name) const {
+  return getBlendTreeParameterIndex(m_program, name);
+}
+} // namespace SirEngine
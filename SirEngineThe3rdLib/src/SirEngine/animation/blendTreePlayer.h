@@ -0,0 +1,44 @@
+#pragma once
+#include <cassert>
+
+#include "SirEngine/animation/animationPlayer.h"
+#include "nlohmann/json_fwd.hpp"
+
+namespace SirEngine {
+struct Skeleton;
+class AnimationManager;
+struct AnimationClip;
+
+// plays a compiled blend tree, see blendTree.h, the parameters get set from
+// gameplay code before the evaluation
+class BlendTreePlayer final : public AnimationPlayer {
+public:
+  BlendTreePlayer() : AnimationPlayer() {}
+  ~BlendTreePlayer() override;
+  // false when the compiled tree or one of its clips can't be loaded, the
+  // errors get logged
+  bool init(AnimationManager *manager, nlohmann::json &configJson);
+  void evaluate(long long stampNS, StackAllocator &scratch) override;
+  [[nodiscard]] uint32_t getJointCount() const override;
+
+  // -1 if the tree has no such parameter
+  [[nodiscard]] int getParameterIndex(const char *name) const;
+  inline void setParameter(const uint32_t index, const float value) {
+    assert(index < m_parameterCount);
+    m_parameters[index] = value;
+  }
+  [[nodiscard]] float getParameter(const uint32_t index) const {
+    assert(index < m_parameterCount);
+    return m_parameters[index];
+  }
+
+private:
+  Skeleton *skeleton = nullptr;
+  void *m_program = nullptr;
+  // one per clip of the program, in the same order
+  const AnimationClip **m_clips = nullptr;
+  float *m_parameters = nullptr;
+  uint32_t m_parameterCount = 0;
+};
+
+} // namespace SirEngine
@@ -0,0 +1,785 @@
+#include "SirEngine/animation/clipCompression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/animation/skeleton.h"
+
+namespace SirEngine {
+
+namespace {
+constexpr float RANGE_QUANTIZED_MAX = 65535.0f;
+constexpr float SMALLEST_THREE_QUANTIZED_MAX = 32767.0f;
+// the three smallest components of a unit quaternion are within +-1/sqrt(2)
+constexpr float SMALLEST_THREE_RANGE = 0.70710678f;
+
+// every track value fits in four floats, rotations are x,y,z,w
+struct TrackValue {
+  float v[4];
+};
+
+uint32_t getComponentCount(const TRACK_TYPE type) {
+  switch (type) {
+    case TRACK_TYPE::ROTATION:
+      return 4;
+    case TRACK_TYPE::TRANSLATION:
+      return 3;
+    default:
+      return 1;
+  }
+}
+
+TrackValue getIdentityValue(const TRACK_TYPE type) {
+  switch (type) {
+    case TRACK_TYPE::ROTATION:
+      return {{0.0f, 0.0f, 0.0f, 1.0f}};
+    case TRACK_TYPE::TRANSLATION:
+      return {{0.0f, 0.0f, 0.0f, 0.0f}};
+    default:
+      return {{1.0f, 0.0f, 0.0f, 0.0f}};
+  }
+}
+
+uint32_t getKeySizeInBytes(const TRACK_TYPE type, const TRACK_FORMAT format) {
+  switch (format) {
+    case TRACK_FORMAT::IDENTITY:
+      return 0;
+    case TRACK_FORMAT::QUANTIZED:
+      // smallest three packs a rotation in the same space as a translation
+      return type == TRACK_TYPE::SCALE ? sizeof(uint16_t)
+                                       : sizeof(uint16_t) * 3;
+    default:
+      return sizeof(float) * getComponentCount(type);
+  }
+}
+
+// quantized translations and scale store min and extent of every component
+// in front of the keys
+uint32_t getRangeSizeInBytes(const TRACK_TYPE type, const TRACK_FORMAT format) {
+  return format == TRACK_FORMAT::QUANTIZED && type != TRACK_TYPE::ROTATION
+             ? sizeof(float) * 2 * getComponentCount(type)
+             : 0;
+}
+
+void encodeSmallestThree(const float *rot, uint16_t *out) {
+  float q[4];
+  const float length = std::sqrt(rot[0] * rot[0] + rot[1] * rot[1] +
+                                 rot[2] * rot[2] + rot[3] * rot[3]);
+  uint32_t largest = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    q[i] = rot[i] / length;
+    if (std::abs(q[i]) > std::abs(q[largest])) {
+      largest = i;
+    }
+  }
+  // q and -q are the same rotation, flipping keeps the dropped component
+  // positive so the decoder can rebuild it
+  const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+  uint32_t component = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (i == largest) {
+      continue;
+    }
+    const float normalized =
+        std::clamp(q[i] * sign / SMALLEST_THREE_RANGE, -1.0f, 1.0f);
+    out[component++] = static_cast<uint16_t>(std::lround(
+        (normalized * 0.5f + 0.5f) * SMALLEST_THREE_QUANTIZED_MAX));
+  }
+  // the index of the dropped component goes in the spare top bits
+  out[0] |= static_cast<uint16_t>((largest >> 1) << 15);
+  out[1] |= static_cast<uint16_t>((largest & 1) << 15);
+}
+
+void decodeSmallestThree(const uint16_t *in, float *rot) {
+  const uint32_t largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+  float lengthSq = 0.0f;
+  uint32_t component = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (i == largest) {
+      continue;
+    }
+    const float quantized = static_cast<float>(in[component++] & 0x7FFF);
+    const float value =
+        (quantized / SMALLEST_THREE_QUANTIZED_MAX * 2.0f - 1.0f) *
+        SMALLEST_THREE_RANGE;
+    rot[i] = value;
+    lengthSq += value * value;
+  }
+  rot[largest] = std::sqrt(std::max(0.0f, 1.0f - lengthSq));
+}
+
+// range is min then extent per component, only used by quantized tracks.
+// Values are not aligned in the compressed block, everything goes through
+// memcpy
+void encodeKey(const TRACK_TYPE type, const TRACK_FORMAT format,
+               const float *range, const TrackValue &value, char *out) {
+  const uint32_t componentCount = getComponentCount(type);
+  if (format != TRACK_FORMAT::QUANTIZED) {
+    memcpy(out, value.v, getKeySizeInBytes(type, format));
+    return;
+  }
+  uint16_t quantized[3];
+  if (type == TRACK_TYPE::ROTATION) {
+    encodeSmallestThree(value.v, quantized);
+  } else {
+    for (uint32_t i = 0; i < componentCount; ++i) {
+      const float extent = range[componentCount + i];
+      const float normalized =
+          extent > 0.0f ? (value.v[i] - range[i]) / extent : 0.0f;
+      quantized[i] = static_cast<uint16_t>(std::lround(
+          std::clamp(normalized, 0.0f, 1.0f) * RANGE_QUANTIZED_MAX));
+    }
+  }
+  memcpy(out, quantized, getKeySizeInBytes(type, format));
+}
+
+TrackValue decodeKey(const TRACK_TYPE type, const TRACK_FORMAT format,
+                     const char *range, const char *key) {
+  if (format == TRACK_FORMAT::IDENTITY) {
+    return getIdentityValue(type);
+  }
+  TrackValue value{{0.0f, 0.0f, 0.0f, 0.0f}};
+  if (format != TRACK_FORMAT::QUANTIZED) {
+    memcpy(value.v, key, getKeySizeInBytes(type, format));
+    return value;
+  }
+  uint16_t quantized[3];
+  memcpy(quantized, key, getKeySizeInBytes(type, format));
+  if (type == TRACK_TYPE::ROTATION) {
+    decodeSmallestThree(quantized, value.v);
+    return value;
+  }
+  const uint32_t componentCount = getComponentCount(type);
+  float rangeValues[6];
+  memcpy(rangeValues, range, sizeof(float) * 2 * componentCount);
+  for (uint32_t i = 0; i < componentCount; ++i) {
+    value.v[i] = rangeValues[i] + rangeValues[componentCount + i] *
+                                      static_cast<float>(quantized[i]) /
+                                      RANGE_QUANTIZED_MAX;
+  }
+  return value;
+}
+
+// rotations are always normalized lerped on the short path, the compressor
+// validates every key span with this same function so there is no need for
+// the slerp fallback of the pose streams kernel, wide spans just get split
+TrackValue interpolateKeys(const TRACK_TYPE type, const TrackValue &a,
+                           const TrackValue &b, const float factor) {
+  TrackValue out{{0.0f, 0.0f, 0.0f, 0.0f}};
+  if (type != TRACK_TYPE::ROTATION) {
+    for (uint32_t i = 0; i < 3; ++i) {
+      out.v[i] = a.v[i] + factor * (b.v[i] - a.v[i]);
+    }
+    return out;
+  }
+  const float dot = a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2] +
+                    a.v[3] * b.v[3];
+  const float sign = dot < 0.0f ? -1.0f : 1.0f;
+  float lengthSq = 0.0f;
+  for (uint32_t i = 0; i < 4; ++i) {
+    out.v[i] = a.v[i] + factor * (b.v[i] * sign - a.v[i]);
+    lengthSq += out.v[i] * out.v[i];
+  }
+  const float invLength = 1.0f / std::sqrt(lengthSq);
+  for (float &component : out.v) {
+    component *= invLength;
+  }
+  return out;
+}
+
+// measured in double, the rotation tolerances are close to the float
+// precision of a quaternion dot product
+double getError(const TRACK_TYPE type, const TrackValue &value,
+                const TrackValue &reference) {
+  if (type == TRACK_TYPE::ROTATION) {
+    double dot = 0.0;
+    double valueLengthSq = 0.0;
+    double referenceLengthSq = 0.0;
+    for (uint32_t i = 0; i < 4; ++i) {
+      dot += static_cast<double>(value.v[i]) * reference.v[i];
+      valueLengthSq += static_cast<double>(value.v[i]) * value.v[i];
+      referenceLengthSq +=
+          static_cast<double>(reference.v[i]) * reference.v[i];
+    }
+    const double cosHalfAngle =
+        std::abs(dot) / std::sqrt(valueLengthSq * referenceLengthSq);
+    return 2.0 * std::acos(std::min(1.0, cosHalfAngle));
+  }
+  double distanceSq = 0.0;
+  for (uint32_t i = 0; i < 3; ++i) {
+    const double delta = static_cast<double>(value.v[i]) - reference.v[i];
+    distanceSq += delta * delta;
+  }
+  return std::sqrt(distanceSq);
+}
+
+TrackValue getSourceValue(const TRACK_TYPE type, const JointPose &pose) {
+  switch (type) {
+    case TRACK_TYPE::ROTATION:
+      return {{pose.m_rot.x, pose.m_rot.y, pose.m_rot.z, pose.m_rot.w}};
+    case TRACK_TYPE::TRANSLATION:
+      return {{pose.m_trans.x, pose.m_trans.y, pose.m_trans.z, 0.0f}};
+    default:
+      return {{pose.m_scale, 0.0f, 0.0f, 0.0f}};
+  }
+}
+
+bool isWithinTolerance(const TRACK_TYPE type,
+                       const std::vector<TrackValue> &source,
+                       const TrackValue &value, const double tolerance) {
+  for (const TrackValue &sourceValue : source) {
+    if (getError(type, value, sourceValue) > tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isSpanWithinTolerance(const TRACK_TYPE type,
+                           const std::vector<TrackValue> &source,
+                           const std::vector<TrackValue> &decoded,
+                           const uint32_t start, const uint32_t end,
+                           const double tolerance) {
+  const float span = static_cast<float>(end - start);
+  for (uint32_t frame = start + 1; frame < end; ++frame) {
+    const TrackValue value =
+        interpolateKeys(type, decoded[start], decoded[end],
+                        static_cast<float>(frame - start) / span);
+    if (getError(type, value, source[frame]) > tolerance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// finds format and keys of a track, appends the key frames in between the
+// first and last one and the values
+CompressedTrack compressTrack(const TRACK_TYPE type,
+                              const std::vector<TrackValue> &source,
+                              const double tolerance,
+                              std::vector<uint8_t> &keyFrames,
+                              std::vector<char> &values) {
+  const auto frameCount = static_cast<uint32_t>(source.size());
+  const uint32_t componentCount = getComponentCount(type);
+  TRACK_FORMAT format = TRACK_FORMAT::RAW;
+  std::vector<uint32_t> keys;
+  // min then extent per component
+  float range[6]{};
+  if (isWithinTolerance(type, source, getIdentityValue(type), tolerance)) {
+    format = TRACK_FORMAT::IDENTITY;
+  } else if (isWithinTolerance(type, source, source[0], tolerance)) {
+    format = TRACK_FORMAT::CONSTANT;
+    keys.push_back(0);
+  } else {
+    for (uint32_t c = 0; c < componentCount; ++c) {
+      float minValue = source[0].v[c];
+      float maxValue = source[0].v[c];
+      for (const TrackValue &value : source) {
+        minValue = std::min(minValue, value.v[c]);
+        maxValue = std::max(maxValue, value.v[c]);
+      }
+      range[c] = minValue;
+      range[componentCount + c] = maxValue - minValue;
+    }
+    // quantized when the precision allows it, raw otherwise
+    std::vector<TrackValue> decoded(frameCount);
+    for (const TRACK_FORMAT candidate :
+         {TRACK_FORMAT::QUANTIZED, TRACK_FORMAT::RAW}) {
+      format = candidate;
+      bool quantizationFits = true;
+      char encoded[sizeof(TrackValue)];
+      for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        encodeKey(type, format, range, source[frame], encoded);
+        decoded[frame] = decodeKey(
+            type, format, reinterpret_cast<const char *>(range), encoded);
+        quantizationFits &=
+            getError(type, decoded[frame], source[frame]) <= tolerance;
+      }
+      if (quantizationFits) {
+        break;
+      }
+    }
+
+    // greedy key reduction, from every key we reach as far as the
+    // interpolation of the decoded values stays within tolerance, the
+    // segment length bounds the cost
+    keys.push_back(0);
+    uint32_t start = 0;
+    const uint32_t lastFrame = frameCount - 1;
+    while (start < lastFrame) {
+      uint32_t end = start + 1;
+      while (end < lastFrame &&
+             isSpanWithinTolerance(type, source, decoded, start, end + 1,
+                                   tolerance)) {
+        ++end;
+      }
+      keys.push_back(end);
+      start = end;
+    }
+    for (size_t i = 1; i + 1 < keys.size(); ++i) {
+      keyFrames.push_back(static_cast<uint8_t>(keys[i]));
+    }
+  }
+
+  const uint32_t rangeSize = getRangeSizeInBytes(type, format);
+  const uint32_t keySize = getKeySizeInBytes(type, format);
+  const size_t offset = values.size();
+  values.resize(offset + rangeSize + keySize * keys.size());
+  char *out = values.data() + offset;
+  memcpy(out, range, rangeSize);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    encodeKey(type, format, range, source[keys[i]],
+              out + rangeSize + i * keySize);
+  }
+  CompressedTrack track{};
+  track.format = static_cast<uint16_t>(format);
+  track.keyCount = static_cast<uint16_t>(keys.size());
+  return track;
+}
+
+// a track of a segment ready to be sampled
+struct TrackView {
+  TRACK_TYPE type;
+  TRACK_FORMAT format;
+  uint32_t keyCount;
+  uint32_t keySize;
+  // only the key frames in between the first and the last key
+  const uint8_t *innerKeyFrames;
+  const char *range;
+  const char *keys;
+
+  [[nodiscard]] uint32_t getKeyFrame(const uint32_t key,
+                                     const uint32_t lastFrame) const {
+    if (key == 0) {
+      return 0;
+    }
+    return key + 1 == keyCount ? lastFrame : innerKeyFrames[key - 1];
+  }
+  [[nodiscard]] TrackValue decode(const uint32_t key) const {
+    return decodeKey(type, format, range, keys + key * keySize);
+  }
+};
+
+// walks the tracks of a segment in order, key frames and values of a track
+// start where the ones of the previous track end
+class SegmentReader {
+ public:
+  SegmentReader(const void *compressed, const uint32_t segment) {
+    const auto *data = static_cast<const char *>(compressed);
+    const auto *header = reinterpret_cast<const CompressedClipHeader *>(data);
+    assert(segment < header->segmentCount);
+    const auto *offsets = reinterpret_cast<const uint32_t *>(
+        data + sizeof(CompressedClipHeader));
+    const char *segmentData = data + offsets[segment];
+    const auto *segmentHeader =
+        reinterpret_cast<const CompressedSegmentHeader *>(segmentData);
+    m_tracks = reinterpret_cast<const CompressedTrack *>(
+        segmentData + sizeof(CompressedSegmentHeader));
+    m_keyFrames = reinterpret_cast<const uint8_t *>(
+        segmentData + segmentHeader->keyFramesOffsetInBytes);
+    m_values = segmentData + segmentHeader->valuesOffsetInBytes;
+    m_frameCount = segmentHeader->frameCount;
+  }
+
+  TrackView next(const TRACK_TYPE type) {
+    const CompressedTrack track = *m_tracks++;
+    TrackView view{};
+    view.type = type;
+    view.format = static_cast<TRACK_FORMAT>(track.format);
+    view.keyCount = track.keyCount;
+    view.keySize = getKeySizeInBytes(type, view.format);
+    view.innerKeyFrames = m_keyFrames;
+    view.range = m_values;
+    view.keys = m_values + getRangeSizeInBytes(type, view.format);
+    m_keyFrames += view.keyCount > 2 ? view.keyCount - 2 : 0;
+    m_values = view.keys + view.keySize * view.keyCount;
+    return view;
+  }
+
+  [[nodiscard]] uint32_t getFrameCount() const { return m_frameCount; }
+
+ private:
+  const CompressedTrack *m_tracks;
+  const uint8_t *m_keyFrames;
+  const char *m_values;
+  uint32_t m_frameCount;
+};
+
+// frames are local to the segment, the segment always has a key after it
+TrackValue sampleTrack(const TrackView &track, const uint32_t frame,
+                       const float fraction, const uint32_t lastFrame) {
+  if (track.keyCount <= 1) {
+    return track.decode(0);
+  }
+  // the frame is bracketed by the last key at or before it and the one after
+  const uint8_t *innerEnd = track.innerKeyFrames + track.keyCount - 2;
+  const auto key = static_cast<uint32_t>(
+      std::upper_bound(track.innerKeyFrames, innerEnd, frame) -
+      track.innerKeyFrames);
+  const uint32_t keyFrame = track.getKeyFrame(key, lastFrame);
+  const float span =
+      static_cast<float>(track.getKeyFrame(key + 1, lastFrame) - keyFrame);
+  const float factor =
+      (static_cast<float>(frame - keyFrame) + fraction) / span;
+  return interpolateKeys(track.type, track.decode(key), track.decode(key + 1),
+                         factor);
+}
+
+void writeTrackValue(const TRACK_TYPE type, const TrackValue &value,
+                     float *streams, const uint32_t stride,
+                     const uint32_t joint) {
+  const uint32_t firstStream = type == TRACK_TYPE::ROTATION      ? 0
+                               : type == TRACK_TYPE::TRANSLATION ? 4
+                                                                 : 7;
+  const uint32_t componentCount = getComponentCount(type);
+  for (uint32_t c = 0; c < componentCount; ++c) {
+    streams[(firstStream + c) * stride + joint] = value.v[c];
+  }
+}
+
+void fillStreamsPadding(float *streams, const uint32_t jointCount) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  for (uint32_t s = 0; s < POSE_STREAM_COUNT; ++s) {
+    const float identity =
+        s == static_cast<uint32_t>(POSE_STREAM::ROT_W) ||
+                s == static_cast<uint32_t>(POSE_STREAM::SCALE)
+            ? 1.0f
+            : 0.0f;
+    for (uint32_t i = jointCount; i < stride; ++i) {
+      streams[s * stride + i] = identity;
+    }
+  }
+}
+
+// compresses the source frames of a segment, the last one is the boundary
+// frame shared with the next segment
+void compressSegment(const JointPose *poses, const uint32_t jointCount,
+                     const std::vector<uint32_t> &sourceFrames,
+                     const ClipCompressionSettings &settings,
+                     ClipCompressionStats &stats, std::vector<char> &outData) {
+  const auto frameCount = static_cast<uint32_t>(sourceFrames.size());
+  const uint32_t trackCount = jointCount * TRACKS_PER_JOINT;
+  std::vector<CompressedTrack> tracks;
+  tracks.reserve(trackCount);
+  std::vector<uint8_t> keyFrames;
+  std::vector<char> values;
+  std::vector<TrackValue> source(frameCount);
+  for (uint32_t joint = 0; joint < jointCount; ++joint) {
+    for (uint32_t t = 0; t < TRACKS_PER_JOINT; ++t) {
+      const auto type = static_cast<TRACK_TYPE>(t);
+      float tolerance = settings.scaleTolerance;
+      if (type == TRACK_TYPE::ROTATION) {
+        tolerance = settings.jointRotationTolerances.empty()
+                        ? settings.rotationTolerance
+                        : settings.jointRotationTolerances[joint];
+      } else if (type == TRACK_TYPE::TRANSLATION) {
+        tolerance = settings.jointTranslationTolerances.empty()
+                        ? settings.translationTolerance
+                        : settings.jointTranslationTolerances[joint];
+      }
+      for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        source[frame] = getSourceValue(
+            type, poses[sourceFrames[frame] * jointCount + joint]);
+      }
+      const CompressedTrack track =
+          compressTrack(type, source, tolerance, keyFrames, values);
+      tracks.push_back(track);
+      stats.constantTracks += track.keyCount <= 1;
+      stats.rawTracks +=
+          static_cast<TRACK_FORMAT>(track.format) == TRACK_FORMAT::RAW;
+      stats.keyCount += track.keyCount > 1 ? track.keyCount : 0;
+    }
+  }
+
+  // header, tracks, key frames and values back to back
+  CompressedSegmentHeader header{};
+  header.frameCount = frameCount;
+  header.keyFramesOffsetInBytes = static_cast<uint32_t>(
+      sizeof(CompressedSegmentHeader) + sizeof(CompressedTrack) * trackCount);
+  header.valuesOffsetInBytes =
+      header.keyFramesOffsetInBytes + static_cast<uint32_t>(keyFrames.size());
+  header.sizeInBytes =
+      header.valuesOffsetInBytes + static_cast<uint32_t>(values.size());
+  const size_t start = outData.size();
+  outData.resize(start + header.sizeInBytes, 0);
+  char *out = outData.data() + start;
+  memcpy(out, &header, sizeof(CompressedSegmentHeader));
+  memcpy(out + sizeof(CompressedSegmentHeader), tracks.data(),
+         sizeof(CompressedTrack) * trackCount);
+  memcpy(out + header.keyFramesOffsetInBytes, keyFrames.data(),
+         keyFrames.size());
+  memcpy(out + header.valuesOffsetInBytes, values.data(), values.size());
+}
+}  // namespace
+
+uint32_t getUncompressedClipSize(const uint32_t jointCount,
+                                 const uint32_t frameCount) {
+  return static_cast<uint32_t>(sizeof(JointPose)) * jointCount * frameCount;
+}
+
+ClipCompressionStats compressClip(const JointPose *poses,
+                                  const uint32_t jointCount,
+                                  const uint32_t frameCount,
+                                  const ClipCompressionSettings &settings,
+                                  std::vector<char> &outData) {
+  assert(frameCount > 0);
+  assert(settings.segmentFrameCount > 0 &&
+         settings.segmentFrameCount <= MAX_SEGMENT_FRAME_COUNT);
+  assert(settings.jointRotationTolerances.empty() ||
+         settings.jointRotationTolerances.size() == jointCount);
+  assert(settings.jointTranslationTolerances.empty() ||
+         settings.jointTranslationTolerances.size() == jointCount);
+
+  CompressedClipHeader header{};
+  header.jointCount = jointCount;
+  header.frameCount = frameCount;
+  header.segmentFrameCount = settings.segmentFrameCount;
+  header.segmentCount =
+      (frameCount + settings.segmentFrameCount - 1) / settings.segmentFrameCount;
+  const uint32_t offsetsSize = sizeof(uint32_t) * header.segmentCount;
+  outData.assign(sizeof(CompressedClipHeader) + offsetsSize, 0);
+
+  ClipCompressionStats stats;
+  std::vector<uint32_t> offsets(header.segmentCount);
+  std::vector<uint32_t> sourceFrames;
+  for (uint32_t segment = 0; segment < header.segmentCount; ++segment) {
+    const uint32_t first = segment * settings.segmentFrameCount;
+    const uint32_t last =
+        std::min(first + settings.segmentFrameCount, frameCount) - 1;
+    sourceFrames.clear();
+    for (uint32_t frame = first; frame <= last; ++frame) {
+      sourceFrames.push_back(frame);
+    }
+    // the boundary frame, the end of the clip blends back to the start
+    sourceFrames.push_back(last + 1 < frameCount ? last + 1 : 0);
+    // segment headers are read in place, they start 4 bytes aligned
+    outData.resize((outData.size() + 3) & ~static_cast<size_t>(3), 0);
+    offsets[segment] = static_cast<uint32_t>(outData.size());
+    compressSegment(poses, jointCount, sourceFrames, settings, stats, outData);
+  }
+  header.sizeInBytes = static_cast<uint32_t>(outData.size());
+  memcpy(outData.data(), &header, sizeof(CompressedClipHeader));
+  memcpy(outData.data() + sizeof(CompressedClipHeader), offsets.data(),
+         offsetsSize);
+
+  // the error is measured on what the runtime actually produces
+  stats.rawSizeInBytes = getUncompressedClipSize(jointCount, frameCount);
+  stats.compressedSizeInBytes = header.sizeInBytes;
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  std::vector<float> streams(getPoseStreamsSize(jointCount));
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    sampleCompressedClip(outData.data(), frame, 0.0f, streams.data());
+    for (uint32_t joint = 0; joint < jointCount; ++joint) {
+      const JointPose &pose = poses[frame * jointCount + joint];
+      const TrackValue rot{{streams[joint], streams[stride + joint],
+                            streams[stride * 2 + joint],
+                            streams[stride * 3 + joint]}};
+      const TrackValue trans{{streams[stride * 4 + joint],
+                              streams[stride * 5 + joint],
+                              streams[stride * 6 + joint], 0.0f}};
+      const TrackValue scale{{streams[stride * 7 + joint], 0.0f, 0.0f, 0.0f}};
+      stats.maxRotationError = std::max(
+          stats.maxRotationError,
+          static_cast<float>(getError(
+              TRACK_TYPE::ROTATION, rot,
+              getSourceValue(TRACK_TYPE::ROTATION, pose))));
+      stats.maxTranslationError = std::max(
+          stats.maxTranslationError,
+          static_cast<float>(getError(
+              TRACK_TYPE::TRANSLATION, trans,
+              getSourceValue(TRACK_TYPE::TRANSLATION, pose))));
+      stats.maxScaleError = std::max(
+          stats.maxScaleError,
+          static_cast<float>(getError(TRACK_TYPE::SCALE, scale,
+                                      getSourceValue(TRACK_TYPE::SCALE, pose))));
+    }
+  }
+  return stats;
+}
+
+void sampleCompressedClip(const void *compressed, const uint32_t frame,
+                          const float fraction, float *outStreams,
+                          const uint32_t animatedJointCount) {
+  const auto *header = static_cast<const CompressedClipHeader *>(compressed);
+  assert(frame < header->frameCount);
+  const uint32_t segment = frame / header->segmentFrameCount;
+  const uint32_t localFrame = frame - segment * header->segmentFrameCount;
+  SegmentReader reader(compressed, segment);
+  const uint32_t lastFrame = reader.getFrameCount() - 1;
+
+  const uint32_t jointCount = header->jointCount;
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const uint32_t sampledJointCount =
+      getAnimatedJointCount(jointCount, animatedJointCount);
+  for (uint32_t joint = 0; joint < sampledJointCount; ++joint) {
+    for (uint32_t t = 0; t < TRACKS_PER_JOINT; ++t) {
+      const auto type = static_cast<TRACK_TYPE>(t);
+      const TrackView track = reader.next(type);
+      const TrackValue value =
+          sampleTrack(track, localFrame, fraction, lastFrame);
+      writeTrackValue(type, value, outStreams, stride, joint);
+    }
+  }
+  fillStreamsPadding(outStreams, jointCount);
+}
+
+bool validateCompressedClip(const void *compressed,
+                            const uint32_t sizeInBytes) {
+  // the block might come straight from a file buffer, no alignment is assumed
+  // and everything is read through memcpy
+  const auto *data = static_cast<const char *>(compressed);
+  if (sizeInBytes < sizeof(CompressedClipHeader)) {
+    return false;
+  }
+  CompressedClipHeader header;
+  memcpy(&header, data, sizeof(CompressedClipHeader));
+  if ((header.jointCount == 0) | (header.frameCount == 0) |
+      (header.segmentFrameCount == 0) |
+      (header.segmentFrameCount > MAX_SEGMENT_FRAME_COUNT) |
+      (header.sizeInBytes > sizeInBytes)) {
+    return false;
+  }
+  const uint32_t expectedSegmentCount =
+      (header.frameCount + header.segmentFrameCount - 1) /
+      header.segmentFrameCount;
+  const uint64_t tableEnd = sizeof(CompressedClipHeader) +
+                            sizeof(uint32_t) * uint64_t{header.segmentCount};
+  if ((header.segmentCount != expectedSegmentCount) |
+      (tableEnd > header.sizeInBytes)) {
+    return false;
+  }
+
+  const uint64_t trackCount = uint64_t{header.jointCount} * TRACKS_PER_JOINT;
+  for (uint32_t segment = 0; segment < header.segmentCount; ++segment) {
+    uint32_t offset;
+    memcpy(&offset, data + sizeof(CompressedClipHeader) +
+                        sizeof(uint32_t) * segment,
+           sizeof(uint32_t));
+    // segment headers are read in place
+    if ((offset < tableEnd) | ((offset & 3) != 0) |
+            (offset > header.sizeInBytes) ||
+        header.sizeInBytes - offset < sizeof(CompressedSegmentHeader)) {
+      return false;
+    }
+    CompressedSegmentHeader segmentHeader;
+    memcpy(&segmentHeader, data + offset, sizeof(CompressedSegmentHeader));
+    // the frames of the segment plus the boundary one
+    const uint32_t first = segment * header.segmentFrameCount;
+    const uint32_t expectedFrameCount =
+        std::min(header.segmentFrameCount, header.frameCount - first) + 1;
+    if ((segmentHeader.frameCount != expectedFrameCount) |
+        (segmentHeader.sizeInBytes > header.sizeInBytes - offset) |
+        (segmentHeader.keyFramesOffsetInBytes !=
+         sizeof(CompressedSegmentHeader) +
+             sizeof(CompressedTrack) * trackCount) |
+        (segmentHeader.valuesOffsetInBytes <
+         segmentHeader.keyFramesOffsetInBytes) |
+        (segmentHeader.valuesOffsetInBytes > segmentHeader.sizeInBytes)) {
+      return false;
+    }
+
+    // walking the tracks the same way the SegmentReader does
+    const char *segmentData = data + offset;
+    const uint32_t lastFrame = segmentHeader.frameCount - 1;
+    uint32_t keyFramesOffset = segmentHeader.keyFramesOffsetInBytes;
+    uint64_t valuesOffset = segmentHeader.valuesOffsetInBytes;
+    for (uint64_t t = 0; t < trackCount; ++t) {
+      CompressedTrack track;
+      memcpy(&track,
+             segmentData + sizeof(CompressedSegmentHeader) +
+                 sizeof(CompressedTrack) * t,
+             sizeof(CompressedTrack));
+      const auto type = static_cast<TRACK_TYPE>(t % TRACKS_PER_JOINT);
+      const auto format = static_cast<TRACK_FORMAT>(track.format);
+      const uint32_t keyCount = track.keyCount;
+      const bool validKeyCount =
+          format == TRACK_FORMAT::IDENTITY   ? keyCount == 0
+          : format == TRACK_FORMAT::CONSTANT ? keyCount == 1
+                                             : (keyCount >= 2) &
+                                                   (keyCount <= lastFrame + 1);
+      if (!validKeyCount) {
+        return false;
+      }
+      // inner key frames strictly in between the first and last frame, in
+      // order, or the key spans would be empty
+      const uint32_t innerCount = keyCount > 2 ? keyCount - 2 : 0;
+      if (innerCount > segmentHeader.valuesOffsetInBytes - keyFramesOffset) {
+        return false;
+      }
+      uint32_t previous = 0;
+      for (uint32_t k = 0; k < innerCount; ++k) {
+        const auto frame =
+            static_cast<uint8_t>(segmentData[keyFramesOffset + k]);
+        if ((frame <= previous) | (frame >= lastFrame)) {
+          return false;
+        }
+        previous = frame;
+      }
+      keyFramesOffset += innerCount;
+      valuesOffset += getRangeSizeInBytes(type, format) +
+                      uint64_t{getKeySizeInBytes(type, format)} * keyCount;
+      if (valuesOffset > segmentHeader.sizeInBytes) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+uint32_t decodeCompressedSegment(const void *compressed, const uint32_t segment,
+                                 float *outFrames,
+                                 const uint32_t animatedJointCount) {
+  const auto *header = static_cast<const CompressedClipHeader *>(compressed);
+  SegmentReader reader(compressed, segment);
+  const uint32_t frameCount = reader.getFrameCount();
+  const uint32_t lastFrame = frameCount - 1;
+  const uint32_t jointCount = header->jointCount;
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const uint32_t poseSize = getPoseStreamsSize(jointCount);
+  const uint32_t decodedJointCount =
+      getAnimatedJointCount(jointCount, animatedJointCount);
+
+  // track after track walking the keys in order, every span between two keys
+  // is dequantized once and interpolated over all its frames
+  for (uint32_t joint = 0; joint < decodedJointCount; ++joint) {
+    for (uint32_t t = 0; t < TRACKS_PER_JOINT; ++t) {
+      const auto type = static_cast<TRACK_TYPE>(t);
+      const TrackView track = reader.next(type);
+      if (track.keyCount <= 1) {
+        const TrackValue value = track.decode(0);
+        for (uint32_t frame = 0; frame < frameCount; ++frame) {
+          writeTrackValue(type, value, outFrames + frame * poseSize, stride,
+                          joint);
+        }
+        continue;
+      }
+      TrackValue next = track.decode(0);
+      uint32_t nextFrame = 0;
+      for (uint32_t key = 0; key + 1 < track.keyCount; ++key) {
+        const TrackValue current = next;
+        const uint32_t currentFrame = nextFrame;
+        next = track.decode(key + 1);
+        nextFrame = track.getKeyFrame(key + 1, lastFrame);
+        const float span = static_cast<float>(nextFrame - currentFrame);
+        for (uint32_t frame = currentFrame; frame < nextFrame; ++frame) {
+          const TrackValue value = interpolateKeys(
+              type, current, next,
+              static_cast<float>(frame - currentFrame) / span);
+          writeTrackValue(type, value, outFrames + frame * poseSize, stride,
+                          joint);
+        }
+      }
+      writeTrackValue(type, next, outFrames + lastFrame * poseSize, stride,
+                      joint);
+    }
+  }
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    fillStreamsPadding(outFrames + frame * poseSize, jointCount);
+  }
+  return frameCount;
+}
+
+}  // namespace SirEngine
@@ -0,0 +1,143 @@
+#pragma once
+#include <stdint.h>
+
+#include <vector>
+
+#include "SirEngine/animation/poseStreams.h"
+
+namespace SirEngine {
+
+struct JointPose;
+
+/*
+Compressed animation clips. Every joint has three tracks, rotation,
+translation and scale, and every track is stored in one of four formats:
+
+- IDENTITY: no data, the track stays within tolerance of the identity, which
+  is what most scale tracks look like
+- CONSTANT: a single raw value, the track does not move more than the
+  tolerance
+- QUANTIZED: rotations use the smallest three encoding in 48 bits, the
+  largest component is dropped and rebuilt from the unit length, the other
+  three get 15 bits each plus two bits for the index of the dropped one.
+  Translations and scale are quantized to 16 bits per component in the range
+  the track covers
+- RAW: plain floats, used when quantizing would break the tolerance
+
+On top of that tracks only keep the keys needed to stay within tolerance, the
+frames in between are rebuilt by interpolating the neighbouring keys, the
+same way the runtime does. The first and last frame are always keys.
+
+Clips are cut in segments of a fixed number of frames, every segment is
+compressed on its own and carries one extra boundary frame, the first frame
+of the next segment, or the first frame of the clip for the last one, so a
+segment can be decoded and interpolated without touching its neighbours.
+Long clips can then be played by decoding a segment at the time, see
+clipCursor.h.
+
+The compressed clip is a single relocatable block: the clip header, the
+offsets of the segments and the segments. A segment is a header, two bytes
+per track, the key frames as bytes, only the ones in between the first and
+last frame, and the values, unaligned. Tracks are stored joint after joint
+and rotation, translation, scale within a joint, where the key frames and
+values of a track start is found by walking the tracks in order, which both
+sampling and decoding do anyway.
+*/
+
+enum class TRACK_FORMAT : uint8_t { IDENTITY = 0, CONSTANT, QUANTIZED, RAW };
+enum class TRACK_TYPE : uint8_t { ROTATION = 0, TRANSLATION, SCALE, COUNT };
+static constexpr uint32_t TRACKS_PER_JOINT =
+    static_cast<uint32_t>(TRACK_TYPE::COUNT);
+// key frames are stored in a byte, boundary frame included
+static constexpr uint32_t MAX_SEGMENT_FRAME_COUNT = 254;
+// version of the clip binary files holding compressed poses, as written by
+// the animation compiler, clips with any other version need recompiling
+static constexpr uint32_t COMPRESSED_CLIP_FILE_VERSION = (0 << 16) | (3 << 8);
+
+// followed by one uint32_t offset per segment, from the start of the clip
+struct CompressedClipHeader {
+  uint32_t jointCount;
+  uint32_t frameCount;
+  uint32_t segmentFrameCount;
+  uint32_t segmentCount;
+  uint32_t sizeInBytes;
+};
+
+struct CompressedSegmentHeader {
+  // frames of the segment, boundary frame included
+  uint32_t frameCount;
+  // all the offsets are from the start of the segment header
+  uint32_t keyFramesOffsetInBytes;
+  uint32_t valuesOffsetInBytes;
+  uint32_t sizeInBytes;
+};
+
+struct CompressedTrack {
+  uint16_t format : 2;
+  uint16_t keyCount : 14;
+};
+static_assert(sizeof(CompressedTrack) == 2);
+
+// how far the compressed clip can be from the source, rotations are measured
+// as the angle in radians between the two, translations and scale as the
+// distance between them
+struct ClipCompressionSettings {
+  float rotationTolerance = 0.0005f;
+  float translationTolerance = 0.001f;
+  float scaleTolerance = 0.0001f;
+  // shorter segments bound the memory of a playing clip better, at the cost
+  // of repeating the first and last key of every track in each segment
+  uint32_t segmentFrameCount = 32;
+  // optional per joint overrides, either empty or one value per joint. Joints
+  // high in the hierarchy move everything under them and usually want
+  // tighter values than the fingers
+  std::vector<float> jointRotationTolerances;
+  std::vector<float> jointTranslationTolerances;
+};
+
+struct ClipCompressionStats {
+  uint32_t rawSizeInBytes = 0;
+  uint32_t compressedSizeInBytes = 0;
+  // tracks are counted once per segment, identity tracks count as constant
+  uint32_t constantTracks = 0;
+  uint32_t rawTracks = 0;
+  // keys kept over all the animated tracks
+  uint32_t keyCount = 0;
+  // error of the compressed clip sampled at every source frame
+  float maxRotationError = 0.0f;
+  float maxTranslationError = 0.0f;
+  float maxScaleError = 0.0f;
+};
+
+// poses are frameCount * jointCount, frame after frame as the clip compiler
+// produces them, the compressed block is written to outData
+ClipCompressionStats compressClip(const JointPose *poses, uint32_t jointCount,
+                                  uint32_t frameCount,
+                                  const ClipCompressionSettings &settings,
+                                  std::vector<char> &outData);
+
+// decodes the compressed clip at frame + fraction, fraction in [0,1), straight
+// into pose streams, see poseStreams.h. Sampling past the last frame
+// interpolates back to the first one, as looping clips do. Tracks are stored
+// joint after joint, a reduced pose stops walking them early
+void sampleCompressedClip(const void *compressed, uint32_t frame,
+                          float fraction, float *outStreams,
+                          uint32_t animatedJointCount = POSE_ALL_JOINTS);
+
+// decodes all the frames of a segment, boundary frame included, as pose
+// streams one after the other, returns the number of frames written. The
+// output needs room for segmentFrameCount + 1 poses
+uint32_t decodeCompressedSegment(const void *compressed, uint32_t segment,
+                                 float *outFrames,
+                                 uint32_t animatedJointCount = POSE_ALL_JOINTS);
+
+// checks a compressed block coming from disk before anything samples it: the
+// counts in the header, the segment table, every segment and the key frames
+// and values of every track need to be consistent and within sizeInBytes.
+// Sampling and decoding trust the block and only assert
+bool validateCompressedClip(const void *compressed, uint32_t sizeInBytes);
+
+// size in bytes a clip would take stored as JointPose arrays
+uint32_t getUncompressedClipSize(uint32_t jointCount, uint32_t frameCount);
+
+}  // namespace SirEngine
@@ -0,0 +1,83 @@
+#include "SirEngine/animation/clipCursor.h"
+
+#include <cassert>
+
+#include "SirEngine/animation/clipCompression.h"
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/globals.h"
+#include "SirEngine/memory/cpu/threeSizesPool.h"
+
+namespace SirEngine {
+
+ClipCursor::~ClipCursor() { release(); }
+
+void ClipCursor::initialize(const void *compressedClip) {
+  release();
+  const auto *header =
+      static_cast<const CompressedClipHeader *>(compressedClip);
+  m_compressed = compressedClip;
+  m_jointCount = header->jointCount;
+  m_poseSize = getPoseStreamsSize(m_jointCount);
+  m_segmentFrameCount = header->segmentFrameCount;
+  m_segmentCount = header->segmentCount;
+  // a segment carries the boundary frame on top of its own frames
+  m_slotFrameCount = m_segmentFrameCount + 1;
+  m_frames = static_cast<float *>(
+      globals::PERSISTENT_ALLOCATOR->allocate(getDecodedSizeInBytes()));
+  m_slotSegments[0] = -1;
+  m_slotSegments[1] = -1;
+  m_slotJointCounts[0] = 0;
+  m_slotJointCounts[1] = 0;
+  m_decodeCount = 0;
+}
+
+void ClipCursor::release() {
+  if (m_frames != nullptr) {
+    globals::PERSISTENT_ALLOCATOR->free(m_frames);
+    m_frames = nullptr;
+  }
+  m_compressed = nullptr;
+}
+
+uint32_t ClipCursor::acquireSegment(const uint32_t segment,
+                                    const uint32_t jointCount,
+                                    const uint32_t keepSlot) {
+  uint32_t slot = keepSlot == 0 ? 1 : 0;
+  for (uint32_t s = 0; s < SLOT_COUNT; ++s) {
+    if (m_slotSegments[s] == static_cast<int>(segment)) {
+      if (m_slotJointCounts[s] >= jointCount) {
+        return s;
+      }
+      // decoded for a smaller pose, done again in place
+      slot = s;
+    }
+  }
+  decodeCompressedSegment(m_compressed, segment, getSlotFrame(slot, 0),
+                          jointCount);
+  m_slotSegments[slot] = static_cast<int>(segment);
+  m_slotJointCounts[slot] = jointCount;
+  ++m_decodeCount;
+  return slot;
+}
+
+void ClipCursor::sample(const uint32_t frame, const float fraction,
+                        float *outStreams, const uint32_t animatedJointCount) {
+  assert(isInitialized());
+  const uint32_t segment = frame / m_segmentFrameCount;
+  assert(segment < m_segmentCount);
+  const uint32_t localFrame = frame - segment * m_segmentFrameCount;
+  const uint32_t jointCount =
+      getAnimatedJointCount(m_jointCount, animatedJointCount);
+  const uint32_t slot = acquireSegment(segment, jointCount, SLOT_COUNT);
+  interpolatePoseStreams(getSlotFrame(slot, localFrame),
+                         getSlotFrame(slot, localFrame + 1), fraction,
+                         m_jointCount, outStreams, jointCount);
+
+  // decoding ahead in this same call, a no-op once the next segment is
+  // decoded, the sample crossing the boundary then finds it ready
+  if (m_segmentCount > 1) {
+    acquireSegment((segment + 1) % m_segmentCount, jointCount, slot);
+  }
+}
+
+}  // namespace SirEngine
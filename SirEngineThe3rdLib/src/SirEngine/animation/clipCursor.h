@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+
+#include "SirEngine/animation/poseStreams.h"
+
+namespace SirEngine {
+
+/*
+Plays a compressed clip one segment at the time, see clipCompression.h. The
+segment being played and the one after it are kept decoded as pose streams,
+sampling is then a plain interpolation between two decoded frames. The memory
+held is two segments worth of poses no matter how long the clip is.
+
+The decode ahead is synchronous, it happens inside sample: the first sample
+in a segment also decodes the one after it, so that call pays for a whole
+segment decode on top of the interpolation, while the sample crossing into
+the next segment finds it ready and only interpolates. Once every
+segmentFrameCount frames a sample is expensive, the cost is moved to the start
+of the segment, not removed. Seeking away from the decoded segments decodes
+the target segment on the spot, in the sample that seeks.
+
+Reduced poses, see getAnimatedJointCount, only decode the leading joints of a
+segment, asking for more joints than a slot holds decodes it again.
+
+A cursor belongs to a single player, it is not thread safe but different
+cursors over the same clip can be used from different threads.
+*/
+class ClipCursor final {
+ public:
+  ClipCursor() = default;
+  ~ClipCursor();
+  ClipCursor(const ClipCursor &) = delete;
+  ClipCursor &operator=(const ClipCursor &) = delete;
+
+  // the compressed clip needs to outlive the cursor
+  void initialize(const void *compressedClip);
+  void release();
+
+  // frame in [0, frameCount), fraction in [0,1), past the last frame the clip
+  // loops back to the first one
+  void sample(uint32_t frame, float fraction, float *outStreams,
+              uint32_t animatedJointCount = POSE_ALL_JOINTS);
+
+  [[nodiscard]] bool isInitialized() const { return m_compressed != nullptr; }
+  [[nodiscard]] uint32_t getDecodedSizeInBytes() const {
+    return sizeof(float) * m_poseSize * m_slotFrameCount * SLOT_COUNT;
+  }
+  // segments decoded since initialization
+  [[nodiscard]] uint32_t getDecodeCount() const { return m_decodeCount; }
+
+ private:
+  static constexpr uint32_t SLOT_COUNT = 2;
+
+  // returns the slot holding the segment with at least the given joints,
+  // decoding it if needed
+  uint32_t acquireSegment(uint32_t segment, uint32_t jointCount,
+                          uint32_t keepSlot);
+  [[nodiscard]] float *getSlotFrame(const uint32_t slot,
+                                    const uint32_t frame) const {
+    return m_frames + (slot * m_slotFrameCount + frame) * m_poseSize;
+  }
+
+ private:
+  const void *m_compressed = nullptr;
+  float *m_frames = nullptr;
+  int m_slotSegments[SLOT_COUNT] = {-1, -1};
+  uint32_t m_slotJointCounts[SLOT_COUNT] = {0, 0};
+  uint32_t m_jointCount = 0;
+  uint32_t m_poseSize = 0;
+  uint32_t m_segmentFrameCount = 0;
+  uint32_t m_segmentCount = 0;
+  uint32_t m_slotFrameCount = 0;
+  uint32_t m_decodeCount = 0;
+};
+
+}  // namespace SirEngine
@@ -0,0 +1,273 @@
+#include "SirEngine/animation/cpuSkinning.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <glm/gtx/quaternion.hpp>
+
+#include "SirEngine/io/binaryFile.h"
+#include "SirEngine/workerPool.h"
+
+namespace SirEngine {
+
+namespace {
+constexpr uint32_t DUAL_QUATERNION_SIZE = 8;
+
+// sum of the influencing matrices scaled by their weights, then applied to
+// the vertex, the same result as transforming the vertex by every matrix
+#if defined(__AVX2__)
+// a register holds two columns, blending an influence is two fused
+// multiply adds
+void skinVertexLinearBlend(const glm::mat4 *matrices, const int *influences,
+                           const float *weights, const float *position,
+                           const float *normal, float *outPosition,
+                           float *outNormal) {
+  __m256 columns01 = _mm256_setzero_ps();
+  __m256 columns23 = _mm256_setzero_ps();
+  for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+    const auto *matrix =
+        reinterpret_cast<const float *>(&matrices[influences[i]]);
+    const __m256 weight = _mm256_set1_ps(weights[i]);
+    columns01 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix), columns01);
+    columns23 =
+        _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix + 8), columns23);
+  }
+  // column0 * x + column1 * y in one half, column2 * z + column3 in the other
+  const __m256 xy = _mm256_setr_ps(position[0], position[0], position[0],
+                                   position[0], position[1], position[1],
+                                   position[1], position[1]);
+  const __m256 z1 = _mm256_setr_ps(position[2], position[2], position[2],
+                                   position[2], 1.0f, 1.0f, 1.0f, 1.0f);
+  __m256 sum = _mm256_fmadd_ps(columns23, z1, _mm256_mul_ps(columns01, xy));
+  _mm_storeu_ps(outPosition, _mm_add_ps(_mm256_castps256_ps128(sum),
+                                        _mm256_extractf128_ps(sum, 1)));
+  outPosition[3] = 1.0f;
+
+  // normals ignore the translation
+  const __m256 normalXY =
+      _mm256_setr_ps(normal[0], normal[0], normal[0], normal[0], normal[1],
+                     normal[1], normal[1], normal[1]);
+  const __m256 normalZ0 = _mm256_setr_ps(normal[2], normal[2], normal[2],
+                                         normal[2], 0.0f, 0.0f, 0.0f, 0.0f);
+  sum = _mm256_fmadd_ps(columns23, normalZ0, _mm256_mul_ps(columns01, normalXY));
+  _mm_storeu_ps(outNormal, _mm_add_ps(_mm256_castps256_ps128(sum),
+                                      _mm256_extractf128_ps(sum, 1)));
+  outNormal[3] = 0.0f;
+}
+#else
+void skinVertexLinearBlend(const glm::mat4 *matrices, const int *influences,
+                           const float *weights, const float *position,
+                           const float *normal, float *outPosition,
+                           float *outNormal) {
+  __m128 columns[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(),
+                       _mm_setzero_ps()};
+  for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+    const auto *matrix =
+        reinterpret_cast<const float *>(&matrices[influences[i]]);
+    const __m128 weight = _mm_set1_ps(weights[i]);
+    for (uint32_t c = 0; c < 4; ++c) {
+      columns[c] =
+          _mm_add_ps(_mm_mul_ps(weight, _mm_loadu_ps(matrix + c * 4)),
+                     columns[c]);
+    }
+  }
+  const __m128 rotated =
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(position[0])),
+                            _mm_mul_ps(columns[1], _mm_set1_ps(position[1]))),
+                 _mm_mul_ps(columns[2], _mm_set1_ps(position[2])));
+  _mm_storeu_ps(outPosition, _mm_add_ps(rotated, columns[3]));
+  outPosition[3] = 1.0f;
+  _mm_storeu_ps(
+      outNormal,
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(normal[0])),
+                            _mm_mul_ps(columns[1], _mm_set1_ps(normal[1]))),
+                 _mm_mul_ps(columns[2], _mm_set1_ps(normal[2]))));
+  outNormal[3] = 0.0f;
+}
+#endif
+
+void skinVertexDualQuaternion(const float *dualQuaternions,
+                              const int *influences, const float *weights,
+                              const float *position, const float *normal,
+                              float *outPosition, float *outNormal) {
+  // all the rotations get blended in the hemisphere of the first one
+  const float *first = dualQuaternions + influences[0] * DUAL_QUATERNION_SIZE;
+  alignas(32) float blended[DUAL_QUATERNION_SIZE];
+#if defined(__AVX2__)
+  // the whole dual quaternion fits a register
+  __m256 sum = _mm256_setzero_ps();
+  for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+    const float *dq = dualQuaternions + influences[i] * DUAL_QUATERNION_SIZE;
+    const float dot = dq[0] * first[0] + dq[1] * first[1] + dq[2] * first[2] +
+                      dq[3] * first[3];
+    const float weight = dot < 0.0f ? -weights[i] : weights[i];
+    sum = _mm256_fmadd_ps(_mm256_set1_ps(weight), _mm256_loadu_ps(dq), sum);
+  }
+  _mm256_store_ps(blended, sum);
+#else
+  __m128 realSum = _mm_setzero_ps();
+  __m128 dualSum = _mm_setzero_ps();
+  for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+    const float *dq = dualQuaternions + influences[i] * DUAL_QUATERNION_SIZE;
+    const float dot = dq[0] * first[0] + dq[1] * first[1] + dq[2] * first[2] +
+                      dq[3] * first[3];
+    const __m128 weight =
+        _mm_set1_ps(dot < 0.0f ? -weights[i] : weights[i]);
+    realSum = _mm_add_ps(_mm_mul_ps(weight, _mm_loadu_ps(dq)), realSum);
+    dualSum = _mm_add_ps(_mm_mul_ps(weight, _mm_loadu_ps(dq + 4)), dualSum);
+  }
+  _mm_store_ps(blended, realSum);
+  _mm_store_ps(blended + 4, dualSum);
+#endif
+
+  const float invLength =
+      1.0f / std::sqrt(blended[0] * blended[0] + blended[1] * blended[1] +
+                       blended[2] * blended[2] + blended[3] * blended[3]);
+  const glm::quat real(blended[3] * invLength, blended[0] * invLength,
+                       blended[1] * invLength, blended[2] * invLength);
+  const glm::vec3 realVector(real.x, real.y, real.z);
+  const glm::vec3 dualVector(blended[4] * invLength, blended[5] * invLength,
+                             blended[6] * invLength);
+  const float dualW = blended[7] * invLength;
+  const glm::vec3 translation =
+      2.0f * (real.w * dualVector - dualW * realVector +
+              glm::cross(realVector, dualVector));
+
+  const glm::vec3 skinned =
+      real * glm::vec3(position[0], position[1], position[2]) + translation;
+  outPosition[0] = skinned.x;
+  outPosition[1] = skinned.y;
+  outPosition[2] = skinned.z;
+  outPosition[3] = 1.0f;
+  const glm::vec3 skinnedNormal =
+      real * glm::vec3(normal[0], normal[1], normal[2]);
+  outNormal[0] = skinnedNormal.x;
+  outNormal[1] = skinnedNormal.y;
+  outNormal[2] = skinnedNormal.z;
+  outNormal[3] = 0.0f;
+}
+}  // namespace
+
+SkinningVertexData getSkinningVertexData(const std::vector<char> &modelFile,
+                                         const std::vector<char> &skinFile) {
+  const auto *model = getMapperData<ModelMapperData>(modelFile.data());
+  const auto *skin = getMapperData<SkinMapperData>(skinFile.data());
+  assert(skin->influenceCountPerVertex == VERTEX_INFLUENCE_COUNT);
+  assert(skin->jointsSizeInByte ==
+         model->vertexCount * VERTEX_INFLUENCE_COUNT * sizeof(int));
+
+  const char *vertexData = modelFile.data() + sizeof(BinaryFileHeader);
+  const char *skinData = skinFile.data() + sizeof(BinaryFileHeader);
+  SkinningVertexData data;
+  data.positions = reinterpret_cast<const float *>(
+      vertexData + model->positionRange.m_offset);
+  data.normals =
+      reinterpret_cast<const float *>(vertexData + model->normalsRange.m_offset);
+  data.influences = reinterpret_cast<const int *>(skinData);
+  data.weights =
+      reinterpret_cast<const float *>(skinData + skin->jointsSizeInByte);
+  data.vertexCount = model->vertexCount;
+  return data;
+}
+
+void CpuSkinning::setMatrices(const glm::mat4 *matrices,
+                              const uint32_t matrixCount,
+                              const SKINNING_MODE mode) {
+  m_matrices = matrices;
+  m_matrixCount = matrixCount;
+  m_mode = mode;
+  if (mode != SKINNING_MODE::DUAL_QUATERNION) {
+    return;
+  }
+  m_dualQuaternions.resize(matrixCount * DUAL_QUATERNION_SIZE);
+  for (uint32_t i = 0; i < matrixCount; ++i) {
+    const glm::mat4 &matrix = matrices[i];
+    const glm::quat real = glm::normalize(glm::quat_cast(matrix));
+    const glm::quat translation(0.0f, matrix[3].x, matrix[3].y, matrix[3].z);
+    const glm::quat dual = (translation * real) * 0.5f;
+    float *out = m_dualQuaternions.data() + i * DUAL_QUATERNION_SIZE;
+    out[0] = real.x;
+    out[1] = real.y;
+    out[2] = real.z;
+    out[3] = real.w;
+    out[4] = dual.x;
+    out[5] = dual.y;
+    out[6] = dual.z;
+    out[7] = dual.w;
+  }
+}
+
+void CpuSkinning::skinRange(const SkinningVertexData &vertices,
+                            const uint32_t firstVertex,
+                            const uint32_t vertexCount,
+                            const SkinningOutput &output) const {
+  assert(m_matrices != nullptr);
+  assert(firstVertex + vertexCount <= vertices.vertexCount);
+  const uint32_t end = firstVertex + vertexCount;
+  for (uint32_t v = firstVertex; v < end; ++v) {
+    const int *influences = vertices.influences + v * VERTEX_INFLUENCE_COUNT;
+    const float *weights = vertices.weights + v * VERTEX_INFLUENCE_COUNT;
+    if (m_mode == SKINNING_MODE::LINEAR_BLEND) {
+      skinVertexLinearBlend(m_matrices, influences, weights,
+                            vertices.positions + v * 4,
+                            vertices.normals + v * 4, output.positions + v * 4,
+                            output.normals + v * 4);
+    } else {
+      skinVertexDualQuaternion(
+          m_dualQuaternions.data(), influences, weights,
+          vertices.positions + v * 4, vertices.normals + v * 4,
+          output.positions + v * 4, output.normals + v * 4);
+    }
+  }
+}
+
+void CpuSkinning::skin(const SkinningVertexData &vertices,
+                       const SkinningOutput &output, WorkerPool *pool) const {
+  if (pool == nullptr) {
+    skinRange(vertices, 0, vertices.vertexCount, output);
+    return;
+  }
+  const uint32_t taskCount =
+      (vertices.vertexCount + SKINNING_BATCH_SIZE - 1) / SKINNING_BATCH_SIZE;
+  pool->parallelFor(taskCount, [&](const uint32_t task) {
+    const uint32_t first = task * SKINNING_BATCH_SIZE;
+    skinRange(vertices, first,
+              std::min(SKINNING_BATCH_SIZE, vertices.vertexCount - first),
+              output);
+  });
+}
+
+void skinVerticesLinearBlendScalar(const SkinningVertexData &vertices,
+                                   const glm::mat4 *matrices,
+                                   const SkinningOutput &output) {
+  for (uint32_t v = 0; v < vertices.vertexCount; ++v) {
+    const float *p = vertices.positions + v * 4;
+    const float *n = vertices.normals + v * 4;
+    const glm::vec4 position(p[0], p[1], p[2], 1.0f);
+    const glm::vec4 normal(n[0], n[1], n[2], 0.0f);
+    glm::vec4 skinPos(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec4 skinNormal(0.0f);
+    for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+      const glm::mat4 &matrix =
+          matrices[vertices.influences[v * VERTEX_INFLUENCE_COUNT + i]];
+      const float weight = vertices.weights[v * VERTEX_INFLUENCE_COUNT + i];
+      skinPos += weight * (matrix * position);
+      // w = 0 keeps only the 3x3 part
+      skinNormal += weight * (matrix * normal);
+    }
+    float *outPosition = output.positions + v * 4;
+    outPosition[0] = skinPos.x;
+    outPosition[1] = skinPos.y;
+    outPosition[2] = skinPos.z;
+    outPosition[3] = 1.0f;
+    float *outNormal = output.normals + v * 4;
+    outNormal[0] = skinNormal.x;
+    outNormal[1] = skinNormal.y;
+    outNormal[2] = skinNormal.z;
+    outNormal[3] = 0.0f;
+  }
+}
+
+}  // namespace SirEngine
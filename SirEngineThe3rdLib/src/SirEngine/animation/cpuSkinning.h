@@ -0,0 +1,92 @@
+#pragma once
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace SirEngine {
+
+class WorkerPool;
+
+// joints influencing a vertex, as produced by the skin compiler and read by
+// the skinning shader
+static constexpr uint32_t VERTEX_INFLUENCE_COUNT = 6;
+// vertices skinned by a single pool task
+static constexpr uint32_t SKINNING_BATCH_SIZE = 1024;
+
+enum class SKINNING_MODE {
+  // same result as the skinning shader
+  LINEAR_BLEND = 0,
+  // no candy wrapper on twisting joints, the skin matrices must be rigid
+  DUAL_QUATERNION
+};
+
+/*
+Skinning on the cpu, used to validate skin data and to run skinned meshes
+where there is no gpu, like on the build and server machines. The vertex data
+is read in the layout of the processed mesh and skin files: positions and
+normals as vec4 streams, VERTEX_INFLUENCE_COUNT joint indices and weights per
+vertex.
+
+Linear blend skinning blends the influencing matrices with SIMD, one column
+at the time, then transforms the vertex once. Dual quaternion skinning
+blends the eight floats of the joint dual quaternions in a single 256 bit
+register. Either way the vertices get split in batches of
+SKINNING_BATCH_SIZE processed in parallel on the worker pool.
+*/
+struct SkinningVertexData {
+  // vec4 per vertex, w is ignored
+  const float *positions = nullptr;
+  const float *normals = nullptr;
+  // VERTEX_INFLUENCE_COUNT per vertex
+  const int *influences = nullptr;
+  const float *weights = nullptr;
+  uint32_t vertexCount = 0;
+};
+
+struct SkinningOutput {
+  // vec4 per vertex, positions get w = 1 and normals w = 0. Normals are not
+  // normalized, same as the shader
+  float *positions = nullptr;
+  float *normals = nullptr;
+};
+
+// vertex data of a processed mesh and of its skin, both files fully read in
+// memory, the pointers point inside the given buffers
+SkinningVertexData getSkinningVertexData(const std::vector<char> &modelFile,
+                                         const std::vector<char> &skinFile);
+
+// the skin matrices, bind pose included, column major as glm stores them,
+// which is SkeletonPose::m_globalPose transposed
+class CpuSkinning final {
+ public:
+  CpuSkinning() = default;
+  CpuSkinning(const CpuSkinning &) = delete;
+  CpuSkinning &operator=(const CpuSkinning &) = delete;
+
+  // converts the matrices to dual quaternions when needed, to be called every
+  // time the matrices change, before skinning
+  void setMatrices(const glm::mat4 *matrices, uint32_t matrixCount,
+                   SKINNING_MODE mode);
+  // skins all the vertices, on the pool when one is given
+  void skin(const SkinningVertexData &vertices, const SkinningOutput &output,
+            WorkerPool *pool = nullptr) const;
+  // skins the vertices in [firstVertex, firstVertex + vertexCount)
+  void skinRange(const SkinningVertexData &vertices, uint32_t firstVertex,
+                 uint32_t vertexCount, const SkinningOutput &output) const;
+
+ private:
+  const glm::mat4 *m_matrices = nullptr;
+  uint32_t m_matrixCount = 0;
+  SKINNING_MODE m_mode = SKINNING_MODE::LINEAR_BLEND;
+  // real then dual part, x,y,z,w each
+  std::vector<float> m_dualQuaternions;
+};
+
+// reference implementation, one influence at the time with glm, it follows
+// the skinning shader line by line
+void skinVerticesLinearBlendScalar(const SkinningVertexData &vertices,
+                                   const glm::mat4 *matrices,
+                                   const SkinningOutput &output);
+
+}  // namespace SirEngine
@@ -3,11 +3,13 @@
 #include "SirEngine/animation/animationClip.h"
 #include "SirEngine/animation/animationManager.h"
 #include "SirEngine/animation/animationManipulation.h"
+#include "SirEngine/animation/poseStreams.h"
 #include "SirEngine/animation/skeleton.h"
+#include "SirEngine/globals.h"
 #include "SirEngine/io/fileUtils.h"
 #include "SirEngine/input.h"
 #include "SirEngine/log.h"
-#include "SirEngine/runtimeString.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
 #include "SirEngine/scripting/scriptingContext.h"
 #include "nlohmann/json.hpp"
 
@@ -42,6 +44,13 @@ int convertTimeToFrames(const int64_t currentStamp, const int64_t originStamp,
   return frame;
 }
 
+LuaStatePlayer::~LuaStatePlayer() {
+  // a player never initialized has no clips
+  if (m_clips != nullptr) {
+    globals::PERSISTENT_ALLOCATOR->free(m_clips);
+  }
+}
+
 void LuaStatePlayer::init(AnimationManager *manager,
                           nlohmann::json &configJson) {
   m_transform = glm::mat4(1.0f);
@@ -70,39 +79,61 @@ void LuaStatePlayer::init(AnimationManager *manager,
   stateMachine =
       globals::SCRIPTING_CONTEXT->loadScript(scriptPath.c_str(), true);
 
-  // now we need to iterate the animations and make sure they are loaded, they
-  // will reference them by name for now, so no need to store a handle or
-  // pointer just make sure they are loaded
-
   const auto found = configJson.find(ANIMATION_CLIPS_KEY);
   if (found == configJson.end()) {
     assert(0 &&
            "Could not find animations clips in given state machine config");
   }
+
+  // the start function of the state machine gets two tables, clip name to
+  // clip id and keyword name to keyword value, the script resolves all its
+  // names through them once and from there on only returns ids
+  lua_State *state = globals::SCRIPTING_CONTEXT->getContext();
+  lua_getglobal(state, START_FUNCTION_NAME);
+
+  m_clipCount = static_cast<uint32_t>(found.value().size());
+  m_clips = static_cast<const AnimationClip **>(
+      globals::PERSISTENT_ALLOCATOR->allocate(sizeof(AnimationClip *) *
+                                              m_clipCount));
+  lua_createtable(state, 0, static_cast<int>(m_clipCount));
+  uint32_t clipId = 0;
   for (const auto &anim : found.value()) {
     const auto clipPath = anim.get<std::string>();
 
     assert(!clipPath.empty());
 
     // animation
-    // checking if the animation clip is already cached, if not load it
+    // checking if the animation clip is already cached, if not load it, the
+    // script knows the clip by its file name
     const std::string animationClipFileName = getFileName(clipPath);
-    manager->loadAnimationClip(animationClipFileName.c_str(), clipPath.c_str());
+    m_clips[clipId] = manager->loadAnimationClip(animationClipFileName.c_str(),
+                                                 clipPath.c_str());
+    assert(m_clips[clipId] != nullptr);
+    assert(static_cast<uint32_t>(m_clips[clipId]->m_bonesPerFrame) ==
+           skeleton->m_jointCount);
+    lua_pushinteger(state, clipId);
+    lua_setfield(state, -2, animationClipFileName.c_str());
+    ++clipId;
+  }
+
+  const auto &keywords = manager->getKeywordMap();
+  lua_createtable(state, 0, static_cast<int>(keywords.getUsedBins()));
+  const uint32_t binCount = keywords.binCount();
+  for (uint32_t i = 0; i < binCount; ++i) {
+    if (!keywords.isBinUsed(i)) {
+      continue;
+    }
+    lua_pushinteger(state, keywords.getValueAtBin(i));
+    lua_setfield(state, -2, keywords.getKeyAtBin(i));
   }
 
   // allocating named pose
   m_outPose = manager->getSkeletonPose(skeleton);
-  // scratch memory to perform the transition
-  m_transitionSource = manager->getSkeletonPose(skeleton);
-  m_transitionDest = manager->getSkeletonPose(skeleton);
   m_startTimeStamp = manager->getAnimClock().getTicks();
   m_flags = ANIM_FLAGS::READY;
 
   // execute the start of the state machine
-  lua_State *state = globals::SCRIPTING_CONTEXT->getContext();
-  lua_getglobal(state, START_FUNCTION_NAME);
-
-  const int status = lua_pcall(state, 0, 3, 0);
+  const int status = lua_pcall(state, 2, 3, 0);
   if (status != LUA_OK) {
     const char *message = lua_tostring(state, -1);
     SE_CORE_ERROR(message);
@@ -110,78 +141,71 @@ void LuaStatePlayer::init(AnimationManager *manager,
     assert(0);
   }
 
-  const char *newState = lua_tostring(state, -3);
-  assert(newState != nullptr);
-  currentState = persistentString(newState);
-  const char *currentAnimStr = lua_tostring(state, -2);
-  assert(currentAnimStr != nullptr);
-  currentAnim = persistentString(currentAnimStr);
+  // returns the start state, its clip and cog speed
+  currentState = lua_tointeger(state, -3);
+  currentClip = getClipFromId(lua_tointeger(state, -2));
   auto cogSpeed = static_cast<float>(lua_tonumber(state, -1));
+  lua_pop(state, 3);
 
   m_currentCogSpeed = cogSpeed;
 }
 
+const AnimationClip *LuaStatePlayer::getClipFromId(
+    const long long clipId) const {
+  assert(clipId >= 0 && clipId < m_clipCount &&
+         "state machine returned a clip id out of range");
+  return m_clips[clipId];
+}
+
 void LuaStatePlayer::evaluateStateMachine() {
   // execute the lua state machine
   lua_State *state = globals::SCRIPTING_CONTEXT->getContext();
   lua_getglobal(state, EVALUATE_FUNCTION_NAME);
-  lua_pushstring(state, currentState);
-  const int status = lua_pcall(state, 1, 6, 0);
+  lua_pushinteger(state, currentState);
+  const int status = lua_pcall(state, 1, 5, 0);
   if (status != LUA_OK) {
     const char *message = lua_tostring(state, -1);
     SE_CORE_ERROR(message);
     lua_pop(state, 1);
     assert(0);
   }
-  // TODO might be worth to return the table directly and parse that
   // the first returned argument is the state that the state machine decided to
   // be in
-  const char *newState = lua_tostring(state, -6);
+  const long long newState = lua_tointeger(state, -5);
   // the method among other param returns a state, if the state changed from the
   // one we passed in, it means we also got enough data to perform a transition,
-  // (the other arguments
+  // all of them ids resolved by the start function
   // return args are:
-  //- new state, string: the state the state machine is in
-  //- current animation clip: string,
-  //- transition to animation clip, string
-  //- transition key: string, which key we want to use for the transition
-  bool shouldParseArguments = strcmp(newState, currentState) != 0;
+  //- new state, integer: the state the state machine is in
+  //- transition to animation clip, integer: the clip id
+  //- transition key: integer, which keyword we want to use for the transition,
+  //  nil for none
+  //- transition length in seconds and cog speed, numbers
+  const bool shouldParseArguments = newState != currentState;
   if (shouldParseArguments) {
     // also mean we took a transition to a new state
-    // currently not used
-    // const char *sourceAnim = lua_tostring(state, -5);
-    const char *targetAnim = lua_tostring(state, -4);
-    const char *transitionKey = lua_tostring(state, -3);
-    auto transitionLenInSeconds = static_cast<float>(lua_tonumber(state, -2));
-    auto cogSpeed = static_cast<float>(lua_tonumber(state, -1));
-
-    // stringFree(currentState);
-    // currentState = persistentString(newState);
     Transition transition;
-    transition.m_targetAnimation = persistentString(targetAnim);
-    transition.m_targetState = persistentString(newState);
-    transition.m_transitionLength = transitionLenInSeconds;
-    transition.m_cogSpeed = cogSpeed;
-
-    // lets convert the transition key from string to the correct enum
-    if (strlen(transitionKey) != 0) {
-      transition.m_transitionKeyID = static_cast<ANIM_CLIP_KEYWORDS>(
-          globals::ANIMATION_MANAGER->animationKeywordNameToValue(
-              transitionKey));
-    } else {
-      transition.m_transitionKeyID = ANIM_CLIP_KEYWORDS::NONE;
-    }
-
-    // adding the transition to the queue for later evaluation
-    m_transitionsQueue.push(transition);
+    transition.m_targetClip = getClipFromId(lua_tointeger(state, -4));
+    transition.m_targetState = newState;
+    const long long transitionKey = lua_tointeger(state, -3);
+    transition.m_transitionKeyID =
+        transitionKey != 0 ? static_cast<ANIM_CLIP_KEYWORDS>(transitionKey)
+                           : ANIM_CLIP_KEYWORDS::NONE;
+    transition.m_transitionLength = static_cast<float>(lua_tonumber(state, -2));
+    transition.m_cogSpeed = static_cast<float>(lua_tonumber(state, -1));
+
+    // adding the transition to the queue for later evaluation, the update
+    // throttles the state machine so there is always room
+    const bool pushed = m_transitionsQueue.push(transition);
+    assert(pushed);
+    (void)pushed;
 
     // we let current state move forward such that state machine evaluates
     // correctly, but we throttle the evaluation based on the max state changes
     // queue
-    stringFree(currentState);
-    currentState = persistentString(newState);
+    currentState = newState;
   }
-  lua_pop(state, 6);
+  lua_pop(state, 5);
 }
 
 void LuaStatePlayer::updateTransform() {
@@ -214,46 +238,46 @@ void LuaStatePlayer::updateTransform() {
   m_transform = translationMatrix * m_transform;
 }
 
-void LuaStatePlayer::evaluate(const int64_t stampNS) {
+void LuaStatePlayer::update(const int64_t) {
   updateTransform();
 
   // if the queue is too full we just prevent the state machine from evaluating
-  bool shouldEvaluate = m_transitionsQueue.size() < m_queueMaxSize;
+  const int pendingTransitions = m_transitionsQueue.usedElementCount() +
+                                 (m_isTransitioning ? 1 : 0);
+  const bool shouldEvaluate = pendingTransitions < QUEUE_MAX_SIZE;
   if (shouldEvaluate) {
     evaluateStateMachine();
   }
+}
 
+void LuaStatePlayer::evaluate(const int64_t stampNS, StackAllocator &scratch) {
   // let us check if there is any transition to be done
-  if (m_currentTransition == nullptr && m_transitionsQueue.empty()) {
+  if (!m_isTransitioning && m_transitionsQueue.isEmpty()) {
     // no transition to make, let us perform a simple animation evaluation
-    AnimationEvalRequest eval{currentAnim,      m_outPose,    stampNS,
-                              m_startTimeStamp, m_multiplier, true,
-                              m_transform};
-    evaluateAnim(&eval);
-    m_flags = ANIM_FLAGS::NEW_MATRICES;
+    sampleAnimationClip(currentClip, stampNS, m_startTimeStamp, m_multiplier,
+                        m_outPose->m_localStreams, m_animatedJointCount);
   } else {
     // we do indeed need to perform a transition
 
     // if there is not a currently active transition we get the front of the
     // queue
-    if (m_currentTransition == nullptr) {
-      m_currentTransition = &m_transitionsQueue.front();
+    if (!m_isTransitioning) {
+      m_currentTransition = m_transitionsQueue.pop();
+      m_isTransitioning = true;
     }
 
     // now we have a current transition and we need to get started
     const bool completedTransition =
-        performTransition(m_currentTransition, stampNS);
+        performTransition(&m_currentTransition, stampNS, scratch);
 
     if (completedTransition) {
-      currentAnim = m_currentTransition->m_targetAnimation;
-      m_startTimeStamp = m_currentTransition->m_destAnimStartTimeStamp;
-      m_currentCogSpeed = m_currentTransition->m_cogSpeed;
+      currentClip = m_currentTransition.m_targetClip;
+      m_startTimeStamp = m_currentTransition.m_destAnimStartTimeStamp;
+      m_currentCogSpeed = m_currentTransition.m_cogSpeed;
       m_workingCogSpeed = m_currentCogSpeed;
-      ;
 
       // cleaning up the transition
-      m_currentTransition = nullptr;
-      m_transitionsQueue.pop();
+      m_isTransitioning = false;
     }
   }
 
@@ -265,15 +289,10 @@ void LuaStatePlayer::evaluate(const int64_t stampNS) {
 }
 
 bool LuaStatePlayer::performTransition(Transition *transition,
-                                       const int64_t timeStamp) {
-  // let us first fetch the clip from the animation manager, I am not
-  // particularly happy about this fetch based on string, BUT I will worry
-  // once the profile shows is an actual problem for now this will do
-  const AnimationClip *clip =
-      globals::ANIMATION_MANAGER->getAnimationClipByName(currentAnim);
-  const AnimationClip *clipDest =
-      globals::ANIMATION_MANAGER->getAnimationClipByName(
-          transition->m_targetAnimation);
+                                       const int64_t timeStamp,
+                                       StackAllocator &scratch) {
+  const AnimationClip *clip = currentClip;
+  const AnimationClip *clipDest = transition->m_targetClip;
 
   const double frameLenInMS = clip->m_frameRate * 1000.0;
 
@@ -372,70 +391,46 @@ bool LuaStatePlayer::performTransition(Transition *transition,
     assert(ratio > -0.00001f);
     if (ratio >= 1.0f) {
       // we are past the range, no need o interpolate
-      AnimationEvalRequest eval{transition->m_targetAnimation,
-                                m_outPose,
-                                timeStamp,
-                                m_startTimeStamp,
-                                m_multiplier,
-                                true,
-                                m_transform};
-      evaluateAnim(&eval);
+      sampleAnimationClip(clipDest, timeStamp, m_startTimeStamp, m_multiplier,
+                          m_outPose->m_localStreams, m_animatedJointCount);
       transition->m_status = TRANSITION_STATUS::DONE;
       // we are done with the transition return true
       return true;
 
     } else {
-      submitInterpRequest(timeStamp, transition, ratio);
+      submitInterpRequest(timeStamp, transition, ratio, scratch);
     }
   } else {
-    AnimationEvalRequest eval{currentAnim,      m_outPose,    timeStamp,
-                              m_startTimeStamp, m_multiplier, true,
-                              m_transform};
-    evaluateAnim(&eval);
+    sampleAnimationClip(clip, timeStamp, m_startTimeStamp, m_multiplier,
+                        m_outPose->m_localStreams, m_animatedJointCount);
   }
-  m_flags = ANIM_FLAGS::NEW_MATRICES;
   return false;
 }
 
 void LuaStatePlayer::submitInterpRequest(const int64_t timeStamp,
-                                         Transition *transition,
-                                         const float ratio) {
-  // we have to make two interpolation requests
-  // source interpolation request request
-  AnimationEvalRequest srcRequest{};
-  srcRequest.convertToGlobals = false;
-  srcRequest.m_animation = currentAnim;
-  srcRequest.m_destination = m_transitionSource;
-  srcRequest.m_stampNS = timeStamp;
-  srcRequest.m_originTime = m_startTimeStamp;
-  srcRequest.m_multiplier = 1.0f;
-  srcRequest.m_transform =
-      m_transform;  // not used since convert to global is off
-  evaluateAnim(&srcRequest);
-
-  // now we interpolate the destination
-  AnimationEvalRequest destRequest{};
-  destRequest.convertToGlobals = false;
-  destRequest.m_animation = transition->m_targetAnimation;
-  destRequest.m_destination = m_transitionDest;
-  destRequest.m_stampNS = timeStamp;
-  destRequest.m_originTime = transition->m_destAnimStartTimeStamp;
-  destRequest.m_multiplier = 1.0f;
-  destRequest.m_transform =
-      m_transform;  // not used since convert to global is off
-  evaluateAnim(&destRequest);
+                                         const Transition *transition,
+                                         const float ratio,
+                                         StackAllocator &scratch) {
+  // the two animations get sampled in scratch memory, then blended in the
+  // output pose
+  const uint32_t jointCount = skeleton->m_jointCount;
+  const size_t streamsSizeInBytes =
+      sizeof(float) * getPoseStreamsSize(jointCount);
+  auto *source = static_cast<float *>(scratch.allocate(streamsSizeInBytes));
+  auto *destination =
+      static_cast<float *>(scratch.allocate(streamsSizeInBytes));
+
+  sampleAnimationClip(currentClip, timeStamp, m_startTimeStamp, 1.0f, source,
+                      m_animatedJointCount);
+  sampleAnimationClip(transition->m_targetClip, timeStamp,
+                      transition->m_destAnimStartTimeStamp, 1.0f, destination,
+                      m_animatedJointCount);
 
   // now we need to interpolate not two frames but to existing poses
   // one from the source and one from the destination animation
-  InterpolateTwoPosesRequest finalRequest{};
-  finalRequest.factor = ratio;
-  finalRequest.src = m_transitionSource;
-  finalRequest.dest = m_transitionDest;
-  finalRequest.output = m_outPose;
-  finalRequest.m_transform = m_transform;
-
-  interpolateTwoPoses(finalRequest);
-  m_flags = ANIM_FLAGS::NEW_MATRICES;
+  interpolatePoseStreams(source, destination, ratio, jointCount,
+                         m_outPose->m_localStreams, m_animatedJointCount);
+  scratch.free(streamsSizeInBytes * 2);
 
   // interpolate cog speed
   m_workingCogSpeed =
@@ -11,51 +11,62 @@
 // from there. One option is to pass a void pointer and cast it internally which
 // is not really pretty either
 #include "nlohmann/json_fwd.hpp"
-// TODO remove std::queue
-#include <queue>
-// once the queue is removed I can just also swap the allocation for pointers in
-// a pool and not have the include
 #include "SirEngine/animation/animationManipulation.h"
+#include "SirEngine/memory/cpu/ringBuffer.h"
 
 namespace SirEngine {
 struct SkeletonPose;
 struct Skeleton;
 class AnimationManager;
+struct AnimationClip;
 
+// Plays a state machine written in lua. Names only exist at load time: the
+// clips listed in the config get an id, their position in the list, and the
+// start function of the script gets the tables mapping clip and keyword names
+// to ids, so the state machine can resolve itself once. From there on the
+// evaluate function of the script trades integers only and the queued
+// transitions live in a fixed ring buffer, a frame does not allocate.
 class LuaStatePlayer final : public AnimationPlayer {
 
 public:
   LuaStatePlayer() : AnimationPlayer() {}
-  ~LuaStatePlayer() override = default;
+  ~LuaStatePlayer() override;
 
   void init(AnimationManager *manager, nlohmann::json &configJson);
-  void evaluate(long long stampNS) override;
+  void update(long long stampNS) override;
+  void evaluate(long long stampNS, StackAllocator &scratch) override;
   [[nodiscard]] uint32_t getJointCount() const override;
 
 private:
   void evaluateStateMachine();
   void updateTransform();
-  void submitInterpRequest(long long timeStamp, Transition *transition,
-                           float ratio);
-  bool performTransition(Transition *transition, const long long timeStamp);
+  void submitInterpRequest(long long timeStamp, const Transition *transition,
+                           float ratio, StackAllocator &scratch);
+  bool performTransition(Transition *transition, const long long timeStamp,
+                         StackAllocator &scratch);
+  const AnimationClip *getClipFromId(long long clipId) const;
 
 private:
   Skeleton *skeleton = nullptr;
   float m_multiplier = 1.0f;
   ScriptHandle stateMachine{};
-  const char *currentState = "";
-  const char *currentAnim = "";
-  SkeletonPose *m_transitionSource = nullptr;
-  SkeletonPose *m_transitionDest = nullptr;
-  Transition *m_currentTransition = nullptr;
-  int m_queueMaxSize = 2;
+  // one per clip of the config, the index is the id the script uses
+  const AnimationClip **m_clips = nullptr;
+  uint32_t m_clipCount = 0;
+  // state ids are opaque, they are whatever the script returns
+  long long currentState = 0;
+  const AnimationClip *currentClip = nullptr;
+  // the transition being played, out of the queue
+  Transition m_currentTransition{};
+  bool m_isTransitioning = false;
   float m_currentCogSpeed = 0.0f;
   float m_workingCogSpeed = 0.0f;
-  glm::mat4 m_transform;
-
-  // temporary
-  std::queue<Transition> m_transitionsQueue;
 
+  // the state machine stops being evaluated while this many transitions,
+  // the playing one included, are pending
+  static constexpr int QUEUE_MAX_SIZE = 2;
+  RingBuffer<Transition, QUEUE_MAX_SIZE + 1> m_transitionsQueue{
+      QUEUE_MAX_SIZE};
 };
 
 } // namespace SirEngine
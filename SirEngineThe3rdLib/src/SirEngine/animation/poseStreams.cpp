@@ -0,0 +1,394 @@
+#include "SirEngine/animation/poseStreams.h"
+
+#include <immintrin.h>
+
+#include <cstring>
+
+#include "SirEngine/animation/skeleton.h"
+
+namespace SirEngine {
+
+namespace {
+// thin layer over the widest instruction set we are compiled for, the kernel
+// is written once against it. The engine is built with AVX2 and FMA, SSE2 is
+// the baseline of x64
+#if defined(__AVX2__)
+using Lanes = __m256;
+constexpr uint32_t LANE_COUNT = 8;
+inline Lanes load(const float *p) { return _mm256_loadu_ps(p); }
+inline void store(float *p, const Lanes v) { _mm256_storeu_ps(p, v); }
+inline Lanes splat(const float v) { return _mm256_set1_ps(v); }
+inline Lanes add(const Lanes a, const Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes sub(const Lanes a, const Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes mul(const Lanes a, const Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes div(const Lanes a, const Lanes b) { return _mm256_div_ps(a, b); }
+// a * b + c
+inline Lanes madd(const Lanes a, const Lanes b, const Lanes c) {
+  return _mm256_fmadd_ps(a, b, c);
+}
+inline Lanes bitAnd(const Lanes a, const Lanes b) {
+  return _mm256_and_ps(a, b);
+}
+inline Lanes bitXor(const Lanes a, const Lanes b) {
+  return _mm256_xor_ps(a, b);
+}
+inline Lanes rsqrt(const Lanes a) { return _mm256_rsqrt_ps(a); }
+inline int lessThanMask(const Lanes a, const Lanes b) {
+  return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ));
+}
+#else
+using Lanes = __m128;
+constexpr uint32_t LANE_COUNT = 4;
+inline Lanes load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, const Lanes v) { _mm_storeu_ps(p, v); }
+inline Lanes splat(const float v) { return _mm_set1_ps(v); }
+inline Lanes add(const Lanes a, const Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes sub(const Lanes a, const Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes mul(const Lanes a, const Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes div(const Lanes a, const Lanes b) { return _mm_div_ps(a, b); }
+inline Lanes madd(const Lanes a, const Lanes b, const Lanes c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+inline Lanes bitAnd(const Lanes a, const Lanes b) { return _mm_and_ps(a, b); }
+inline Lanes bitXor(const Lanes a, const Lanes b) { return _mm_xor_ps(a, b); }
+inline Lanes rsqrt(const Lanes a) { return _mm_rsqrt_ps(a); }
+inline int lessThanMask(const Lanes a, const Lanes b) {
+  return _mm_movemask_ps(_mm_cmplt_ps(a, b));
+}
+#endif
+static_assert(POSE_SIMD_WIDTH % LANE_COUNT == 0,
+              "the streams padding must be a multiple of the lanes");
+
+// the estimate is only good to 12 bits, one newton step brings it to almost
+// full precision
+inline Lanes inverseLength(const Lanes lengthSq) {
+  const Lanes estimate = rsqrt(lengthSq);
+  return mul(mul(splat(0.5f), estimate),
+             sub(splat(3.0f), mul(mul(lengthSq, estimate), estimate)));
+}
+
+// a lane worth of rotations
+struct LaneQuats {
+  Lanes x;
+  Lanes y;
+  Lanes z;
+  Lanes w;
+};
+inline LaneQuats loadRotations(const float *streams, const uint32_t stride,
+                               const uint32_t joint) {
+  return {load(streams + joint), load(streams + stride + joint),
+          load(streams + stride * 2 + joint),
+          load(streams + stride * 3 + joint)};
+}
+inline void storeRotations(float *streams, const uint32_t stride,
+                           const uint32_t joint, const LaneQuats &q) {
+  store(streams + joint, q.x);
+  store(streams + stride + joint, q.y);
+  store(streams + stride * 2 + joint, q.z);
+  store(streams + stride * 3 + joint, q.w);
+}
+// a * b, same convention as glm
+inline LaneQuats multiplyRotations(const LaneQuats &a, const LaneQuats &b) {
+  return {sub(madd(a.w, b.x, madd(a.x, b.w, mul(a.y, b.z))), mul(a.z, b.y)),
+          sub(madd(a.w, b.y, madd(a.y, b.w, mul(a.z, b.x))), mul(a.x, b.z)),
+          sub(madd(a.w, b.z, madd(a.z, b.w, mul(a.x, b.y))), mul(a.y, b.x)),
+          sub(mul(a.w, b.w),
+              madd(a.x, b.x, madd(a.y, b.y, mul(a.z, b.z))))};
+}
+inline LaneQuats normalizeRotations(const LaneQuats &q) {
+  const Lanes invLength =
+      inverseLength(madd(q.w, q.w, madd(q.z, q.z, madd(q.y, q.y,
+                                                       mul(q.x, q.x)))));
+  return {mul(q.x, invLength), mul(q.y, invLength), mul(q.z, invLength),
+          mul(q.w, invLength)};
+}
+
+glm::quat getStreamRotation(const float *streams, const uint32_t stride,
+                            const uint32_t joint) {
+  return glm::quat(streams[stride * 3 + joint], streams[joint],
+                   streams[stride + joint], streams[stride * 2 + joint]);
+}
+void setStreamRotation(float *streams, const uint32_t stride,
+                       const uint32_t joint, const glm::quat &rot) {
+  streams[joint] = rot.x;
+  streams[stride + joint] = rot.y;
+  streams[stride * 2 + joint] = rot.z;
+  streams[stride * 3 + joint] = rot.w;
+}
+}  // namespace
+
+void jointPosesToStreams(const JointPose *poses, const uint32_t jointCount,
+                         float *streams) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  float *rx = streams;
+  float *ry = rx + stride;
+  float *rz = ry + stride;
+  float *rw = rz + stride;
+  float *tx = rw + stride;
+  float *ty = tx + stride;
+  float *tz = ty + stride;
+  float *s = tz + stride;
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    const JointPose &pose = poses[i];
+    rx[i] = pose.m_rot.x;
+    ry[i] = pose.m_rot.y;
+    rz[i] = pose.m_rot.z;
+    rw[i] = pose.m_rot.w;
+    tx[i] = pose.m_trans.x;
+    ty[i] = pose.m_trans.y;
+    tz[i] = pose.m_trans.z;
+    s[i] = pose.m_scale;
+  }
+  for (uint32_t i = jointCount; i < stride; ++i) {
+    rx[i] = ry[i] = rz[i] = 0.0f;
+    rw[i] = 1.0f;
+    tx[i] = ty[i] = tz[i] = 0.0f;
+    s[i] = 1.0f;
+  }
+}
+
+void streamsToJointPoses(const float *streams, const uint32_t jointCount,
+                         JointPose *poses) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const float *rx = streams;
+  const float *ry = rx + stride;
+  const float *rz = ry + stride;
+  const float *rw = rz + stride;
+  const float *tx = rw + stride;
+  const float *ty = tx + stride;
+  const float *tz = ty + stride;
+  const float *s = tz + stride;
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    JointPose &pose = poses[i];
+    pose.m_rot = glm::quat(rw[i], rx[i], ry[i], rz[i]);
+    pose.m_trans = glm::vec3(tx[i], ty[i], tz[i]);
+    pose.m_scale = s[i];
+  }
+}
+
+namespace {
+// shared by the uniform and the per joint interpolation, jointFactors is
+// null for the former
+void interpolateStreams(const float *a, const float *b, const float factor,
+                        const float *jointFactors, const uint32_t jointCount,
+                        float *out, const uint32_t animatedJointCount) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  // padding lanes included when all the joints are animated
+  const uint32_t end = getPoseStreamStride(
+      getAnimatedJointCount(jointCount, animatedJointCount));
+  const Lanes uniform = splat(factor);
+  const Lanes signMask = splat(-0.0f);
+  const Lanes minDot = splat(NLERP_MIN_DOT);
+
+  // rotations
+  for (uint32_t j = 0; j < end; j += LANE_COUNT) {
+    const Lanes t = jointFactors != nullptr ? load(jointFactors + j) : uniform;
+    const Lanes ax = load(a + j);
+    const Lanes ay = load(a + stride + j);
+    const Lanes az = load(a + stride * 2 + j);
+    const Lanes aw = load(a + stride * 3 + j);
+    Lanes bx = load(b + j);
+    Lanes by = load(b + stride + j);
+    Lanes bz = load(b + stride * 2 + j);
+    Lanes bw = load(b + stride * 3 + j);
+
+    // flipping b where needed to take the shortest path
+    Lanes dot = mul(ax, bx);
+    dot = madd(ay, by, dot);
+    dot = madd(az, bz, dot);
+    dot = madd(aw, bw, dot);
+    const Lanes sign = bitAnd(dot, signMask);
+    bx = bitXor(bx, sign);
+    by = bitXor(by, sign);
+    bz = bitXor(bz, sign);
+    bw = bitXor(bw, sign);
+    const int slerpLanes = lessThanMask(bitXor(dot, sign), minDot);
+
+    // wide angles get a proper slerp, done before storing anything since out
+    // might alias the inputs
+    glm::quat slerped[LANE_COUNT];
+    if (slerpLanes != 0) {
+      for (uint32_t lane = 0; lane < LANE_COUNT; ++lane) {
+        if ((slerpLanes & (1 << lane)) != 0) {
+          slerped[lane] = glm::slerp(
+              getStreamRotation(a, stride, j + lane),
+              getStreamRotation(b, stride, j + lane),
+              jointFactors != nullptr ? jointFactors[j + lane] : factor);
+        }
+      }
+    }
+
+    const Lanes rx = madd(t, sub(bx, ax), ax);
+    const Lanes ry = madd(t, sub(by, ay), ay);
+    const Lanes rz = madd(t, sub(bz, az), az);
+    const Lanes rw = madd(t, sub(bw, aw), aw);
+    Lanes lengthSq = mul(rx, rx);
+    lengthSq = madd(ry, ry, lengthSq);
+    lengthSq = madd(rz, rz, lengthSq);
+    lengthSq = madd(rw, rw, lengthSq);
+    const Lanes invLength = inverseLength(lengthSq);
+    store(out + j, mul(rx, invLength));
+    store(out + stride + j, mul(ry, invLength));
+    store(out + stride * 2 + j, mul(rz, invLength));
+    store(out + stride * 3 + j, mul(rw, invLength));
+
+    if (slerpLanes != 0) {
+      for (uint32_t lane = 0; lane < LANE_COUNT; ++lane) {
+        if ((slerpLanes & (1 << lane)) != 0) {
+          setStreamRotation(out, stride, j + lane, slerped[lane]);
+        }
+      }
+    }
+  }
+
+  // translations and scale, a plain lerp on the remaining streams
+  for (uint32_t s = 4; s < POSE_STREAM_COUNT; ++s) {
+    for (uint32_t j = 0; j < end; j += LANE_COUNT) {
+      const Lanes t =
+          jointFactors != nullptr ? load(jointFactors + j) : uniform;
+      const uint32_t idx = s * stride + j;
+      const Lanes va = load(a + idx);
+      store(out + idx, madd(t, sub(load(b + idx), va), va));
+    }
+  }
+}
+}  // namespace
+
+void interpolatePoseStreams(const float *a, const float *b, const float factor,
+                            const uint32_t jointCount, float *out,
+                            const uint32_t animatedJointCount) {
+  interpolateStreams(a, b, factor, nullptr, jointCount, out,
+                     animatedJointCount);
+}
+
+void interpolatePoseStreamsMasked(const float *a, const float *b,
+                                  const float *jointFactors,
+                                  const uint32_t jointCount, float *out,
+                                  const uint32_t animatedJointCount) {
+  interpolateStreams(a, b, 0.0f, jointFactors, jointCount, out,
+                     animatedJointCount);
+}
+
+void clearPoseStreams(float *streams, const uint32_t jointCount,
+                      const uint32_t animatedJointCount) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const uint32_t end = getPoseStreamStride(
+      getAnimatedJointCount(jointCount, animatedJointCount));
+  for (uint32_t s = 0; s < POSE_STREAM_COUNT; ++s) {
+    memset(streams + s * stride, 0, sizeof(float) * end);
+  }
+}
+
+void accumulatePoseStreams(const float *pose, const float weight,
+                           const uint32_t jointCount, float *accumulator,
+                           const uint32_t animatedJointCount) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const uint32_t end = getPoseStreamStride(
+      getAnimatedJointCount(jointCount, animatedJointCount));
+  const Lanes w = splat(weight);
+  const Lanes signMask = splat(-0.0f);
+
+  for (uint32_t j = 0; j < end; j += LANE_COUNT) {
+    const LaneQuats acc = loadRotations(accumulator, stride, j);
+    const LaneQuats q = loadRotations(pose, stride, j);
+    // same hemisphere as what got accumulated so far, the first pose in
+    // finds a zero accumulator and is taken as is
+    const Lanes dot =
+        madd(acc.w, q.w, madd(acc.z, q.z, madd(acc.y, q.y, mul(acc.x, q.x))));
+    const Lanes signedWeight = bitXor(w, bitAnd(dot, signMask));
+    storeRotations(accumulator, stride, j,
+                   {madd(signedWeight, q.x, acc.x),
+                    madd(signedWeight, q.y, acc.y),
+                    madd(signedWeight, q.z, acc.z),
+                    madd(signedWeight, q.w, acc.w)});
+  }
+  for (uint32_t s = 4; s < POSE_STREAM_COUNT; ++s) {
+    for (uint32_t j = s * stride; j < s * stride + end; j += LANE_COUNT) {
+      store(accumulator + j, madd(w, load(pose + j), load(accumulator + j)));
+    }
+  }
+}
+
+void normalizePoseStreams(float *streams, const uint32_t jointCount,
+                          const uint32_t animatedJointCount) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const uint32_t end = getPoseStreamStride(
+      getAnimatedJointCount(jointCount, animatedJointCount));
+  for (uint32_t j = 0; j < end; j += LANE_COUNT) {
+    storeRotations(streams, stride, j,
+                   normalizeRotations(loadRotations(streams, stride, j)));
+  }
+}
+
+void addPoseStreams(const float *base, const float *additive,
+                    const float *reference, const float factor,
+                    const uint32_t jointCount, float *out,
+                    const uint32_t animatedJointCount) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  const uint32_t end = getPoseStreamStride(
+      getAnimatedJointCount(jointCount, animatedJointCount));
+  const Lanes t = splat(factor);
+  const Lanes oneMinusT = splat(1.0f - factor);
+  const Lanes one = splat(1.0f);
+  const Lanes signMask = splat(-0.0f);
+
+  for (uint32_t j = 0; j < end; j += LANE_COUNT) {
+    LaneQuats delta = loadRotations(additive, stride, j);
+    if (reference != nullptr) {
+      // the inverse of a unit rotation is its conjugate
+      const LaneQuats ref = loadRotations(reference, stride, j);
+      delta = multiplyRotations(delta, {bitXor(ref.x, signMask),
+                                        bitXor(ref.y, signMask),
+                                        bitXor(ref.z, signMask), ref.w});
+    }
+    // shortest path from the identity, then scaled by the factor
+    const Lanes sign = bitAnd(delta.w, signMask);
+    const LaneQuats scaled = normalizeRotations(
+        {mul(t, bitXor(delta.x, sign)), mul(t, bitXor(delta.y, sign)),
+         mul(t, bitXor(delta.z, sign)),
+         madd(t, bitXor(delta.w, sign), oneMinusT)});
+    storeRotations(out, stride, j,
+                   multiplyRotations(scaled, loadRotations(base, stride, j)));
+  }
+
+  // translations add the difference
+  const auto scaleStream = static_cast<uint32_t>(POSE_STREAM::SCALE);
+  for (uint32_t s = 4; s < scaleStream; ++s) {
+    for (uint32_t j = s * stride; j < s * stride + end; j += LANE_COUNT) {
+      Lanes difference = load(additive + j);
+      if (reference != nullptr) {
+        difference = sub(difference, load(reference + j));
+      }
+      store(out + j, madd(t, difference, load(base + j)));
+    }
+  }
+  // scale multiplies by the ratio
+  for (uint32_t j = scaleStream * stride; j < scaleStream * stride + end;
+       j += LANE_COUNT) {
+    Lanes ratio = load(additive + j);
+    if (reference != nullptr) {
+      ratio = div(ratio, load(reference + j));
+    }
+    store(out + j, mul(load(base + j), madd(t, sub(ratio, one), one)));
+  }
+}
+
+void interpolatePoseStreamsScalar(const float *a, const float *b,
+                                  const float factor,
+                                  const uint32_t jointCount, float *out) {
+  const uint32_t stride = getPoseStreamStride(jointCount);
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    const glm::quat rot =
+        glm::slerp(getStreamRotation(a, stride, i),
+                   getStreamRotation(b, stride, i), factor);
+    setStreamRotation(out, stride, i, rot);
+  }
+  for (uint32_t s = 4; s < POSE_STREAM_COUNT; ++s) {
+    for (uint32_t i = 0; i < jointCount; ++i) {
+      const uint32_t idx = stride * s + i;
+      out[idx] = (1.0f - factor) * a[idx] + factor * b[idx];
+    }
+  }
+}
+
+}  // namespace SirEngine
@@ -0,0 +1,109 @@
+#pragma once
+#include <stdint.h>
+
+namespace SirEngine {
+
+struct JointPose;
+
+// Poses in structure of arrays layout: one stream of floats per component,
+// all the x of the rotations, then all the y and so on. The streams of a pose
+// are back to back in a single block and every stream is padded to a multiple
+// of POSE_SIMD_WIDTH joints, the padding joints are identities so the kernels
+// never have to deal with a tail.
+enum class POSE_STREAM {
+  ROT_X = 0,
+  ROT_Y,
+  ROT_Z,
+  ROT_W,
+  TRANS_X,
+  TRANS_Y,
+  TRANS_Z,
+  SCALE,
+  COUNT
+};
+
+static constexpr uint32_t POSE_STREAM_COUNT =
+    static_cast<uint32_t>(POSE_STREAM::COUNT);
+static constexpr uint32_t POSE_SIMD_WIDTH = 8;
+
+// floats in a single stream
+inline uint32_t getPoseStreamStride(const uint32_t jointCount) {
+  return (jointCount + POSE_SIMD_WIDTH - 1) & ~(POSE_SIMD_WIDTH - 1);
+}
+// floats in a whole pose
+inline uint32_t getPoseStreamsSize(const uint32_t jointCount) {
+  return getPoseStreamStride(jointCount) * POSE_STREAM_COUNT;
+}
+inline float *getPoseStream(float *streams, const uint32_t jointCount,
+                            const POSE_STREAM stream) {
+  return streams + getPoseStreamStride(jointCount) * static_cast<int>(stream);
+}
+inline const float *getPoseStream(const float *streams,
+                                  const uint32_t jointCount,
+                                  const POSE_STREAM stream) {
+  return streams + getPoseStreamStride(jointCount) * static_cast<int>(stream);
+}
+
+// Reduced poses only animate the first joints of the skeleton, the ones
+// closest to the root, see AnimationLodTier. The kernels always work on whole
+// groups of POSE_SIMD_WIDTH joints so the count gets rounded up, the joints
+// after it are left untouched
+static constexpr uint32_t POSE_ALL_JOINTS = ~0u;
+inline uint32_t getAnimatedJointCount(const uint32_t jointCount,
+                                      const uint32_t animatedJointCount) {
+  if (animatedJointCount >= jointCount) {
+    return jointCount;
+  }
+  const uint32_t rounded = getPoseStreamStride(animatedJointCount);
+  return rounded < jointCount ? rounded : jointCount;
+}
+
+// conversions from and to the array of structures layout, the padding is
+// filled when going to streams
+void jointPosesToStreams(const JointPose *poses, uint32_t jointCount,
+                         float *streams);
+void streamsToJointPoses(const float *streams, uint32_t jointCount,
+                         JointPose *poses);
+
+// out = a * (1 - factor) + b * factor over all the joints, rotations take
+// the shortest path. Rotations get normalized lerped, which is close enough
+// to a slerp for the small angles found between two keys, joints rotating
+// more than NLERP_MIN_DOT allows fall back to a proper slerp.
+// The output can alias either input
+void interpolatePoseStreams(const float *a, const float *b, float factor,
+                            uint32_t jointCount, float *out,
+                            uint32_t animatedJointCount = POSE_ALL_JOINTS);
+// same as above with a factor per joint, jointFactors is padded like a stream
+void interpolatePoseStreamsMasked(const float *a, const float *b,
+                                  const float *jointFactors,
+                                  uint32_t jointCount, float *out,
+                                  uint32_t animatedJointCount = POSE_ALL_JOINTS);
+// reference implementation, one joint at the time with glm::slerp
+void interpolatePoseStreamsScalar(const float *a, const float *b, float factor,
+                                  uint32_t jointCount, float *out);
+
+// N-way blending: the accumulator starts zeroed, every pose gets added scaled
+// by its weight, rotations flipped to the same hemisphere of the accumulator,
+// then the rotations get normalized. The weights are expected to sum to one
+void clearPoseStreams(float *streams, uint32_t jointCount,
+                      uint32_t animatedJointCount = POSE_ALL_JOINTS);
+void accumulatePoseStreams(const float *pose, float weight,
+                           uint32_t jointCount, float *accumulator,
+                           uint32_t animatedJointCount = POSE_ALL_JOINTS);
+void normalizePoseStreams(float *streams, uint32_t jointCount,
+                          uint32_t animatedJointCount = POSE_ALL_JOINTS);
+
+// out = delta * base, where delta = additive * inverse(reference) scaled by
+// factor, the same goes for translations and scale as differences. A null
+// reference means the additive pose is already a delta. The weighted delta
+// rotation is normalized lerped from the identity. The output can alias base
+void addPoseStreams(const float *base, const float *additive,
+                    const float *reference, float factor, uint32_t jointCount,
+                    float *out,
+                    uint32_t animatedJointCount = POSE_ALL_JOINTS);
+
+// cosine of the half angle between two rotations under which nlerp is not
+// accurate enough anymore, about 36 degrees of rotation
+static constexpr float NLERP_MIN_DOT = 0.95f;
+
+}  // namespace SirEngine
@@ -1,8 +1,11 @@
 #include "SirEngine/animation/skeleton.h"
+#include "SirEngine/animation/poseStreams.h"
 #include "SirEngine/io/fileUtils.h"
 #include "SirEngine/runtimeString.h"
 #undef max
+#include <cassert>
 #include <glm/gtx/quaternion.hpp>
+#include <immintrin.h>
 #include "nlohmann/json.hpp"
 
 namespace SirEngine {
@@ -56,7 +59,127 @@ bool Skeleton::loadFromFile(const char *path) {
   return true;
 }
 
-void SkeletonPose::updateGlobalFromLocal(
+uint32_t Skeleton::getJointCountUpToDepth(const uint32_t maxDepth) const {
+  // walking up the parents is fine, this only runs when the lod of a player
+  // changes
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < m_jointCount; ++i) {
+    uint32_t depth = 0;
+    for (int parent = m_parentIds[i]; parent >= 0 && depth <= maxDepth;
+         parent = m_parentIds[parent]) {
+      ++depth;
+    }
+    if (depth <= maxDepth) {
+      count = i + 1;
+    }
+  }
+  return count;
+}
+
+namespace {
+// a * b + c, fused when available
+inline __m128 multiplyAdd(const __m128 a, const __m128 b, const __m128 c) {
+#if defined(__AVX2__)
+  return _mm_fmadd_ps(a, b, c);
+#else
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+}  // namespace
+
+void SkeletonPose::updateGlobalFromLocal(const glm::mat4 &transform) const {
+  const uint32_t jointCount = m_skeleton->m_jointCount;
+  const float *rotX =
+      getPoseStream(m_localStreams, jointCount, POSE_STREAM::ROT_X);
+  const float *rotY =
+      getPoseStream(m_localStreams, jointCount, POSE_STREAM::ROT_Y);
+  const float *rotZ =
+      getPoseStream(m_localStreams, jointCount, POSE_STREAM::ROT_Z);
+  const float *rotW =
+      getPoseStream(m_localStreams, jointCount, POSE_STREAM::ROT_W);
+  const float *transX =
+      getPoseStream(m_localStreams, jointCount, POSE_STREAM::TRANS_X);
+  const float *transY =
+      getPoseStream(m_localStreams, jointCount, POSE_STREAM::TRANS_Y);
+  const float *transZ =
+      getPoseStream(m_localStreams, jointCount, POSE_STREAM::TRANS_Z);
+  const int *parentIds = m_skeleton->m_parentIds.data();
+  const auto *inverseBinds =
+      reinterpret_cast<const float *>(m_skeleton->m_jointsWolrdInv.data());
+  auto *worldMatrices = reinterpret_cast<float *>(m_worldMat);
+  auto *skinMatrices = reinterpret_cast<float *>(m_globalPose);
+
+  // every joint comes after its parent, the parent world matrix is always
+  // ready, the roots hang from the transform
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    const int parentId = parentIds[i];
+    assert(parentId < static_cast<int>(i));
+    const float *parent = parentId < 0
+                              ? reinterpret_cast<const float *>(&transform)
+                              : worldMatrices + parentId * 16;
+    const __m128 parent0 = _mm_loadu_ps(parent);
+    const __m128 parent1 = _mm_loadu_ps(parent + 4);
+    const __m128 parent2 = _mm_loadu_ps(parent + 8);
+    const __m128 parent3 = _mm_loadu_ps(parent + 12);
+
+    // the local matrix is never built, its elements scale the parent columns
+    const float x2 = rotX[i] + rotX[i];
+    const float y2 = rotY[i] + rotY[i];
+    const float z2 = rotZ[i] + rotZ[i];
+    const float xx = rotX[i] * x2;
+    const float yy = rotY[i] * y2;
+    const float zz = rotZ[i] * z2;
+    const float xy = rotX[i] * y2;
+    const float xz = rotX[i] * z2;
+    const float yz = rotY[i] * z2;
+    const float wx = rotW[i] * x2;
+    const float wy = rotW[i] * y2;
+    const float wz = rotW[i] * z2;
+    const __m128 world0 = multiplyAdd(
+        parent2, _mm_set1_ps(xz - wy),
+        multiplyAdd(parent1, _mm_set1_ps(xy + wz),
+                    _mm_mul_ps(parent0, _mm_set1_ps(1.0f - (yy + zz)))));
+    const __m128 world1 = multiplyAdd(
+        parent2, _mm_set1_ps(yz + wx),
+        multiplyAdd(parent1, _mm_set1_ps(1.0f - (xx + zz)),
+                    _mm_mul_ps(parent0, _mm_set1_ps(xy - wz))));
+    const __m128 world2 = multiplyAdd(
+        parent2, _mm_set1_ps(1.0f - (xx + yy)),
+        multiplyAdd(parent1, _mm_set1_ps(yz - wx),
+                    _mm_mul_ps(parent0, _mm_set1_ps(xz + wy))));
+    const __m128 world3 = multiplyAdd(
+        parent2, _mm_set1_ps(transZ[i]),
+        multiplyAdd(parent1, _mm_set1_ps(transY[i]),
+                    multiplyAdd(parent0, _mm_set1_ps(transX[i]), parent3)));
+    float *world = worldMatrices + i * 16;
+    _mm_storeu_ps(world, world0);
+    _mm_storeu_ps(world + 4, world1);
+    _mm_storeu_ps(world + 8, world2);
+    _mm_storeu_ps(world + 12, world3);
+
+    // skin matrix, same thing with the inverse bind on the right
+    const float *inverseBind = inverseBinds + i * 16;
+    __m128 skin[4];
+    for (uint32_t column = 0; column < 4; ++column) {
+      const float *bindColumn = inverseBind + column * 4;
+      skin[column] = multiplyAdd(
+          world3, _mm_set1_ps(bindColumn[3]),
+          multiplyAdd(world2, _mm_set1_ps(bindColumn[2]),
+                      multiplyAdd(world1, _mm_set1_ps(bindColumn[1]),
+                                  _mm_mul_ps(world0,
+                                             _mm_set1_ps(bindColumn[0])))));
+    }
+    // the shader wants it transposed
+    _MM_TRANSPOSE4_PS(skin[0], skin[1], skin[2], skin[3]);
+    float *skinMatrix = skinMatrices + i * 16;
+    _mm_storeu_ps(skinMatrix, skin[0]);
+    _mm_storeu_ps(skinMatrix + 4, skin[1]);
+    _mm_storeu_ps(skinMatrix + 8, skin[2]);
+    _mm_storeu_ps(skinMatrix + 12, skin[3]);
+  }
+}
+
+void SkeletonPose::updateGlobalFromLocalScalar(
     const glm::mat4 transform) const {
 
   // establishing the invariant, where every bone
@@ -65,11 +188,6 @@ void SkeletonPose::updateGlobalFromLocal(
   // since we know whatever parent is already processed
 
   // here we compute the root
-  // those conversions might actually hurt performance but
-  // for now is not a bottle neck since I evaluate few skeletons
-  // only
-  // TODO maybe remove glm or do the computation manually so to avoid
-  // intermediate copies and conversions between data-types etc
   const glm::quat &r = m_localPose[0].m_rot;
   glm::mat4 qM = glm::toMat4(r);
   // patching the rotation in
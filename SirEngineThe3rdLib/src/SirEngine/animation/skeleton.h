@@ -25,6 +25,10 @@ struct Skeleton {
   const char *m_name;
 
   bool loadFromFile(const char *path);
+  // number of leading joints to animate so that every joint past them is
+  // deeper than maxDepth in the hierarchy, the root being at depth zero.
+  // Exported skeletons are breadth first, the leaves end up at the back
+  [[nodiscard]] uint32_t getJointCountUpToDepth(uint32_t maxDepth) const;
 };
 
 struct SkeletonPose {
@@ -33,6 +37,10 @@ struct SkeletonPose {
   // m_skeleton->m_jointcount the function allocating this will allocate a
   // single array and set the pointers of the correct sub-allocations
   JointPose *m_localPose;
+  // the local pose as written by the evaluation kernels, see poseStreams.h,
+  // it is the input of updateGlobalFromLocal. m_localPose is not kept in sync,
+  // use streamsToJointPoses when it is needed
+  float *m_localStreams;
   // this is the pose ready to be uploaded to the skinning shader, each matrix
   // is pre-multiplied by the bind matrix
   glm::mat4 *m_globalPose;
@@ -45,13 +53,20 @@ struct SkeletonPose {
    * the global pose is not the world position of the bones, it is the world
    * position multiplied by the inverse bind, basically the matrix that will
    * transform the vertex by the bone, so matrix ready for the skin cluster to
-   * process the result will be stored in m_global_pose
-   * @param alloc: the allocator to store temporary created matrices, since is a
-   * stack allocator this is not thread safe due to the nature of the stack
-   * allocator, allocating and freeing from multiple threads will make a mess
-   * @Note : not thread safe
+   * process the result will be stored in m_global_pose, transposed as the
+   * shader wants it
+   * The local pose is read straight from m_localStreams, each joint rotation
+   * is expanded to an affine matrix and concatenated to the parent columns
+   * with SIMD, the inverse bind is applied in the same pass. Translation and
+   * rotation only, the scale is ignored
+   * @param transform: matrix moving the whole skeleton in the world
+   * @Note : poses are independent from each other, different poses can be
+   * updated from different threads
    */
-  void updateGlobalFromLocal(glm::mat4 transform) const;
+  void updateGlobalFromLocal(const glm::mat4 &transform) const;
+  // reference implementation, full 4x4 matrices with glm built out of
+  // m_localPose
+  void updateGlobalFromLocalScalar(glm::mat4 transform) const;
 };
 
 } // namespace SirEngine
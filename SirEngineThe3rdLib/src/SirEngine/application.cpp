@@ -1,13 +1,19 @@
 #include "SirEngine/application.h"
 
+#include "SirEngine/animation/animationManager.h"
 #include "SirEngine/engineConfig.h"
+#include "SirEngine/events/eventBus.h"
+#include "SirEngine/frameScheduler.h"
 #include "SirEngine/globals.h"
+#include "SirEngine/graphics/camera.h"
 #include "SirEngine/graphics/renderingContext.h"
 #include "SirEngine/input.h"
 #include "SirEngine/io/fileUtils.h"
 #include "SirEngine/layer.h"
 #include "SirEngine/layers/imguiDebugLayer.h"
 #include "SirEngine/log.h"
+#include "SirEngine/skinClusterManager.h"
+#include "SirEngine/workerPool.h"
 #include "flags.h"
 
 namespace SirEngine {
@@ -50,42 +56,96 @@ Application::Application() {
     exit(EXIT_FAILURE);
   }
 
-  m_queuedEndOfFrameEvents[0].events =
-      static_cast<Event **>(globals::PERSISTENT_ALLOCATOR->allocate(
-          sizeof(Event *) * RESERVE_ALLOC_EVENT_QUEUE));
-  m_queuedEndOfFrameEvents[0].totalSize = RESERVE_ALLOC_EVENT_QUEUE;
-  m_queuedEndOfFrameEvents[1].events =
-      static_cast<Event **>(globals::PERSISTENT_ALLOCATOR->allocate(
-          sizeof(Event *) * RESERVE_ALLOC_EVENT_QUEUE));
-  m_queuedEndOfFrameEvents[1].totalSize = RESERVE_ALLOC_EVENT_QUEUE;
-  m_queuedEndOfFrameEventsCurrent = &m_queuedEndOfFrameEvents[0];
+  m_eventBus = new EventBus();
+  globals::EVENT_BUS = m_eventBus;
+
+  // the calling thread is a worker as well
+  const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+  m_workerPool = new WorkerPool(hardwareThreads != 0 ? hardwareThreads : 1);
+  m_scheduler = new FrameScheduler(m_workerPool);
+  globals::FRAME_SCHEDULER = m_scheduler;
+  registerEngineSystems();
 
   globals::APPLICATION = this;
 }
 
 Application::~Application() {
+  // events queued during the last frame never got dispatched
+  m_eventBus->swap();
+  for (const QueuedEvent &queued : m_eventBus->read<QueuedEvent>()) {
+    delete queued.event;
+  }
+  globals::EVENT_BUS = nullptr;
+  delete m_eventBus;
+  globals::FRAME_SCHEDULER = nullptr;
+  delete m_scheduler;
+  delete m_workerPool;
   delete globals::ENGINE_FLAGS;
   delete m_window;
 }
+
+void Application::registerEngineSystems() {
+  // registered first, it opens the frame before any other system runs
+  m_scheduler->addSystem(
+      "platform events", FramePhase::INPUT, SystemAccess().mainThread(),
+      [this](const FrameContext &) { processPlatformEvents(); });
+  // player updates run scripts, the poses are evaluated on the pool, then
+  // the skins whose player produced new matrices get uploaded. The animation
+  // lod is measured from the main camera
+  m_scheduler->addSystem(
+      "animation", FramePhase::ANIMATION, SystemAccess().mainThread(),
+      [](const FrameContext &context) {
+        if (globals::ANIMATION_MANAGER != nullptr) {
+          if (globals::MAIN_CAMERA != nullptr) {
+            globals::ANIMATION_MANAGER->setLodViewPosition(
+                globals::MAIN_CAMERA->getPosition());
+          }
+          globals::ANIMATION_MANAGER->evaluate(context.pool);
+        }
+        if (globals::SKIN_MANAGER != nullptr) {
+          globals::SKIN_MANAGER->uploadDirtyMatrices();
+        }
+      });
+  static const char *LAYER_SYSTEM_NAMES[FRAME_PHASE_COUNT] = {
+      "layers input",      "layers pre-animation",
+      "layers animation",  "layers simulation",
+      "layers extraction", "layers submit"};
+  for (uint32_t p = 0; p < FRAME_PHASE_COUNT; ++p) {
+    const auto phase = static_cast<FramePhase>(p);
+    m_scheduler->addSystem(
+        LAYER_SYSTEM_NAMES[p], phase, SystemAccess().mainThread(),
+        [this, phase](const FrameContext &) { updateLayers(phase); });
+  }
+}
+
+void Application::processPlatformEvents() {
+  m_window->onUpdate();
+  globals::RENDERING_CONTEXT->newFrame();
+  // everything sent last frame becomes readable, events queued while
+  // dispatching land in the new frame
+  m_eventBus->swap();
+  for (const QueuedEvent &queued : m_eventBus->read<QueuedEvent>()) {
+    onEvent(*queued.event);
+    delete queued.event;
+  }
+}
+
+void Application::updateLayers(const FramePhase phase) {
+  const int count = m_layerStack.count();
+  Layer **layers = m_layerStack.begin();
+  for (int i = 0; i < count; ++i) {
+    if (layers[i]->getUpdatePhase() == phase) {
+      layers[i]->onUpdate();
+    }
+  }
+}
+
 void Application::run() {
   while (m_run) {
     globals::LAST_FRAME_TIME_NS = globals::GAME_CLOCK.getDelta();
     ++globals::TOTAL_NUMBER_OF_FRAMES;
-    m_window->onUpdate();
-    globals::RENDERING_CONTEXT->newFrame();
-    EventQueue *currentQueue = m_queuedEndOfFrameEventsCurrent;
-    flipEndOfFrameQueue();
-    for (uint32_t i = 0; i < currentQueue->allocCount; ++i) {
-      onEvent(*(currentQueue->events[i]));
-      delete currentQueue->events[i];
-    }
-    currentQueue->allocCount = 0;
-
-    const int count = m_layerStack.count();
-    Layer **layers = m_layerStack.begin();
-    for (int i = 0; i < count; ++i) {
-      layers[i]->onUpdate();
-    }
+    m_scheduler->runFrame(globals::LAST_FRAME_TIME_NS);
+    // every phase is done, the frame can go to the gpu
     globals::RENDERING_CONTEXT->dispatchFrame();
     // update input to cache current input for next frame
     globals::INPUT->swapFrameKey();
@@ -105,9 +165,7 @@ void Application::run() {
   globals::RENDERING_CONTEXT->shutdownGraphic();
 }
 void Application::queueEventForEndOfFrame(Event *e) const {
-  const int alloc = m_queuedEndOfFrameEventsCurrent->allocCount;
-  m_queuedEndOfFrameEventsCurrent->events[alloc] = e;
-  ++(m_queuedEndOfFrameEventsCurrent->allocCount);
+  m_eventBus->send(QueuedEvent{e});
 }
 void Application::onEvent(Event &e) {
   // close event dispatch
@@ -4,8 +4,13 @@
 
 #include "SirEngine/events/applicationEvent.h"
 #include "SirEngine/events/event.h"
+#include "SirEngine/framePhase.h"
 #include "SirEngine/layerStack.h"
 namespace SirEngine {
+class EventBus;
+class FrameScheduler;
+class WorkerPool;
+
 class  Application {
 public:
   Application();
@@ -19,29 +24,27 @@ public:
 protected:
   bool onCloseWindow(WindowCloseEvent &e);
   bool onResizeWindow(WindowResizeEvent &e);
-  inline void flipEndOfFrameQueue() {
-    m_queueEndOfFrameCounter = (m_queueEndOfFrameCounter + 1) % 2;
-    m_queuedEndOfFrameEventsCurrent =
-        &m_queuedEndOfFrameEvents[m_queueEndOfFrameCounter];
-  }
+  // the engine work is run by the frame scheduler like any other system
+  void registerEngineSystems();
+  void processPlatformEvents();
+  void updateLayers(FramePhase phase);
 
 protected:
-  struct EventQueue {
-    Event**events = nullptr;
-    uint32_t totalSize = 0;
-    uint32_t allocCount = 0;
+  // the legacy heap allocated events travel through the event bus like any
+  // other event, they get dispatched and deleted at the start of next frame
+  struct QueuedEvent {
+    Event *event;
   };
 
 protected:
-  EventQueue m_queuedEndOfFrameEvents[2];
-  EventQueue *m_queuedEndOfFrameEventsCurrent;
-  uint32_t m_queueEndOfFrameCounter = 0;
   BaseWindow *m_window = nullptr;
   bool m_run = true;
   LayerStack m_layerStack;
   Layer *imGuiLayer;
   Layer *graphicsLayer;
-  static constexpr uint32_t RESERVE_ALLOC_EVENT_QUEUE = 200;
+  WorkerPool *m_workerPool = nullptr;
+  FrameScheduler *m_scheduler = nullptr;
+  EventBus *m_eventBus = nullptr;
 };
 
 // To be implemented by the client
@@ -1,5 +1,6 @@
 #include "SirEngine/debugUiWidgets/frameTimingsWidget.h"
 #include "SirEngine/globals.h"
+#include "SirEngine/frameScheduler.h"
 #include <imgui/imgui.h>
 #include <iomanip>
 #include <random>
@@ -110,5 +111,41 @@ void FrameTimingsWidget::render() {
   ImGui::PlotHistogram("", finalHisto, IM_ARRAYSIZE(finalHisto), 0, NULL, 0.0f,
                        1.0f, ImVec2(0, 80));
   ImGui::PopItemWidth();
+  renderPhases();
+}
+
+void FrameTimingsWidget::renderPhases() {
+  const FrameScheduler *scheduler = globals::FRAME_SCHEDULER;
+  if (scheduler == nullptr) {
+    return;
+  }
+  if (!ImGui::CollapsingHeader("Frame phases",
+                               ImGuiTreeNodeFlags_DefaultOpen)) {
+    return;
+  }
+  constexpr float smoothing = 0.05f;
+  const uint32_t systemCount = scheduler->getSystemCount();
+  for (uint32_t p = 0; p < FRAME_PHASE_COUNT; ++p) {
+    const auto phase = static_cast<FramePhase>(p);
+    const float phaseMs =
+        static_cast<float>(scheduler->getPhaseTimeNs(phase)) * 1e-6f;
+    m_phaseAverages[p] += (phaseMs - m_phaseAverages[p]) * smoothing;
+    std::stringstream label;
+    label << std::fixed << std::setprecision(3) << getFramePhaseName(phase)
+          << ": " << m_phaseAverages[p] << "ms";
+    if (!ImGui::TreeNode(getFramePhaseName(phase), "%s",
+                         label.str().c_str())) {
+      continue;
+    }
+    for (uint32_t s = 0; s < systemCount; ++s) {
+      if (scheduler->getSystemPhase(s) != phase) {
+        continue;
+      }
+      const float systemMs =
+          static_cast<float>(scheduler->getSystemTimeNs(s)) * 1e-6f;
+      ImGui::Text("%s: %.3fms", scheduler->getSystemName(s), systemMs);
+    }
+    ImGui::TreePop();
+  }
 }
 } // namespace SirEngine
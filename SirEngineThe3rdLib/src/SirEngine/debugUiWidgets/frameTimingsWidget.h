@@ -1,6 +1,8 @@
 #pragma once
 #include <cstdint>
 
+#include "SirEngine/framePhase.h"
+
 namespace SirEngine {
 namespace debug {
 struct FrameTimingsWidget final {
@@ -9,10 +11,15 @@ struct FrameTimingsWidget final {
 #define MAX_FRAME_TIME 20.0f
   FrameTimingsWidget();
   void render();
+  // per phase and per system cost, coming from the frame scheduler
+  void renderPhases();
   float m_samples[NUMBER_OF_SAMPLES];
   float m_tempSamples[NUMBER_OF_SAMPLES];
   uint32_t m_runningCounter = 0;
   float m_framesHistogram[NUMBER_OF_HISTOGRAMS_BUCKETS]{};
+  // exponential moving average of the phases in ms, raw frames are too noisy
+  // to be read
+  float m_phaseAverages[FRAME_PHASE_COUNT]{};
 
 };
 }; // namespace debug
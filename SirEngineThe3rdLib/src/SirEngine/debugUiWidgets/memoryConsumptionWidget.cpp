@@ -1,4 +1,6 @@
 #include "SirEngine/debugUiWidgets/memoryConsumptionWidget.h"
+#include "SirEngine/debugUiWidgets/memoryPoolTrackerWidget.h"
+#include "SirEngine/ecs/archetypeAllocator.h"
 #include "SirEngine/engineConfig.h"
 #include "SirEngine/globals.h"
 
@@ -22,5 +24,7 @@ void MemoryConsumptionWidget::render() {
     vk::renderImGuiMemoryWidget();
 #endif
   }
+  renderArchetypeAllocatorStats("ECS archetype memory",
+                                ecs::getDefaultArchetypeAllocator());
 }
 } // namespace SirEngine::debug
@@ -1,5 +1,6 @@
 #include "SirEngine/debugUiWidgets/memoryPoolTrackerWidget.h"
 
+#include "SirEngine/ecs/archetypeAllocator.h"
 #include "SirEngine/graphics/graphicsDefines.h"
 #include "SirEngine/runtimeString.h"
 
@@ -8,6 +9,7 @@
 #include <imgui/imgui_internal.h>
 
 #include <cstdint>
+#include <cstdio>
 #include <iomanip>
 #include <sstream>
 #include <vector>
@@ -163,4 +165,37 @@ void renderMemoryPoolTracker(
          << "MB  " << info.m_wastedMemoryInBytes << "Bytes\n";
   ImGui::Text(stream.str().c_str());
 }
+
+void renderArchetypeAllocatorStats(const char *headerName,
+                                   const ecs::ArchetypeAllocator &allocator) {
+  if (!ImGui::CollapsingHeader(headerName, ImGuiTreeNodeFlags_DefaultOpen))
+    return;
+
+  std::stringstream stream;
+  stream << std::fixed << std::setprecision(2)
+         << "Used: " << allocator.getUsedSizeInBytes() * BYTE_TO_MB << "MB\n"
+         << "Peak used: " << allocator.getPeakUsedSizeInBytes() * BYTE_TO_MB
+         << "MB\n"
+         << "Reserved: " << allocator.getReservedSizeInBytes() * BYTE_TO_MB
+         << "MB\n"
+         << "Large allocations: " << allocator.getLargeAllocationCount() << "  "
+         << allocator.getLargeAllocationSizeInBytes() * BYTE_TO_MB << "MB\n";
+  ImGui::Text(stream.str().c_str());
+
+  // one bar per size class, used blocks over the blocks reserved so far
+  char overlay[64];
+  for (uint32_t i = 0; i < ecs::ArchetypeAllocator::SIZE_CLASS_COUNT; ++i) {
+    const ChunkPool &pool = allocator.getPool(i);
+    const uint32_t reserved = pool.getReservedBlockCount();
+    if (reserved == 0) {
+      continue;
+    }
+    const uint32_t used = pool.getUsedBlockCount();
+    snprintf(overlay, sizeof(overlay), "%uKB blocks: %u/%u (peak %u)",
+             pool.getBlockSizeInBytes() / 1024, used, reserved,
+             pool.getPeakUsedBlockCount());
+    ImGui::ProgressBar(static_cast<float>(used) / static_cast<float>(reserved),
+                       ImVec2(0.f, 0.f), overlay);
+  }
+}
 }  // namespace SirEngine::debug
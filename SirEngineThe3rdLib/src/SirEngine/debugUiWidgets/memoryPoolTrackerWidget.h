@@ -1,9 +1,18 @@
 #pragma once
 #include "SirEngine/memory/cpu/linearBufferManager.h"
 
+namespace SirEngine::ecs {
+class ArchetypeAllocator;
+}
+
 namespace SirEngine::debug {
 
 void renderMemoryPoolTracker(const char *headerName,
                              const size_t poolRangeInBytes,
                              const ResizableVector<BufferRangeTracker> *allocs);
+
+// renders usage of the chunk pools backing the ecs archetypes, one bar per
+// block size class
+void renderArchetypeAllocatorStats(const char *headerName,
+                                   const ecs::ArchetypeAllocator &allocator);
 }; // namespace SirEngine::debug
@@ -0,0 +1,164 @@
+#pragma once
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+
+#include "SirEngine/memory/cpu/chunkPool.h"
+
+namespace SirEngine::ecs {
+
+// The archetypes storage does not come from the general purpose heap, every
+// archetype gets a single block holding all its columns out of a set of chunk
+// pools. Block sizes are bucketed in power of two classes starting at
+// MIN_BLOCK_SIZE_IN_BYTES, an archetype growing moves to the next class and
+// gives its old block back to the pool, where the next archetype of that size
+// will pick it up. The classes smaller than a page share their slabs between
+// many blocks, archetypes with a handful of entities do not pay for a whole
+// page each. Requests bigger than the last class go straight to the system,
+// page aligned and rounded to the page size.
+// The allocator is not thread safe, same as the registry.
+class ArchetypeAllocator final {
+ public:
+  static constexpr uint32_t MIN_BLOCK_SIZE_IN_BYTES = 1024;
+  // 1KB up to 2MB
+  static constexpr uint32_t SIZE_CLASS_COUNT = 12;
+  // how much memory every pool asks to the system at once, the biggest classes
+  // get a single block per slab
+  static constexpr uint32_t SLAB_SIZE_IN_BYTES = 256 * 1024;
+
+  ArchetypeAllocator() {
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; ++i) {
+      const uint32_t blockSize = getSizeClassBlockSize(i);
+      const uint32_t blocksPerSlab =
+          blockSize < SLAB_SIZE_IN_BYTES ? SLAB_SIZE_IN_BYTES / blockSize : 1;
+      m_pools[i] = new ChunkPool(blockSize, blocksPerSlab);
+    }
+  }
+  ~ArchetypeAllocator() {
+    // the pools release their slabs whether blocks are in use or not
+    assert(getUsedBlockCount() == 0 &&
+           "archetypes still alive while destroying their allocator");
+    for (ChunkPool* pool : m_pools) {
+      delete pool;
+    }
+  }
+  ArchetypeAllocator(const ArchetypeAllocator&) = delete;
+  ArchetypeAllocator& operator=(const ArchetypeAllocator&) = delete;
+
+  [[nodiscard]] static constexpr uint32_t getSizeClassBlockSize(
+      const uint32_t sizeClass) {
+    return MIN_BLOCK_SIZE_IN_BYTES << sizeClass;
+  }
+
+  // returns the size of the block that would be handed out for the given
+  // request, callers use it to fill the whole block rather than the bare
+  // request
+  [[nodiscard]] static size_t getBlockSize(const size_t sizeInBytes) {
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; ++i) {
+      if (sizeInBytes <= getSizeClassBlockSize(i)) {
+        return getSizeClassBlockSize(i);
+      }
+    }
+    constexpr size_t pageMask = ChunkPool::PAGE_SIZE_IN_BYTES - 1;
+    return (sizeInBytes + pageMask) & ~pageMask;
+  }
+
+  // the size needs to be a value returned by getBlockSize, and the same size
+  // needs to be given back on free
+  void* allocate(const size_t blockSize) {
+    assert(getBlockSize(blockSize) == blockSize);
+    m_usedSizeInBytes += blockSize;
+    m_peakUsedSizeInBytes = m_usedSizeInBytes > m_peakUsedSizeInBytes
+                                ? m_usedSizeInBytes
+                                : m_peakUsedSizeInBytes;
+    const int sizeClass = getSizeClass(blockSize);
+    if (sizeClass != LARGE_ALLOCATION) {
+      return m_pools[sizeClass]->allocate();
+    }
+    ++m_largeAllocationCount;
+    m_largeAllocationSizeInBytes += blockSize;
+    return ::operator new(blockSize,
+                          std::align_val_t{ChunkPool::PAGE_SIZE_IN_BYTES});
+  }
+
+  void free(void* ptr, const size_t blockSize) {
+    assert(ptr != nullptr);
+    assert(m_usedSizeInBytes >= blockSize);
+    m_usedSizeInBytes -= blockSize;
+    const int sizeClass = getSizeClass(blockSize);
+    if (sizeClass != LARGE_ALLOCATION) {
+      m_pools[sizeClass]->free(ptr);
+      return;
+    }
+    assert(m_largeAllocationCount != 0);
+    --m_largeAllocationCount;
+    m_largeAllocationSizeInBytes -= blockSize;
+    ::operator delete(ptr, std::align_val_t{ChunkPool::PAGE_SIZE_IN_BYTES});
+  }
+
+  // stats
+  [[nodiscard]] const ChunkPool& getPool(const uint32_t sizeClass) const {
+    assert(sizeClass < SIZE_CLASS_COUNT);
+    return *m_pools[sizeClass];
+  }
+  // memory handed out to archetypes, pooled and large allocations
+  [[nodiscard]] size_t getUsedSizeInBytes() const { return m_usedSizeInBytes; }
+  [[nodiscard]] size_t getPeakUsedSizeInBytes() const {
+    return m_peakUsedSizeInBytes;
+  }
+  // memory requested to the system, pooled and large allocations
+  [[nodiscard]] size_t getReservedSizeInBytes() const {
+    size_t total = m_largeAllocationSizeInBytes;
+    for (const ChunkPool* pool : m_pools) {
+      total += pool->getReservedSizeInBytes();
+    }
+    return total;
+  }
+  // blocks handed out to archetypes and not freed yet, pooled and large
+  // allocations
+  [[nodiscard]] uint32_t getUsedBlockCount() const {
+    uint32_t total = m_largeAllocationCount;
+    for (const ChunkPool* pool : m_pools) {
+      total += pool->getUsedBlockCount();
+    }
+    return total;
+  }
+  [[nodiscard]] uint32_t getLargeAllocationCount() const {
+    return m_largeAllocationCount;
+  }
+  [[nodiscard]] size_t getLargeAllocationSizeInBytes() const {
+    return m_largeAllocationSizeInBytes;
+  }
+
+ private:
+  static constexpr int LARGE_ALLOCATION = -1;
+  static int getSizeClass(const size_t blockSize) {
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; ++i) {
+      if (blockSize == getSizeClassBlockSize(i)) {
+        return static_cast<int>(i);
+      }
+    }
+    return LARGE_ALLOCATION;
+  }
+
+ private:
+  ChunkPool* m_pools[SIZE_CLASS_COUNT]{};
+  size_t m_usedSizeInBytes = 0;
+  size_t m_peakUsedSizeInBytes = 0;
+  size_t m_largeAllocationSizeInBytes = 0;
+  uint32_t m_largeAllocationCount = 0;
+};
+
+// allocator used by every registry and archetype not given an explicit one,
+// this is what the engine memory stats report.
+// It is created on first use and never destroyed, registries with static
+// storage duration give their blocks back during the static destruction in
+// any order, the memory left goes back to the system with the process
+inline ArchetypeAllocator& getDefaultArchetypeAllocator() {
+  static ArchetypeAllocator* allocator = new ArchetypeAllocator();
+  return *allocator;
+}
+
+}  // namespace SirEngine::ecs
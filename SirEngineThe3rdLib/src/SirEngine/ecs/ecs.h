@@ -1,12 +1,23 @@
 #pragma once
 #include <stdint.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include "SirEngine/ecs/archetypeAllocator.h"
+
+namespace SirEngine {
+class WorkerPool;
+}
+
 namespace SirEngine::ecs {
 namespace CompileHash {
 static constexpr unsigned int crc_table[256] = {
@@ -152,12 +163,246 @@ struct ComponentTypeInfo {
   size_t hash;
 };
 
+// queries are expressed as pointers to components, a pointer to const
+// component means read only access, this gives us back the plain component
+// type from the query type
+template <typename T>
+using ComponentType =
+    std::remove_const_t<typename std::remove_pointer<T>::type>;
+
+// Components are stored in archetype tables by default, which is the best
+// layout for iteration but adding or removing a component means moving all the
+// other components of the entity to a different archetype. Components that get
+// toggled often, like tags, can opt in the sparse set storage instead, adding
+// and removing them is O(1) and does not move any other data.
+// To opt in, specialize the trait, or use the SE_ECS_SPARSE_COMPONENT macro:
+//   SE_ECS_SPARSE_COMPONENT(Selected)
+// Shared components are the opposite, data that is the same for many entities,
+// like mesh or material handles. Every unique value is stored once and the
+// archetype gets partitioned by the value, entities sharing the same value
+// live together in the same archetype. Declare them with
+// SE_ECS_SHARED_COMPONENT and set them with Registry::setSharedComponent.
+enum class ComponentStorage { ARCHETYPE, SPARSE_SET, SHARED };
+
+template <typename T>
+struct ComponentStorageTrait {
+  static constexpr ComponentStorage storage = ComponentStorage::ARCHETYPE;
+};
+
+template <typename T>
+constexpr bool isSparseComponent =
+    ComponentStorageTrait<ComponentType<T>>::storage ==
+    ComponentStorage::SPARSE_SET;
+template <typename T>
+constexpr bool isSharedComponent =
+    ComponentStorageTrait<ComponentType<T>>::storage ==
+    ComponentStorage::SHARED;
+template <typename T>
+constexpr bool isArchetypeComponent =
+    ComponentStorageTrait<ComponentType<T>>::storage ==
+    ComponentStorage::ARCHETYPE;
+
+#define SE_ECS_SPARSE_COMPONENT(TYPE)                         \
+  template <>                                                 \
+  struct SirEngine::ecs::ComponentStorageTrait<TYPE> {        \
+    static constexpr SirEngine::ecs::ComponentStorage storage = \
+        SirEngine::ecs::ComponentStorage::SPARSE_SET;         \
+  };
+
+#define SE_ECS_SHARED_COMPONENT(TYPE)                         \
+  template <>                                                 \
+  struct SirEngine::ecs::ComponentStorageTrait<TYPE> {        \
+    static constexpr SirEngine::ecs::ComponentStorage storage = \
+        SirEngine::ecs::ComponentStorage::SHARED;             \
+  };
+
+// The MultiHash of a type is stable but sparse, to describe an archetype as a
+// bitset the component types also get a dense index. Indices are handed out
+// in order the first time a type is seen by anybody, they are only valid for
+// the lifetime of the program, anything persisted keeps using the hash.
+static constexpr uint32_t MAX_COMPONENT_TYPES = 256;
+static constexpr uint32_t INVALID_COMPONENT_TYPE_INDEX =
+    static_cast<uint32_t>(-1);
+
+// past MAX_COMPONENT_TYPES the masks would alias types and queries would
+// silently match the wrong archetypes, this stops the program in every build
+[[noreturn]] inline void componentTypeIndexOutOfRange(const uint32_t typeIndex) {
+  std::cerr << "ECS component type index " << typeIndex
+            << " out of range, at most " << MAX_COMPONENT_TYPES
+            << " component types are supported, bump MAX_COMPONENT_TYPES"
+            << std::endl;
+  std::abort();
+}
+
+// one bit per component type index, used as archetype signature. Matching a
+// query against an archetype is a handful of word ANDs regardless of how many
+// components are involved
+struct ComponentMask {
+  static constexpr uint32_t WORD_COUNT = MAX_COMPONENT_TYPES / 64;
+  uint64_t words[WORD_COUNT]{};
+
+  void set(const uint32_t typeIndex) {
+    if (typeIndex >= MAX_COMPONENT_TYPES) {
+      componentTypeIndexOutOfRange(typeIndex);
+    }
+    words[typeIndex >> 6] |= uint64_t(1) << (typeIndex & 63);
+  }
+  void reset(const uint32_t typeIndex) {
+    if (typeIndex >= MAX_COMPONENT_TYPES) {
+      componentTypeIndexOutOfRange(typeIndex);
+    }
+    words[typeIndex >> 6] &= ~(uint64_t(1) << (typeIndex & 63));
+  }
+  [[nodiscard]] bool test(const uint32_t typeIndex) const {
+    assert(typeIndex < MAX_COMPONENT_TYPES);
+    return (words[typeIndex >> 6] >> (typeIndex & 63)) & 1;
+  }
+  // true if every bit of other is set in this mask as well
+  [[nodiscard]] bool contains(const ComponentMask& other) const {
+    uint64_t missing = 0;
+    for (uint32_t i = 0; i < WORD_COUNT; ++i) {
+      missing |= other.words[i] & ~words[i];
+    }
+    return missing == 0;
+  }
+  // true if at least one bit is set in both masks
+  [[nodiscard]] bool intersects(const ComponentMask& other) const {
+    uint64_t common = 0;
+    for (uint32_t i = 0; i < WORD_COUNT; ++i) {
+      common |= other.words[i] & words[i];
+    }
+    return common != 0;
+  }
+  [[nodiscard]] bool empty() const {
+    uint64_t bits = 0;
+    for (const uint64_t word : words) {
+      bits |= word;
+    }
+    return bits == 0;
+  }
+  // calls func(typeIndex) for every bit set, in increasing order
+  template <typename FUNC>
+  void forEachSet(FUNC&& func) const {
+    for (uint32_t w = 0; w < WORD_COUNT; ++w) {
+      uint64_t bits = words[w];
+      for (uint32_t b = 0; bits != 0; ++b, bits >>= 1) {
+        if (bits & 1) {
+          func(w * 64 + b);
+        }
+      }
+    }
+  }
+  bool operator==(const ComponentMask& other) const {
+    return memcmp(words, other.words, sizeof(words)) == 0;
+  }
+  bool operator!=(const ComponentMask& other) const {
+    return !(*this == other);
+  }
+};
+
+namespace ComponentTypeIndexMeta {
+struct Table {
+  std::mutex mutex;
+  std::unordered_map<size_t, uint32_t> indices;
+};
+inline Table& getTable() {
+  static Table table;
+  return table;
+}
+}  // namespace ComponentTypeIndexMeta
+
+// returns the dense index of the type with the given hash, assigning the next
+// free one if the type was never seen. This is the slow path for code that
+// only knows the hash, typed code goes through getComponentTypeIndex
+inline uint32_t registerComponentTypeIndex(const size_t hash) {
+  ComponentTypeIndexMeta::Table& table = ComponentTypeIndexMeta::getTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  const auto found = table.indices.find(hash);
+  if (found != table.indices.end()) {
+    return found->second;
+  }
+  const auto index = static_cast<uint32_t>(table.indices.size());
+  if (index >= MAX_COMPONENT_TYPES) {
+    componentTypeIndexOutOfRange(index);
+  }
+  table.indices[hash] = index;
+  return index;
+}
+
+// same as registerComponentTypeIndex without assigning an index to unknown
+// types, INVALID_COMPONENT_TYPE_INDEX is returned for them
+inline uint32_t findComponentTypeIndex(const size_t hash) {
+  ComponentTypeIndexMeta::Table& table = ComponentTypeIndexMeta::getTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  const auto found = table.indices.find(hash);
+  return found != table.indices.end() ? found->second
+                                      : INVALID_COMPONENT_TYPE_INDEX;
+}
+
+// the index is resolved once per type, afterwards it is a plain load
+template <typename T>
+uint32_t getComponentTypeIndex() {
+  static const uint32_t index = registerComponentTypeIndex(MultiHash<T>::hash);
+  return index;
+}
+
+// mask of the TYPES having the given storage, query types are accepted as
+// well, pointers and const are stripped
+template <ComponentStorage STORAGE, typename... TYPES>
+const ComponentMask& getComponentMask() {
+  static const ComponentMask mask = [] {
+    ComponentMask result;
+    (
+        [&result] {
+          if constexpr (ComponentStorageTrait<ComponentType<TYPES>>::storage ==
+                        STORAGE) {
+            result.set(getComponentTypeIndex<ComponentType<TYPES>>());
+          }
+        }(),
+        ...);
+    return result;
+  }();
+  return mask;
+}
+
+// mixes a type hash before summing it into an archetype hash, the sum makes
+// the archetype hash independent from the order of the components
+constexpr size_t mixComponentHash(size_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+template <typename... TYPES>
+constexpr size_t componentsHash() {
+  return (size_t(0) + ... + mixComponentHash(MultiHash<TYPES>::hash));
+}
+
 // this strut represent a component, the component can only hold pod data to
 // make our life easier if in the future we need to change that we can register
 // constructor destructor lambda functions
 struct Component {
   void* data;
   ComponentTypeInfo info;
+  // change detection bookkeeping, the rows of the component are split in
+  // chunks of Archetype::VERSION_CHUNK_SIZE elements and every chunk records
+  // the registry version of the last write access. This allows consumers to
+  // only process the data that changed since the last time they looked
+  uint32_t* chunkVersions;
+  // highest version written in the whole column, used to quickly skip
+  // archetypes that did not change at all
+  uint32_t version;
+};
+
+// an archetype partitioned by a shared component records which value all its
+// entities share, the value index refers to the SharedComponentStore of the
+// type
+struct SharedComponentRef {
+  size_t hash;
+  uint32_t valueIndex;
 };
 
 // when we move components from one entity to another archetype we have other
@@ -176,7 +421,8 @@ struct EntityMoveResult {
 // this is an actual entity, the entity is nothing more than tracking
 // information to where the actual data is.
 struct Entity {
-  // this is where inside the archetype the entity is
+  // this is where inside the archetype the entity is, when the entity is dead
+  // it is instead the index of the next entity in the free list
   uint32_t localIndex;
   // points to the index in the registry archetype array, this allows us to do
   // a quick look up of the archetype
@@ -184,10 +430,15 @@ struct Entity {
   // the version is used to avoid issues where entities get recycled and you
   // might have an old entity that points to a valid location just because the
   // entity has been reused but refers to a wrong entity, the version lets you
-  // disambiguate against that. Every time an entity is used the version gets
-  // bumped
+  // disambiguate against that. Every time an entity is deleted the version
+  // gets bumped, it wraps around skipping zero
   uint16_t version;
 };
+
+// The id handed to the user, index in the registry entity array plus the
+// generation (version) of the entity at the time of creation. Any id whose
+// version does not match the registry one is stale. A zero initialized id is
+// never valid since version zero is never used
 struct EntityId {
   uint32_t index;
   uint16_t version;
@@ -199,46 +450,74 @@ struct EntityId {
 // components uniquely. This means there should never be two archetypes with the
 // same exact set of components.
 // An archetype holds the data for each component type, entity indices to know
-// which entity the data belongs to
+// which entity the data belongs to.
+// All the columns live in a single storage block coming from the
+// ArchetypeAllocator, components data first, then the chunk versions and the
+// entity indices. The archetype always fills the whole block it gets, so the
+// capacity is whatever fits in the block size class
 struct Archetype {
-  // how many components to allocate on creation
+  // minimum amount of entities to allocate on creation
   static constexpr uint32_t INITIAL_SIZE = 10;
+  // every component column starts on its own cache line
+  static constexpr size_t COLUMN_ALIGNMENT = 64;
   static constexpr int INVALID_COMPONENT_INDEX = -1;
+  // how many rows share the same change version, smaller values give more
+  // precise change detection at the cost of more bookkeeping
+  static constexpr uint32_t VERSION_CHUNK_SIZE = 32;
   uint32_t componentCount = 0;
   uint32_t entityCount = 0;
   // this is how many components can fit in our buffer allocation.It is not
   // a size in bytes but a size in elements.
   uint32_t bufferElementCount = 0;
   // the id of the archetype, this is the result of hashing all the types of
-  // components it hosts
+  // components it hosts plus the shared values. It does not depend on the
+  // order of the components
   size_t hash = 0;
+  // same as hash without the shared values
+  size_t componentsHash = 0;
+  // signature of the archetype, the type indices of the columns and of the
+  // shared components
+  ComponentMask m_mask;
+  ComponentMask m_sharedMask;
   Component* m_components = nullptr;
   // this array hosts the indices to which each entity refers to, this is used
   // for several bookkeeping, like inform the registry that an entity has been
   // moved internally
   size_t* m_entitieIndexes = nullptr;
+  // shared components values of this archetype, they are part of the
+  // archetype identity alongside the component types
+  std::vector<SharedComponentRef> m_shared;
+  ArchetypeAllocator* m_allocator = nullptr;
+  void* m_storage = nullptr;
+  size_t m_storageSizeInBytes = 0;
 
   //---------------------------------------------
   // creation functionality
   //---------------------------------------------
-  Archetype() = default;
+  explicit Archetype(ArchetypeAllocator* allocator = nullptr)
+      : m_allocator(allocator != nullptr ? allocator
+                                         : &getDefaultArchetypeAllocator()) {}
   ~Archetype() {
-    for (uint32_t i = 0; i < componentCount; ++i) {
-      delete[] static_cast<char*>(m_components[i].data);
-    }
-    delete[] m_entitieIndexes;
+    releaseStorage();
+    delete[] m_components;
+  }
+  Archetype(const Archetype&) = delete;
+  Archetype& operator=(const Archetype&) = delete;
+
+  static uint32_t getVersionChunkCount(const uint32_t elementCount) {
+    return (elementCount + VERSION_CHUNK_SIZE - 1) / VERSION_CHUNK_SIZE;
   }
 
   // creates an empty archetype with the given required components
   template <typename... TYPES>
   void create() {
-    bufferElementCount = INITIAL_SIZE;
-    m_components = new Component[sizeof...(TYPES)]{
-        Component{new char[INITIAL_SIZE * sizeof(TYPES)],
-                  {sizeof(TYPES), MultiHash<TYPES>::hash}}...};
-    m_entitieIndexes = new size_t[INITIAL_SIZE];
+    m_components = new Component[sizeof...(TYPES)]{Component{
+        nullptr, {sizeof(TYPES), MultiHash<TYPES>::hash}, nullptr, 0}...};
     componentCount = sizeof...(TYPES);
-    hash = MultiHash<TYPES...>::hash;
+    m_mask = getComponentMask<ComponentStorage::ARCHETYPE, TYPES...>();
+    componentsHash = ecs::componentsHash<TYPES...>();
+    hash = componentsHash;
+    resize(INITIAL_SIZE);
   }
 
   // this is a variation of the creation where you already have the components
@@ -250,21 +529,43 @@ struct Archetype {
     m_entitieIndexes[0] = entityGlobalIndex;
   }
 
-  // create an archetype from a list of existing components and a size.
+  // create an archetype from a list of components without storage and a size.
   // This happens when the registry needs to generate an archetype without
   // knowing any of the concrete types. This happens often when moving entities
   // between archetypes
   void createFromComponents(Component* cmps, const size_t size) {
-    hash = 0;
-    // lets compute the hash by hash-combining the components hashes
+    componentsHash = 0;
+    m_mask = {};
     for (size_t i = 0; i < size; ++i) {
-      hash = hash_combine(hash, cmps[i].info.hash);
+      componentsHash += mixComponentHash(cmps[i].info.hash);
+      m_mask.set(registerComponentTypeIndex(cmps[i].info.hash));
     }
-    bufferElementCount = INITIAL_SIZE;
+    hash = componentsHash;
     m_components = cmps;
-    m_entitieIndexes = new size_t[INITIAL_SIZE];
     entityCount = 0;
     componentCount = static_cast<uint32_t>(size);
+    resize(INITIAL_SIZE);
+  }
+
+  // partitions the archetype by the given shared values, they become part of
+  // the archetype identity
+  void setSharedComponents(const SharedComponentRef* shared,
+                           const size_t count) {
+    m_shared.assign(shared, shared + count);
+    m_sharedMask = {};
+    for (const SharedComponentRef& ref : m_shared) {
+      m_sharedMask.set(registerComponentTypeIndex(ref.hash));
+    }
+    hash = computeHash(componentsHash, m_shared);
+  }
+
+  static size_t computeHash(const size_t componentsHash,
+                            const std::vector<SharedComponentRef>& shared) {
+    size_t result = componentsHash;
+    for (const SharedComponentRef& ref : shared) {
+      result += mixComponentHash(hash_combine(ref.hash, ref.valueIndex));
+    }
+    return result;
   }
 
   //---------------------------------------------
@@ -272,6 +573,9 @@ struct Archetype {
   //---------------------------------------------
   template <typename T>
   [[nodiscard]] int getComponentIndex() const {
+    if (!hasComponent<T>()) {
+      return INVALID_COMPONENT_INDEX;
+    }
     return getComponentIndexFromHash(MultiHash<T>::hash);
   }
 
@@ -300,7 +604,7 @@ struct Archetype {
   //---------------------------------------------
   template <typename T>
   [[nodiscard]] bool hasComponent() const {
-    return hasComponentFromHash(MultiHash<T>::hash);
+    return m_mask.test(getComponentTypeIndex<T>());
   }
 
   [[nodiscard]] bool hasComponentFromHash(const size_t cmpId) const {
@@ -309,7 +613,42 @@ struct Archetype {
 
   template <typename... TYPES>
   [[nodiscard]] bool hasComponents() const {
-    return (hasComponent<TYPES>() & ...);
+    return m_mask.contains(
+        getComponentMask<ComponentStorage::ARCHETYPE, TYPES...>());
+  }
+
+  // columns and shared are masks of the types the archetype must have, the
+  // query matching boils down to this
+  [[nodiscard]] bool matches(const ComponentMask& columns,
+                             const ComponentMask& shared) const {
+    return m_mask.contains(columns) & m_sharedMask.contains(shared);
+  }
+
+  [[nodiscard]] int getSharedIndexFromHash(const size_t cmpId) const {
+    const auto count = static_cast<uint32_t>(m_shared.size());
+    for (uint32_t i = 0; i < count; ++i) {
+      if (m_shared[i].hash == cmpId) {
+        return static_cast<int>(i);
+      }
+    }
+    return INVALID_COMPONENT_INDEX;
+  }
+  [[nodiscard]] bool hasSharedComponentFromHash(const size_t cmpId) const {
+    return getSharedIndexFromHash(cmpId) != INVALID_COMPONENT_INDEX;
+  }
+  [[nodiscard]] bool hasSharedComponents(
+      const std::vector<SharedComponentRef>& shared) const {
+    if (shared.size() != m_shared.size()) {
+      return false;
+    }
+    for (const SharedComponentRef& ref : shared) {
+      const int idx = getSharedIndexFromHash(ref.hash);
+      if ((idx == INVALID_COMPONENT_INDEX) ||
+          (m_shared[idx].valueIndex != ref.valueIndex)) {
+        return false;
+      }
+    }
+    return true;
   }
   [[nodiscard]] bool hasComponentFromHashes(
       const std::vector<size_t>& ids) const {
@@ -321,6 +660,54 @@ struct Archetype {
     return result;
   }
 
+  //---------------------------------------------
+  // change detection
+  //---------------------------------------------
+  // stamps the given version on the chunk holding the row for the requested
+  // component only
+  void markComponentRowChanged(const uint32_t cmpIdx, const uint32_t row,
+                               const uint32_t version) {
+    assert(cmpIdx < componentCount);
+    assert(row < bufferElementCount);
+    Component& cmp = m_components[cmpIdx];
+    cmp.chunkVersions[row / VERSION_CHUNK_SIZE] = version;
+    cmp.version = version;
+  }
+
+  // stamps the given version on the chunk holding the row for all the
+  // components, used when an entity lands in a row due to structural changes
+  void markRowChanged(const uint32_t row, const uint32_t version) {
+    for (uint32_t i = 0; i < componentCount; ++i) {
+      markComponentRowChanged(i, row, version);
+    }
+  }
+
+  // stamps the given version on every used chunk of the component, this is
+  // what happens when somebody asks for write access to the whole column
+  void markComponentChanged(const uint32_t cmpIdx, const uint32_t version) {
+    assert(cmpIdx < componentCount);
+    Component& cmp = m_components[cmpIdx];
+    const uint32_t chunkCount = getVersionChunkCount(entityCount);
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+      cmp.chunkVersions[i] = version;
+    }
+    cmp.version = version;
+  }
+
+  [[nodiscard]] bool hasComponentChangedSince(
+      const uint32_t cmpIdx, const uint32_t sinceVersion) const {
+    assert(cmpIdx < componentCount);
+    return m_components[cmpIdx].version > sinceVersion;
+  }
+
+  [[nodiscard]] bool hasChunkChangedSince(const uint32_t cmpIdx,
+                                          const uint32_t chunk,
+                                          const uint32_t sinceVersion) const {
+    assert(cmpIdx < componentCount);
+    assert(chunk < getVersionChunkCount(bufferElementCount));
+    return m_components[cmpIdx].chunkVersions[chunk] > sinceVersion;
+  }
+
   //---------------------------------------------
   // entity manipulation
   //---------------------------------------------
@@ -400,6 +787,9 @@ struct Archetype {
     // next we need to add the new component
     write(cmp, entityCount);
 
+    // keeping track of the global index of the entity in the new archetype
+    m_entitieIndexes[entityCount] = source->m_entitieIndexes[e.localIndex];
+
     // we need to remove the old entity from the source component
     // to do so we copy the last entity entity to the hole and return that such
     // entity has been moved
@@ -440,6 +830,9 @@ struct Archetype {
              sourceCmp->info.componentDataTypeSize);
     }
 
+    // keeping track of the global index of the entity in the new archetype
+    m_entitieIndexes[entityCount] = source->m_entitieIndexes[e.localIndex];
+
     // we need to remove the old entity from the source component
     // to do so we copy the last entity entity to the hole and return that such
     // entity has been moved
@@ -451,6 +844,61 @@ struct Archetype {
     return r;
   }
 
+  // makes sure the archetype can host at least the given amount of entities
+  // without having to reallocate
+  void reserve(const uint32_t elementCount) {
+    if (elementCount > bufferElementCount) {
+      resize(elementCount);
+    }
+  }
+
+  // grows the archetype by count rows in one go and returns the first of
+  // them, the caller is in charge of filling the columns and entity indices
+  uint32_t appendRows(const uint32_t count) {
+    reserve(entityCount + count);
+    const uint32_t first = entityCount;
+    entityCount += count;
+    return first;
+  }
+
+  // writes the same value in count consecutive rows of a column, the copied
+  // range doubles at every step so only log2(count) memcpy are issued
+  void fillColumn(const uint32_t cmpIdx, const uint32_t first,
+                  const uint32_t count, const void* value) {
+    assert(cmpIdx < componentCount);
+    assert(first + count <= entityCount);
+    if (count == 0) {
+      return;
+    }
+    const size_t typeSize = m_components[cmpIdx].info.componentDataTypeSize;
+    char* dest = static_cast<char*>(m_components[cmpIdx].data) +
+                 first * typeSize;
+    memcpy(dest, value, typeSize);
+    uint32_t filled = 1;
+    while (filled < count) {
+      const uint32_t toCopy = filled < count - filled ? filled : count - filled;
+      memcpy(dest + filled * typeSize, dest, toCopy * typeSize);
+      filled += toCopy;
+    }
+  }
+
+  // same as markRowChanged for a range of rows, the chunks are stamped once
+  void markRowRangeChanged(const uint32_t first, const uint32_t count,
+                           const uint32_t version) {
+    if (count == 0) {
+      return;
+    }
+    const uint32_t startChunk = first / VERSION_CHUNK_SIZE;
+    const uint32_t endChunk = (first + count - 1) / VERSION_CHUNK_SIZE;
+    for (uint32_t i = 0; i < componentCount; ++i) {
+      Component& cmp = m_components[i];
+      for (uint32_t c = startChunk; c <= endChunk; ++c) {
+        cmp.chunkVersions[c] = version;
+      }
+      cmp.version = version;
+    }
+  }
+
  private:
   // writes a component of the given type in the correct array at the requested
   // index
@@ -465,44 +913,347 @@ struct Archetype {
 
   inline void resizeIfNeeded() {
     if (entityCount >= bufferElementCount) {
-      resize();
+      // simple strategy of doubling allocation size, which moves the storage
+      // to the next block size class
+      resize(bufferElementCount * 2);
     }
   }
 
-  // resizes the needed allocation for components and entities
-  void resize() {
-    // simple strategy of doubling allocation size
-    uint32_t newSize = bufferElementCount * 2;
+  static size_t alignUp(const size_t offset, const size_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+  }
 
-    // iterate all the components and allocate new memory
+  // walks the columns of a storage block able to host the given amount of
+  // entities and returns the block size in bytes. When a block is given, the
+  // live rows are copied over and the columns are pointed to it
+  size_t layoutStorage(const uint32_t capacity, char* storage) {
+    size_t offset = 0;
     for (uint32_t i = 0; i < componentCount; ++i) {
       Component& cmp = m_components[i];
-      // TODO change this for an allocator
-      size_t toAlloc = newSize * cmp.info.componentDataTypeSize;
-      char* newMemory = new char[toAlloc];
-      memcpy(newMemory, cmp.data,
-             bufferElementCount * cmp.info.componentDataTypeSize);
-      delete[] static_cast<char*>(cmp.data);
-      cmp.data = newMemory;
+      offset = alignUp(offset, COLUMN_ALIGNMENT);
+      if (storage != nullptr) {
+        if (entityCount != 0) {
+          memcpy(storage + offset, cmp.data,
+                 entityCount * cmp.info.componentDataTypeSize);
+        }
+        cmp.data = storage + offset;
+      }
+      offset += capacity * cmp.info.componentDataTypeSize;
+    }
+
+    // versions need to grow with the buffer
+    const uint32_t chunkCount = getVersionChunkCount(capacity);
+    const uint32_t oldChunkCount = getVersionChunkCount(bufferElementCount);
+    for (uint32_t i = 0; i < componentCount; ++i) {
+      Component& cmp = m_components[i];
+      offset = alignUp(offset, alignof(uint32_t));
+      if (storage != nullptr) {
+        auto* versions = reinterpret_cast<uint32_t*>(storage + offset);
+        if (oldChunkCount != 0) {
+          memcpy(versions, cmp.chunkVersions,
+                 oldChunkCount * sizeof(uint32_t));
+        }
+        memset(versions + oldChunkCount, 0,
+               (chunkCount - oldChunkCount) * sizeof(uint32_t));
+        cmp.chunkVersions = versions;
+      }
+      offset += chunkCount * sizeof(uint32_t);
     }
 
-    // do the same but for the entities bookkeeping:
-    auto* newEntities = new size_t[newSize];
-    memcpy(newEntities, m_entitieIndexes, bufferElementCount * sizeof(size_t));
-    delete[] m_entitieIndexes;
-    m_entitieIndexes = newEntities;
+    // last the entities bookkeeping
+    offset = alignUp(offset, alignof(size_t));
+    if (storage != nullptr) {
+      auto* entities = reinterpret_cast<size_t*>(storage + offset);
+      if (entityCount != 0) {
+        memcpy(entities, m_entitieIndexes, entityCount * sizeof(size_t));
+      }
+      m_entitieIndexes = entities;
+    }
+    offset += capacity * sizeof(size_t);
+    return offset;
+  }
+
+  // finds how many entities fit in a block of the given size
+  uint32_t computeCapacity(const size_t blockSize) {
+    // every row needs at least its entity index
+    size_t low = 0;
+    size_t high = blockSize / sizeof(size_t);
+    while (low < high) {
+      const size_t mid = (low + high + 1) / 2;
+      if (layoutStorage(static_cast<uint32_t>(mid), nullptr) <= blockSize) {
+        low = mid;
+      } else {
+        high = mid - 1;
+      }
+    }
+    return static_cast<uint32_t>(low);
+  }
 
-    bufferElementCount = newSize;
+  // moves the archetype to a storage block big enough for the given amount of
+  // entities, the old block goes back to the allocator
+  void resize(const uint32_t newSize) {
+    assert(newSize > bufferElementCount);
+    const size_t blockSize =
+        ArchetypeAllocator::getBlockSize(layoutStorage(newSize, nullptr));
+    const uint32_t capacity = computeCapacity(blockSize);
+    assert(capacity >= newSize);
+
+    auto* storage = static_cast<char*>(m_allocator->allocate(blockSize));
+    layoutStorage(capacity, storage);
+    releaseStorage();
+    m_storage = storage;
+    m_storageSizeInBytes = blockSize;
+    bufferElementCount = capacity;
+  }
+
+  void releaseStorage() {
+    if (m_storage != nullptr) {
+      m_allocator->free(m_storage, m_storageSizeInBytes);
+      m_storage = nullptr;
+      m_storageSizeInBytes = 0;
+    }
   }
 };
 
+// A sparse set holds the data of a single sparse component type. The data is
+// densely packed and a sparse array maps the global entity index to the dense
+// slot. Removing a component swaps the last element in the hole, no other
+// component of the entity is touched.
+// Change detection is not tracked for sparse components, a tag being added or
+// removed is the change itself.
+struct SparseSet {
+  static constexpr uint32_t INVALID_INDEX = static_cast<uint32_t>(-1);
+  ComponentTypeInfo info{};
+  uint32_t count = 0;
+  // packed component data, count elements of info.componentDataTypeSize
+  std::vector<char> data;
+  // dense slot to global entity index
+  std::vector<uint32_t> denseEntities;
+  // global entity index to dense slot, INVALID_INDEX if not present
+  std::vector<uint32_t> sparse;
+
+  [[nodiscard]] bool contains(const uint32_t entityIndex) const {
+    return (entityIndex < sparse.size()) &&
+           (sparse[entityIndex] != INVALID_INDEX);
+  }
+
+  [[nodiscard]] void* get(const uint32_t entityIndex) {
+    assert(contains(entityIndex));
+    return data.data() + sparse[entityIndex] * info.componentDataTypeSize;
+  }
+  [[nodiscard]] const void* get(const uint32_t entityIndex) const {
+    assert(contains(entityIndex));
+    return data.data() + sparse[entityIndex] * info.componentDataTypeSize;
+  }
+
+  // returns the memory for the new component, the caller writes into it
+  void* add(const uint32_t entityIndex) {
+    assert(!contains(entityIndex));
+    if (entityIndex >= sparse.size()) {
+      sparse.resize(entityIndex + 1, INVALID_INDEX);
+    }
+    const uint32_t slot = count++;
+    // vectors grow geometrically, no need to do it by hand
+    data.resize(count * info.componentDataTypeSize);
+    denseEntities.push_back(entityIndex);
+    sparse[entityIndex] = slot;
+    return data.data() + slot * info.componentDataTypeSize;
+  }
+
+  void remove(const uint32_t entityIndex) {
+    assert(contains(entityIndex));
+    const uint32_t slot = sparse[entityIndex];
+    const uint32_t last = count - 1;
+    if (slot != last) {
+      // plugging the hole with the last element
+      memcpy(data.data() + slot * info.componentDataTypeSize,
+             data.data() + last * info.componentDataTypeSize,
+             info.componentDataTypeSize);
+      const uint32_t movedEntity = denseEntities[last];
+      denseEntities[slot] = movedEntity;
+      sparse[movedEntity] = slot;
+    }
+    sparse[entityIndex] = INVALID_INDEX;
+    denseEntities.pop_back();
+    --count;
+    data.resize(count * info.componentDataTypeSize);
+  }
+
+  void reserve(const uint32_t elementCount) {
+    data.reserve(elementCount * info.componentDataTypeSize);
+    denseEntities.reserve(elementCount);
+  }
+};
+
+// Holds all the unique values of a shared component type, values are never
+// freed, shared components are expected to be a small set of values like
+// mesh or material handles
+struct SharedComponentStore {
+  ComponentTypeInfo info{};
+  uint32_t count = 0;
+  std::vector<char> values;
+
+  [[nodiscard]] const void* get(const uint32_t valueIndex) const {
+    assert(valueIndex < count);
+    return values.data() + valueIndex * info.componentDataTypeSize;
+  }
+
+  // returns the index of the value, adding it if never seen before. The
+  // amount of unique values is small, a linear scan is all we need
+  uint32_t findOrAdd(const void* value) {
+    const size_t size = info.componentDataTypeSize;
+    for (uint32_t i = 0; i < count; ++i) {
+      if (memcmp(values.data() + i * size, value, size) == 0) {
+        return i;
+      }
+    }
+    values.resize((count + 1) * size);
+    memcpy(values.data() + count * size, value, size);
+    return count++;
+  }
+};
+
+// structural changes done on the registry since the last reset, whoever owns
+// the frame resets them once per frame. Moving entities between archetypes is
+// what makes structural changes expensive
+struct StructuralChangeCounters {
+  uint32_t createdEntities = 0;
+  uint32_t deletedEntities = 0;
+  // adding or removing archetype or shared components
+  uint32_t archetypeMoves = 0;
+  uint32_t sparseAdds = 0;
+  uint32_t sparseRemoves = 0;
+  uint32_t createdArchetypes = 0;
+};
+
+// the compiler generated signature of this function contains the name of the
+// type, it is only meant for debugging and stats, see getComponentTypeName
+template <typename T>
+constexpr const char* rawComponentTypeName() {
+  return GENERATOR_PRETTY_FUNCTION;
+}
+
+// global data living in the registry rather than on an entity, like the
+// active camera or the frame settings
+struct SingletonComponent {
+  ComponentTypeInfo info{};
+  std::vector<char> data;
+};
+
+// A prefab is a template entity, a set of component values that gets copied
+// in every instance created by Registry::instantiate. Archetype, sparse and
+// shared components can be mixed, the signature of the target archetype is
+// computed while setting the values, so instancing does not need to look at
+// the types one by one. Prefabs are independent from any registry, they can
+// be built by hand or captured from an existing entity.
+class Prefab {
+ public:
+  struct PrefabComponent {
+    ComponentTypeInfo info;
+    ComponentStorage storage;
+    // where the value lives in the prefab data
+    uint32_t offset;
+    // see rawComponentTypeName, null when only the hash is known
+    const char* name;
+  };
+
+  template <typename T>
+  Prefab& set(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    setRaw({sizeof(T), MultiHash<T>::hash}, ComponentStorageTrait<T>::storage,
+           &value, rawComponentTypeName<T>());
+    return *this;
+  }
+
+  // type erased version of set, the value is copied
+  void setRaw(const ComponentTypeInfo& info, const ComponentStorage storage,
+              const void* value, const char* name = nullptr) {
+    PrefabComponent* cmp = find(info.hash);
+    if (cmp == nullptr) {
+      // values are aligned such that get() can hand out references
+      const size_t offset = (m_data.size() + VALUE_ALIGNMENT - 1) &
+                            ~(VALUE_ALIGNMENT - 1);
+      m_data.resize(offset + info.componentDataTypeSize);
+      m_components.push_back(
+          {info, storage, static_cast<uint32_t>(offset), name});
+      cmp = &m_components.back();
+      if (storage == ComponentStorage::ARCHETYPE) {
+        m_columns.set(registerComponentTypeIndex(info.hash));
+        m_componentsHash += mixComponentHash(info.hash);
+      }
+    }
+    assert(cmp->info.componentDataTypeSize == info.componentDataTypeSize);
+    assert(cmp->storage == storage);
+    memcpy(m_data.data() + cmp->offset, value, info.componentDataTypeSize);
+  }
+
+  template <typename T>
+  [[nodiscard]] bool has() const {
+    return find(MultiHash<T>::hash) != nullptr;
+  }
+
+  template <typename T>
+  [[nodiscard]] const T& get() const {
+    const PrefabComponent* cmp = find(MultiHash<T>::hash);
+    assert(cmp != nullptr);
+    return *reinterpret_cast<const T*>(m_data.data() + cmp->offset);
+  }
+
+  void clear() {
+    m_components.clear();
+    m_data.clear();
+    m_columns = {};
+    m_componentsHash = 0;
+  }
+
+  [[nodiscard]] const std::vector<PrefabComponent>& getComponents() const {
+    return m_components;
+  }
+  [[nodiscard]] const void* getValue(const PrefabComponent& cmp) const {
+    return m_data.data() + cmp.offset;
+  }
+  // signature of the archetype components only, see Archetype
+  [[nodiscard]] const ComponentMask& getColumnMask() const {
+    return m_columns;
+  }
+  [[nodiscard]] size_t getComponentsHash() const { return m_componentsHash; }
+
+ private:
+  static constexpr size_t VALUE_ALIGNMENT = 16;
+
+  PrefabComponent* find(const size_t hash) {
+    for (PrefabComponent& cmp : m_components) {
+      if (cmp.info.hash == hash) {
+        return &cmp;
+      }
+    }
+    return nullptr;
+  }
+  [[nodiscard]] const PrefabComponent* find(const size_t hash) const {
+    return const_cast<Prefab*>(this)->find(hash);
+  }
+
+ private:
+  std::vector<PrefabComponent> m_components;
+  std::vector<char> m_data;
+  ComponentMask m_columns;
+  size_t m_componentsHash = 0;
+};
+
 // The registry is the public face of the ecs. The user only interacts with the
 // Registry only. The Archetype is completely hidden to the user altough exposed
 // in this header due to the template craziness, the Archetype is not used by
 // the user and only manipulated internally by the Register
 class Registry {
  public:
-  Registry() = default;
+  // how many entities a worker processes at once in parallelForEach
+  static constexpr uint32_t PARALLEL_BATCH_SIZE = 1024;
+
+  // archetypes storage comes from the given allocator, or from the default
+  // one when none is given
+  explicit Registry(ArchetypeAllocator* allocator = nullptr)
+      : m_allocator(allocator != nullptr ? allocator
+                                         : &getDefaultArchetypeAllocator()) {}
   ~Registry() {
     size_t archCount = m_archetypes.size();
     for (size_t i = 0; i < archCount; ++i) {
@@ -512,12 +1263,14 @@ class Registry {
 
   template <typename... TYPES>
   EntityId createEntity(TYPES... types) {
+    static_assert((isArchetypeComponent<TYPES> && ...),
+                  "sparse and shared components need to be added after the "
+                  "entity creation");
     // make sure the types exists in our bookkeeping
     ensureTypeInfos<TYPES...>();
-    // let us find an archetype
-    size_t id = MultiHash<TYPES...>::hash;
     // find a fitting archetype if required create a new one
-    Archetype* arch = findArchetype<TYPES...>();
+    uint16_t archetypeIdx = INVALID_ARCHETYPE;
+    Archetype* arch = findArchetype<TYPES...>(archetypeIdx);
 
     // creating the entity
     size_t eid = getNewEntityId();
@@ -525,58 +1278,128 @@ class Registry {
 
     // updating the entity content with the result of the new allocation
     Entity& e = m_entities[eid];
-    e.archetypeIndex = m_archetypeToIndex[id];
+    e.archetypeIndex = archetypeIdx;
     e.localIndex = static_cast<uint32_t>(localIndex);
+    arch->markRowChanged(e.localIndex, m_version);
+    ++m_structuralChanges.createdEntities;
     return {static_cast<uint32_t>(eid), e.version, 0};
   }
   void deleteEntity(const EntityId eid) {
-    assert(eid.index < m_entities.size());
+    assert(isEntityValid(eid));
     Entity& e = m_entities[eid.index];
-    assert(eid.version == e.version);
     auto* arch = m_archetypes[e.archetypeIndex];
 
     // deleting an entity is pretty straight forward, we ask the archetype to
     // get rid of it, once that is done we just need to invalidate the current
     // entity and market it for being able to be recycled
     EntityMoveResult moveResult = arch->deleteEntity(e);
-    if (moveResult.entityGlobalIndex != EntityMoveResult::VOID_REQUEST) {
-      Entity& movedEntity = m_entities[moveResult.entityGlobalIndex];
-      movedEntity.localIndex = moveResult.destIdx;
+    patchMovedEntity(arch, moveResult);
+    for (auto& set : m_sparseSets) {
+      if (set.second.contains(eid.index)) {
+        set.second.remove(eid.index);
+      }
     }
-    // marking entity as free ready to be recycled
-    m_freeEntities.push_back(eid.index);
+    // marking entity as free ready to be recycled, bumping the version right
+    // away makes any outstanding id stale even before the slot is reused
     e.archetypeIndex = INVALID_ARCHETYPE;
+    e.version = nextEntityVersion(e.version);
+    pushFreeEntity(eid.index);
+    ++m_structuralChanges.deletedEntities;
   }
 
   template <typename T>
   bool hasComponent(const EntityId eid) {
     Entity e = m_entities[eid.index];
     assert(eid.version == e.version);
-    return m_archetypes[e.archetypeIndex]->getComponentIndex<T>() !=
-           Archetype::INVALID_COMPONENT_INDEX;
+    if constexpr (isSparseComponent<T>) {
+      const SparseSet* set = findSparseSet(MultiHash<T>::hash);
+      return (set != nullptr) && set->contains(eid.index);
+    }
+    if constexpr (isSharedComponent<T>) {
+      return m_archetypes[e.archetypeIndex]->m_sharedMask.test(
+          getComponentTypeIndex<T>());
+    }
+    return m_archetypes[e.archetypeIndex]->hasComponent<T>();
   }
 
+  // read only access to the component, does not count as a change
   template <typename T>
   [[nodiscard]] const T& getComponent(const EntityId eid) const {
-    return getComponent<T>(eid);
+    const Entity& e = getEntity(eid);
+    if constexpr (isSparseComponent<T>) {
+      const SparseSet* set = findSparseSet(MultiHash<T>::hash);
+      assert(set != nullptr);
+      return *static_cast<const T*>(set->get(eid.index));
+    }
+    if constexpr (isSharedComponent<T>) {
+      return getSharedValue<T>(m_archetypes[e.archetypeIndex]);
+    }
+    const Archetype* arch = m_archetypes[e.archetypeIndex];
+    const int cmpIdx = arch->getComponentIndex<T>();
+    assert(cmpIdx != Archetype::INVALID_COMPONENT_INDEX);
+    const Component* cmp = arch->getComponentFromIdx(cmpIdx);
+    return static_cast<const T*>(cmp->data)[e.localIndex];
   }
 
+  // O(1) liveness check, stale and out of range ids are simply not valid
   [[nodiscard]] bool isEntityValid(const EntityId eid) const {
-    assert(eid.index < m_entities.size());
-    const Entity& e = m_entities[eid.index];
-    return (e.archetypeIndex != INVALID_ARCHETYPE) & (eid.version == e.version);
+    return (eid.index < m_entities.size()) &&
+           (m_entities[eid.index].version == eid.version) &&
+           (m_entities[eid.index].archetypeIndex != INVALID_ARCHETYPE);
+  }
+  [[nodiscard]] uint32_t getAliveEntityCount() const {
+    return static_cast<uint32_t>(m_entities.size()) - m_freeCount;
   }
 
+  // mutable access to the component, this is considered a write and the
+  // component gets flagged as changed for the current version.
+  // Shared values can't be modified in place, they are returned as const, use
+  // setSharedComponent to change them
   template <typename T>
-  T& getComponent(const EntityId eid) {
+  std::conditional_t<isSharedComponent<T>, const T&, T&> getComponent(
+      const EntityId eid) {
     assert(hasComponent<T>(eid));
     const Entity e = m_entities[eid.index];
     assert(eid.version == e.version);
-    Component* cmp = m_archetypes[e.archetypeIndex]->getComponent<T>();
+    if constexpr (isSharedComponent<T>) {
+      return getSharedValue<T>(m_archetypes[e.archetypeIndex]);
+    }
+    if constexpr (isSparseComponent<T>) {
+      return *static_cast<T*>(getSparseSet<T>().get(eid.index));
+    }
+    Archetype* arch = m_archetypes[e.archetypeIndex];
+    const auto cmpIdx = static_cast<uint32_t>(arch->getComponentIndex<T>());
+    arch->markComponentRowChanged(cmpIdx, e.localIndex, m_version);
+    Component* cmp = arch->getComponentFromIdx(cmpIdx);
     auto* data = static_cast<T*>(cmp->data);
     return data[e.localIndex];
   }
 
+  // explicitly flags a component as changed, useful when the data was written
+  // through a pointer obtained by other means
+  template <typename T>
+  void markComponentChanged(const EntityId eid) {
+    static_assert(isArchetypeComponent<T>,
+                  "change detection is only tracked for archetype components");
+    const Entity& e = getEntity(eid);
+    Archetype* arch = m_archetypes[e.archetypeIndex];
+    const int cmpIdx = arch->getComponentIndex<T>();
+    assert(cmpIdx != Archetype::INVALID_COMPONENT_INDEX);
+    arch->markComponentRowChanged(static_cast<uint32_t>(cmpIdx), e.localIndex,
+                                  m_version);
+  }
+
+  //---------------------------------------------
+  // change detection
+  //---------------------------------------------
+  // Every write access gets stamped with the current registry version.
+  // Closing a version returns it, any write happening after the call will be
+  // stamped with a newer version. A consumer mirroring ecs data somewhere else
+  // can store the returned value and use it as sinceVersion on the next
+  // changed query to only get what was written in the meantime.
+  uint32_t advanceVersion() { return m_version++; }
+  [[nodiscard]] uint32_t getVersion() const { return m_version; }
+
   // a query allows to find all the archetypes that match a specific component
   // setup. The result is a series of tuples, each tuple refers to a matching
   // archetype. The tuple will contain at first index a size, telling the user
@@ -587,6 +1410,9 @@ class Registry {
   template <typename... TYPES>
   void populateComponentQuery(
       std::vector<std::tuple<size_t, TYPES...>>& query) {
+    static_assert((isArchetypeComponent<TYPES> && ...),
+                  "sparse and shared components are not stored in columns, use "
+                  "forEach or populateSharedComponentQuery");
     query.clear();
 
     // iterating all the archetypes and find which one match
@@ -595,24 +1421,441 @@ class Registry {
     // force one.
     // https://medium.com/@ajmmertens/building-an-ecs-2-archetypes-and-vectorization-fe21690805f9
     // of course it can be optimized but the growth will always be linear
+    // pointers to non const components are considered write access and will
+    // flag the whole column as changed, ask for pointers to const if you only
+    // need to read
+    const ComponentMask& columns =
+        getComponentMask<ComponentStorage::ARCHETYPE, TYPES...>();
     size_t size = m_archetypes.size();
     for (size_t i = 0; i < size; ++i) {
       Archetype* arch = m_archetypes[i];
-      bool result =
-          arch->hasComponents<typename std::remove_pointer<TYPES>::type...>();
+      bool result = arch->m_mask.contains(columns);
       result &= (arch->entityCount != 0);
       if (result) {
         auto componentCount = arch->entityCount;
         std::tuple<size_t, TYPES...> tup{
             componentCount,
             (static_cast<TYPES>(
-                arch->getComponent<typename std::remove_pointer<TYPES>::type>()
-                    ->data))...};
+                arch->getComponent<ComponentType<TYPES>>()->data))...};
+        query.emplace_back(tup);
+        (markQueryWriteAccess<TYPES>(arch), ...);
+      }
+    }
+  }
+
+  // Same as populateComponentQuery but only returns the data where the
+  // CHANGED component has been written after sinceVersion. Each tuple covers
+  // a contiguous range of changed rows inside an archetype rather than the
+  // whole archetype, the size and pointers are already offset to the start of
+  // the range, so the result can be iterated exactly like a normal query.
+  // The granularity is Archetype::VERSION_CHUNK_SIZE rows, some unchanged
+  // rows might be returned alongside the changed ones.
+  template <typename CHANGED, typename... TYPES>
+  void populateChangedComponentQuery(
+      std::vector<std::tuple<size_t, TYPES...>>& query,
+      const uint32_t sinceVersion) {
+    static_assert((isArchetypeComponent<TYPES> && ...),
+                  "sparse and shared components are not stored in columns, use "
+                  "forEach or populateSharedComponentQuery");
+    query.clear();
+
+    const ComponentMask& columns =
+        getComponentMask<ComponentStorage::ARCHETYPE, CHANGED, TYPES...>();
+    size_t size = m_archetypes.size();
+    for (size_t i = 0; i < size; ++i) {
+      Archetype* arch = m_archetypes[i];
+      bool result = arch->m_mask.contains(columns);
+      result &= (arch->entityCount != 0);
+      if (!result) {
+        continue;
+      }
+      const auto changedIdx =
+          static_cast<uint32_t>(arch->getComponentIndex<CHANGED>());
+      // quick rejection of the whole archetype
+      if (!arch->hasComponentChangedSince(changedIdx, sinceVersion)) {
+        continue;
+      }
+
+      // we merge adjacent changed chunks in a single range
+      const uint32_t chunkCount =
+          Archetype::getVersionChunkCount(arch->entityCount);
+      uint32_t chunk = 0;
+      while (chunk < chunkCount) {
+        if (!arch->hasChunkChangedSince(changedIdx, chunk, sinceVersion)) {
+          ++chunk;
+          continue;
+        }
+        const uint32_t startChunk = chunk;
+        while ((chunk < chunkCount) &&
+               arch->hasChunkChangedSince(changedIdx, chunk, sinceVersion)) {
+          ++chunk;
+        }
+        const uint32_t start = startChunk * Archetype::VERSION_CHUNK_SIZE;
+        uint32_t end = chunk * Archetype::VERSION_CHUNK_SIZE;
+        end = end > arch->entityCount ? arch->entityCount : end;
+        std::tuple<size_t, TYPES...> tup{
+            end - start,
+            (static_cast<TYPES>(
+                 arch->getComponent<ComponentType<TYPES>>()->data) +
+             start)...};
         query.emplace_back(tup);
+        (markQueryRangeWriteAccess<TYPES>(arch, startChunk, chunk), ...);
       }
     }
   }
 
+  // Calls func(EntityId, TYPES&...) for every entity having all the given
+  // components, archetype and sparse components can be mixed freely. As for
+  // queries, non const types are considered write access. When sparse
+  // components are involved the iteration is driven by the smallest sparse
+  // set, otherwise it walks the matching archetypes. Adding or removing
+  // components while iterating is not supported.
+  template <typename... TYPES, typename FUNC>
+  void forEach(FUNC&& func) {
+    static_assert(((!isSharedComponent<TYPES> || std::is_const_v<TYPES>)&&...),
+                  "shared components can only be iterated as const");
+    if constexpr ((isSparseComponent<TYPES> || ...)) {
+      // finding the smallest sparse set to drive the iteration, if any of
+      // them does not exist there is nothing to iterate
+      SparseSet* driver = nullptr;
+      bool missing = false;
+      (pickSparseDriver<TYPES>(driver, missing), ...);
+      if (missing) {
+        return;
+      }
+      for (uint32_t i = 0; i < driver->count; ++i) {
+        const uint32_t entityIndex = driver->denseEntities[i];
+        const Entity& e = m_entities[entityIndex];
+        Archetype* arch = m_archetypes[e.archetypeIndex];
+        if (!(hasForEachComponent<TYPES>(arch, entityIndex) && ...)) {
+          continue;
+        }
+        func(EntityId{entityIndex, e.version, 0},
+             accessForEachComponent<TYPES>(arch, e, entityIndex)...);
+      }
+    } else {
+      const ComponentMask& columnMask =
+          getComponentMask<ComponentStorage::ARCHETYPE, TYPES...>();
+      const ComponentMask& sharedMask =
+          getComponentMask<ComponentStorage::SHARED, TYPES...>();
+      const size_t size = m_archetypes.size();
+      for (size_t a = 0; a < size; ++a) {
+        Archetype* arch = m_archetypes[a];
+        if ((arch->entityCount == 0) ||
+            !arch->matches(columnMask, sharedMask)) {
+          continue;
+        }
+        std::tuple<TYPES*...> columns{getForEachColumn<TYPES>(arch)...};
+        (markQueryWriteAccess<TYPES*>(arch), ...);
+        for (uint32_t row = 0; row < arch->entityCount; ++row) {
+          const auto entityIndex =
+              static_cast<uint32_t>(arch->m_entitieIndexes[row]);
+          // shared values are a single element, their column stride is zero
+          func(EntityId{entityIndex, m_entities[entityIndex].version, 0},
+               std::get<TYPES*>(columns)[isSharedComponent<TYPES> ? 0
+                                                                  : row]...);
+        }
+      }
+    }
+  }
+
+  // Same as forEach but the entities are split in batches of batchSize that
+  // are spread over the workers of the pool. func is called concurrently from
+  // several threads and must only touch the entity it is given, per worker
+  // data, like the pool scratch allocators, can be picked with
+  // WorkerPool::getCurrentWorkerIndex. The change bookkeeping is done upfront
+  // on the calling thread. The registry can not be modified while iterating.
+  // The pool type is deduced so the registry only needs WorkerPool forward
+  // declared, the caller includes workerPool.h.
+  template <typename... TYPES, typename FUNC, typename POOL>
+  void parallelForEach(POOL& pool, FUNC&& func,
+                       const uint32_t batchSize = PARALLEL_BATCH_SIZE) {
+    static_assert(std::is_same_v<POOL, WorkerPool>,
+                  "parallelForEach runs on a WorkerPool");
+    static_assert(((!isSharedComponent<TYPES> || std::is_const_v<TYPES>)&&...),
+                  "shared components can only be iterated as const");
+    assert(batchSize != 0);
+    if constexpr ((isSparseComponent<TYPES> || ...)) {
+      SparseSet* driver = nullptr;
+      bool missing = false;
+      (pickSparseDriver<TYPES>(driver, missing), ...);
+      if (missing) {
+        return;
+      }
+      // filtering and stamping the versions serially, the workers only read
+      // the matching entities
+      m_parallelEntities.clear();
+      for (uint32_t i = 0; i < driver->count; ++i) {
+        const uint32_t entityIndex = driver->denseEntities[i];
+        const Entity& e = m_entities[entityIndex];
+        Archetype* arch = m_archetypes[e.archetypeIndex];
+        if (!(hasForEachComponent<TYPES>(arch, entityIndex) && ...)) {
+          continue;
+        }
+        (markForEachRowChanged<TYPES>(arch, e), ...);
+        m_parallelEntities.push_back(entityIndex);
+      }
+      const auto count = static_cast<uint32_t>(m_parallelEntities.size());
+      pool.parallelFor(
+          (count + batchSize - 1) / batchSize, [&](const uint32_t batch) {
+            const uint32_t start = batch * batchSize;
+            const uint32_t end =
+                start + batchSize < count ? start + batchSize : count;
+            for (uint32_t i = start; i < end; ++i) {
+              const uint32_t entityIndex = m_parallelEntities[i];
+              const Entity& e = m_entities[entityIndex];
+              Archetype* arch = m_archetypes[e.archetypeIndex];
+              func(EntityId{entityIndex, e.version, 0},
+                   readForEachComponent<TYPES>(arch, e, entityIndex)...);
+            }
+          });
+    } else {
+      m_parallelBatches.clear();
+      const ComponentMask& columnMask =
+          getComponentMask<ComponentStorage::ARCHETYPE, TYPES...>();
+      const ComponentMask& sharedMask =
+          getComponentMask<ComponentStorage::SHARED, TYPES...>();
+      const size_t size = m_archetypes.size();
+      for (size_t a = 0; a < size; ++a) {
+        Archetype* arch = m_archetypes[a];
+        if ((arch->entityCount == 0) ||
+            !arch->matches(columnMask, sharedMask)) {
+          continue;
+        }
+        (markQueryWriteAccess<TYPES*>(arch), ...);
+        for (uint32_t start = 0; start < arch->entityCount;
+             start += batchSize) {
+          const uint32_t end = start + batchSize < arch->entityCount
+                                   ? start + batchSize
+                                   : arch->entityCount;
+          m_parallelBatches.push_back(
+              ParallelBatch{static_cast<uint32_t>(a), start, end});
+        }
+      }
+      pool.parallelFor(
+          static_cast<uint32_t>(m_parallelBatches.size()),
+          [&](const uint32_t batchIndex) {
+            const ParallelBatch& batch = m_parallelBatches[batchIndex];
+            Archetype* arch = m_archetypes[batch.archetypeIndex];
+            std::tuple<TYPES*...> columns{getForEachColumn<TYPES>(arch)...};
+            for (uint32_t row = batch.start; row < batch.end; ++row) {
+              const auto entityIndex =
+                  static_cast<uint32_t>(arch->m_entitieIndexes[row]);
+              func(EntityId{entityIndex, m_entities[entityIndex].version, 0},
+                   std::get<TYPES*>(
+                       columns)[isSharedComponent<TYPES> ? 0 : row]...);
+            }
+          });
+    }
+  }
+
+  // Same as populateComponentQuery but only archetypes having the SHARED
+  // component are returned, right after the size every tuple has a pointer to
+  // the shared value of the archetype. Tuples are sorted by shared value, all
+  // the consecutive tuples with the same value pointer can be batched
+  // together, for example in a single instanced draw for a shared mesh.
+  // The value pointers are valid until a new shared value is added
+  template <typename SHARED, typename... TYPES>
+  void populateSharedComponentQuery(
+      std::vector<std::tuple<size_t, const SHARED*, TYPES...>>& query) {
+    static_assert(isSharedComponent<SHARED>);
+    static_assert((isArchetypeComponent<TYPES> && ...),
+                  "sparse and shared components are not stored in columns, use "
+                  "forEach");
+    query.clear();
+    const ComponentMask& columns =
+        getComponentMask<ComponentStorage::ARCHETYPE, TYPES...>();
+    const ComponentMask& shared =
+        getComponentMask<ComponentStorage::SHARED, SHARED>();
+    const size_t size = m_archetypes.size();
+    for (size_t i = 0; i < size; ++i) {
+      Archetype* arch = m_archetypes[i];
+      bool result = arch->matches(columns, shared);
+      result &= (arch->entityCount != 0);
+      if (result) {
+        std::tuple<size_t, const SHARED*, TYPES...> tup{
+            arch->entityCount, &getSharedValue<SHARED>(arch),
+            (static_cast<TYPES>(
+                arch->getComponent<ComponentType<TYPES>>()->data))...};
+        query.emplace_back(tup);
+        (markQueryWriteAccess<TYPES>(arch), ...);
+      }
+    }
+    // values of a type are contiguous in the store, sorting the pointers
+    // sorts by value index
+    std::sort(query.begin(), query.end(), [](const auto& a, const auto& b) {
+      return std::get<1>(a) < std::get<1>(b);
+    });
+  }
+
+  // sets the shared value for the entity, adding the shared component if the
+  // entity did not have it. The entity moves to the archetype partition of
+  // the new value
+  template <typename T>
+  void setSharedComponent(const EntityId eid, const T& value) {
+    static_assert(isSharedComponent<T>);
+    ensureTypeInfo<T>();
+    Entity& e = getEntity(eid);
+    Archetype* arch = m_archetypes[e.archetypeIndex];
+    const uint32_t valueIndex = getSharedStore<T>().findOrAdd(&value);
+
+    scratchShared = arch->m_shared;
+    const int sharedIdx = arch->getSharedIndexFromHash(MultiHash<T>::hash);
+    if (sharedIdx == Archetype::INVALID_COMPONENT_INDEX) {
+      scratchShared.push_back({MultiHash<T>::hash, valueIndex});
+    } else {
+      if (scratchShared[sharedIdx].valueIndex == valueIndex) {
+        return;
+      }
+      scratchShared[sharedIdx].valueIndex = valueIndex;
+    }
+    moveToSharedPartition(e, arch);
+  }
+
+  // global data, not attached to any entity, there is at most one value per
+  // type
+  template <typename T>
+  void setSingleton(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    SingletonComponent& singleton = m_singletons[MultiHash<T>::hash];
+    singleton.info = {sizeof(T), MultiHash<T>::hash};
+    singleton.data.resize(sizeof(T));
+    memcpy(singleton.data.data(), &value, sizeof(T));
+  }
+
+  template <typename T>
+  [[nodiscard]] bool hasSingleton() const {
+    return m_singletons.find(MultiHash<T>::hash) != m_singletons.end();
+  }
+
+  template <typename T>
+  T& getSingleton() {
+    const auto found = m_singletons.find(MultiHash<T>::hash);
+    assert(found != m_singletons.end());
+    return *reinterpret_cast<T*>(found->second.data.data());
+  }
+
+  template <typename T>
+  [[nodiscard]] const T& getSingleton() const {
+    const auto found = m_singletons.find(MultiHash<T>::hash);
+    assert(found != m_singletons.end());
+    return *reinterpret_cast<const T*>(found->second.data.data());
+  }
+
+  template <typename T>
+  void removeSingleton() {
+    assert(hasSingleton<T>());
+    m_singletons.erase(MultiHash<T>::hash);
+  }
+
+  //---------------------------------------------
+  // prefabs
+  //---------------------------------------------
+  // Creates count entities having all the prefab components at once. The
+  // target archetype is looked up a single time, grows once to fit all the
+  // instances and every column is filled with a handful of bulk copies, no
+  // entity ever moves between archetypes. The ids are written to outIds when
+  // given, it needs room for count elements
+  void instantiate(const Prefab& prefab, const uint32_t count,
+                   EntityId* outIds = nullptr) {
+    if (count == 0) {
+      return;
+    }
+    scratchShared.clear();
+    for (const Prefab::PrefabComponent& cmp : prefab.getComponents()) {
+      registerTypeInfo(cmp.info);
+      const uint32_t typeIndex = registerComponentTypeIndex(cmp.info.hash);
+      if ((cmp.name != nullptr) && (m_componentNames[typeIndex] == nullptr)) {
+        m_componentNames[typeIndex] = cmp.name;
+      }
+      if (cmp.storage == ComponentStorage::SHARED) {
+        const uint32_t valueIndex =
+            getSharedStore(cmp.info).findOrAdd(prefab.getValue(cmp));
+        scratchShared.push_back({cmp.info.hash, valueIndex});
+      }
+    }
+    uint16_t archetypeIdx = INVALID_ARCHETYPE;
+    Archetype* arch = findArchetypeFromSignature(
+        prefab.getColumnMask(), prefab.getComponentsHash(), scratchShared,
+        archetypeIdx);
+
+    const uint32_t first = arch->appendRows(count);
+    for (const Prefab::PrefabComponent& cmp : prefab.getComponents()) {
+      if (cmp.storage == ComponentStorage::ARCHETYPE) {
+        const int cmpIdx = arch->getComponentIndexFromHash(cmp.info.hash);
+        assert(cmpIdx != Archetype::INVALID_COMPONENT_INDEX);
+        arch->fillColumn(static_cast<uint32_t>(cmpIdx), first, count,
+                         prefab.getValue(cmp));
+      }
+    }
+    arch->markRowRangeChanged(first, count, m_version);
+
+    if (count > m_freeCount) {
+      m_entities.reserve(m_entities.size() + count - m_freeCount);
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      const size_t eid = getNewEntityId();
+      Entity& e = m_entities[eid];
+      e.archetypeIndex = archetypeIdx;
+      e.localIndex = first + i;
+      arch->m_entitieIndexes[first + i] = eid;
+      if (outIds != nullptr) {
+        outIds[i] = {static_cast<uint32_t>(eid), e.version, 0};
+      }
+    }
+
+    for (const Prefab::PrefabComponent& cmp : prefab.getComponents()) {
+      if (cmp.storage == ComponentStorage::SPARSE_SET) {
+        SparseSet& set = getSparseSet(cmp.info);
+        set.reserve(set.count + count);
+        for (uint32_t i = 0; i < count; ++i) {
+          const auto entityIndex =
+              static_cast<uint32_t>(arch->m_entitieIndexes[first + i]);
+          memcpy(set.add(entityIndex), prefab.getValue(cmp),
+                 cmp.info.componentDataTypeSize);
+        }
+        m_structuralChanges.sparseAdds += count;
+      }
+    }
+    m_structuralChanges.createdEntities += count;
+  }
+
+  // captures all the components of the entity, archetype, sparse and shared,
+  // in the prefab. Instantiating it clones the entity
+  void createPrefab(const EntityId eid, Prefab& outPrefab) const {
+    const Entity& e = getEntity(eid);
+    const Archetype* arch = m_archetypes[e.archetypeIndex];
+    outPrefab.clear();
+    for (uint32_t i = 0; i < arch->componentCount; ++i) {
+      const Component& cmp = arch->m_components[i];
+      outPrefab.setRaw(cmp.info, ComponentStorage::ARCHETYPE,
+                       static_cast<const char*>(cmp.data) +
+                           e.localIndex * cmp.info.componentDataTypeSize,
+                       getRawComponentTypeName(cmp.info.hash));
+    }
+    for (const SharedComponentRef& ref : arch->m_shared) {
+      const SharedComponentStore& store = m_sharedStores.find(ref.hash)->second;
+      outPrefab.setRaw(store.info, ComponentStorage::SHARED,
+                       store.get(ref.valueIndex),
+                       getRawComponentTypeName(ref.hash));
+    }
+    for (const auto& set : m_sparseSets) {
+      if (set.second.contains(eid.index)) {
+        outPrefab.setRaw(set.second.info, ComponentStorage::SPARSE_SET,
+                         set.second.get(eid.index),
+                         getRawComponentTypeName(set.first));
+      }
+    }
+  }
+
+  // creates count copies of the entity, see instantiate
+  void cloneEntity(const EntityId eid, const uint32_t count,
+                   EntityId* outIds = nullptr) {
+    Prefab prefab;
+    createPrefab(eid, prefab);
+    instantiate(prefab, count, outIds);
+  }
+
   template <typename T>
   void removeComponent(const EntityId eid) {
     ensureTypeInfo<T>();
@@ -620,31 +1863,43 @@ class Registry {
 
     Entity& e = m_entities[eid.index];
     assert(eid.version == e.version);
+    if constexpr (isSparseComponent<T>) {
+      // no data movement, the entity stays in its archetype
+      getSparseSet<T>().remove(eid.index);
+      ++m_structuralChanges.sparseRemoves;
+      return;
+    }
 
     auto* arch = m_archetypes[e.archetypeIndex];
-
-    // let us build the list of components we need
-    scratchIds.clear();
-    for (uint32_t i = 0; i < arch->componentCount; ++i) {
-      auto hash = arch->m_components[i].info.hash;
-      if (hash != MultiHash<T>::hash) {
-        scratchIds.push_back(hash);
+    if constexpr (isSharedComponent<T>) {
+      scratchShared.clear();
+      for (const SharedComponentRef& ref : arch->m_shared) {
+        if (ref.hash != MultiHash<T>::hash) {
+          scratchShared.push_back(ref);
+        }
       }
+      moveToSharedPartition(e, arch);
+      return;
     }
 
-    assert(scratchIds.size() == (arch->componentCount - 1));
+    // the signature of the archetype we need, the hash is a sum so removing
+    // a type is a subtraction
+    ComponentMask mask = arch->m_mask;
+    mask.reset(getComponentTypeIndex<T>());
+    const size_t hash =
+        arch->componentsHash - mixComponentHash(MultiHash<T>::hash);
+    scratchShared = arch->m_shared;
     uint16_t nextIdx = INVALID_ARCHETYPE;
-    Archetype* next = findArchetypeFromIds(scratchIds, nextIdx);
+    Archetype* next = findArchetypeFromSignature(mask, hash, scratchShared,
+                                                 nextIdx);
 
     EntityMoveResult moveResult = next->move(arch, e);
-    if (moveResult.entityGlobalIndex != -1) {
-      // update the moved entity
-      Entity& movedEntity = m_entities[moveResult.entityGlobalIndex];
-      movedEntity.localIndex = moveResult.destIdx;
-    }
+    patchMovedEntity(arch, moveResult);
 
     // updated archetype in entity
     e.archetypeIndex = nextIdx;
+    next->markRowChanged(e.localIndex, m_version);
+    ++m_structuralChanges.archetypeMoves;
   }
 
   template <typename T>
@@ -652,28 +1907,167 @@ class Registry {
     ensureTypeInfo<T>();
     Entity& e = m_entities[eid.index];
     assert(eid.version == e.version);
+    if constexpr (isSparseComponent<T>) {
+      SparseSet& set = getSparseSet<T>();
+      memcpy(set.add(eid.index), &cmp, sizeof(T));
+      ++m_structuralChanges.sparseAdds;
+      return;
+    }
+    if constexpr (isSharedComponent<T>) {
+      setSharedComponent(eid, cmp);
+      return;
+    }
 
     auto* arch = m_archetypes[e.archetypeIndex];
-    scratchIds.clear();
-
-    // populate the list of required components
-    for (uint32_t i = 0; i < arch->componentCount; ++i) {
-      scratchIds.push_back(arch->m_components[i].info.hash);
-    }
-    scratchIds.push_back(MultiHash<T>::hash);
+    ComponentMask mask = arch->m_mask;
+    mask.set(getComponentTypeIndex<T>());
+    const size_t hash =
+        arch->componentsHash + mixComponentHash(MultiHash<T>::hash);
+    scratchShared = arch->m_shared;
 
     uint16_t nextIdx = INVALID_ARCHETYPE;
-    Archetype* next = findArchetypeFromIds(scratchIds, nextIdx);
+    Archetype* next = findArchetypeFromSignature(mask, hash, scratchShared,
+                                                 nextIdx);
 
     EntityMoveResult moveResult = next->move(arch, cmp, e);
-    if (moveResult.entityGlobalIndex != -1) {
-      // update the moved entity
-      Entity& movedEntity = m_entities[moveResult.entityGlobalIndex];
-      movedEntity.localIndex = moveResult.destIdx;
-    }
+    patchMovedEntity(arch, moveResult);
 
     // updated archetype
     e.archetypeIndex = nextIdx;
+    next->markRowChanged(e.localIndex, m_version);
+    ++m_structuralChanges.archetypeMoves;
+  }
+
+  //---------------------------------------------
+  // low level access, used by tools like snapshots
+  //---------------------------------------------
+  [[nodiscard]] uint32_t getArchetypeCount() const {
+    return static_cast<uint32_t>(m_archetypes.size());
+  }
+  [[nodiscard]] const Archetype* getArchetype(const uint32_t idx) const {
+    assert(idx < m_archetypes.size());
+    return m_archetypes[idx];
+  }
+  [[nodiscard]] const std::vector<Entity>& getEntities() const {
+    return m_entities;
+  }
+  [[nodiscard]] uint32_t getFreeListHead() const { return m_freeHead; }
+  [[nodiscard]] uint32_t getFreeListTail() const { return m_freeTail; }
+  [[nodiscard]] const std::unordered_map<size_t, SparseSet>& getSparseSets()
+      const {
+    return m_sparseSets;
+  }
+  [[nodiscard]] const std::unordered_map<size_t, SharedComponentStore>&
+  getSharedStores() const {
+    return m_sharedStores;
+  }
+  [[nodiscard]] const std::unordered_map<size_t, SingletonComponent>&
+  getSingletons() const {
+    return m_singletons;
+  }
+
+  [[nodiscard]] const ArchetypeAllocator* getArchetypeAllocator() const {
+    return m_allocator;
+  }
+  // indexed by component type index, types never seen by this registry have
+  // a zero size
+  [[nodiscard]] const std::vector<ComponentTypeInfo>& getComponentTypeInfos()
+      const {
+    return m_componentTypeInfo;
+  }
+  // compiler generated signature holding the name of the type, null for types
+  // only known by hash, like the ones restored from a snapshot
+  [[nodiscard]] const char* getRawComponentTypeName(const size_t hash) const {
+    const uint32_t typeIndex = findComponentTypeIndex(hash);
+    return typeIndex < m_componentNames.size() ? m_componentNames[typeIndex]
+                                               : nullptr;
+  }
+
+  [[nodiscard]] const StructuralChangeCounters& getStructuralChanges() const {
+    return m_structuralChanges;
+  }
+  void resetStructuralChanges() { m_structuralChanges = {}; }
+
+  // destroys all the archetypes, entities and singletons, type infos are kept
+  void clear() {
+    for (auto* arch : m_archetypes) {
+      delete arch;
+    }
+    m_archetypes.clear();
+    m_archetypeToIndex.clear();
+    m_entities.clear();
+    m_freeHead = INVALID_ENTITY_INDEX;
+    m_freeTail = INVALID_ENTITY_INDEX;
+    m_freeCount = 0;
+    m_sparseSets.clear();
+    m_sharedStores.clear();
+    m_singletons.clear();
+    m_structuralChanges = {};
+  }
+
+  SharedComponentStore* createSharedStoreFromTypeInfo(
+      const ComponentTypeInfo& info) {
+    assert(m_sharedStores.find(info.hash) == m_sharedStores.end());
+    registerTypeInfo(info);
+    SharedComponentStore& store = m_sharedStores[info.hash];
+    store.info = info;
+    return &store;
+  }
+
+  void setSingletonFromTypeInfo(const ComponentTypeInfo& info,
+                                const void* data) {
+    SingletonComponent& singleton = m_singletons[info.hash];
+    singleton.info = info;
+    singleton.data.resize(info.componentDataTypeSize);
+    memcpy(singleton.data.data(), data, info.componentDataTypeSize);
+  }
+
+  // same as createArchetypeFromTypeInfos but for sparse components
+  SparseSet* createSparseSetFromTypeInfo(const ComponentTypeInfo& info,
+                                         const uint32_t reserveCount) {
+    assert(m_sparseSets.find(info.hash) == m_sparseSets.end());
+    registerTypeInfo(info);
+    SparseSet& set = m_sparseSets[info.hash];
+    set.info = info;
+    set.reserve(reserveCount);
+    return &set;
+  }
+
+  // creates an empty archetype purely from type infos, the type infos are
+  // registered in the process. This is used when the concrete types are not
+  // known, like when restoring data from disk. The columns keep the order of
+  // the given infos
+  Archetype* createArchetypeFromTypeInfos(
+      const ComponentTypeInfo* infos, const uint32_t count,
+      const uint32_t reserveCount, const SharedComponentRef* shared = nullptr,
+      const uint32_t sharedCount = 0) {
+    auto* cmps = new Component[count];
+    for (uint32_t i = 0; i < count; ++i) {
+      registerTypeInfo(infos[i]);
+      cmps[i] = createComponent(infos[i]);
+    }
+    Archetype* arch = addArchetype(cmps, count, shared, sharedCount);
+    arch->reserve(reserveCount);
+    return arch;
+  }
+
+  // archetype index of the dead entities
+  static constexpr uint16_t INVALID_ARCHETYPE = static_cast<uint16_t>(-1);
+  // ends of an empty free list and next index of its last entity
+  static constexpr uint32_t INVALID_ENTITY_INDEX = static_cast<uint32_t>(-1);
+
+  // overrides the whole entity bookkeeping, archetypes referenced by the
+  // entities need to exist already. The free list lives inside the entities
+  // themselves, only its ends are needed
+  void restoreEntities(const Entity* entities, const size_t count,
+                       const uint32_t freeHead, const uint32_t freeTail) {
+    m_entities.assign(entities, entities + count);
+    m_freeHead = freeHead;
+    m_freeTail = freeTail;
+    m_freeCount = 0;
+    for (const Entity& e : m_entities) {
+      m_freeCount += e.archetypeIndex == INVALID_ARCHETYPE ? 1 : 0;
+    }
   }
 
   Entity& getEntity(const EntityId eid) {
@@ -691,6 +2085,171 @@ class Registry {
   }
 
  private:
+  // when an entity leaves an archetype, the last entity gets moved to patch
+  // the hole, here we update its bookkeeping and flag its new row as changed
+  void patchMovedEntity(Archetype* arch, const EntityMoveResult& moveResult) {
+    if (moveResult.entityGlobalIndex != EntityMoveResult::VOID_REQUEST) {
+      Entity& movedEntity = m_entities[moveResult.entityGlobalIndex];
+      movedEntity.localIndex = moveResult.destIdx;
+      arch->markRowChanged(moveResult.destIdx, m_version);
+    }
+  }
+
+  template <typename T>
+  SharedComponentStore& getSharedStore() {
+    static_assert(isSharedComponent<T>);
+    return getSharedStore({sizeof(T), MultiHash<T>::hash});
+  }
+
+  SharedComponentStore& getSharedStore(const ComponentTypeInfo& info) {
+    const auto found = m_sharedStores.find(info.hash);
+    if (found != m_sharedStores.end()) {
+      return found->second;
+    }
+    SharedComponentStore& store = m_sharedStores[info.hash];
+    store.info = info;
+    return store;
+  }
+
+  template <typename T>
+  const T& getSharedValue(const Archetype* arch) const {
+    const int sharedIdx =
+        arch->getSharedIndexFromHash(MultiHash<ComponentType<T>>::hash);
+    assert(sharedIdx != Archetype::INVALID_COMPONENT_INDEX);
+    const auto found = m_sharedStores.find(MultiHash<ComponentType<T>>::hash);
+    assert(found != m_sharedStores.end());
+    return *static_cast<const T*>(
+        found->second.get(arch->m_shared[sharedIdx].valueIndex));
+  }
+
+  // moves the entity to the archetype having the same components and the
+  // shared values currently in scratchShared
+  void moveToSharedPartition(Entity& e, Archetype* arch) {
+    uint16_t nextIdx = INVALID_ARCHETYPE;
+    Archetype* next = findArchetypeFromSignature(
+        arch->m_mask, arch->componentsHash, scratchShared, nextIdx);
+    assert(next != arch);
+
+    // same columns on both sides, the removal move copies all of them
+    EntityMoveResult moveResult = next->move(arch, e);
+    patchMovedEntity(arch, moveResult);
+    e.archetypeIndex = nextIdx;
+    next->markRowChanged(e.localIndex, m_version);
+    ++m_structuralChanges.archetypeMoves;
+  }
+
+  template <typename T>
+  SparseSet& getSparseSet() {
+    static_assert(isSparseComponent<T>);
+    return getSparseSet({sizeof(T), MultiHash<T>::hash});
+  }
+
+  SparseSet& getSparseSet(const ComponentTypeInfo& info) {
+    const auto found = m_sparseSets.find(info.hash);
+    if (found != m_sparseSets.end()) {
+      return found->second;
+    }
+    SparseSet& set = m_sparseSets[info.hash];
+    set.info = info;
+    return set;
+  }
+
+  [[nodiscard]] const SparseSet* findSparseSet(const size_t hash) const {
+    const auto found = m_sparseSets.find(hash);
+    return found != m_sparseSets.end() ? &found->second : nullptr;
+  }
+
+  template <typename T>
+  void pickSparseDriver(SparseSet*& driver, bool& missing) {
+    if constexpr (isSparseComponent<T>) {
+      const auto found = m_sparseSets.find(MultiHash<ComponentType<T>>::hash);
+      if (found == m_sparseSets.end()) {
+        missing = true;
+        return;
+      }
+      SparseSet* set = &found->second;
+      driver = ((driver == nullptr) || (set->count < driver->count)) ? set
+                                                                      : driver;
+    }
+  }
+
+  template <typename T>
+  bool hasForEachComponent(const Archetype* arch, const uint32_t entityIndex) {
+    if constexpr (isSparseComponent<T>) {
+      return findSparseSet(MultiHash<ComponentType<T>>::hash)
+          ->contains(entityIndex);
+    } else if constexpr (isSharedComponent<T>) {
+      return arch->m_sharedMask.test(getComponentTypeIndex<ComponentType<T>>());
+    } else {
+      return arch->hasComponent<ComponentType<T>>();
+    }
+  }
+
+  template <typename T>
+  T& accessForEachComponent(Archetype* arch, const Entity& e,
+                            const uint32_t entityIndex) {
+    markForEachRowChanged<T>(arch, e);
+    return readForEachComponent<T>(arch, e, entityIndex);
+  }
+
+  // only looks up the data, it does not touch the registry bookkeeping and can
+  // be called concurrently
+  template <typename T>
+  T& readForEachComponent(Archetype* arch, const Entity& e,
+                          const uint32_t entityIndex) {
+    if constexpr (isSparseComponent<T>) {
+      return *static_cast<T*>(
+          m_sparseSets.find(MultiHash<ComponentType<T>>::hash)
+              ->second.get(entityIndex));
+    } else if constexpr (isSharedComponent<T>) {
+      return getSharedValue<T>(arch);
+    } else {
+      return static_cast<T*>(
+          arch->getComponent<ComponentType<T>>()->data)[e.localIndex];
+    }
+  }
+
+  template <typename T>
+  void markForEachRowChanged(Archetype* arch, const Entity& e) {
+    if constexpr (isArchetypeComponent<T> && !std::is_const_v<T>) {
+      arch->markComponentRowChanged(
+          static_cast<uint32_t>(arch->getComponentIndex<ComponentType<T>>()),
+          e.localIndex, m_version);
+    }
+  }
+
+  template <typename T>
+  T* getForEachColumn(Archetype* arch) {
+    if constexpr (isSharedComponent<T>) {
+      return &getSharedValue<T>(arch);
+    } else {
+      return static_cast<T*>(arch->getComponent<ComponentType<T>>()->data);
+    }
+  }
+
+  template <typename T>
+  void markQueryWriteAccess(Archetype* arch) {
+    if constexpr (isArchetypeComponent<T> &&
+                  !std::is_const_v<typename std::remove_pointer<T>::type>) {
+      arch->markComponentChanged(
+          static_cast<uint32_t>(arch->getComponentIndex<ComponentType<T>>()),
+          m_version);
+    }
+  }
+
+  template <typename T>
+  void markQueryRangeWriteAccess(Archetype* arch, const uint32_t startChunk,
+                                 const uint32_t endChunk) {
+    if constexpr (!std::is_const_v<typename std::remove_pointer<T>::type>) {
+      const auto cmpIdx =
+          static_cast<uint32_t>(arch->getComponentIndex<ComponentType<T>>());
+      for (uint32_t c = startChunk; c < endChunk; ++c) {
+        arch->markComponentRowChanged(cmpIdx, c * Archetype::VERSION_CHUNK_SIZE,
+                                      m_version);
+      }
+    }
+  }
+
   // Every time we come across a concrete type, we generate the type info for
   // it, meaning the hash and the size of the type. Such that whenever we
   // encounter that type
@@ -702,122 +2261,191 @@ class Registry {
 
   template <typename T>
   void ensureTypeInfo() {
-    size_t id = MultiHash<T>::hash;
-    const auto found = m_componentTypeInfo.find(id);
-    if (found == m_componentTypeInfo.end()) {
-      // we need to add the type info
-      m_componentTypeInfo[id] = {sizeof(T), MultiHash<T>::hash};
+    const uint32_t typeIndex = getComponentTypeIndex<T>();
+    if ((typeIndex < m_componentTypeInfo.size()) &&
+        (m_componentTypeInfo[typeIndex].componentDataTypeSize != 0)) {
+      return;
     }
+    registerTypeInfo({sizeof(T), MultiHash<T>::hash});
+    m_componentNames[typeIndex] = rawComponentTypeName<T>();
   }
 
-  // given an array of archetypes we are going to find a matching archetype, if
-  // not potentially create one if requested
-  Archetype* findArchetypeFromIds(const std::vector<size_t>& requestedIds,
-                                  uint16_t& outIdx,
-                                  const bool createIfMissing = true) {
-    Archetype* next = nullptr;
-    uint16_t nextIdx = INVALID_ARCHETYPE;
-    uint16_t counter = 0;
-    for (auto* a : m_archetypes) {
-      if (a->componentCount != requestedIds.size()) {
-        ++counter;
-        continue;
-      }
-      bool found = true;
+  void registerTypeInfo(const ComponentTypeInfo& info) {
+    const uint32_t typeIndex = registerComponentTypeIndex(info.hash);
+    if (typeIndex >= m_componentTypeInfo.size()) {
+      m_componentTypeInfo.resize(typeIndex + 1, ComponentTypeInfo{0, 0});
+      m_componentNames.resize(typeIndex + 1, nullptr);
+    }
+    m_componentTypeInfo[typeIndex] = info;
+  }
 
-      // iterating the current components
-      for (const auto currId : requestedIds) {
-        found &= (a->getComponentIndexFromHash(currId) == -1) ? false : true;
+  // finds the archetype with exactly the given columns and shared values,
+  // creating it if missing and requested. componentsHash is the hash of the
+  // columns only, see Archetype::componentsHash
+  Archetype* findArchetypeFromSignature(
+      const ComponentMask& columns, const size_t componentsHash,
+      const std::vector<SharedComponentRef>& shared, uint16_t& outIdx,
+      const bool createIfMissing = true) {
+    const size_t hash = Archetype::computeHash(componentsHash, shared);
+    const auto found = m_archetypeToIndex.find(hash);
+    if (found != m_archetypeToIndex.end()) {
+      Archetype* arch = m_archetypes[found->second];
+      if ((arch->m_mask == columns) && arch->hasSharedComponents(shared)) {
+        outIdx = found->second;
+        return arch;
       }
-      if (found) {
-        next = a;
-        nextIdx = counter;
-        break;
+      // colliding archetypes are not in the map, they can only be found by
+      // scanning. No archetype can have this hash if it is not in the map
+      const size_t size = m_archetypes.size();
+      for (size_t i = 0; i < size; ++i) {
+        Archetype* candidate = m_archetypes[i];
+        if ((candidate->m_mask == columns) &&
+            candidate->hasSharedComponents(shared)) {
+          outIdx = static_cast<uint16_t>(i);
+          return candidate;
+        }
       }
-      ++counter;
     }
-    if ((next == nullptr) & createIfMissing) {
-      next = createArchetypeFromIds(requestedIds);
-      auto found = m_archetypeToIndex.find(next->hash);
-      assert(found != m_archetypeToIndex.end());
-      nextIdx = found->second;
+    if (!createIfMissing) {
+      outIdx = INVALID_ARCHETYPE;
+      return nullptr;
     }
-    assert(nextIdx != INVALID_ARCHETYPE);
-    outIdx = nextIdx;
-    return next;
+    Archetype* arch = createArchetypeFromSignature(columns, shared);
+    assert(arch->hash == hash);
+    outIdx = static_cast<uint16_t>(m_archetypes.size() - 1);
+    return arch;
   }
 
   // find an archetype given the concrete types
   template <typename... TYPES>
-  Archetype* findArchetype(const bool createIfMissing = true) {
-    const size_t id = MultiHash<TYPES...>::hash;
-    auto found = m_archetypeToIndex.find(id);
-    if (found != m_archetypeToIndex.end()) {
-      return m_archetypes[found->second];
-    }
-    if (createIfMissing) {
-      m_archetypeToIndex[id] = static_cast<uint16_t>(m_archetypes.size());
-      auto* arch = new Archetype();
-      arch->create<TYPES...>();
-      m_archetypes.emplace_back(arch);
-      return arch;
-    }
-    return nullptr;
+  Archetype* findArchetype(uint16_t& outIdx,
+                           const bool createIfMissing = true) {
+    scratchShared.clear();
+    return findArchetypeFromSignature(
+        getComponentMask<ComponentStorage::ARCHETYPE, TYPES...>(),
+        componentsHash<TYPES...>(), scratchShared, outIdx, createIfMissing);
   }
 
+  // the storage is set up by the archetype the component ends up in
   static Component createComponent(const ComponentTypeInfo& info) {
     return Component{
-        new char[info.componentDataTypeSize * Archetype::INITIAL_SIZE],
-        {info.componentDataTypeSize, info.hash}};
+        nullptr, {info.componentDataTypeSize, info.hash}, nullptr, 0};
   }
 
-  // This function creates an archetype completely from type ids.
-  Archetype* createArchetypeFromIds(const std::vector<size_t>& ids) {
-    // allocating memory for the component array
+  // creates an archetype from its signature, the columns are laid out by
+  // type index. All the types need to be registered already
+  Archetype* createArchetypeFromSignature(
+      const ComponentMask& columns,
+      const std::vector<SharedComponentRef>& shared) {
+    uint32_t count = 0;
+    columns.forEachSet([&count](uint32_t) { ++count; });
     // memory will be of ownership of the archetypes
-    auto* cmps = new Component[ids.size()];
-    int counter = 0;
-    for (const auto cmpId : ids) {
-      auto found = m_componentTypeInfo.find(cmpId);
-      assert(found != m_componentTypeInfo.end());
-      const ComponentTypeInfo& info = found->second;
+    auto* cmps = new Component[count];
+    uint32_t counter = 0;
+    columns.forEachSet([&](const uint32_t typeIndex) {
+      assert(typeIndex < m_componentTypeInfo.size());
+      const ComponentTypeInfo& info = m_componentTypeInfo[typeIndex];
+      assert(info.componentDataTypeSize != 0);
       cmps[counter++] = createComponent(info);
-    }
-    auto* arch = new Archetype();
-    arch->createFromComponents(cmps, ids.size());
-    m_archetypeToIndex[arch->hash] = static_cast<uint16_t>(m_archetypes.size());
+    });
+    return addArchetype(cmps, count, shared.data(),
+                        static_cast<uint32_t>(shared.size()));
+  }
+
+  Archetype* addArchetype(Component* cmps, const uint32_t count,
+                          const SharedComponentRef* shared,
+                          const uint32_t sharedCount) {
+    assert(m_archetypes.size() < INVALID_ARCHETYPE);
+    auto* arch = new Archetype(m_allocator);
+    arch->createFromComponents(cmps, count);
+    // shared values are part of the identity, each partition gets its hash
+    arch->setSharedComponents(shared, sharedCount);
+    // on a hash collision the first archetype keeps the slot
+    m_archetypeToIndex.emplace(arch->hash,
+                               static_cast<uint16_t>(m_archetypes.size()));
     m_archetypes.push_back(arch);
+    ++m_structuralChanges.createdArchetypes;
     return arch;
   }
 
+  static uint16_t nextEntityVersion(const uint16_t version) {
+    // zero is skipped such that a zero initialized EntityId is never valid
+    return version == static_cast<uint16_t>(-1) ? ENTITY_STARTING_VERSION
+                                                : version + 1;
+  }
+
+  // The free list is intrusive, a dead entity stores the index of the next
+  // free entity in its localIndex, no extra memory is needed. It is a FIFO,
+  // a freed slot goes to the back of the queue, this spreads the version
+  // bumps over all the free slots and pushes back as much as possible the
+  // moment a version wraps around and an old id could alias a new one
+  void pushFreeEntity(const uint32_t index) {
+    m_entities[index].localIndex = INVALID_ENTITY_INDEX;
+    if (m_freeTail == INVALID_ENTITY_INDEX) {
+      m_freeHead = index;
+    } else {
+      m_entities[m_freeTail].localIndex = index;
+    }
+    m_freeTail = index;
+    ++m_freeCount;
+  }
+
   size_t getNewEntityId() {
     // first we check whether or not we have a free entity in the free list
-    if (m_freeEntities.empty()) {
+    if (m_freeHead == INVALID_ENTITY_INDEX) {
+      assert(m_entities.size() < INVALID_ENTITY_INDEX);
       size_t toReturn = m_entities.size();
       m_entities.emplace_back(
           Entity{0, INVALID_ARCHETYPE,
                  static_cast<uint16_t>(ENTITY_STARTING_VERSION)});
       return toReturn;
     }
-    // if here we recycle a free entity
-    size_t toReturn = m_freeEntities[m_freeEntities.size() - 1];
-    assert(m_entities[toReturn].archetypeIndex == INVALID_ARCHETYPE);
-    // important: here the version gets updated this will invalidate any stale
-    // EntityId out there
-    ++m_entities[toReturn].version;
-    m_freeEntities.pop_back();
+    // if here we recycle a free entity, the version was already bumped when
+    // the entity got deleted
+    const uint32_t toReturn = m_freeHead;
+    Entity& e = m_entities[toReturn];
+    assert(e.archetypeIndex == INVALID_ARCHETYPE);
+    m_freeHead = e.localIndex;
+    if (m_freeHead == INVALID_ENTITY_INDEX) {
+      m_freeTail = INVALID_ENTITY_INDEX;
+    }
+    --m_freeCount;
     return toReturn;
   }
 
  private:
-  static constexpr uint16_t INVALID_ARCHETYPE = static_cast<uint16_t>(-1);
   static constexpr uint16_t ENTITY_STARTING_VERSION = 1;
+  static constexpr uint32_t REGISTRY_STARTING_VERSION = 1;
+
+  // a range of rows of an archetype processed by a single worker
+  struct ParallelBatch {
+    uint32_t archetypeIndex;
+    uint32_t start;
+    uint32_t end;
+  };
 
-  std::vector<size_t> scratchIds;
+  std::vector<SharedComponentRef> scratchShared;
+  ArchetypeAllocator* m_allocator;
   std::vector<Archetype*> m_archetypes;
+  // scratch storage for parallelForEach, kept around to avoid allocations
+  std::vector<ParallelBatch> m_parallelBatches;
+  std::vector<uint32_t> m_parallelEntities;
   std::vector<Entity> m_entities;
+  // archetype hash to index, the signature still needs to be checked on a hit
   std::unordered_map<size_t, uint16_t> m_archetypeToIndex;
-  std::unordered_map<size_t, ComponentTypeInfo> m_componentTypeInfo;
-  std::vector<size_t> m_freeEntities;
+  // indexed by component type index
+  std::vector<ComponentTypeInfo> m_componentTypeInfo;
+  std::vector<const char*> m_componentNames;
+  // ends of the intrusive free list, see pushFreeEntity()
+  uint32_t m_freeHead = INVALID_ENTITY_INDEX;
+  uint32_t m_freeTail = INVALID_ENTITY_INDEX;
+  uint32_t m_freeCount = 0;
+  // node based map, sparse sets never move once created
+  std::unordered_map<size_t, SparseSet> m_sparseSets;
+  std::unordered_map<size_t, SharedComponentStore> m_sharedStores;
+  std::unordered_map<size_t, SingletonComponent> m_singletons;
+  // current version stamped on every write, see advanceVersion()
+  uint32_t m_version = REGISTRY_STARTING_VERSION;
+  StructuralChangeCounters m_structuralChanges;
 };
 }  // namespace SirEngine::ecs
\ No newline at end of file
@@ -0,0 +1,686 @@
+#include "SirEngine/ecs/ecsSnapshot.h"
+
+#include "SirEngine/ecs/ecs.h"
+#include "SirEngine/io/binaryFile.h"
+#include "SirEngine/log.h"
+
+namespace SirEngine::ecs {
+
+static constexpr uint32_t SNAPSHOT_VERSION = 4;
+// raw blocks get aligned such that once loaded in memory they can be read
+// in place by SIMD code if needed
+static constexpr uint64_t SNAPSHOT_BLOCK_ALIGNMENT = 16;
+
+struct SnapshotComponentType {
+  uint64_t hash;
+  uint64_t sizeInByte;
+};
+
+struct SnapshotArchetype {
+  uint64_t hash;
+  // index of the first column of the archetype in the column table, the
+  // archetype owns componentCount contiguous columns
+  uint32_t firstColumn;
+  uint32_t componentCount;
+  uint32_t entityCount;
+  // same as the columns, the archetype owns sharedCount contiguous shared
+  // refs starting at firstShared
+  uint32_t sharedCount;
+  uint32_t firstShared;
+  uint32_t padding;
+  // raw block of uint64_t global entity indices, one per entity
+  uint64_t entityIndicesOffset;
+};
+
+struct SnapshotColumn {
+  uint32_t componentType;
+  uint32_t padding;
+  uint64_t dataOffset;
+};
+
+struct SnapshotSparseSet {
+  uint32_t componentType;
+  uint32_t count;
+  // raw block of uint32_t global entity indices, in dense order
+  uint64_t entityIndicesOffset;
+  uint64_t dataOffset;
+};
+
+struct SnapshotSharedRef {
+  uint32_t componentType;
+  uint32_t valueIndex;
+};
+
+// all the unique values of a shared component type, in value index order
+struct SnapshotSharedStore {
+  uint32_t componentType;
+  uint32_t count;
+  uint64_t dataOffset;
+};
+
+struct SnapshotSingleton {
+  uint32_t componentType;
+  uint32_t padding;
+  uint64_t dataOffset;
+};
+
+static uint64_t alignOffset(const uint64_t offset) {
+  return (offset + SNAPSHOT_BLOCK_ALIGNMENT - 1) &
+         ~(SNAPSHOT_BLOCK_ALIGNMENT - 1);
+}
+
+static uint32_t findComponentType(
+    const std::vector<SnapshotComponentType> &types, const size_t hash) {
+  const auto count = static_cast<uint32_t>(types.size());
+  for (uint32_t i = 0; i < count; ++i) {
+    if (types[i].hash == hash) {
+      return i;
+    }
+  }
+  return count;
+}
+
+static uint32_t addComponentType(std::vector<SnapshotComponentType> &types,
+                                 const ComponentTypeInfo &info) {
+  const uint32_t typeIdx = findComponentType(types, info.hash);
+  if (typeIdx == types.size()) {
+    types.push_back({info.hash, info.componentDataTypeSize});
+  }
+  return typeIdx;
+}
+
+static ComponentTypeInfo toTypeInfo(const SnapshotComponentType &type) {
+  return {static_cast<size_t>(type.sizeInByte),
+          static_cast<size_t>(type.hash)};
+}
+
+template <typename T>
+static void copyTable(char *outPtr, const uint64_t offset,
+                      const std::vector<T> &table) {
+  if (!table.empty()) {
+    memcpy(outPtr + offset, table.data(), table.size() * sizeof(T));
+  }
+}
+
+static void buildSnapshotBulkData(const Registry &registry,
+                                  std::vector<char> &bulk,
+                                  EcsSnapshotMapperData &mapper) {
+  const uint32_t archetypeCount = registry.getArchetypeCount();
+
+  // first pass, we gather the tables, this is only bookkeeping
+  std::vector<SnapshotComponentType> types;
+  // shared stores first, archetypes refer to their types
+  std::vector<SnapshotSharedStore> sharedStores;
+  std::vector<const SharedComponentStore *> sharedSources;
+  for (const auto &entry : registry.getSharedStores()) {
+    const SharedComponentStore &store = entry.second;
+    sharedStores.push_back({addComponentType(types, store.info), store.count, 0});
+    sharedSources.push_back(&store);
+  }
+
+  std::vector<SnapshotArchetype> archetypes(archetypeCount);
+  std::vector<SnapshotColumn> columns;
+  std::vector<SnapshotSharedRef> sharedRefs;
+  for (uint32_t a = 0; a < archetypeCount; ++a) {
+    const Archetype *arch = registry.getArchetype(a);
+    SnapshotArchetype &outArch = archetypes[a];
+    outArch.hash = arch->hash;
+    outArch.firstColumn = static_cast<uint32_t>(columns.size());
+    outArch.componentCount = arch->componentCount;
+    outArch.entityCount = arch->entityCount;
+    outArch.sharedCount = static_cast<uint32_t>(arch->m_shared.size());
+    outArch.firstShared = static_cast<uint32_t>(sharedRefs.size());
+    outArch.padding = 0;
+    for (uint32_t c = 0; c < arch->componentCount; ++c) {
+      columns.push_back(
+          {addComponentType(types, arch->m_components[c].info), 0, 0});
+    }
+    for (const SharedComponentRef &ref : arch->m_shared) {
+      const uint32_t typeIdx = findComponentType(types, ref.hash);
+      assert(typeIdx != types.size());
+      sharedRefs.push_back({typeIdx, ref.valueIndex});
+    }
+  }
+
+  std::vector<SnapshotSparseSet> sparseSets;
+  std::vector<const SparseSet *> sparseSources;
+  for (const auto &entry : registry.getSparseSets()) {
+    const SparseSet &set = entry.second;
+    sparseSets.push_back({addComponentType(types, set.info), set.count, 0, 0});
+    sparseSources.push_back(&set);
+  }
+
+  std::vector<SnapshotSingleton> singletons;
+  std::vector<const SingletonComponent *> singletonSources;
+  for (const auto &entry : registry.getSingletons()) {
+    const SingletonComponent &singleton = entry.second;
+    singletons.push_back({addComponentType(types, singleton.info), 0, 0});
+    singletonSources.push_back(&singleton);
+  }
+
+  const std::vector<Entity> &entities = registry.getEntities();
+
+  // computing the layout of the bulk data, tables first then raw blocks
+  mapper.componentTypeCount = static_cast<uint32_t>(types.size());
+  mapper.archetypeCount = archetypeCount;
+  mapper.columnCount = static_cast<uint32_t>(columns.size());
+  mapper.entityCount = static_cast<uint32_t>(entities.size());
+  mapper.freeListHead = registry.getFreeListHead();
+  mapper.freeListTail = registry.getFreeListTail();
+  mapper.padding = 0;
+  mapper.sparseSetCount = static_cast<uint32_t>(sparseSets.size());
+  mapper.sharedStoreCount = static_cast<uint32_t>(sharedStores.size());
+  mapper.sharedRefCount = static_cast<uint32_t>(sharedRefs.size());
+  mapper.singletonCount = static_cast<uint32_t>(singletons.size());
+  mapper.padding2 = 0;
+  uint64_t offset = 0;
+  mapper.componentTypesOffset = offset;
+  offset = alignOffset(offset + types.size() * sizeof(SnapshotComponentType));
+  mapper.archetypesOffset = offset;
+  offset = alignOffset(offset + archetypes.size() * sizeof(SnapshotArchetype));
+  mapper.columnsOffset = offset;
+  offset = alignOffset(offset + columns.size() * sizeof(SnapshotColumn));
+  mapper.entitiesOffset = offset;
+  offset = alignOffset(offset + entities.size() * sizeof(Entity));
+  mapper.sparseSetsOffset = offset;
+  offset = alignOffset(offset + sparseSets.size() * sizeof(SnapshotSparseSet));
+  mapper.sharedStoresOffset = offset;
+  offset =
+      alignOffset(offset + sharedStores.size() * sizeof(SnapshotSharedStore));
+  mapper.sharedRefsOffset = offset;
+  offset = alignOffset(offset + sharedRefs.size() * sizeof(SnapshotSharedRef));
+  mapper.singletonsOffset = offset;
+  offset = alignOffset(offset + singletons.size() * sizeof(SnapshotSingleton));
+
+  for (uint32_t a = 0; a < archetypeCount; ++a) {
+    const Archetype *arch = registry.getArchetype(a);
+    SnapshotArchetype &outArch = archetypes[a];
+    outArch.entityIndicesOffset = offset;
+    offset = alignOffset(offset + arch->entityCount * sizeof(uint64_t));
+    for (uint32_t c = 0; c < arch->componentCount; ++c) {
+      columns[outArch.firstColumn + c].dataOffset = offset;
+      offset = alignOffset(
+          offset + arch->entityCount *
+                       arch->m_components[c].info.componentDataTypeSize);
+    }
+  }
+
+  for (size_t i = 0; i < sparseSets.size(); ++i) {
+    SnapshotSparseSet &outSet = sparseSets[i];
+    outSet.entityIndicesOffset = offset;
+    offset = alignOffset(offset + outSet.count * sizeof(uint32_t));
+    outSet.dataOffset = offset;
+    offset = alignOffset(offset + outSet.count *
+                                      sparseSources[i]->info.componentDataTypeSize);
+  }
+  for (size_t i = 0; i < sharedStores.size(); ++i) {
+    sharedStores[i].dataOffset = offset;
+    offset = alignOffset(offset + sharedSources[i]->values.size());
+  }
+  for (size_t i = 0; i < singletons.size(); ++i) {
+    singletons[i].dataOffset = offset;
+    offset = alignOffset(offset + singletonSources[i]->data.size());
+  }
+
+  // second pass, actual copy of the data
+  bulk.resize(offset);
+  char *outPtr = bulk.data();
+  memset(outPtr, 0, offset);
+  copyTable(outPtr, mapper.componentTypesOffset, types);
+  copyTable(outPtr, mapper.archetypesOffset, archetypes);
+  copyTable(outPtr, mapper.columnsOffset, columns);
+  copyTable(outPtr, mapper.entitiesOffset, entities);
+  copyTable(outPtr, mapper.sparseSetsOffset, sparseSets);
+  copyTable(outPtr, mapper.sharedStoresOffset, sharedStores);
+  copyTable(outPtr, mapper.sharedRefsOffset, sharedRefs);
+  copyTable(outPtr, mapper.singletonsOffset, singletons);
+  for (size_t i = 0; i < sharedStores.size(); ++i) {
+    copyTable(outPtr, sharedStores[i].dataOffset, sharedSources[i]->values);
+  }
+  for (size_t i = 0; i < singletons.size(); ++i) {
+    copyTable(outPtr, singletons[i].dataOffset, singletonSources[i]->data);
+  }
+  for (size_t i = 0; i < sparseSets.size(); ++i) {
+    const SparseSet &set = *sparseSources[i];
+    memcpy(outPtr + sparseSets[i].entityIndicesOffset, set.denseEntities.data(),
+           set.count * sizeof(uint32_t));
+    memcpy(outPtr + sparseSets[i].dataOffset, set.data.data(),
+           set.count * set.info.componentDataTypeSize);
+  }
+
+  for (uint32_t a = 0; a < archetypeCount; ++a) {
+    const Archetype *arch = registry.getArchetype(a);
+    const SnapshotArchetype &outArch = archetypes[a];
+    auto *outIndices =
+        reinterpret_cast<uint64_t *>(outPtr + outArch.entityIndicesOffset);
+    for (uint32_t e = 0; e < arch->entityCount; ++e) {
+      outIndices[e] = arch->m_entitieIndexes[e];
+    }
+    for (uint32_t c = 0; c < arch->componentCount; ++c) {
+      const Component &cmp = arch->m_components[c];
+      memcpy(outPtr + columns[outArch.firstColumn + c].dataOffset, cmp.data,
+             arch->entityCount * cmp.info.componentDataTypeSize);
+    }
+  }
+}
+
+void serializeRegistrySnapshot(const Registry &registry,
+                               std::vector<char> &outData) {
+  std::vector<char> bulk;
+  EcsSnapshotMapperData mapper{};
+  buildSnapshotBulkData(registry, bulk, mapper);
+
+  BinaryFileHeader header;
+  header.fileType = BinaryFileType::ECS_SNAPSHOT;
+  header.version = SNAPSHOT_VERSION;
+  header.mapperDataOffsetInByte = sizeof(BinaryFileHeader) + bulk.size();
+
+  outData.resize(sizeof(BinaryFileHeader) + bulk.size() +
+                 sizeof(EcsSnapshotMapperData));
+  char *outPtr = outData.data();
+  memcpy(outPtr, &header, sizeof(BinaryFileHeader));
+  memcpy(outPtr + sizeof(BinaryFileHeader), bulk.data(), bulk.size());
+  memcpy(outPtr + header.mapperDataOffsetInByte, &mapper,
+         sizeof(EcsSnapshotMapperData));
+}
+
+bool writeRegistrySnapshot(const Registry &registry, const char *outPath) {
+  std::vector<char> bulk;
+  EcsSnapshotMapperData mapper{};
+  buildSnapshotBulkData(registry, bulk, mapper);
+
+  BinaryFileWriteRequest request;
+  request.outPath = outPath;
+  request.fileType = BinaryFileType::ECS_SNAPSHOT;
+  request.version = SNAPSHOT_VERSION;
+  request.bulkData = bulk.data();
+  request.bulkDataSizeInByte = bulk.size();
+  request.mapperData = &mapper;
+  request.mapperDataSizeInByte = sizeof(EcsSnapshotMapperData);
+  return writeBinaryFile(request) == WriteBinaryFileStatus::SUCCESS;
+}
+
+// true if count elements of elementSize starting at offset end inside the
+// bulk data, written such that nothing read from the file can overflow
+static bool sectionFits(const uint64_t offset, const uint64_t count,
+                        const uint64_t elementSize, const uint64_t bulkSize) {
+  if (offset > bulkSize) {
+    return false;
+  }
+  return elementSize == 0 || count <= (bulkSize - offset) / elementSize;
+}
+
+// the free list is stored in the dead entities, it needs to go through all of
+// them exactly once from head to tail, getNewEntityId follows it blindly
+static bool validateFreeList(const Entity *entities,
+                             const EcsSnapshotMapperData *mapper) {
+  const uint32_t invalid = Registry::INVALID_ENTITY_INDEX;
+  const uint32_t head = mapper->freeListHead;
+  const uint32_t tail = mapper->freeListTail;
+  if (((head == invalid) != (tail == invalid)) ||
+      ((head != invalid) && (head >= mapper->entityCount)) ||
+      ((tail != invalid) && (tail >= mapper->entityCount))) {
+    return false;
+  }
+  uint32_t deadCount = 0;
+  for (uint32_t i = 0; i < mapper->entityCount; ++i) {
+    deadCount += entities[i].archetypeIndex == Registry::INVALID_ARCHETYPE;
+  }
+  // walking at most deadCount steps, a cycle never reaches the end
+  uint32_t visited = 0;
+  uint32_t last = invalid;
+  for (uint32_t index = head; index != invalid;
+       index = entities[index].localIndex) {
+    if ((index >= mapper->entityCount) || (visited == deadCount) ||
+        (entities[index].archetypeIndex != Registry::INVALID_ARCHETYPE)) {
+      return false;
+    }
+    ++visited;
+    last = index;
+  }
+  return (visited == deadCount) && (last == tail);
+}
+
+// everything restoring reads gets checked before the registry is touched, a
+// truncated or corrupted snapshot is rejected instead of read out of bounds
+static bool validateSnapshot(const Registry &registry, const char *bulk,
+                             const uint64_t bulkSize,
+                             const EcsSnapshotMapperData *mapper) {
+  // archetype indices are stored in 16 bits, the invalid one included
+  if (mapper->archetypeCount > Registry::INVALID_ARCHETYPE) {
+    SE_CORE_ERROR("Corrupted ecs snapshot, {0} archetypes, at most {1}",
+                  mapper->archetypeCount, Registry::INVALID_ARCHETYPE);
+    return false;
+  }
+  const bool tablesFit =
+      sectionFits(mapper->componentTypesOffset, mapper->componentTypeCount,
+                  sizeof(SnapshotComponentType), bulkSize) &&
+      sectionFits(mapper->archetypesOffset, mapper->archetypeCount,
+                  sizeof(SnapshotArchetype), bulkSize) &&
+      sectionFits(mapper->columnsOffset, mapper->columnCount,
+                  sizeof(SnapshotColumn), bulkSize) &&
+      sectionFits(mapper->entitiesOffset, mapper->entityCount, sizeof(Entity),
+                  bulkSize) &&
+      sectionFits(mapper->sparseSetsOffset, mapper->sparseSetCount,
+                  sizeof(SnapshotSparseSet), bulkSize) &&
+      sectionFits(mapper->sharedStoresOffset, mapper->sharedStoreCount,
+                  sizeof(SnapshotSharedStore), bulkSize) &&
+      sectionFits(mapper->sharedRefsOffset, mapper->sharedRefCount,
+                  sizeof(SnapshotSharedRef), bulkSize) &&
+      sectionFits(mapper->singletonsOffset, mapper->singletonCount,
+                  sizeof(SnapshotSingleton), bulkSize);
+  if (!tablesFit) {
+    SE_CORE_ERROR("Corrupted ecs snapshot, a table ends past the data");
+    return false;
+  }
+
+  const auto *types = reinterpret_cast<const SnapshotComponentType *>(
+      bulk + mapper->componentTypesOffset);
+  const uint32_t typeCount = mapper->componentTypeCount;
+
+  // restoring registers the types, a known type needs to keep its size or the
+  // typed access would read the restored data with the wrong layout
+  const std::vector<ComponentTypeInfo> &registered =
+      registry.getComponentTypeInfos();
+  for (uint32_t i = 0; i < typeCount; ++i) {
+    const SnapshotComponentType &type = types[i];
+    bool duplicated = false;
+    for (uint32_t j = 0; j < i; ++j) {
+      duplicated |= types[j].hash == type.hash;
+    }
+    if ((type.sizeInByte == 0) | duplicated) {
+      SE_CORE_ERROR("Corrupted ecs snapshot, bad component type {0}", i);
+      return false;
+    }
+    const uint32_t typeIndex =
+        findComponentTypeIndex(static_cast<size_t>(type.hash));
+    if ((typeIndex < registered.size()) &&
+        (registered[typeIndex].componentDataTypeSize != 0) &&
+        (registered[typeIndex].componentDataTypeSize != type.sizeInByte)) {
+      SE_CORE_ERROR(
+          "Ecs snapshot component type {0} has a size of {1} bytes, {2} "
+          "registered",
+          type.hash, type.sizeInByte,
+          registered[typeIndex].componentDataTypeSize);
+      return false;
+    }
+  }
+
+  const auto *sharedStores = reinterpret_cast<const SnapshotSharedStore *>(
+      bulk + mapper->sharedStoresOffset);
+  for (uint32_t i = 0; i < mapper->sharedStoreCount; ++i) {
+    const SnapshotSharedStore &store = sharedStores[i];
+    if (store.componentType >= typeCount ||
+        !sectionFits(store.dataOffset, store.count,
+                     types[store.componentType].sizeInByte, bulkSize)) {
+      SE_CORE_ERROR("Corrupted ecs snapshot, bad shared store {0}", i);
+      return false;
+    }
+    for (uint32_t j = 0; j < i; ++j) {
+      if (sharedStores[j].componentType == store.componentType) {
+        SE_CORE_ERROR("Corrupted ecs snapshot, duplicated shared store {0}",
+                      i);
+        return false;
+      }
+    }
+  }
+
+  const auto *archetypes = reinterpret_cast<const SnapshotArchetype *>(
+      bulk + mapper->archetypesOffset);
+  const auto *columns =
+      reinterpret_cast<const SnapshotColumn *>(bulk + mapper->columnsOffset);
+  const auto *sharedRefs = reinterpret_cast<const SnapshotSharedRef *>(
+      bulk + mapper->sharedRefsOffset);
+  for (uint32_t a = 0; a < mapper->archetypeCount; ++a) {
+    const SnapshotArchetype &arch = archetypes[a];
+    const bool rangesFit =
+        static_cast<uint64_t>(arch.firstColumn) + arch.componentCount <=
+            mapper->columnCount &&
+        static_cast<uint64_t>(arch.firstShared) + arch.sharedCount <=
+            mapper->sharedRefCount &&
+        sectionFits(arch.entityIndicesOffset, arch.entityCount,
+                    sizeof(uint64_t), bulkSize);
+    if (!rangesFit) {
+      SE_CORE_ERROR("Corrupted ecs snapshot, bad archetype {0}", a);
+      return false;
+    }
+    const auto *indices =
+        reinterpret_cast<const uint64_t *>(bulk + arch.entityIndicesOffset);
+    for (uint32_t e = 0; e < arch.entityCount; ++e) {
+      if (indices[e] >= mapper->entityCount) {
+        SE_CORE_ERROR("Corrupted ecs snapshot, bad entity in archetype {0}",
+                      a);
+        return false;
+      }
+    }
+    for (uint32_t c = 0; c < arch.componentCount; ++c) {
+      const SnapshotColumn &column = columns[arch.firstColumn + c];
+      if (column.componentType >= typeCount ||
+          !sectionFits(column.dataOffset, arch.entityCount,
+                       types[column.componentType].sizeInByte, bulkSize)) {
+        SE_CORE_ERROR("Corrupted ecs snapshot, bad column in archetype {0}",
+                      a);
+        return false;
+      }
+    }
+    for (uint32_t r = 0; r < arch.sharedCount; ++r) {
+      // the value needs to exist in the store of its type
+      const SnapshotSharedRef &ref = sharedRefs[arch.firstShared + r];
+      bool found = false;
+      for (uint32_t i = 0; i < mapper->sharedStoreCount; ++i) {
+        found |= (sharedStores[i].componentType == ref.componentType) &&
+                 (ref.valueIndex < sharedStores[i].count);
+      }
+      if (!found) {
+        SE_CORE_ERROR("Corrupted ecs snapshot, bad shared ref in archetype {0}",
+                      a);
+        return false;
+      }
+    }
+  }
+
+  // live entities point to a row of their archetype
+  const auto *entities =
+      reinterpret_cast<const Entity *>(bulk + mapper->entitiesOffset);
+  for (uint32_t i = 0; i < mapper->entityCount; ++i) {
+    const Entity &e = entities[i];
+    if (e.archetypeIndex == Registry::INVALID_ARCHETYPE) {
+      continue;
+    }
+    if (e.archetypeIndex >= mapper->archetypeCount ||
+        e.localIndex >= archetypes[e.archetypeIndex].entityCount) {
+      SE_CORE_ERROR("Corrupted ecs snapshot, bad entity {0}", i);
+      return false;
+    }
+  }
+  if (!validateFreeList(entities, mapper)) {
+    SE_CORE_ERROR("Corrupted ecs snapshot, bad entity free list");
+    return false;
+  }
+
+  const auto *sparseSets = reinterpret_cast<const SnapshotSparseSet *>(
+      bulk + mapper->sparseSetsOffset);
+  for (uint32_t i = 0; i < mapper->sparseSetCount; ++i) {
+    const SnapshotSparseSet &set = sparseSets[i];
+    if (set.componentType >= typeCount ||
+        !sectionFits(set.entityIndicesOffset, set.count, sizeof(uint32_t),
+                     bulkSize) ||
+        !sectionFits(set.dataOffset, set.count,
+                     types[set.componentType].sizeInByte, bulkSize)) {
+      SE_CORE_ERROR("Corrupted ecs snapshot, bad sparse set {0}", i);
+      return false;
+    }
+    for (uint32_t j = 0; j < i; ++j) {
+      if (sparseSets[j].componentType == set.componentType) {
+        SE_CORE_ERROR("Corrupted ecs snapshot, duplicated sparse set {0}", i);
+        return false;
+      }
+    }
+    const auto *indices =
+        reinterpret_cast<const uint32_t *>(bulk + set.entityIndicesOffset);
+    for (uint32_t e = 0; e < set.count; ++e) {
+      if (indices[e] >= mapper->entityCount) {
+        SE_CORE_ERROR("Corrupted ecs snapshot, bad entity in sparse set {0}",
+                      i);
+        return false;
+      }
+    }
+  }
+
+  const auto *singletons = reinterpret_cast<const SnapshotSingleton *>(
+      bulk + mapper->singletonsOffset);
+  for (uint32_t i = 0; i < mapper->singletonCount; ++i) {
+    const SnapshotSingleton &singleton = singletons[i];
+    if (singleton.componentType >= typeCount ||
+        !sectionFits(singleton.dataOffset, 1,
+                     types[singleton.componentType].sizeInByte, bulkSize)) {
+      SE_CORE_ERROR("Corrupted ecs snapshot, bad singleton {0}", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool restoreRegistrySnapshot(Registry &registry, const void *binaryData,
+                             const uint64_t sizeInByte) {
+  if (sizeInByte < sizeof(BinaryFileHeader)) {
+    SE_CORE_ERROR("Ecs snapshot too small to hold a header: {0} bytes",
+                  sizeInByte);
+    return false;
+  }
+  const BinaryFileHeader *header = getHeader(binaryData);
+  if (header->fileType != BinaryFileType::ECS_SNAPSHOT) {
+    SE_CORE_ERROR(
+        "Expected ecs snapshot binary file but got {0}",
+        getBinaryFileTypeName(static_cast<BinaryFileType>(header->fileType)));
+    return false;
+  }
+  if (header->version != SNAPSHOT_VERSION) {
+    SE_CORE_ERROR("Unsupported ecs snapshot version {0}, expected {1}",
+                  header->version, SNAPSHOT_VERSION);
+    return false;
+  }
+
+  // the mapper data follows the bulk data
+  if (header->mapperDataOffsetInByte < sizeof(BinaryFileHeader) ||
+      header->mapperDataOffsetInByte > sizeInByte ||
+      sizeInByte - header->mapperDataOffsetInByte <
+          sizeof(EcsSnapshotMapperData)) {
+    SE_CORE_ERROR("Truncated ecs snapshot, {0} bytes", sizeInByte);
+    return false;
+  }
+  const auto *mapper = getMapperData<EcsSnapshotMapperData>(binaryData);
+  const char *bulk =
+      reinterpret_cast<const char *>(binaryData) + sizeof(BinaryFileHeader);
+  const uint64_t bulkSize =
+      header->mapperDataOffsetInByte - sizeof(BinaryFileHeader);
+  if (!validateSnapshot(registry, bulk, bulkSize, mapper)) {
+    return false;
+  }
+  const auto *types = reinterpret_cast<const SnapshotComponentType *>(
+      bulk + mapper->componentTypesOffset);
+  const auto *archetypes = reinterpret_cast<const SnapshotArchetype *>(
+      bulk + mapper->archetypesOffset);
+  const auto *columns =
+      reinterpret_cast<const SnapshotColumn *>(bulk + mapper->columnsOffset);
+
+  const auto *sharedStores = reinterpret_cast<const SnapshotSharedStore *>(
+      bulk + mapper->sharedStoresOffset);
+  const auto *sharedRefs = reinterpret_cast<const SnapshotSharedRef *>(
+      bulk + mapper->sharedRefsOffset);
+
+  registry.clear();
+  const uint32_t version = registry.getVersion();
+
+  // shared values keep their index, archetype refs stay valid
+  for (uint32_t i = 0; i < mapper->sharedStoreCount; ++i) {
+    const SnapshotSharedStore &inStore = sharedStores[i];
+    const SnapshotComponentType &type = types[inStore.componentType];
+    SharedComponentStore *store =
+        registry.createSharedStoreFromTypeInfo(toTypeInfo(type));
+    const char *inData = bulk + inStore.dataOffset;
+    store->count = inStore.count;
+    store->values.assign(inData, inData + inStore.count * type.sizeInByte);
+  }
+
+  std::vector<ComponentTypeInfo> infos;
+  std::vector<SharedComponentRef> shared;
+  for (uint32_t a = 0; a < mapper->archetypeCount; ++a) {
+    const SnapshotArchetype &inArch = archetypes[a];
+    infos.clear();
+    for (uint32_t c = 0; c < inArch.componentCount; ++c) {
+      infos.push_back(
+          toTypeInfo(types[columns[inArch.firstColumn + c].componentType]));
+    }
+    shared.clear();
+    for (uint32_t r = 0; r < inArch.sharedCount; ++r) {
+      const SnapshotSharedRef &ref = sharedRefs[inArch.firstShared + r];
+      shared.push_back({static_cast<size_t>(types[ref.componentType].hash),
+                        ref.valueIndex});
+    }
+
+    // archetypes get re-created in the same order, entities can keep
+    // referencing them by index
+    Archetype *arch = registry.createArchetypeFromTypeInfos(
+        infos.data(), inArch.componentCount, inArch.entityCount,
+        shared.data(), inArch.sharedCount);
+    arch->entityCount = inArch.entityCount;
+    const auto *inIndices =
+        reinterpret_cast<const uint64_t *>(bulk + inArch.entityIndicesOffset);
+    for (uint32_t e = 0; e < inArch.entityCount; ++e) {
+      arch->m_entitieIndexes[e] = static_cast<size_t>(inIndices[e]);
+    }
+    for (uint32_t c = 0; c < inArch.componentCount; ++c) {
+      Component &cmp = arch->m_components[c];
+      memcpy(cmp.data, bulk + columns[inArch.firstColumn + c].dataOffset,
+             inArch.entityCount * cmp.info.componentDataTypeSize);
+      // for anybody mirroring data, restored data is new data
+      arch->markComponentChanged(c, version);
+    }
+  }
+
+  const auto *entities =
+      reinterpret_cast<const Entity *>(bulk + mapper->entitiesOffset);
+  // the free list is stored inside the entities, only the ends are needed
+  registry.restoreEntities(entities, mapper->entityCount, mapper->freeListHead,
+                           mapper->freeListTail);
+
+  const auto *sparseSets = reinterpret_cast<const SnapshotSparseSet *>(
+      bulk + mapper->sparseSetsOffset);
+  for (uint32_t i = 0; i < mapper->sparseSetCount; ++i) {
+    const SnapshotSparseSet &inSet = sparseSets[i];
+    const SnapshotComponentType &type = types[inSet.componentType];
+    SparseSet *set =
+        registry.createSparseSetFromTypeInfo(toTypeInfo(type), inSet.count);
+    const auto *inIndices =
+        reinterpret_cast<const uint32_t *>(bulk + inSet.entityIndicesOffset);
+    const char *inData = bulk + inSet.dataOffset;
+    set->count = inSet.count;
+    set->data.assign(inData, inData + inSet.count * type.sizeInByte);
+    set->denseEntities.assign(inIndices, inIndices + inSet.count);
+    set->sparse.assign(mapper->entityCount, SparseSet::INVALID_INDEX);
+    for (uint32_t e = 0; e < inSet.count; ++e) {
+      set->sparse[inIndices[e]] = e;
+    }
+  }
+
+  const auto *singletons = reinterpret_cast<const SnapshotSingleton *>(
+      bulk + mapper->singletonsOffset);
+  for (uint32_t i = 0; i < mapper->singletonCount; ++i) {
+    registry.setSingletonFromTypeInfo(
+        toTypeInfo(types[singletons[i].componentType]),
+        bulk + singletons[i].dataOffset);
+  }
+  return true;
+}
+
+bool loadRegistrySnapshot(Registry &registry, const char *path) {
+  std::vector<char> binaryData;
+  if (!readAllBytes(path, binaryData)) {
+    return false;
+  }
+  return restoreRegistrySnapshot(registry, binaryData.data(),
+                                 binaryData.size());
+}
+
+}  // namespace SirEngine::ecs
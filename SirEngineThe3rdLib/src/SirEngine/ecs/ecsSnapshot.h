@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+#include <vector>
+
+namespace SirEngine::ecs {
+class Registry;
+
+/*
+A snapshot is a binary dump of a whole registry, following the BinaryFile
+conventions (header, bulk data, mapper data). The bulk data is made of:
+- a table of component types, hash and size, the hash is what allows us to
+  match the data to a concrete type once loaded
+- a table of archetypes, each one referencing a contiguous range of columns
+- a table of columns, each one pointing to a raw block of component data
+- the registry entities and free list, such that EntityIds stay valid
+- a table of sparse sets, each one pointing to its dense entity indices and
+  data
+- the shared component values, the shared refs of the archetypes and the
+  singletons
+- the raw blocks of data themselves
+
+Restoring does not parse anything, archetypes are re-created from the type
+table and each column is restored with a single memcpy.
+*/
+
+// serializes the registry in a binary blob, header included, ready to be
+// written to disk or restored directly
+void serializeRegistrySnapshot(const Registry &registry,
+                               std::vector<char> &outData);
+bool writeRegistrySnapshot(const Registry &registry, const char *outPath);
+
+// restores a registry from binary data, header included. Whatever was in the
+// registry gets destroyed. The data is validated against its size first, a
+// truncated or corrupted snapshot returns false leaving the registry untouched
+bool restoreRegistrySnapshot(Registry &registry, const void *binaryData,
+                             uint64_t sizeInByte);
+bool loadRegistrySnapshot(Registry &registry, const char *path);
+
+}  // namespace SirEngine::ecs
@@ -0,0 +1,304 @@
+#include "SirEngine/ecs/ecsStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+#include "nlohmann/json.hpp"
+
+namespace SirEngine::ecs {
+
+static const char *storageToString(const ComponentStorage storage) {
+  switch (storage) {
+    case ComponentStorage::ARCHETYPE:
+      return "archetype";
+    case ComponentStorage::SPARSE_SET:
+      return "sparse";
+    case ComponentStorage::SHARED:
+      return "shared";
+  }
+  return "unknown";
+}
+
+static std::string hashToString(const size_t hash) {
+  std::stringstream stream;
+  stream << "0x" << std::hex << hash;
+  return stream.str();
+}
+
+std::string getComponentTypeName(const Registry &registry, const size_t hash) {
+  const char *raw = registry.getRawComponentTypeName(hash);
+  if (raw == nullptr) {
+    return hashToString(hash);
+  }
+  // gcc: "... rawComponentTypeName() [with T = Type]"
+  // clang: "... rawComponentTypeName() [T = Type]"
+  // msvc: "... rawComponentTypeName<struct Type>(void)"
+  const std::string signature(raw);
+  size_t start = signature.find("T = ");
+  size_t end = std::string::npos;
+  if (start != std::string::npos) {
+    start += 4;
+    end = signature.find_first_of("];", start);
+  } else {
+    start = signature.find("rawComponentTypeName<");
+    if (start == std::string::npos) {
+      return signature;
+    }
+    start += 21;
+    end = signature.rfind('>');
+    for (const char *prefix : {"struct ", "class "}) {
+      if (signature.compare(start, strlen(prefix), prefix) == 0) {
+        start += strlen(prefix);
+      }
+    }
+  }
+  if ((end == std::string::npos) || (end <= start)) {
+    return signature;
+  }
+  return signature.substr(start, end - start);
+}
+
+void collectRegistryStats(const Registry &registry, RegistryStats &outStats) {
+  outStats = {};
+  outStats.aliveEntityCount = registry.getAliveEntityCount();
+  outStats.freeEntityCount =
+      static_cast<uint32_t>(registry.getEntities().size()) -
+      outStats.aliveEntityCount;
+  outStats.structuralChanges = registry.getStructuralChanges();
+  outStats.singletonCount =
+      static_cast<uint32_t>(registry.getSingletons().size());
+
+  // spread of every component type over the archetypes, keyed by hash
+  std::unordered_map<size_t, ComponentSpreadStats> spread;
+  const auto getSpread = [&](const ComponentTypeInfo &info,
+                             const ComponentStorage storage)
+      -> ComponentSpreadStats & {
+    auto found = spread.find(info.hash);
+    if (found == spread.end()) {
+      found = spread
+                  .emplace(info.hash,
+                           ComponentSpreadStats{
+                               info.hash,
+                               getComponentTypeName(registry, info.hash),
+                               info.componentDataTypeSize, storage, 0, 0})
+                  .first;
+    }
+    return found->second;
+  };
+
+  const uint32_t archetypeCount = registry.getArchetypeCount();
+  outStats.archetypeCount = archetypeCount;
+  outStats.archetypes.reserve(archetypeCount);
+  for (uint32_t a = 0; a < archetypeCount; ++a) {
+    const Archetype *arch = registry.getArchetype(a);
+    ArchetypeStats archStats{};
+    archStats.hash = arch->hash;
+    archStats.entityCount = arch->entityCount;
+    archStats.capacity = arch->bufferElementCount;
+    archStats.storageSizeInBytes = arch->m_storageSizeInBytes;
+    archStats.occupancy =
+        arch->bufferElementCount != 0
+            ? static_cast<float>(arch->entityCount) /
+                  static_cast<float>(arch->bufferElementCount)
+            : 0.0f;
+    archStats.sharedCount = static_cast<uint32_t>(arch->m_shared.size());
+
+    // every row carries its entity index alongside the components
+    size_t rowSize = sizeof(size_t);
+    archStats.columns.reserve(arch->componentCount);
+    for (uint32_t i = 0; i < arch->componentCount; ++i) {
+      const ComponentTypeInfo &info = arch->m_components[i].info;
+      rowSize += info.componentDataTypeSize;
+      archStats.columns.push_back(
+          {info.hash, getComponentTypeName(registry, info.hash),
+           info.componentDataTypeSize,
+           info.componentDataTypeSize * arch->entityCount,
+           info.componentDataTypeSize * arch->bufferElementCount});
+      if (arch->entityCount != 0) {
+        ComponentSpreadStats &cmpSpread =
+            getSpread(info, ComponentStorage::ARCHETYPE);
+        ++cmpSpread.archetypeCount;
+        cmpSpread.entityCount += arch->entityCount;
+      }
+    }
+    archStats.usedSizeInBytes = rowSize * arch->entityCount;
+    archStats.unusedSizeInBytes =
+        archStats.storageSizeInBytes - archStats.usedSizeInBytes;
+
+    for (const SharedComponentRef &ref : arch->m_shared) {
+      const auto found = registry.getSharedStores().find(ref.hash);
+      assert(found != registry.getSharedStores().end());
+      getSpread(found->second.info, ComponentStorage::SHARED).entityCount +=
+          arch->entityCount;
+    }
+
+    outStats.emptyArchetypeCount += arch->entityCount == 0 ? 1 : 0;
+    outStats.fragmentedArchetypeCount +=
+        (arch->entityCount != 0) &&
+                (archStats.occupancy < FRAGMENTED_OCCUPANCY)
+            ? 1
+            : 0;
+    outStats.storageSizeInBytes += archStats.storageSizeInBytes;
+    outStats.usedSizeInBytes += archStats.usedSizeInBytes;
+    outStats.unusedSizeInBytes += archStats.unusedSizeInBytes;
+    outStats.archetypes.emplace_back(std::move(archStats));
+  }
+  const uint32_t populatedCount = archetypeCount - outStats.emptyArchetypeCount;
+  outStats.averageEntitiesPerArchetype =
+      populatedCount != 0 ? static_cast<float>(outStats.aliveEntityCount) /
+                                static_cast<float>(populatedCount)
+                          : 0.0f;
+
+  // shared components are spread over one partition per unique value
+  for (const auto &store : registry.getSharedStores()) {
+    getSpread(store.second.info, ComponentStorage::SHARED).archetypeCount =
+        store.second.count;
+    outStats.sharedValueCount += store.second.count;
+  }
+  // sparse components do not live in archetypes at all
+  for (const auto &set : registry.getSparseSets()) {
+    const SparseSet &sparse = set.second;
+    getSpread(sparse.info, ComponentStorage::SPARSE_SET).entityCount =
+        sparse.count;
+    outStats.sparseSizeInBytes += sparse.data.capacity() +
+                                  sparse.denseEntities.capacity() *
+                                      sizeof(uint32_t) +
+                                  sparse.sparse.capacity() * sizeof(uint32_t);
+  }
+
+  outStats.components.reserve(spread.size());
+  for (auto &cmpSpread : spread) {
+    outStats.components.emplace_back(std::move(cmpSpread.second));
+  }
+  std::sort(outStats.archetypes.begin(), outStats.archetypes.end(),
+            [](const ArchetypeStats &lhs, const ArchetypeStats &rhs) {
+              return lhs.storageSizeInBytes != rhs.storageSizeInBytes
+                         ? lhs.storageSizeInBytes > rhs.storageSizeInBytes
+                         : lhs.entityCount > rhs.entityCount;
+            });
+  std::sort(outStats.components.begin(), outStats.components.end(),
+            [](const ComponentSpreadStats &lhs,
+               const ComponentSpreadStats &rhs) {
+              return lhs.archetypeCount != rhs.archetypeCount
+                         ? lhs.archetypeCount > rhs.archetypeCount
+                         : lhs.entityCount > rhs.entityCount;
+            });
+}
+
+std::string formatRegistryStats(const RegistryStats &stats) {
+  std::stringstream stream;
+  stream << std::fixed << std::setprecision(2);
+  stream << "Entities: " << stats.aliveEntityCount << " alive, "
+         << stats.freeEntityCount << " free\n"
+         << "Archetypes: " << stats.archetypeCount << ", "
+         << stats.emptyArchetypeCount << " empty, "
+         << stats.fragmentedArchetypeCount << " below "
+         << FRAGMENTED_OCCUPANCY * 100.0f << "% occupancy, "
+         << stats.averageEntitiesPerArchetype << " entities on average\n"
+         << "Archetype storage: " << stats.storageSizeInBytes << " bytes, "
+         << stats.usedSizeInBytes << " used, " << stats.unusedSizeInBytes
+         << " unused\n"
+         << "Sparse sets: " << stats.sparseSizeInBytes << " bytes\n"
+         << "Shared values: " << stats.sharedValueCount
+         << ", singletons: " << stats.singletonCount << "\n";
+  const StructuralChangeCounters &changes = stats.structuralChanges;
+  stream << "Structural changes: " << changes.createdEntities << " created, "
+         << changes.deletedEntities << " deleted, " << changes.archetypeMoves
+         << " archetype moves, " << changes.sparseAdds << " sparse adds, "
+         << changes.sparseRemoves << " sparse removes, "
+         << changes.createdArchetypes << " new archetypes\n";
+
+  stream << "\nArchetypes:\n";
+  for (const ArchetypeStats &arch : stats.archetypes) {
+    stream << "  " << hashToString(arch.hash) << ": " << arch.entityCount << "/"
+           << arch.capacity << " entities (" << arch.occupancy * 100.0f
+           << "%), " << arch.storageSizeInBytes << " bytes, "
+           << arch.unusedSizeInBytes << " unused";
+    if (arch.sharedCount != 0) {
+      stream << ", " << arch.sharedCount << " shared";
+    }
+    stream << "\n";
+    for (const ColumnStats &column : arch.columns) {
+      stream << "    " << column.name << " (" << column.typeSizeInBytes
+             << " bytes): " << column.usedSizeInBytes << "/"
+             << column.capacitySizeInBytes << " bytes\n";
+    }
+  }
+
+  stream << "\nComponents:\n";
+  for (const ComponentSpreadStats &cmp : stats.components) {
+    stream << "  " << cmp.name << " (" << storageToString(cmp.storage) << ", "
+           << cmp.typeSizeInBytes << " bytes): " << cmp.entityCount
+           << " entities";
+    if (cmp.storage == ComponentStorage::ARCHETYPE) {
+      stream << " in " << cmp.archetypeCount << " archetypes";
+    } else if (cmp.storage == ComponentStorage::SHARED) {
+      stream << ", " << cmp.archetypeCount << " unique values";
+    }
+    stream << "\n";
+  }
+  return stream.str();
+}
+
+void registryStatsToJson(const RegistryStats &stats, nlohmann::json &outJson) {
+  outJson = nlohmann::json::object();
+  outJson["aliveEntityCount"] = stats.aliveEntityCount;
+  outJson["freeEntityCount"] = stats.freeEntityCount;
+  outJson["archetypeCount"] = stats.archetypeCount;
+  outJson["emptyArchetypeCount"] = stats.emptyArchetypeCount;
+  outJson["fragmentedArchetypeCount"] = stats.fragmentedArchetypeCount;
+  outJson["averageEntitiesPerArchetype"] = stats.averageEntitiesPerArchetype;
+  outJson["storageSizeInBytes"] = stats.storageSizeInBytes;
+  outJson["usedSizeInBytes"] = stats.usedSizeInBytes;
+  outJson["unusedSizeInBytes"] = stats.unusedSizeInBytes;
+  outJson["sparseSizeInBytes"] = stats.sparseSizeInBytes;
+  outJson["sharedValueCount"] = stats.sharedValueCount;
+  outJson["singletonCount"] = stats.singletonCount;
+
+  const StructuralChangeCounters &changes = stats.structuralChanges;
+  outJson["structuralChanges"] = {
+      {"createdEntities", changes.createdEntities},
+      {"deletedEntities", changes.deletedEntities},
+      {"archetypeMoves", changes.archetypeMoves},
+      {"sparseAdds", changes.sparseAdds},
+      {"sparseRemoves", changes.sparseRemoves},
+      {"createdArchetypes", changes.createdArchetypes}};
+
+  nlohmann::json archetypes = nlohmann::json::array();
+  for (const ArchetypeStats &arch : stats.archetypes) {
+    nlohmann::json columns = nlohmann::json::array();
+    for (const ColumnStats &column : arch.columns) {
+      columns.push_back({{"name", column.name},
+                         {"hash", hashToString(column.hash)},
+                         {"typeSizeInBytes", column.typeSizeInBytes},
+                         {"usedSizeInBytes", column.usedSizeInBytes},
+                         {"capacitySizeInBytes", column.capacitySizeInBytes}});
+    }
+    archetypes.push_back({{"hash", hashToString(arch.hash)},
+                          {"entityCount", arch.entityCount},
+                          {"capacity", arch.capacity},
+                          {"occupancy", arch.occupancy},
+                          {"storageSizeInBytes", arch.storageSizeInBytes},
+                          {"usedSizeInBytes", arch.usedSizeInBytes},
+                          {"unusedSizeInBytes", arch.unusedSizeInBytes},
+                          {"sharedCount", arch.sharedCount},
+                          {"columns", columns}});
+  }
+  outJson["archetypes"] = archetypes;
+
+  nlohmann::json components = nlohmann::json::array();
+  for (const ComponentSpreadStats &cmp : stats.components) {
+    components.push_back({{"name", cmp.name},
+                          {"hash", hashToString(cmp.hash)},
+                          {"storage", storageToString(cmp.storage)},
+                          {"typeSizeInBytes", cmp.typeSizeInBytes},
+                          {"archetypeCount", cmp.archetypeCount},
+                          {"entityCount", cmp.entityCount}});
+  }
+  outJson["components"] = components;
+}
+
+}  // namespace SirEngine::ecs
@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "SirEngine/ecs/ecs.h"
+#include "nlohmann/json_fwd.hpp"
+
+namespace SirEngine::ecs {
+
+/*
+Debug statistics of a registry, meant to understand how the entities end up
+laid out in memory and to drive the component layout design:
+- every archetype with its fill rate and the bytes of each column, archetypes
+  holding only a handful of entities in a whole storage block are what
+  fragmentation looks like
+- every component type with the number of archetypes it is spread over, a
+  component living in many archetypes with few entities each is usually a
+  tag toggled on and off that would be better off sparse, or a shared value
+  with too many unique values
+- sparse sets, shared stores and singletons
+- the structural changes counted since the last reset
+
+Collecting the stats walks the whole registry, it is not meant to be done
+every frame in shipping builds.
+*/
+
+struct ColumnStats {
+  size_t hash;
+  std::string name;
+  size_t typeSizeInBytes;
+  // bytes holding live entities
+  size_t usedSizeInBytes;
+  // bytes reserved for the column, live entities and unused capacity
+  size_t capacitySizeInBytes;
+};
+
+struct ArchetypeStats {
+  size_t hash;
+  uint32_t entityCount;
+  uint32_t capacity;
+  // size of the whole storage block, columns, versions and entity indices
+  size_t storageSizeInBytes;
+  size_t usedSizeInBytes;
+  size_t unusedSizeInBytes;
+  // entityCount / capacity
+  float occupancy;
+  uint32_t sharedCount;
+  std::vector<ColumnStats> columns;
+};
+
+struct ComponentSpreadStats {
+  size_t hash;
+  std::string name;
+  size_t typeSizeInBytes;
+  ComponentStorage storage;
+  // how many archetypes hold the component, or the amount of unique values for
+  // shared components
+  uint32_t archetypeCount;
+  uint32_t entityCount;
+};
+
+struct RegistryStats {
+  uint32_t archetypeCount = 0;
+  uint32_t emptyArchetypeCount = 0;
+  // archetypes filled less than FRAGMENTED_OCCUPANCY
+  uint32_t fragmentedArchetypeCount = 0;
+  uint32_t aliveEntityCount = 0;
+  uint32_t freeEntityCount = 0;
+  float averageEntitiesPerArchetype = 0.0f;
+  size_t storageSizeInBytes = 0;
+  size_t usedSizeInBytes = 0;
+  size_t unusedSizeInBytes = 0;
+  size_t sparseSizeInBytes = 0;
+  uint32_t sharedValueCount = 0;
+  uint32_t singletonCount = 0;
+  // sorted by storage size then entity count, biggest first
+  std::vector<ArchetypeStats> archetypes;
+  // sorted by archetype count, most spread first
+  std::vector<ComponentSpreadStats> components;
+  StructuralChangeCounters structuralChanges;
+};
+
+static constexpr float FRAGMENTED_OCCUPANCY = 0.25f;
+
+void collectRegistryStats(const Registry &registry, RegistryStats &outStats);
+
+// human readable report, one line per archetype and component
+std::string formatRegistryStats(const RegistryStats &stats);
+void registryStatsToJson(const RegistryStats &stats, nlohmann::json &outJson);
+
+// extracts the plain type name out of rawComponentTypeName, returns the
+// hash in hex for types without a name
+std::string getComponentTypeName(const Registry &registry, size_t hash);
+
+}  // namespace SirEngine::ecs
@@ -0,0 +1,251 @@
+#include "SirEngine/ecs/transformHierarchy.h"
+
+namespace SirEngine::ecs {
+
+static constexpr uint32_t DEPTH_NOT_COMPUTED = static_cast<uint32_t>(-1);
+
+void TransformHierarchy::addEntity(Registry &registry, const EntityId eid,
+                                   const EntityId parent) {
+  assert(registry.hasComponent<LocalTransform>(eid));
+  assert(!isInHierarchy(eid));
+  if (eid.index >= m_entityToSlot.size()) {
+    m_entityToSlot.resize(eid.index + 1, INVALID_SLOT);
+    m_entityVersions.resize(eid.index + 1, 0);
+  }
+  const glm::mat4 &local = registry.getComponent<LocalTransform>(eid).matrix;
+  registry.addComponent(eid, WorldTransform{local});
+  registry.addComponent(eid, TransformNode{parent, INVALID_SLOT});
+
+  m_entityToSlot[eid.index] = PENDING_SLOT;
+  m_entityVersions[eid.index] = eid.version;
+  m_pending.push_back(eid);
+  m_structureDirty = true;
+}
+
+void TransformHierarchy::removeEntity(Registry &registry, const EntityId eid) {
+  assert(isInHierarchy(eid));
+  // children of the removed node become roots
+  const uint32_t slot = m_entityToSlot[eid.index];
+  if (slot != PENDING_SLOT) {
+    const auto count = static_cast<uint32_t>(m_entities.size());
+    for (uint32_t i = slot + 1; i < count; ++i) {
+      if (m_parentSlots[i] == static_cast<int32_t>(slot)) {
+        registry.getComponent<TransformNode>(m_entities[i]).parent = NO_PARENT;
+      }
+    }
+  }
+  // pending nodes might also be children of the removed entity
+  for (const EntityId pending : m_pending) {
+    if (!isInHierarchy(pending) || (pending.index == eid.index) ||
+        !registry.isEntityValid(pending)) {
+      continue;
+    }
+    TransformNode &node = registry.getComponent<TransformNode>(pending);
+    if ((node.parent.index == eid.index) &&
+        (node.parent.version == eid.version)) {
+      node.parent = NO_PARENT;
+    }
+  }
+
+  registry.removeComponent<TransformNode>(eid);
+  registry.removeComponent<WorldTransform>(eid);
+  m_entityToSlot[eid.index] = INVALID_SLOT;
+  m_structureDirty = true;
+}
+
+void TransformHierarchy::setParent(Registry &registry, const EntityId eid,
+                                   const EntityId parent) {
+  assert(isInHierarchy(eid));
+  assert(!isParentValid(parent) || isInHierarchy(parent));
+  registry.getComponent<TransformNode>(eid).parent = parent;
+  m_structureDirty = true;
+}
+
+const glm::mat4 &TransformHierarchy::getWorldMatrix(const EntityId eid) const {
+  assert(isInHierarchy(eid));
+  const uint32_t slot = m_entityToSlot[eid.index];
+  assert(slot != PENDING_SLOT && "entity added but hierarchy not updated yet");
+  return m_worlds[slot];
+}
+
+uint32_t TransformHierarchy::computeDepth(const Registry &registry,
+                                          const uint32_t node) {
+  // while rebuilding, m_entityToSlot holds the index in the scratch node list
+  // walking up the chain until we find a node with a known depth, then
+  // walking down again assigning depths
+  uint32_t current = node;
+  uint32_t chainLength = 0;
+  while (m_scratchDepths[current] == DEPTH_NOT_COMPUTED) {
+    const EntityId parent =
+        registry.getComponent<TransformNode>(m_scratchNodes[current]).parent;
+    if (!isParentValid(parent) || !isInHierarchy(parent)) {
+      m_scratchDepths[current] = 0;
+      break;
+    }
+    current = m_entityToSlot[parent.index];
+    ++chainLength;
+    assert(chainLength <= m_scratchNodes.size() && "cycle in hierarchy");
+  }
+
+  uint32_t depth = m_scratchDepths[current] + chainLength;
+  current = node;
+  while (m_scratchDepths[current] == DEPTH_NOT_COMPUTED) {
+    m_scratchDepths[current] = depth--;
+    const EntityId parent =
+        registry.getComponent<TransformNode>(m_scratchNodes[current]).parent;
+    current = m_entityToSlot[parent.index];
+  }
+  return m_scratchDepths[node];
+}
+
+bool TransformHierarchy::hasDeadNodes(const Registry &registry) const {
+  for (const EntityId eid : m_entities) {
+    if (!registry.isEntityValid(eid)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void TransformHierarchy::rebuild(Registry &registry) {
+  // gathering all the nodes still part of the hierarchy, the ones destroyed
+  // in the registry get dropped, unless their index already belongs to a new
+  // entity of the hierarchy
+  m_scratchNodes.clear();
+  const auto gather = [&](const EntityId eid) {
+    if (!isInHierarchy(eid)) {
+      return;
+    }
+    if (registry.isEntityValid(eid)) {
+      m_scratchNodes.push_back(eid);
+    } else {
+      m_entityToSlot[eid.index] = INVALID_SLOT;
+    }
+  };
+  for (const EntityId eid : m_entities) {
+    gather(eid);
+  }
+  for (const EntityId eid : m_pending) {
+    gather(eid);
+  }
+  m_pending.clear();
+
+  const auto nodeCount = static_cast<uint32_t>(m_scratchNodes.size());
+  for (uint32_t i = 0; i < nodeCount; ++i) {
+    m_entityToSlot[m_scratchNodes[i].index] = i;
+  }
+
+  // computing depths and doing a counting sort on them, giving us the breadth
+  // first order
+  m_scratchDepths.assign(nodeCount, DEPTH_NOT_COMPUTED);
+  uint32_t maxDepth = 0;
+  for (uint32_t i = 0; i < nodeCount; ++i) {
+    const uint32_t depth = computeDepth(registry, i);
+    maxDepth = depth > maxDepth ? depth : maxDepth;
+  }
+  std::vector<uint32_t> depthOffsets(maxDepth + 2, 0);
+  for (uint32_t i = 0; i < nodeCount; ++i) {
+    ++depthOffsets[m_scratchDepths[i] + 1];
+  }
+  for (uint32_t d = 1; d < depthOffsets.size(); ++d) {
+    depthOffsets[d] += depthOffsets[d - 1];
+  }
+  m_scratchOrder.resize(nodeCount);
+  for (uint32_t i = 0; i < nodeCount; ++i) {
+    m_scratchOrder[depthOffsets[m_scratchDepths[i]]++] = i;
+  }
+
+  // re-building the SoA arrays in sorted order
+  m_entities.resize(nodeCount);
+  m_parentSlots.resize(nodeCount);
+  m_locals.resize(nodeCount);
+  m_worlds.resize(nodeCount);
+  m_dirty.assign(nodeCount, 1);
+  for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+    m_entities[slot] = m_scratchNodes[m_scratchOrder[slot]];
+  }
+  for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+    m_entityToSlot[m_entities[slot].index] = slot;
+  }
+  const Registry &constRegistry = registry;
+  for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+    const EntityId eid = m_entities[slot];
+    const EntityId parent = constRegistry.getComponent<TransformNode>(eid).parent;
+    m_parentSlots[slot] = (isParentValid(parent) && isInHierarchy(parent))
+                              ? static_cast<int32_t>(m_entityToSlot[parent.index])
+                              : ROOT_PARENT_SLOT;
+    assert(m_parentSlots[slot] < static_cast<int32_t>(slot));
+    m_locals[slot] = constRegistry.getComponent<LocalTransform>(eid).matrix;
+    registry.getComponent<TransformNode>(eid).slot = slot;
+  }
+  m_structureDirty = false;
+}
+
+void TransformHierarchy::gatherChangedLocals(Registry &registry) {
+  registry.populateChangedComponentQuery<LocalTransform>(m_changedQuery,
+                                                         m_lastSeenVersion);
+  for (const auto &q : m_changedQuery) {
+    const size_t count = std::get<0>(q);
+    const LocalTransform *locals = std::get<1>(q);
+    const TransformNode *nodes = std::get<2>(q);
+    for (size_t i = 0; i < count; ++i) {
+      // change detection works on chunks of rows, here we filter out the rows
+      // that did not actually change
+      const uint32_t slot = nodes[i].slot;
+      if (memcmp(&m_locals[slot], &locals[i].matrix, sizeof(glm::mat4)) != 0) {
+        m_locals[slot] = locals[i].matrix;
+        m_dirty[slot] = 1;
+      }
+    }
+  }
+}
+
+void TransformHierarchy::propagate() {
+  // parents always come before children, dirtiness flows down in the same
+  // linear pass
+  const auto count = static_cast<uint32_t>(m_entities.size());
+  uint32_t updated = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const int32_t parent = m_parentSlots[i];
+    if (parent == ROOT_PARENT_SLOT) {
+      if (m_dirty[i]) {
+        m_worlds[i] = m_locals[i];
+        ++updated;
+      }
+      continue;
+    }
+    m_dirty[i] |= m_dirty[parent];
+    if (m_dirty[i]) {
+      m_worlds[i] = m_worlds[parent] * m_locals[i];
+      ++updated;
+    }
+  }
+  m_lastUpdatedCount = updated;
+}
+
+void TransformHierarchy::writeBack(Registry &registry) {
+  const auto count = static_cast<uint32_t>(m_entities.size());
+  for (uint32_t i = 0; i < count; ++i) {
+    if (m_dirty[i]) {
+      registry.getComponent<WorldTransform>(m_entities[i]).matrix = m_worlds[i];
+      m_dirty[i] = 0;
+    }
+  }
+}
+
+void TransformHierarchy::update(Registry &registry) {
+  // entities destroyed without being removed first need a re-sort as well
+  if (m_structureDirty || hasDeadNodes(registry)) {
+    // a rebuild reads all the locals and flags everything as dirty
+    rebuild(registry);
+  } else {
+    gatherChangedLocals(registry);
+  }
+  // anything written after this point, including our own write back, will be
+  // seen as a change next update
+  m_lastSeenVersion = registry.advanceVersion();
+  propagate();
+  writeBack(registry);
+}
+
+}  // namespace SirEngine::ecs
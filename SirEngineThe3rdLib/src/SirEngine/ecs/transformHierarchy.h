@@ -0,0 +1,124 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "SirEngine/ecs/ecs.h"
+
+namespace SirEngine::ecs {
+
+// transform of the entity relative to its parent, or to the world if the
+// entity has no parent. This is the component the user writes to.
+struct LocalTransform {
+  glm::mat4 matrix;
+};
+
+// final world matrix of the entity, written by the TransformHierarchy only
+struct WorldTransform {
+  glm::mat4 matrix;
+};
+
+// the parent link, owned by the TransformHierarchy, use setParent() to change
+// it. The slot is where the entity lives in the depth sorted arrays of the
+// hierarchy
+struct TransformNode {
+  EntityId parent;
+  uint32_t slot;
+};
+
+/*
+The transform hierarchy computes world matrices for entities having a
+LocalTransform. Internally the nodes are kept in SoA arrays sorted breadth
+first, by depth, which guarantees every parent is processed before its
+children, the world matrices can then be propagated in a single linear pass.
+
+Changed local transforms are picked up through the registry change detection,
+only the nodes that changed, or have an ancestor that changed, get
+recomputed and written back to their WorldTransform component, untouched
+subtrees are skipped.
+Structural changes (adding, removing or re-parenting nodes) are cheap to
+request but trigger a full re-sort on the next update.
+Entities destroyed while still in the hierarchy get dropped by the next
+update, their children become roots. Membership is tracked per entity id,
+version included, a recycled index is a different entity.
+*/
+class TransformHierarchy final {
+ public:
+  static constexpr int32_t ROOT_PARENT_SLOT = -1;
+  static constexpr EntityId NO_PARENT{static_cast<uint32_t>(-1), 0, 0};
+
+  TransformHierarchy() = default;
+  ~TransformHierarchy() = default;
+  TransformHierarchy(const TransformHierarchy &) = delete;
+  TransformHierarchy &operator=(const TransformHierarchy &) = delete;
+
+  // the entity needs to have a LocalTransform component already, the
+  // hierarchy will add the WorldTransform and TransformNode components
+  void addEntity(Registry &registry, EntityId eid,
+                 EntityId parent = NO_PARENT);
+  // removes the transform components from the entity, its children become
+  // roots
+  void removeEntity(Registry &registry, EntityId eid);
+  void setParent(Registry &registry, EntityId eid, EntityId parent);
+
+  // propagates the changed local transforms down the hierarchy and writes the
+  // world matrices of the affected entities
+  void update(Registry &registry);
+
+  [[nodiscard]] const glm::mat4 &getWorldMatrix(EntityId eid) const;
+  // a destroyed entity stays in the hierarchy until the next update, the
+  // version tells it apart from a new entity recycling its index
+  [[nodiscard]] bool isInHierarchy(const EntityId eid) const {
+    return (eid.index < m_entityToSlot.size()) &&
+           (m_entityToSlot[eid.index] != INVALID_SLOT) &&
+           (m_entityVersions[eid.index] == eid.version);
+  }
+  [[nodiscard]] uint32_t getNodeCount() const {
+    return static_cast<uint32_t>(m_entities.size());
+  }
+  // how many nodes were recomputed during the last update
+  [[nodiscard]] uint32_t getLastUpdatedCount() const {
+    return m_lastUpdatedCount;
+  }
+
+ private:
+  static bool isParentValid(const EntityId parent) {
+    return parent.index != NO_PARENT.index;
+  }
+  bool hasDeadNodes(const Registry &registry) const;
+  uint32_t computeDepth(const Registry &registry, uint32_t node);
+  void rebuild(Registry &registry);
+  void gatherChangedLocals(Registry &registry);
+  void propagate();
+  void writeBack(Registry &registry);
+
+ private:
+  // depth sorted SoA data, indexed by slot
+  std::vector<EntityId> m_entities;
+  std::vector<int32_t> m_parentSlots;
+  std::vector<glm::mat4> m_locals;
+  std::vector<glm::mat4> m_worlds;
+  std::vector<uint8_t> m_dirty;
+
+  // entity index to slot, INVALID_SLOT when the entity is not in the
+  // hierarchy, PENDING_SLOT if added but not sorted yet
+  static constexpr uint32_t INVALID_SLOT = static_cast<uint32_t>(-1);
+  static constexpr uint32_t PENDING_SLOT = static_cast<uint32_t>(-2);
+  std::vector<uint32_t> m_entityToSlot;
+  // version of the entity owning the slot, an index can be recycled by the
+  // registry
+  std::vector<uint16_t> m_entityVersions;
+  // nodes added since last rebuild
+  std::vector<EntityId> m_pending;
+  bool m_structureDirty = false;
+  uint32_t m_lastSeenVersion = 0;
+  uint32_t m_lastUpdatedCount = 0;
+
+  // scratch memory kept around to avoid allocations every update
+  std::vector<std::tuple<size_t, const LocalTransform *, const TransformNode *>>
+      m_changedQuery;
+  std::vector<EntityId> m_scratchNodes;
+  std::vector<uint32_t> m_scratchDepths;
+  std::vector<uint32_t> m_scratchOrder;
+};
+
+}  // namespace SirEngine::ecs
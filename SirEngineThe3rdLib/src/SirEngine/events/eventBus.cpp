@@ -0,0 +1,56 @@
+#include "SirEngine/events/eventBus.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace SirEngine {
+
+EventBus::~EventBus() {
+  for (std::atomic<Channel *> &channel : m_channels) {
+    delete channel.load();
+  }
+}
+
+uint32_t EventBus::registerEventType() {
+  static std::atomic<uint32_t> nextIndex{0};
+  const uint32_t index = nextIndex++;
+  // past the limit the channels would be indexed out of bounds, there is no
+  // way to recover so this stops the program in every build. Types are
+  // registered from function local statics, the logger might not be up yet
+  if (index >= MAX_EVENT_TYPES) {
+    std::cerr << "Event type index " << index << " out of range, at most "
+              << MAX_EVENT_TYPES
+              << " event types are supported, bump MAX_EVENT_TYPES"
+              << std::endl;
+    std::abort();
+  }
+  return index;
+}
+
+EventBus::Channel &EventBus::getChannel(const uint32_t typeIndex) {
+  Channel *channel = m_channels[typeIndex].load(std::memory_order_acquire);
+  if (channel != nullptr) {
+    return *channel;
+  }
+  // first event of this type, two producers might race to create it
+  std::lock_guard<std::mutex> lock(m_channelsMutex);
+  channel = m_channels[typeIndex].load(std::memory_order_relaxed);
+  if (channel == nullptr) {
+    channel = new Channel();
+    m_channels[typeIndex].store(channel, std::memory_order_release);
+  }
+  return *channel;
+}
+
+void EventBus::swap() {
+  for (std::atomic<Channel *> &entry : m_channels) {
+    Channel *channel = entry.load(std::memory_order_relaxed);
+    if (channel == nullptr) {
+      continue;
+    }
+    channel->writeBuffer = 1 - channel->writeBuffer;
+    channel->sizes[channel->writeBuffer] = 0;
+  }
+}
+
+}  // namespace SirEngine
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstddef>
+#include <stdint.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace SirEngine {
+
+// read only view over the events of one type
+template <typename T>
+struct EventSpan {
+  const T *data = nullptr;
+  uint32_t count = 0;
+
+  [[nodiscard]] const T *begin() const { return data; }
+  [[nodiscard]] const T *end() const { return data + count; }
+  [[nodiscard]] bool empty() const { return count == 0; }
+  const T &operator[](const uint32_t i) const { return data[i]; }
+};
+
+/*
+The event bus stores events in one channel per event type, every channel is
+a contiguous array of plain structs. Producers append to the channel, from
+any thread, and consumers read the whole array as a span, there is no
+virtual dispatch, no per event allocation and no handler registration, a
+consumer reads the channels it is interested in when it runs.
+
+Channels are double buffered and swapped once per frame: events sent during
+frame N are readable during the whole frame N+1, by any number of
+consumers, then the memory gets reused. The buffers only grow, once warm the
+bus does not allocate anymore, same as the frame allocator.
+
+Event types need to be trivially copyable, strings and resources should be
+referenced through handles or pointers with a longer lifetime.
+*/
+class EventBus final {
+ public:
+  static constexpr uint32_t MAX_EVENT_TYPES = 128;
+
+  EventBus() = default;
+  ~EventBus();
+  EventBus(const EventBus &) = delete;
+  EventBus &operator=(const EventBus &) = delete;
+
+  // thread safe
+  template <typename T>
+  void send(const T &event) {
+    sendBatch(&event, 1);
+  }
+  template <typename T>
+  void sendBatch(const T *events, const uint32_t count) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "events are copied around as raw memory");
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+    getChannel(getEventTypeIndex<T>()).append(events, sizeof(T) * count);
+  }
+
+  // events sent during the previous frame, valid until the next swap
+  template <typename T>
+  [[nodiscard]] EventSpan<T> read() const {
+    const Channel *channel =
+        m_channels[getEventTypeIndex<T>()].load(std::memory_order_acquire);
+    if (channel == nullptr) {
+      return {};
+    }
+    const uint32_t readBuffer = 1 - channel->writeBuffer;
+    return {reinterpret_cast<const T *>(channel->buffers[readBuffer].data()),
+            static_cast<uint32_t>(channel->sizes[readBuffer] / sizeof(T))};
+  }
+
+  // frame boundary, what was written becomes readable and the previous
+  // readable events are dropped. Not thread safe, no send or read can happen
+  // while swapping
+  void swap();
+
+  // events sent so far in the current frame
+  template <typename T>
+  [[nodiscard]] uint32_t getPendingCount() const {
+    const Channel *channel =
+        m_channels[getEventTypeIndex<T>()].load(std::memory_order_acquire);
+    return channel == nullptr
+               ? 0
+               : static_cast<uint32_t>(
+                     channel->sizes[channel->writeBuffer] / sizeof(T));
+  }
+
+  // the dense index of an event type, shared by all the buses
+  template <typename T>
+  static uint32_t getEventTypeIndex() {
+    static const uint32_t index = registerEventType();
+    return index;
+  }
+
+ private:
+  struct Channel {
+    std::mutex mutex;
+    std::vector<char> buffers[2];
+    size_t sizes[2]{};
+    uint32_t writeBuffer = 0;
+
+    void append(const void *data, const size_t sizeInBytes) {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::vector<char> &buffer = buffers[writeBuffer];
+      size_t &size = sizes[writeBuffer];
+      if (size + sizeInBytes > buffer.size()) {
+        const size_t grown = buffer.size() * 2;
+        buffer.resize(grown > size + sizeInBytes ? grown : size + sizeInBytes);
+      }
+      memcpy(buffer.data() + size, data, sizeInBytes);
+      size += sizeInBytes;
+    }
+  };
+
+  static uint32_t registerEventType();
+  Channel &getChannel(uint32_t typeIndex);
+
+ private:
+  std::atomic<Channel *> m_channels[MAX_EVENT_TYPES]{};
+  std::mutex m_channelsMutex;
+};
+
+}  // namespace SirEngine
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+namespace SirEngine {
+
+// the frame is split in phases executed in order, every system and layer
+// runs in exactly one of them, see FrameScheduler
+enum class FramePhase : uint8_t {
+  // platform events, input polling, cameras
+  INPUT = 0,
+  // gameplay decisions feeding the animation, state machines, blend weights
+  PRE_ANIMATION,
+  // pose evaluation and skinning matrices
+  ANIMATION,
+  // gameplay, physics, transform hierarchy and spatial index updates
+  SIMULATION,
+  // the ecs gets turned into draw packets for the renderer
+  RENDER_EXTRACTION,
+  // render graph execution and command recording
+  SUBMIT,
+  COUNT
+};
+
+static constexpr uint32_t FRAME_PHASE_COUNT =
+    static_cast<uint32_t>(FramePhase::COUNT);
+
+inline const char *getFramePhaseName(const FramePhase phase) {
+  static const char *NAMES[FRAME_PHASE_COUNT] = {
+      "input",      "pre-animation",     "animation",
+      "simulation", "render extraction", "submit"};
+  return NAMES[static_cast<uint32_t>(phase)];
+}
+
+}  // namespace SirEngine
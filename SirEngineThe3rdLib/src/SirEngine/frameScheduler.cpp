@@ -0,0 +1,111 @@
+#include "SirEngine/frameScheduler.h"
+
+#include <cassert>
+
+#include "SirEngine/workerPool.h"
+
+namespace SirEngine {
+
+FrameScheduler::FrameScheduler(WorkerPool *pool) : m_pool(pool) {}
+
+uint32_t FrameScheduler::addSystem(const char *name, const FramePhase phase,
+                                   const SystemAccess &access,
+                                   SystemFunction function) {
+  assert(phase < FramePhase::COUNT);
+  assert(function);
+  const auto index = static_cast<uint32_t>(m_systems.size());
+  m_systems.push_back({name, phase, access, std::move(function), 0});
+  m_scheduleDirty = true;
+  return index;
+}
+
+uint32_t FrameScheduler::getWaveCount(const FramePhase phase) {
+  if (m_scheduleDirty) {
+    buildSchedule();
+  }
+  const auto p = static_cast<uint32_t>(phase);
+  return m_phaseWaves[p + 1] - m_phaseWaves[p];
+}
+
+void FrameScheduler::buildSchedule() {
+  m_waves.clear();
+  m_waveSystems.clear();
+  std::vector<uint32_t> phaseSystems;
+  std::vector<uint32_t> systemWaves;
+  const auto systemCount = static_cast<uint32_t>(m_systems.size());
+  for (uint32_t p = 0; p < FRAME_PHASE_COUNT; ++p) {
+    m_phaseWaves[p] = static_cast<uint32_t>(m_waves.size());
+    phaseSystems.clear();
+    for (uint32_t i = 0; i < systemCount; ++i) {
+      if (static_cast<uint32_t>(m_systems[i].phase) == p) {
+        phaseSystems.push_back(i);
+      }
+    }
+
+    // a system goes right after the last wave holding something it
+    // conflicts with, earlier registrations always win
+    const auto count = static_cast<uint32_t>(phaseSystems.size());
+    systemWaves.assign(count, 0);
+    uint32_t waveCount = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      const SystemAccess &access = m_systems[phaseSystems[i]].access;
+      uint32_t wave = 0;
+      for (uint32_t j = 0; j < i; ++j) {
+        if (access.conflictsWith(m_systems[phaseSystems[j]].access) &&
+            (systemWaves[j] + 1 > wave)) {
+          wave = systemWaves[j] + 1;
+        }
+      }
+      systemWaves[i] = wave;
+      waveCount = wave + 1 > waveCount ? wave + 1 : waveCount;
+    }
+
+    for (uint32_t w = 0; w < waveCount; ++w) {
+      Wave wave{static_cast<uint32_t>(m_waveSystems.size()), 0};
+      for (uint32_t i = 0; i < count; ++i) {
+        if (systemWaves[i] == w) {
+          m_waveSystems.push_back(phaseSystems[i]);
+          ++wave.count;
+        }
+      }
+      m_waves.push_back(wave);
+    }
+  }
+  m_phaseWaves[FRAME_PHASE_COUNT] = static_cast<uint32_t>(m_waves.size());
+  m_scheduleDirty = false;
+}
+
+void FrameScheduler::runSystem(const uint32_t system, WorkerPool *pool) {
+  System &entry = m_systems[system];
+  const auto start = m_clock.now();
+  entry.function({m_frameIndex, m_deltaTimeNs, pool});
+  entry.lastTimeNs = static_cast<uint64_t>(m_clock.getDelta(start));
+}
+
+void FrameScheduler::runFrame(const uint64_t deltaTimeNs) {
+  if (m_scheduleDirty) {
+    buildSchedule();
+  }
+  m_deltaTimeNs = deltaTimeNs;
+  for (uint32_t p = 0; p < FRAME_PHASE_COUNT; ++p) {
+    const auto start = m_clock.now();
+    for (uint32_t w = m_phaseWaves[p]; w < m_phaseWaves[p + 1]; ++w) {
+      const Wave &wave = m_waves[w];
+      if (wave.count == 1) {
+        runSystem(m_waveSystems[wave.first], m_pool);
+      } else if (m_pool != nullptr) {
+        m_pool->parallelFor(wave.count, [&](const uint32_t task) {
+          runSystem(m_waveSystems[wave.first + task], nullptr);
+        });
+      } else {
+        for (uint32_t i = 0; i < wave.count; ++i) {
+          runSystem(m_waveSystems[wave.first + i], nullptr);
+        }
+      }
+    }
+    m_phaseTimesNs[p] = static_cast<uint64_t>(m_clock.getDelta(start));
+  }
+  ++m_frameIndex;
+}
+
+}  // namespace SirEngine
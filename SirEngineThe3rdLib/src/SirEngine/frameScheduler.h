@@ -0,0 +1,151 @@
+#pragma once
+#include <stdint.h>
+
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "SirEngine/clock.h"
+#include "SirEngine/ecs/ecs.h"
+#include "SirEngine/framePhase.h"
+
+namespace SirEngine {
+
+class WorkerPool;
+
+struct FrameContext {
+  uint64_t frameIndex;
+  uint64_t deltaTimeNs;
+  // only given to systems running alone, the pool does not support nested
+  // parallel loops. Null for systems sharing their wave with others
+  WorkerPool *pool;
+};
+
+// The resources a system touches. Any type can be used as a resource, ecs
+// components being the common case, the types share the dense indices of the
+// ecs component masks. Two systems conflict when one writes something the
+// other reads or writes, conflicting systems never run concurrently.
+// The registry itself is a resource too: systems using it declare a read,
+// systems doing structural changes or closing versions, see
+// Registry::advanceVersion, declare a write.
+class SystemAccess {
+ public:
+  template <typename... TYPES>
+  SystemAccess &read() {
+    (m_reads.set(ecs::getComponentTypeIndex<std::remove_const_t<TYPES>>()),
+     ...);
+    return *this;
+  }
+  template <typename... TYPES>
+  SystemAccess &write() {
+    (m_writes.set(ecs::getComponentTypeIndex<std::remove_const_t<TYPES>>()),
+     ...);
+    return *this;
+  }
+  // the system must run on the calling thread and alone, anything touching
+  // the window, the rendering context or undeclared global state
+  SystemAccess &mainThread() {
+    m_mainThread = true;
+    return *this;
+  }
+
+  [[nodiscard]] bool isMainThread() const { return m_mainThread; }
+  [[nodiscard]] bool conflictsWith(const SystemAccess &other) const {
+    return m_mainThread || other.m_mainThread ||
+           m_writes.intersects(other.m_writes) ||
+           m_writes.intersects(other.m_reads) ||
+           m_reads.intersects(other.m_writes);
+  }
+
+ private:
+  ecs::ComponentMask m_reads;
+  ecs::ComponentMask m_writes;
+  bool m_mainThread = false;
+};
+
+/*
+The frame scheduler runs the systems of the engine, phase after phase. Inside
+a phase the systems are grouped in waves: a system lands in the first wave
+after all the systems registered before it that it conflicts with, systems in
+the same wave do not conflict and run in parallel on the worker pool. The
+registration order is the execution order for conflicting systems, which
+keeps the frame deterministic.
+The schedule is computed once and only rebuilt when systems are added.
+
+Every system and phase gets timed, the timings of the last frame are
+available for the debug ui.
+*/
+class FrameScheduler final {
+ public:
+  using SystemFunction = std::function<void(const FrameContext &)>;
+
+  // without a pool everything runs on the calling thread
+  explicit FrameScheduler(WorkerPool *pool);
+  ~FrameScheduler() = default;
+  FrameScheduler(const FrameScheduler &) = delete;
+  FrameScheduler &operator=(const FrameScheduler &) = delete;
+
+  // returns the index of the system, used to get its timings. The name is
+  // not copied and must outlive the scheduler
+  uint32_t addSystem(const char *name, FramePhase phase,
+                     const SystemAccess &access, SystemFunction function);
+
+  // runs all the phases in order and returns when the frame is done
+  void runFrame(uint64_t deltaTimeNs);
+
+  [[nodiscard]] uint64_t getFrameIndex() const { return m_frameIndex; }
+  [[nodiscard]] WorkerPool *getWorkerPool() const { return m_pool; }
+  [[nodiscard]] uint32_t getSystemCount() const {
+    return static_cast<uint32_t>(m_systems.size());
+  }
+  [[nodiscard]] const char *getSystemName(const uint32_t system) const {
+    return m_systems[system].name;
+  }
+  [[nodiscard]] FramePhase getSystemPhase(const uint32_t system) const {
+    return m_systems[system].phase;
+  }
+  // timings of the last frame
+  [[nodiscard]] uint64_t getSystemTimeNs(const uint32_t system) const {
+    return m_systems[system].lastTimeNs;
+  }
+  [[nodiscard]] uint64_t getPhaseTimeNs(const FramePhase phase) const {
+    return m_phaseTimesNs[static_cast<uint32_t>(phase)];
+  }
+  // how many times the phase has to wait for a group of systems to be done,
+  // the lower the better
+  [[nodiscard]] uint32_t getWaveCount(FramePhase phase);
+
+ private:
+  struct System {
+    const char *name;
+    FramePhase phase;
+    SystemAccess access;
+    SystemFunction function;
+    uint64_t lastTimeNs;
+  };
+  struct Wave {
+    // range in m_waveSystems
+    uint32_t first;
+    uint32_t count;
+  };
+
+  void buildSchedule();
+  void runSystem(uint32_t system, WorkerPool *pool);
+
+ private:
+  WorkerPool *m_pool;
+  Clock<std::chrono::nanoseconds> m_clock;
+  std::vector<System> m_systems;
+  // waves of every phase, back to back, m_phaseWaves[p] is the index of the
+  // first wave of phase p, the last element is the total wave count
+  std::vector<Wave> m_waves;
+  std::vector<uint32_t> m_waveSystems;
+  uint32_t m_phaseWaves[FRAME_PHASE_COUNT + 1]{};
+  bool m_scheduleDirty = true;
+
+  uint64_t m_frameIndex = 0;
+  uint64_t m_deltaTimeNs = 0;
+  uint64_t m_phaseTimesNs[FRAME_PHASE_COUNT]{};
+};
+
+}  // namespace SirEngine
@@ -34,6 +34,8 @@ graphics::LightManager *LIGHT_MANAGER = nullptr;
 graphics::BindingTableManager *BINDING_TABLE_MANAGER = nullptr;
 InteropData *INTEROP_DATA = nullptr;
 ImGuiManager *IMGUI_MANAGER = nullptr;
+FrameScheduler *FRAME_SCHEDULER = nullptr;
+EventBus *EVENT_BUS = nullptr;
 TextureHandle OFFSCREEN_BUFFER= {};
 
 // generic allocators
@@ -26,6 +26,8 @@ class DependencyGraph;
 class DebugRenderer;
 class CommandBufferManager;
 class ImGuiManager;
+class FrameScheduler;
+class EventBus;
 
 class StringPool;
 class StackAllocator;
@@ -77,6 +79,8 @@ extern graphics::LightManager *LIGHT_MANAGER;
 extern graphics::BindingTableManager *BINDING_TABLE_MANAGER;
 extern InteropData *INTEROP_DATA;
 extern ImGuiManager *IMGUI_MANAGER;
+extern FrameScheduler *FRAME_SCHEDULER;
+extern EventBus *EVENT_BUS;
 // TODO remove this, figure out a way to make imgui and the engine communicate
 extern TextureHandle OFFSCREEN_BUFFER;
 
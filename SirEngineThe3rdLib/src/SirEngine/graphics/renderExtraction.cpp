@@ -0,0 +1,140 @@
+#include "SirEngine/graphics/renderExtraction.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "SirEngine/workerPool.h"
+
+namespace SirEngine {
+
+uint32_t getDrawRunEnd(const DrawList &list, const uint32_t start) {
+  assert(start < list.count);
+  const DrawPacket &first = list.packets[start];
+  uint32_t end = start + 1;
+  while ((end < list.count) &&
+         (list.packets[end].mesh.handle == first.mesh.handle) &&
+         (list.packets[end].material.handle == first.material.handle)) {
+    ++end;
+  }
+  return end;
+}
+
+bool isSphereInFrustum(const Plane *frustum, const glm::vec3 &center,
+                       const float radius) {
+  for (int i = 0; i < 6; ++i) {
+    const glm::vec3 normal(frustum[i].normal);
+    const glm::vec3 position(frustum[i].position);
+    if (glm::dot(normal, center - position) > radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void getWorldBoundingSphere(const glm::mat4 &matrix, const RenderBounds &bounds,
+                            glm::vec3 &outCenter, float &outRadius) {
+  outCenter = glm::vec3(matrix * glm::vec4(bounds.center, 1.0f));
+  const float scale2 = std::fmax(
+      glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+      std::fmax(glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])),
+                glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))));
+  outRadius = bounds.radius * std::sqrt(scale2);
+}
+
+void RenderExtractor::extractBatch(Batch &batch, DrawPacket *packets,
+                                   const Plane *frustum) {
+  DrawPacket *out = packets + batch.offset;
+  uint32_t visible = 0;
+  for (uint32_t i = 0; i < batch.count; ++i) {
+    const glm::mat4 &matrix = batch.transforms[i].matrix;
+    if (frustum != nullptr) {
+      glm::vec3 center;
+      float radius;
+      getWorldBoundingSphere(matrix, batch.bounds[i], center, radius);
+      if (!isSphereInFrustum(frustum, center, radius)) {
+        continue;
+      }
+    }
+    DrawPacket &packet = out[visible++];
+    packet.worldMatrix = matrix;
+    packet.mesh = batch.renderer->mesh;
+    packet.material = batch.renderer->material;
+  }
+  batch.visibleCount = visible;
+}
+
+DrawList RenderExtractor::extract(ecs::Registry &registry,
+                                  StackAllocator &frameAllocator,
+                                  const Plane *frustum, WorkerPool *pool,
+                                  const uint32_t batchSize) {
+  assert(batchSize != 0);
+  // sorted by shared value, renderables with the same mesh and material are
+  // next to each other
+  registry.populateSharedComponentQuery(m_query);
+
+  m_batches.clear();
+  uint32_t total = 0;
+  for (const auto &entry : m_query) {
+    const auto count = static_cast<uint32_t>(std::get<0>(entry));
+    for (uint32_t start = 0; start < count; start += batchSize) {
+      Batch batch{};
+      batch.renderer = std::get<1>(entry);
+      batch.transforms = std::get<2>(entry) + start;
+      batch.bounds = std::get<3>(entry) + start;
+      batch.count = count - start < batchSize ? count - start : batchSize;
+      batch.offset = total;
+      total += batch.count;
+      m_batches.push_back(batch);
+    }
+  }
+
+  DrawList list;
+  list.extractedCount = total;
+  if (total == 0) {
+    return list;
+  }
+
+  // worst case, nothing gets culled
+  constexpr size_t alignment =
+      alignof(DrawPacket) < 16 ? 16 : alignof(DrawPacket);
+  const size_t requestedSize = sizeof(DrawPacket) * total + alignment - 1;
+  auto *raw = static_cast<char *>(frameAllocator.allocate(requestedSize));
+  const size_t padding =
+      (alignment - (reinterpret_cast<size_t>(raw) & (alignment - 1))) &
+      (alignment - 1);
+  auto *packets = reinterpret_cast<DrawPacket *>(raw + padding);
+
+  const auto batchCount = static_cast<uint32_t>(m_batches.size());
+  if ((pool != nullptr) && (batchCount > 1)) {
+    pool->parallelFor(batchCount, [&](const uint32_t taskIndex) {
+      extractBatch(m_batches[taskIndex], packets, frustum);
+    });
+  } else {
+    for (Batch &batch : m_batches) {
+      extractBatch(batch, packets, frustum);
+    }
+  }
+
+  // closing the gaps left by culling, batches only ever move backward
+  uint32_t count = 0;
+  for (const Batch &batch : m_batches) {
+    if ((batch.offset != count) && (batch.visibleCount != 0)) {
+      memmove(packets + count, packets + batch.offset,
+              sizeof(DrawPacket) * batch.visibleCount);
+    }
+    count += batch.visibleCount;
+  }
+
+  // the list is the last allocation on the stack, the culled tail and the
+  // unused alignment padding can go back
+  const size_t usedSize = padding + sizeof(DrawPacket) * count;
+  frameAllocator.free(requestedSize - usedSize);
+
+  list.packets = packets;
+  list.count = count;
+  return list;
+}
+
+}  // namespace SirEngine
@@ -0,0 +1,120 @@
+#pragma once
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include "SirEngine/ecs/ecs.h"
+#include "SirEngine/ecs/transformHierarchy.h"
+#include "SirEngine/graphics/cpuGraphicsStructures.h"
+#include "SirEngine/handle.h"
+
+namespace SirEngine {
+
+class StackAllocator;
+class WorkerPool;
+
+// mesh and material drawn by the entity. The component is shared, every
+// mesh/material pair gets its own archetype partition so the extraction
+// produces them as contiguous runs of packets
+struct MeshRenderer {
+  MeshHandle mesh;
+  MaterialHandle material;
+};
+
+// bounding sphere in the local space of the entity, used for culling
+struct RenderBounds {
+  // radius of entities that should never be culled
+  static constexpr float UNBOUNDED_RADIUS =
+      std::numeric_limits<float>::infinity();
+
+  glm::vec3 center;
+  float radius;
+};
+
+// everything a backend needs to issue a draw, independent from the API
+struct DrawPacket {
+  glm::mat4 worldMatrix;
+  MeshHandle mesh;
+  MaterialHandle material;
+};
+
+struct DrawList {
+  // contiguous array living in the frame allocator, valid until the
+  // allocator is reset. Packets sharing mesh and material are consecutive
+  const DrawPacket *packets = nullptr;
+  uint32_t count = 0;
+  // renderables considered before culling
+  uint32_t extractedCount = 0;
+};
+
+// returns one past the last packet of the run starting at start, a run is a
+// set of consecutive packets with the same mesh and material, which a backend
+// can bind once and draw instanced
+uint32_t getDrawRunEnd(const DrawList &list, uint32_t start);
+
+/*
+The render extraction turns the renderables living in the ecs into a flat
+array of draw packets, rebuilt every frame. Renderables are the entities
+having a WorldTransform, a RenderBounds and a MeshRenderer.
+
+The packet array is allocated upfront from the frame allocator for the worst
+case, every archetype partition is then split in batches of batchSize
+entities and every batch writes its visible packets at its own offset, such
+that the workers never need to synchronize. A last serial pass closes the
+gaps left by culled entities and gives the unused tail back to the allocator.
+When a frustum is given, the bounding spheres get tested against the six
+planes, normals are expected pointing out of the volume as computed by the
+camera for the CameraBuffer.
+
+The extraction only reads the registry, it does not bump any change version.
+*/
+class RenderExtractor final {
+ public:
+  static constexpr uint32_t DEFAULT_BATCH_SIZE = 512;
+
+  RenderExtractor() = default;
+  ~RenderExtractor() = default;
+  RenderExtractor(const RenderExtractor &) = delete;
+  RenderExtractor &operator=(const RenderExtractor &) = delete;
+
+  // frustum is either null, to skip culling, or six planes. Without a pool
+  // the extraction runs on the calling thread
+  DrawList extract(ecs::Registry &registry, StackAllocator &frameAllocator,
+                   const Plane *frustum, WorkerPool *pool,
+                   uint32_t batchSize = DEFAULT_BATCH_SIZE);
+
+ private:
+  struct Batch {
+    const MeshRenderer *renderer;
+    const ecs::WorldTransform *transforms;
+    const RenderBounds *bounds;
+    uint32_t count;
+    // where the batch writes in the packet array
+    uint32_t offset;
+    uint32_t visibleCount;
+  };
+
+  static void extractBatch(Batch &batch, DrawPacket *packets,
+                           const Plane *frustum);
+
+ private:
+  std::vector<std::tuple<size_t, const MeshRenderer *,
+                         const ecs::WorldTransform *, const RenderBounds *>>
+      m_query;
+  std::vector<Batch> m_batches;
+};
+
+// sphere in world space against the six planes, touching counts as inside
+bool isSphereInFrustum(const Plane *frustum, const glm::vec3 &center,
+                       float radius);
+// moves the local bounding sphere in world space, the radius grows with the
+// biggest axis scale of the matrix
+void getWorldBoundingSphere(const glm::mat4 &matrix, const RenderBounds &bounds,
+                            glm::vec3 &outCenter, float &outRadius);
+
+}  // namespace SirEngine
+
+SE_ECS_SHARED_COMPONENT(SirEngine::MeshRenderer)
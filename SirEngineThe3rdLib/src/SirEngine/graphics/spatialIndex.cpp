@@ -0,0 +1,387 @@
+#include "SirEngine/graphics/spatialIndex.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace SirEngine {
+
+// cell coordinates are packed in 21 bits each to build the lookup key
+static constexpr int32_t MAX_CELL_COORD = (1 << 20) - 1;
+
+static bool isSphereTouchingAabb(const glm::vec4 &sphere,
+                                 const glm::vec3 &minCorner,
+                                 const glm::vec3 &maxCorner) {
+  const glm::vec3 center(sphere);
+  const glm::vec3 closest = glm::min(glm::max(center, minCorner), maxCorner);
+  const glm::vec3 delta = center - closest;
+  return glm::dot(delta, delta) <= sphere.w * sphere.w;
+}
+
+static bool isSphereTouchingSphere(const glm::vec4 &sphere,
+                                   const glm::vec3 &center,
+                                   const float radius) {
+  const glm::vec3 delta = glm::vec3(sphere) - center;
+  const float distance = sphere.w + radius;
+  return glm::dot(delta, delta) <= distance * distance;
+}
+
+SpatialIndex::SpatialIndex(const float cellSize)
+    : m_cellSize(cellSize), m_invCellSize(1.0f / cellSize) {
+  assert(cellSize > 0.0f);
+}
+
+SpatialIndex::CellCoord SpatialIndex::getCellCoord(
+    const glm::vec3 &position) const {
+  CellCoord coord{};
+  int32_t *out = &coord.x;
+  for (int i = 0; i < 3; ++i) {
+    const float cell = std::floor(position[i] * m_invCellSize);
+    // out of range positions end up in the border cells, queries stay
+    // correct just slower
+    const float clamped =
+        std::fmax(std::fmin(cell, static_cast<float>(MAX_CELL_COORD)),
+                  static_cast<float>(-MAX_CELL_COORD));
+    out[i] = static_cast<int32_t>(clamped);
+  }
+  return coord;
+}
+
+uint64_t SpatialIndex::getCellKey(const CellCoord &coord) {
+  constexpr uint64_t mask = (1ull << 21) - 1;
+  return ((static_cast<uint64_t>(coord.x + MAX_CELL_COORD) & mask) << 42) |
+         ((static_cast<uint64_t>(coord.y + MAX_CELL_COORD) & mask) << 21) |
+         (static_cast<uint64_t>(coord.z + MAX_CELL_COORD) & mask);
+}
+
+void SpatialIndex::insertSlot(const uint32_t slot) {
+  const glm::vec4 &sphere = m_spheres[slot];
+  // a nan radius fails the test as well, broken transforms end up in the
+  // large list where they can not corrupt the grid bounds
+  uint32_t cellIndex = LARGE_CELL;
+  if (sphere.w <= m_cellSize) {
+    const CellCoord coord = getCellCoord(glm::vec3(sphere));
+    const uint64_t key = getCellKey(coord);
+    const auto found = m_cellLookup.find(key);
+    if (found != m_cellLookup.end()) {
+      cellIndex = found->second;
+    } else if (!m_freeCells.empty()) {
+      // the slots vector of an old cell keeps its memory
+      cellIndex = m_freeCells.back();
+      m_freeCells.pop_back();
+      m_cells[cellIndex].coord = coord;
+      m_cellLookup[key] = cellIndex;
+    } else {
+      cellIndex = static_cast<uint32_t>(m_cells.size());
+      m_cells.push_back({coord, 0.0f, false, {}});
+      m_cellLookup[key] = cellIndex;
+    }
+    Cell &cell = m_cells[cellIndex];
+    cell.maxRadius = std::fmax(cell.maxRadius, sphere.w);
+    m_maxGridRadius = std::fmax(m_maxGridRadius, sphere.w);
+  }
+  std::vector<uint32_t> &slots = getSlots(cellIndex);
+  m_cellIndices[slot] = cellIndex;
+  m_cellPositions[slot] = static_cast<uint32_t>(slots.size());
+  slots.push_back(slot);
+}
+
+void SpatialIndex::removeSlot(const uint32_t slot) {
+  const uint32_t cellIndex = m_cellIndices[slot];
+  std::vector<uint32_t> &slots = getSlots(cellIndex);
+  const uint32_t position = m_cellPositions[slot];
+  const uint32_t last = slots.back();
+  slots[position] = last;
+  m_cellPositions[last] = position;
+  slots.pop_back();
+  if (cellIndex == LARGE_CELL) {
+    return;
+  }
+  Cell &cell = m_cells[cellIndex];
+  if (slots.empty()) {
+    m_cellLookup.erase(getCellKey(cell.coord));
+    m_freeCells.push_back(cellIndex);
+    cell.maxRadius = 0.0f;
+    if (m_spheres[slot].w >= m_maxGridRadius) {
+      m_gridRadiusDirty = true;
+    }
+    return;
+  }
+  onRadiusRemoved(cellIndex, m_spheres[slot].w);
+}
+
+void SpatialIndex::onRadiusRemoved(const uint32_t cellIndex,
+                                   const float radius) {
+  Cell &cell = m_cells[cellIndex];
+  if (radius < cell.maxRadius) {
+    return;
+  }
+  if (!cell.radiusDirty) {
+    cell.radiusDirty = true;
+    m_dirtyCells.push_back(cellIndex);
+  }
+  if (radius >= m_maxGridRadius) {
+    m_gridRadiusDirty = true;
+  }
+}
+
+void SpatialIndex::shrinkRadii() {
+  // cells emptied after being marked have no slots and stay at zero, cells
+  // reused in the meantime get recomputed, harmless
+  for (const uint32_t cellIndex : m_dirtyCells) {
+    Cell &cell = m_cells[cellIndex];
+    float maxRadius = 0.0f;
+    for (const uint32_t slot : cell.slots) {
+      maxRadius = std::fmax(maxRadius, m_spheres[slot].w);
+    }
+    cell.maxRadius = maxRadius;
+    cell.radiusDirty = false;
+  }
+  m_dirtyCells.clear();
+  if (!m_gridRadiusDirty) {
+    return;
+  }
+  // empty cells have a zero radius
+  float maxRadius = 0.0f;
+  for (const Cell &cell : m_cells) {
+    maxRadius = std::fmax(maxRadius, cell.maxRadius);
+  }
+  m_maxGridRadius = maxRadius;
+  m_gridRadiusDirty = false;
+}
+
+void SpatialIndex::addEntity(ecs::Registry &registry, const ecs::EntityId eid) {
+  assert(registry.hasComponent<ecs::WorldTransform>(eid));
+  assert(registry.hasComponent<RenderBounds>(eid));
+  assert(!registry.hasComponent<SpatialNode>(eid));
+  const ecs::Registry &constRegistry = registry;
+  glm::vec3 center;
+  float radius;
+  getWorldBoundingSphere(
+      constRegistry.getComponent<ecs::WorldTransform>(eid).matrix,
+      constRegistry.getComponent<RenderBounds>(eid), center, radius);
+
+  const auto slot = static_cast<uint32_t>(m_entities.size());
+  m_entities.push_back(eid);
+  m_spheres.emplace_back(center, radius);
+  m_cellIndices.push_back(LARGE_CELL);
+  m_cellPositions.push_back(0);
+  insertSlot(slot);
+  registry.addComponent(eid, SpatialNode{slot});
+}
+
+void SpatialIndex::removeEntity(ecs::Registry &registry,
+                                const ecs::EntityId eid) {
+  const ecs::Registry &constRegistry = registry;
+  const uint32_t slot = constRegistry.getComponent<SpatialNode>(eid).slot;
+  assert(slot < m_entities.size() && m_entities[slot].index == eid.index);
+  removeSlot(slot);
+
+  // the last slot fills the hole
+  const auto last = static_cast<uint32_t>(m_entities.size() - 1);
+  if (slot != last) {
+    m_entities[slot] = m_entities[last];
+    m_spheres[slot] = m_spheres[last];
+    m_cellIndices[slot] = m_cellIndices[last];
+    m_cellPositions[slot] = m_cellPositions[last];
+    getSlots(m_cellIndices[slot])[m_cellPositions[slot]] = slot;
+    registry.getComponent<SpatialNode>(m_entities[slot]).slot = slot;
+  }
+  m_entities.pop_back();
+  m_spheres.pop_back();
+  m_cellIndices.pop_back();
+  m_cellPositions.pop_back();
+  registry.removeComponent<SpatialNode>(eid);
+}
+
+void SpatialIndex::gatherChanged() {
+  for (const auto &q : m_changedQuery) {
+    const size_t count = std::get<0>(q);
+    const ecs::WorldTransform *transforms = std::get<1>(q);
+    const RenderBounds *bounds = std::get<2>(q);
+    const SpatialNode *nodes = std::get<3>(q);
+    for (size_t i = 0; i < count; ++i) {
+      // change detection works on chunks of rows, here we filter out the rows
+      // that did not actually move
+      glm::vec3 center;
+      float radius;
+      getWorldBoundingSphere(transforms[i].matrix, bounds[i], center, radius);
+      const glm::vec4 sphere(center, radius);
+      const uint32_t slot = nodes[i].slot;
+      if (memcmp(&m_spheres[slot], &sphere, sizeof(glm::vec4)) == 0) {
+        continue;
+      }
+      ++m_lastUpdatedCount;
+      const uint32_t cellIndex = m_cellIndices[slot];
+      // most moves stay in the same cell
+      if ((cellIndex != LARGE_CELL) && (radius <= m_cellSize)) {
+        Cell &cell = m_cells[cellIndex];
+        const CellCoord coord = getCellCoord(center);
+        if ((coord.x == cell.coord.x) && (coord.y == cell.coord.y) &&
+            (coord.z == cell.coord.z)) {
+          if (radius < m_spheres[slot].w) {
+            onRadiusRemoved(cellIndex, m_spheres[slot].w);
+          }
+          m_spheres[slot] = sphere;
+          cell.maxRadius = std::fmax(cell.maxRadius, radius);
+          m_maxGridRadius = std::fmax(m_maxGridRadius, radius);
+          continue;
+        }
+      }
+      removeSlot(slot);
+      m_spheres[slot] = sphere;
+      insertSlot(slot);
+    }
+  }
+}
+
+void SpatialIndex::update(ecs::Registry &registry) {
+  m_lastUpdatedCount = 0;
+  if (!m_entities.empty()) {
+    registry.populateChangedComponentQuery<ecs::WorldTransform>(
+        m_changedQuery, m_lastSeenVersion);
+    gatherChanged();
+    registry.populateChangedComponentQuery<RenderBounds>(m_changedQuery,
+                                                         m_lastSeenVersion);
+    gatherChanged();
+  }
+  shrinkRadii();
+  m_lastSeenVersion = registry.advanceVersion();
+}
+
+template <typename FUNC>
+void SpatialIndex::forEachCell(const glm::vec3 &minCorner,
+                               const glm::vec3 &maxCorner, FUNC &&func) const {
+  // a sphere can stick out of its cell by its radius
+  const CellCoord first = getCellCoord(minCorner - glm::vec3(m_maxGridRadius));
+  const CellCoord last = getCellCoord(maxCorner + glm::vec3(m_maxGridRadius));
+  const uint64_t rangeVolume =
+      static_cast<uint64_t>(last.x - first.x + 1) *
+      static_cast<uint64_t>(last.y - first.y + 1) *
+      static_cast<uint64_t>(last.z - first.z + 1);
+
+  // big query volumes are cheaper to resolve walking the existing cells than
+  // probing the hash map for every coordinate in range
+  if (rangeVolume > getCellCount()) {
+    for (const Cell &cell : m_cells) {
+      const CellCoord &c = cell.coord;
+      if (!cell.slots.empty() && (c.x >= first.x) && (c.x <= last.x) &&
+          (c.y >= first.y) && (c.y <= last.y) && (c.z >= first.z) &&
+          (c.z <= last.z)) {
+        func(cell);
+      }
+    }
+    return;
+  }
+  for (int32_t x = first.x; x <= last.x; ++x) {
+    for (int32_t y = first.y; y <= last.y; ++y) {
+      for (int32_t z = first.z; z <= last.z; ++z) {
+        const auto found = m_cellLookup.find(getCellKey({x, y, z}));
+        if ((found != m_cellLookup.end()) &&
+            !m_cells[found->second].slots.empty()) {
+          func(m_cells[found->second]);
+        }
+      }
+    }
+  }
+}
+
+void SpatialIndex::queryAabb(const glm::vec3 &minCorner,
+                             const glm::vec3 &maxCorner,
+                             std::vector<ecs::EntityId> &outEntities) const {
+  outEntities.clear();
+  forEachCell(minCorner, maxCorner, [&](const Cell &cell) {
+    // cells whose loose bounds are fully inside the box skip the per entity
+    // tests
+    bool inside = true;
+    const int32_t *coord = &cell.coord.x;
+    for (int i = 0; i < 3; ++i) {
+      const float cellMin =
+          static_cast<float>(coord[i]) * m_cellSize - cell.maxRadius;
+      const float cellMax = cellMin + m_cellSize + 2.0f * cell.maxRadius;
+      inside &= (cellMin >= minCorner[i]) && (cellMax <= maxCorner[i]);
+    }
+    for (const uint32_t slot : cell.slots) {
+      if (inside || isSphereTouchingAabb(m_spheres[slot], minCorner,
+                                         maxCorner)) {
+        outEntities.push_back(m_entities[slot]);
+      }
+    }
+  });
+  for (const uint32_t slot : m_largeSlots) {
+    if (isSphereTouchingAabb(m_spheres[slot], minCorner, maxCorner)) {
+      outEntities.push_back(m_entities[slot]);
+    }
+  }
+}
+
+void SpatialIndex::querySphere(const glm::vec3 &center, const float radius,
+                               std::vector<ecs::EntityId> &outEntities) const {
+  outEntities.clear();
+  const glm::vec3 extent(radius);
+  forEachCell(center - extent, center + extent, [&](const Cell &cell) {
+    for (const uint32_t slot : cell.slots) {
+      if (isSphereTouchingSphere(m_spheres[slot], center, radius)) {
+        outEntities.push_back(m_entities[slot]);
+      }
+    }
+  });
+  for (const uint32_t slot : m_largeSlots) {
+    if (isSphereTouchingSphere(m_spheres[slot], center, radius)) {
+      outEntities.push_back(m_entities[slot]);
+    }
+  }
+}
+
+void SpatialIndex::queryFrustum(const Plane *frustum,
+                                std::vector<ecs::EntityId> &outEntities) const {
+  outEntities.clear();
+  const float halfCell = m_cellSize * 0.5f;
+  for (const Cell &cell : m_cells) {
+    if (cell.slots.empty()) {
+      continue;
+    }
+    // classifying the loose cell box against the planes first, a box fully
+    // outside is skipped, a box fully inside is taken as is
+    const glm::vec3 cellCenter =
+        (glm::vec3(static_cast<float>(cell.coord.x),
+                   static_cast<float>(cell.coord.y),
+                   static_cast<float>(cell.coord.z)) *
+         m_cellSize) +
+        glm::vec3(halfCell);
+    const float extent = halfCell + cell.maxRadius;
+    bool outside = false;
+    bool intersecting = false;
+    for (int i = 0; i < 6; ++i) {
+      const glm::vec3 normal(frustum[i].normal);
+      const float distance =
+          glm::dot(normal, cellCenter - glm::vec3(frustum[i].position));
+      const float projected =
+          extent * (std::fabs(normal.x) + std::fabs(normal.y) +
+                    std::fabs(normal.z));
+      if (distance > projected) {
+        outside = true;
+        break;
+      }
+      intersecting |= distance > -projected;
+    }
+    if (outside) {
+      continue;
+    }
+    for (const uint32_t slot : cell.slots) {
+      const glm::vec4 &sphere = m_spheres[slot];
+      if (!intersecting ||
+          isSphereInFrustum(frustum, glm::vec3(sphere), sphere.w)) {
+        outEntities.push_back(m_entities[slot]);
+      }
+    }
+  }
+  for (const uint32_t slot : m_largeSlots) {
+    const glm::vec4 &sphere = m_spheres[slot];
+    if (isSphereInFrustum(frustum, glm::vec3(sphere), sphere.w)) {
+      outEntities.push_back(m_entities[slot]);
+    }
+  }
+}
+
+}  // namespace SirEngine
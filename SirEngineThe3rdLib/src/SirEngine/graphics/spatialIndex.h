@@ -0,0 +1,148 @@
+#pragma once
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "SirEngine/ecs/ecs.h"
+#include "SirEngine/ecs/transformHierarchy.h"
+#include "SirEngine/graphics/cpuGraphicsStructures.h"
+#include "SirEngine/graphics/renderExtraction.h"
+
+namespace SirEngine {
+
+// where the entity lives in the spatial index, owned by the SpatialIndex
+struct SpatialNode {
+  uint32_t slot;
+};
+
+/*
+The spatial index answers proximity queries, which entities are inside an
+axis aligned box, a sphere or a frustum, without walking all of them.
+Indexed entities have a WorldTransform and a RenderBounds, their bounding
+sphere is moved in world space and bucketed in a uniform grid hashed by cell
+coordinates. The grid is loose: an entity belongs to the cell containing the
+center of its sphere, only the query gets expanded by the biggest radius in
+the grid. Entities with a radius bigger than a cell, or unbounded, are kept
+in a separate list tested on every query.
+
+Like the TransformHierarchy, entities are added explicitly and moves are
+picked up through the registry change detection on WorldTransform and
+RenderBounds, static entities cost nothing on update. Entities need to be
+removed from the index before being deleted from the registry.
+
+Cells that get empty are dropped from the lookup and their storage is
+reused by the next new cell. When the biggest sphere of a cell moves away or
+shrinks, the cell radius and the grid radius are recomputed on the next
+update, until then they stay conservative. Queries are always exact since
+every candidate sphere is tested against the query shape.
+*/
+class SpatialIndex final {
+ public:
+  static constexpr float DEFAULT_CELL_SIZE = 16.0f;
+
+  explicit SpatialIndex(float cellSize = DEFAULT_CELL_SIZE);
+  ~SpatialIndex() = default;
+  SpatialIndex(const SpatialIndex &) = delete;
+  SpatialIndex &operator=(const SpatialIndex &) = delete;
+
+  // the entity needs to have a WorldTransform and a RenderBounds already, the
+  // index will add the SpatialNode component
+  void addEntity(ecs::Registry &registry, ecs::EntityId eid);
+  void removeEntity(ecs::Registry &registry, ecs::EntityId eid);
+
+  // moves the entities whose transform or bounds changed since last update
+  void update(ecs::Registry &registry);
+
+  // the queries clear the output vector and fill it with the entities whose
+  // bounding sphere touches the shape, in no particular order
+  void queryAabb(const glm::vec3 &minCorner, const glm::vec3 &maxCorner,
+                 std::vector<ecs::EntityId> &outEntities) const;
+  void querySphere(const glm::vec3 &center, float radius,
+                   std::vector<ecs::EntityId> &outEntities) const;
+  // six planes with normals pointing out of the volume, see RenderExtractor
+  void queryFrustum(const Plane *frustum,
+                    std::vector<ecs::EntityId> &outEntities) const;
+
+  [[nodiscard]] uint32_t getEntityCount() const {
+    return static_cast<uint32_t>(m_entities.size());
+  }
+  // cells with at least one entity in them
+  [[nodiscard]] uint32_t getCellCount() const {
+    return static_cast<uint32_t>(m_cells.size() - m_freeCells.size());
+  }
+  [[nodiscard]] float getCellSize() const { return m_cellSize; }
+  // the biggest radius in the grid, the queries grow by it
+  [[nodiscard]] float getMaxGridRadius() const { return m_maxGridRadius; }
+  // how many entities moved during the last update
+  [[nodiscard]] uint32_t getLastUpdatedCount() const {
+    return m_lastUpdatedCount;
+  }
+
+ private:
+  struct CellCoord {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+  };
+  struct Cell {
+    CellCoord coord;
+    // biggest radius of the spheres in the cell, it can be bigger than the
+    // actual one until the next update
+    float maxRadius;
+    // the sphere with the biggest radius left, maxRadius needs recomputing
+    bool radiusDirty;
+    std::vector<uint32_t> slots;
+  };
+  static constexpr uint32_t LARGE_CELL = static_cast<uint32_t>(-1);
+
+  CellCoord getCellCoord(const glm::vec3 &position) const;
+  static uint64_t getCellKey(const CellCoord &coord);
+  std::vector<uint32_t> &getSlots(uint32_t cellIndex) {
+    return cellIndex == LARGE_CELL ? m_largeSlots : m_cells[cellIndex].slots;
+  }
+  void insertSlot(uint32_t slot);
+  // needs to be called while the slot still has the sphere it was inserted
+  // with
+  void removeSlot(uint32_t slot);
+  // a sphere of the given radius left the cell or got smaller
+  void onRadiusRemoved(uint32_t cellIndex, float radius);
+  void shrinkRadii();
+  void gatherChanged();
+  // calls func(const Cell&) for every non empty cell overlapping the box
+  template <typename FUNC>
+  void forEachCell(const glm::vec3 &minCorner, const glm::vec3 &maxCorner,
+                   FUNC &&func) const;
+
+ private:
+  float m_cellSize;
+  float m_invCellSize;
+  // biggest radius in the grid, the queries grow by it
+  float m_maxGridRadius = 0.0f;
+  bool m_gridRadiusDirty = false;
+
+  // SoA data indexed by slot, the sphere is center and radius in world space
+  std::vector<ecs::EntityId> m_entities;
+  std::vector<glm::vec4> m_spheres;
+  std::vector<uint32_t> m_cellIndices;
+  // index of the slot in the list of its cell
+  std::vector<uint32_t> m_cellPositions;
+
+  std::vector<Cell> m_cells;
+  std::unordered_map<uint64_t, uint32_t> m_cellLookup;
+  // empty cells, not in the lookup, ready to be reused
+  std::vector<uint32_t> m_freeCells;
+  std::vector<uint32_t> m_dirtyCells;
+  std::vector<uint32_t> m_largeSlots;
+
+  uint32_t m_lastSeenVersion = 0;
+  uint32_t m_lastUpdatedCount = 0;
+  // scratch memory kept around to avoid allocations every update
+  std::vector<std::tuple<size_t, const ecs::WorldTransform *,
+                         const RenderBounds *, const SpatialNode *>>
+      m_changedQuery;
+};
+
+}  // namespace SirEngine
@@ -70,7 +70,9 @@ bool  readAllBytes(const std::string &filename,
   X(ANIM)                 \
   X(PSO)                  \
   X(POINT_TILER)          \
-  X(MATERIAL_METADATA)
+  X(MATERIAL_METADATA)    \
+  X(ECS_SNAPSHOT)         \
+  X(BLEND_TREE)
 
 enum BinaryFileType {
   NONE = 0,
@@ -81,7 +83,9 @@ enum BinaryFileType {
   ANIM = 5,
   PSO = 6,
   POINT_TILER = 7,
-  MATERIAL_METADATA = 8
+  MATERIAL_METADATA = 8,
+  ECS_SNAPSHOT = 9,
+  BLEND_TREE = 10
 };
 
 
@@ -134,6 +138,7 @@ struct SkinMapperData {
 
 struct ClipMapperData {
   int nameSizeInByte;
+  // compressed poses, see clipCompression.h
   int posesSizeInByte;
   float frameRate;
   int bonesPerFrame;
@@ -142,6 +147,12 @@ struct ClipMapperData {
   bool isLoopable;
 };
 
+struct BlendTreeMapperData {
+  uint32_t nameSizeInByte;
+  // compiled program, see blendTree.h
+  uint32_t programSizeInByte;
+};
+
 struct PSOMappedData {
   int psoSizeInByte;
   int psoDescSizeInByte;
@@ -172,3 +183,28 @@ struct PointTilerMapperData {
   int nameSizeInByte;
   int pointsSizeInByte;
 };
+
+// all offsets are in byte from the start of the bulk data, meaning right
+// after the BinaryFileHeader
+struct EcsSnapshotMapperData {
+  uint32_t componentTypeCount;
+  uint32_t archetypeCount;
+  uint32_t columnCount;
+  uint32_t entityCount;
+  uint32_t sparseSetCount;
+  uint32_t freeListHead;
+  uint32_t freeListTail;
+  uint32_t padding;
+  uint32_t sharedStoreCount;
+  uint32_t sharedRefCount;
+  uint32_t singletonCount;
+  uint32_t padding2;
+  uint64_t componentTypesOffset;
+  uint64_t archetypesOffset;
+  uint64_t columnsOffset;
+  uint64_t entitiesOffset;
+  uint64_t sparseSetsOffset;
+  uint64_t sharedStoresOffset;
+  uint64_t sharedRefsOffset;
+  uint64_t singletonsOffset;
+};
@@ -2,6 +2,7 @@
 #include "SirEngine/core.h"
 #include <string>
 #include "SirEngine/events/event.h"
+#include "SirEngine/framePhase.h"
 
 namespace SirEngine {
 
@@ -19,6 +20,9 @@ public:
   virtual void onUpdate() = 0;
   virtual void onEvent(Event &event) = 0;
   virtual void clear() = 0;
+  // phase in which onUpdate gets called, layers record render work in their
+  // update so they run in the submit phase unless told otherwise
+  virtual FramePhase getUpdatePhase() const { return FramePhase::SUBMIT; }
 
 
   inline const std::string getName() { return m_debugName; }
@@ -0,0 +1,127 @@
+#pragma once
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <vector>
+
+namespace SirEngine {
+
+// Fixed size block allocator. Blocks are carved out of bigger page aligned
+// slabs requested to the system, blocks smaller than a page are aligned to
+// their size, the others to the page. Freed blocks are pushed in an intrusive
+// free list (the first bytes of a free block hold the pointer to the next one)
+// and handed out again before any new slab is allocated.
+// Slabs are only released when the pool is destroyed, the pool is meant for
+// long lived systems that keep allocating and freeing blocks of the same size.
+// The pool is not thread safe.
+class ChunkPool final {
+ public:
+  static constexpr uint32_t PAGE_SIZE_IN_BYTES = 4096;
+
+  ChunkPool(const uint32_t blockSizeInBytes, const uint32_t blocksPerSlab)
+      : m_blockSizeInBytes(blockSizeInBytes), m_blocksPerSlab(blocksPerSlab) {
+    assert(blockSizeInBytes != 0);
+    assert((((blockSizeInBytes % PAGE_SIZE_IN_BYTES) == 0) ||
+            ((blockSizeInBytes & (blockSizeInBytes - 1)) == 0)) &&
+           "block size must be a power of two or a multiple of the page size");
+    assert(blockSizeInBytes >= sizeof(void*));
+    assert(blocksPerSlab != 0);
+  }
+  ~ChunkPool() {
+    for (char* slab : m_slabs) {
+      ::operator delete(slab, std::align_val_t{PAGE_SIZE_IN_BYTES});
+    }
+  }
+  ChunkPool(const ChunkPool&) = delete;
+  ChunkPool& operator=(const ChunkPool&) = delete;
+
+  void* allocate() {
+    if (m_freeList == nullptr) {
+      allocateSlab();
+    }
+    FreeBlock* block = m_freeList;
+    m_freeList = block->next;
+    ++m_usedBlockCount;
+    m_peakUsedBlockCount = m_usedBlockCount > m_peakUsedBlockCount
+                               ? m_usedBlockCount
+                               : m_peakUsedBlockCount;
+    return block;
+  }
+
+  void free(void* ptr) {
+    assert(ptr != nullptr);
+    assert(ownsBlock(ptr) && "block does not belong to the pool");
+    assert(m_usedBlockCount != 0);
+    auto* block = static_cast<FreeBlock*>(ptr);
+    block->next = m_freeList;
+    m_freeList = block;
+    --m_usedBlockCount;
+  }
+
+  [[nodiscard]] bool ownsBlock(const void* ptr) const {
+    const auto* bytePtr = static_cast<const char*>(ptr);
+    const size_t slabSize = getSlabSizeInBytes();
+    for (const char* slab : m_slabs) {
+      if ((bytePtr >= slab) & (bytePtr < slab + slabSize)) {
+        return ((bytePtr - slab) % m_blockSizeInBytes) == 0;
+      }
+    }
+    return false;
+  }
+
+  // getters
+  [[nodiscard]] uint32_t getBlockSizeInBytes() const {
+    return m_blockSizeInBytes;
+  }
+  [[nodiscard]] uint32_t getBlocksPerSlab() const { return m_blocksPerSlab; }
+  [[nodiscard]] size_t getSlabSizeInBytes() const {
+    return static_cast<size_t>(m_blockSizeInBytes) * m_blocksPerSlab;
+  }
+  [[nodiscard]] uint32_t getSlabCount() const {
+    return static_cast<uint32_t>(m_slabs.size());
+  }
+  [[nodiscard]] uint32_t getUsedBlockCount() const { return m_usedBlockCount; }
+  [[nodiscard]] uint32_t getPeakUsedBlockCount() const {
+    return m_peakUsedBlockCount;
+  }
+  [[nodiscard]] uint32_t getReservedBlockCount() const {
+    return getSlabCount() * m_blocksPerSlab;
+  }
+  [[nodiscard]] size_t getReservedSizeInBytes() const {
+    return getSlabCount() * getSlabSizeInBytes();
+  }
+  [[nodiscard]] size_t getUsedSizeInBytes() const {
+    return static_cast<size_t>(m_usedBlockCount) * m_blockSizeInBytes;
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  void allocateSlab() {
+    auto* slab = static_cast<char*>(::operator new(
+        getSlabSizeInBytes(), std::align_val_t{PAGE_SIZE_IN_BYTES}));
+    m_slabs.push_back(slab);
+    // threading the blocks in order, such that the first allocation gets the
+    // start of the slab
+    for (uint32_t i = m_blocksPerSlab; i > 0; --i) {
+      auto* block = reinterpret_cast<FreeBlock*>(
+          slab + static_cast<size_t>(i - 1) * m_blockSizeInBytes);
+      block->next = m_freeList;
+      m_freeList = block;
+    }
+  }
+
+ private:
+  std::vector<char*> m_slabs;
+  FreeBlock* m_freeList = nullptr;
+  uint32_t m_blockSizeInBytes;
+  uint32_t m_blocksPerSlab;
+  uint32_t m_usedBlockCount = 0;
+  uint32_t m_peakUsedBlockCount = 0;
+};
+
+}  // namespace SirEngine
@@ -110,7 +110,7 @@ class HashMap<const char *, VALUE, hashString32> {
     assert(bin < m_bins);
     return m_keys[bin];
   }
-  VALUE getValueAtBin(uint32_t bin) {
+  VALUE getValueAtBin(const uint32_t bin) const {
     // no check done whether the bin is used or not, up to you kid
     assert(bin < m_bins);
     return m_values[bin];
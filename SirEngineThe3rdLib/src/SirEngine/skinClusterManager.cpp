@@ -3,20 +3,35 @@
 #include "SirEngine/animation/animationClip.h"
 #include "SirEngine/animation/animationManager.h"
 #include "SirEngine/animation/animationPlayer.h"
+#include "SirEngine/animation/cpuSkinning.h"
 #include "SirEngine/animation/skeleton.h"
 #include "SirEngine/io/binaryFile.h"
 #include "SirEngine/bufferManager.h"
 #include "SirEngine/io/fileUtils.h"
 #include "SirEngine/globals.h"
 #include "SirEngine/log.h"
-#include "platform/windows/graphics/dx12/DX12.h"
-#include "platform/windows/graphics/dx12/dx12BufferManager.h"
 
 namespace SirEngine {
 
-static const int VERTEX_INFLUENCE_COUNT = 6;
 static const float SKIN_TOTAL_WEIGHT_TOLERANCE = 0.001f;
 
+void SkinClusterManager::init() {
+  m_matricesBuffer = m_bufferManager->allocate(
+      MAX_SKIN_MATRICES * sizeof(glm::mat4), nullptr, "skinningMatrices",
+      MAX_SKIN_MATRICES, sizeof(glm::mat4),
+      BufferManager::BUFFER_FLAGS_BITS::STORAGE_BUFFER);
+}
+
+void SkinClusterManager::cleanup() {
+  if (m_matricesBuffer.isHandleValid()) {
+    m_bufferManager->free(m_matricesBuffer);
+    m_matricesBuffer = {};
+  }
+  m_skins.clear();
+  m_nameToHandle.clear();
+  m_allocatedMatrices = 0;
+}
+
 SkinHandle SkinClusterManager::loadSkinCluster(
     const char *path, AnimationConfigHandle animHandle) {
   SE_CORE_INFO("Loading skin {0}", path);
@@ -30,6 +45,7 @@ SkinHandle SkinClusterManager::loadSkinCluster(
     readAllBytes(path, binaryData);
 
     const auto mapper = getMapperData<SkinMapperData>(binaryData.data());
+    assert(mapper->influenceCountPerVertex == VERTEX_INFLUENCE_COUNT);
 
     // lets get the vertex data
     auto *joints =
@@ -40,63 +56,95 @@ SkinHandle SkinClusterManager::loadSkinCluster(
 
     // TODO fix buffer names
     // TODO I think those buffers are in the uplaod heap, they are not
-    BufferHandle influecesHandle = globals::BUFFER_MANAGER->allocate(
+    BufferHandle influecesHandle = m_bufferManager->allocate(
         mapper->jointsSizeInByte, joints, "",
         mapper->jointsSizeInByte / sizeof(int), sizeof(int), false);
-    BufferHandle weightsHandle = globals::BUFFER_MANAGER->allocate(
+    BufferHandle weightsHandle = m_bufferManager->allocate(
         mapper->weightsSizeInByte, weights, "",
         mapper->weightsSizeInByte / sizeof(float), sizeof(float), false);
 
-    // now we need to generate the buffer for the matrices we are going to use
-    const AnimationPlayer *animConfig =
-        globals::ANIMATION_MANAGER->getConfig(animHandle);
-    const uint32_t jointCount = animConfig->getJointCount();
-    const BufferHandle matricesHandle = globals::BUFFER_MANAGER->allocate(
-        jointCount * sizeof(float) * 16, nullptr, "skinningMatrices",
-        jointCount, sizeof(float) * 16,
-        BufferManager::BUFFER_FLAGS_BITS::STORAGE_BUFFER);
-
-    uint32_t index;
-    SkinData &data = m_skinPool.getFreeMemoryData(index);
-    data.animHandle = animHandle;
-    data.influencesBuffer = influecesHandle;
-    data.weightsBuffer = weightsHandle;
-    data.matricesBuffer = matricesHandle;
-
-    // data is now loaded need to create handle etc
-    const SkinHandle handle{(MAGIC_NUMBER_COUNTER << 16) | index};
-    data.magicNumber = MAGIC_NUMBER_COUNTER;
-    ++MAGIC_NUMBER_COUNTER;
-
+    const SkinHandle handle = registerSkinCluster(
+        influecesHandle, weightsHandle, animHandle,
+        globals::ANIMATION_MANAGER->getConfig(animHandle));
+    if (!handle.isHandleValid()) {
+      m_bufferManager->free(influecesHandle);
+      m_bufferManager->free(weightsHandle);
+      return handle;
+    }
     m_nameToHandle[name] = handle;
-
     return handle;
   }
   return found->second;
 }
 
+SkinHandle SkinClusterManager::registerSkinCluster(
+    const BufferHandle influencesBuffer, const BufferHandle weightsBuffer,
+    const AnimationConfigHandle animHandle, AnimationPlayer *player) {
+  assert(player != nullptr);
+  assert(m_matricesBuffer.isHandleValid() && "skin manager not initialized");
+  const uint32_t jointCount = player->getJointCount();
+  if (m_allocatedMatrices + jointCount > MAX_SKIN_MATRICES) {
+    SE_CORE_ERROR(
+        "Out of space in the skinning matrices buffer, {0} of {1} matrices "
+        "in use, can't fit a skin with {2} joints",
+        m_allocatedMatrices, MAX_SKIN_MATRICES, jointCount);
+    return {};
+  }
+
+  SkinData data{};
+  data.animHandle = animHandle;
+  data.player = player;
+  data.influencesBuffer = influencesBuffer;
+  data.weightsBuffer = weightsBuffer;
+  data.matricesOffset = m_allocatedMatrices;
+  data.jointCount = jointCount;
+  data.magicNumber = MAGIC_NUMBER_COUNTER;
+  m_allocatedMatrices += jointCount;
+
+  const uint32_t index = m_skins.size();
+  assert(index <= INDEX_MASK);
+  m_skins.pushBack(data);
+  const SkinHandle handle{(MAGIC_NUMBER_COUNTER << 16) | index};
+  ++MAGIC_NUMBER_COUNTER;
+  return handle;
+}
+
 void SkinClusterManager::uploadDirtyMatrices() {
-  // TODO why the heck I am using a string here? investigate hopefully remove
-  // for a simple array?
-  std::unordered_map<std::string, SkinHandle>::iterator it =
-      m_nameToHandle.begin();
-  while (it != m_nameToHandle.end()) {
-    const SkinHandle handle = it->second;
-    const int index = getIndexFromHandle(handle);
-    const SkinData &data = m_skinPool.getConstRef(index);
-
-    void *mappedData = dx12::BUFFER_MANAGER->getMappedData(data.matricesBuffer);
-    assert(mappedData != nullptr);
-
-    AnimationPlayer *animConfig =
-        globals::ANIMATION_MANAGER->getConfig(data.animHandle);
-    const glm::mat4 *matricesDataToCopy =
-        animConfig->getOutPose()->m_globalPose;
-
-    const uint32_t jointCount = animConfig->getJointCount();
-    memcpy(mappedData, matricesDataToCopy, jointCount * sizeof(float) * 16);
-    animConfig->setFlags(ANIM_FLAGS::READY);
-    ++it;
+  m_uploadedRanges.clear();
+  const uint32_t skinCount = m_skins.size();
+  if (skinCount == 0) {
+    return;
+  }
+  auto *mappedData = static_cast<glm::mat4 *>(
+      m_bufferManager->getMappedData(m_matricesBuffer));
+  assert(mappedData != nullptr);
+
+  for (uint32_t i = 0; i < skinCount; ++i) {
+    const SkinData &data = m_skins[i];
+    if (data.player->getFlags() != ANIM_FLAGS::NEW_MATRICES) {
+      continue;
+    }
+    memcpy(mappedData + data.matricesOffset,
+           data.player->getOutPose()->m_globalPose,
+           sizeof(glm::mat4) * data.jointCount);
+
+    // skins are packed in load order, a dirty skin right after the last
+    // range just extends it
+    const uint32_t rangeCount = m_uploadedRanges.size();
+    if (rangeCount != 0) {
+      SkinMatricesRange &last = m_uploadedRanges[rangeCount - 1];
+      if (last.offset + last.count == data.matricesOffset) {
+        last.count += data.jointCount;
+        continue;
+      }
+    }
+    m_uploadedRanges.pushBack({data.matricesOffset, data.jointCount});
+  }
+
+  // flags are cleared only once every skin has been looked at, more than one
+  // skin can be driven by the same player
+  for (uint32_t i = 0; i < skinCount; ++i) {
+    m_skins[i].player->setFlags(ANIM_FLAGS::READY);
   }
 }
 }  // namespace SirEngine
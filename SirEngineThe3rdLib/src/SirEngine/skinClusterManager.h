@@ -1,40 +1,94 @@
 #pragma once
 #include "SirEngine/handle.h"
-#include "memory/cpu/SparseMemoryPool.h"
+#include "memory/cpu/resizableVector.h"
+#include <cassert>
 #include <stdint.h>
 #include <string>
 #include <unordered_map>
 
 namespace SirEngine {
+class AnimationPlayer;
+class BufferManager;
+
 struct SkinData {
   BufferHandle weightsBuffer;
   BufferHandle influencesBuffer;
-  BufferHandle matricesBuffer;
   // used to look up the matrices we want to use for the render
   AnimationConfigHandle animHandle;
+  // resolved once at load, players live as long as the animation manager
+  AnimationPlayer *player;
+  // where the skin matrices live in the shared matrices buffer, in matrices.
+  // The influences index the skin's own joints, the draw binding the shared
+  // buffer has to pass this offset to skinFullPoint in skinning.hlsl, a root
+  // constant per draw, or every skin but the first reads the wrong matrices
+  uint32_t matricesOffset;
+  uint32_t jointCount;
   uint32_t magicNumber;
 };
 
+// a contiguous range of the shared matrices buffer written by an upload, in
+// matrices
+struct SkinMatricesRange {
+  uint32_t offset;
+  uint32_t count;
+};
+
+/*
+All the skinning matrices live in a single shared buffer, every skin owns a
+range of it, allocated in load order. Skins are kept in a dense array walked
+in that same order, so skins next to each other in the array are next to
+each other in the buffer.
+
+A skin is dirty when its animation player evaluated new matrices this frame,
+the upload only copies the dirty skins and merges neighbouring ones in a
+single range, a crowd evaluated every frame is one range, a crowd where only
+some characters animate is a handful of them. The buffer is accessed only
+through the BufferManager interface, so the manager does not depend on any
+backend.
+*/
 class SkinClusterManager final {
 
 public:
-  SkinClusterManager() : m_skinPool(RESERVE_SIZE) {}
-  virtual ~SkinClusterManager() = default;
-  // here mostly for consistency of interface
-  void init(){};
+  // room in the shared buffer, 1MB worth of matrices
+  static constexpr uint32_t MAX_SKIN_MATRICES = 16 * 1024;
+
+  explicit SkinClusterManager(BufferManager *bufferManager)
+      : m_skins(RESERVE_SIZE), m_uploadedRanges(RESERVE_SIZE),
+        m_bufferManager(bufferManager) {}
+  ~SkinClusterManager() = default;
+  // allocates the shared matrices buffer
+  void init();
+  void cleanup();
   SkinClusterManager(const SkinClusterManager &) = delete;
   SkinClusterManager &operator=(const SkinClusterManager &) = delete;
 
   SkinHandle loadSkinCluster(const char *path,
                              AnimationConfigHandle animHandle);
+  // registers a skin whose vertex data is already uploaded, the player is
+  // the one providing its matrices. Returns an invalid handle when the
+  // matrices buffer has no room left for the skin joints
+  SkinHandle registerSkinCluster(BufferHandle influencesBuffer,
+                                 BufferHandle weightsBuffer,
+                                 AnimationConfigHandle animHandle,
+                                 AnimationPlayer *player);
   inline const SkinData &getSkinData(const SkinHandle handle) const
   {
 	  assertMagicNumber(handle);
 	  const uint32_t idx = getIndexFromHandle(handle);
-	  return m_skinPool.getConstRef(idx);
+	  return m_skins[idx];
+  }
+  [[nodiscard]] BufferHandle getMatricesBuffer() const {
+    return m_matricesBuffer;
   }
 
+  // copies the matrices of the skins whose player evaluated since the last
+  // upload, to be called once the animation evaluation is done
   void uploadDirtyMatrices();
+  // ranges written by the last upload, ordered by offset
+  [[nodiscard]] const ResizableVector<SkinMatricesRange> &
+  getUploadedRanges() const {
+    return m_uploadedRanges;
+  }
 
 private:
   static inline uint32_t getIndexFromHandle(const SkinHandle h) {
@@ -47,18 +101,22 @@ private:
   inline void assertMagicNumber(const SkinHandle handle) const {
 	  const uint32_t magic = getMagicFromHandle(handle);
 	  const uint32_t idx = getIndexFromHandle(handle);
-    assert(m_skinPool.getConstRef(idx).magicNumber == magic &&
+    assert(idx < m_skins.size() && m_skins[idx].magicNumber == magic &&
            "invalid magic handle for skin data");
   }
 
 private:
-  // TODO can we do anything about it?
+  // only used at load time to avoid loading the same skin twice
   std::unordered_map<std::string, SkinHandle> m_nameToHandle;
-  SparseMemoryPool<SkinData> m_skinPool;
+  ResizableVector<SkinData> m_skins;
+  ResizableVector<SkinMatricesRange> m_uploadedRanges;
+  BufferManager *m_bufferManager;
+  BufferHandle m_matricesBuffer{0};
+  uint32_t m_allocatedMatrices = 0;
   static const uint32_t INDEX_MASK = (1 << 16) - 1;
   static const uint32_t MAGIC_NUMBER_MASK = ~INDEX_MASK;
   static const uint32_t RESERVE_SIZE = 200;
   uint32_t MAGIC_NUMBER_COUNTER = 1;
 };
 
-} // namespace SirEngine
\ No newline at end of file
+} // namespace SirEngine
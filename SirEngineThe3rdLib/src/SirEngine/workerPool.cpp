@@ -0,0 +1,165 @@
+#include "SirEngine/workerPool.h"
+
+#include <cassert>
+
+#include "SirEngine/memory/cpu/stackAllocator.h"
+
+namespace SirEngine {
+
+static thread_local uint32_t t_workerIndex = 0;
+
+WorkerPool::WorkerPool(const uint32_t workerCount,
+                       const size_t scratchSizeInBytes)
+    : m_workerCount(workerCount) {
+  assert(workerCount != 0);
+  m_ranges = new TaskRange[workerCount];
+  m_scratchAllocators = new StackAllocator[workerCount];
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    m_scratchAllocators[i].initialize(scratchSizeInBytes);
+  }
+  // the calling thread is worker zero
+  m_threads.reserve(workerCount - 1);
+  for (uint32_t i = 1; i < workerCount; ++i) {
+    m_threads.emplace_back(&WorkerPool::workerLoop, this, i);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    m_shutdown = true;
+  }
+  m_wakeCondition.notify_all();
+  for (std::thread &thread : m_threads) {
+    thread.join();
+  }
+  delete[] m_ranges;
+  delete[] m_scratchAllocators;
+}
+
+StackAllocator &WorkerPool::getScratchAllocator(const uint32_t workerIndex) {
+  assert(workerIndex < m_workerCount);
+  return m_scratchAllocators[workerIndex];
+}
+
+uint32_t WorkerPool::getCurrentWorkerIndex() { return t_workerIndex; }
+
+void WorkerPool::dispatch(const uint32_t taskCount, const TaskFunction function,
+                          void *userData) {
+  assert(m_remainingTasks.load() == 0 && "parallel for can not be nested");
+  if (taskCount == 0) {
+    return;
+  }
+  for (uint32_t i = 0; i < m_workerCount; ++i) {
+    m_scratchAllocators[i].reset();
+  }
+  m_function = function;
+  m_userData = userData;
+  m_remainingTasks.store(taskCount, std::memory_order_relaxed);
+
+  // even split to start with, stealing takes care of the rest
+  const uint32_t perWorker = taskCount / m_workerCount;
+  const uint32_t leftOver = taskCount % m_workerCount;
+  uint32_t begin = 0;
+  for (uint32_t i = 0; i < m_workerCount; ++i) {
+    const uint32_t count = perWorker + (i < leftOver ? 1 : 0);
+    TaskRange &range = m_ranges[i];
+    std::lock_guard<std::mutex> lock(range.mutex);
+    range.begin = begin;
+    range.end = begin + count;
+    begin += count;
+  }
+  assert(begin == taskCount);
+
+  if (m_workerCount > 1) {
+    {
+      std::lock_guard<std::mutex> lock(m_wakeMutex);
+      ++m_generation;
+    }
+    m_wakeCondition.notify_all();
+  }
+
+  const uint32_t previousIndex = t_workerIndex;
+  t_workerIndex = 0;
+  runTasks(0);
+  t_workerIndex = previousIndex;
+
+  // other workers might still be finishing the tasks they took
+  while (m_remainingTasks.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+}
+
+void WorkerPool::workerLoop(const uint32_t workerIndex) {
+  t_workerIndex = workerIndex;
+  uint64_t seenGeneration = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_wakeMutex);
+      m_wakeCondition.wait(lock, [&] {
+        return m_shutdown || (m_generation != seenGeneration);
+      });
+      if (m_shutdown) {
+        return;
+      }
+      seenGeneration = m_generation;
+    }
+    runTasks(workerIndex);
+  }
+}
+
+void WorkerPool::runTasks(const uint32_t workerIndex) {
+  uint32_t task;
+  while (true) {
+    if (!popTask(workerIndex, task)) {
+      if (!stealTasks(workerIndex)) {
+        // nothing left anywhere, tasks still running on other workers are
+        // waited on by the dispatching thread
+        return;
+      }
+      continue;
+    }
+    m_function(m_userData, task);
+    m_remainingTasks.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+bool WorkerPool::popTask(const uint32_t workerIndex, uint32_t &outTask) {
+  TaskRange &range = m_ranges[workerIndex];
+  std::lock_guard<std::mutex> lock(range.mutex);
+  if (range.begin == range.end) {
+    return false;
+  }
+  outTask = range.begin++;
+  return true;
+}
+
+bool WorkerPool::stealTasks(const uint32_t workerIndex) {
+  for (uint32_t i = 1; i < m_workerCount; ++i) {
+    const uint32_t victimIndex = (workerIndex + i) % m_workerCount;
+    TaskRange &victim = m_ranges[victimIndex];
+    uint32_t begin;
+    uint32_t end;
+    {
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      const uint32_t available = victim.end - victim.begin;
+      if (available == 0) {
+        continue;
+      }
+      // taking the back half, rounding up such that a single task can be
+      // stolen too
+      end = victim.end;
+      begin = victim.end - (available + 1) / 2;
+      victim.end = begin;
+    }
+    TaskRange &own = m_ranges[workerIndex];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    assert(own.begin == own.end);
+    own.begin = begin;
+    own.end = end;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace SirEngine
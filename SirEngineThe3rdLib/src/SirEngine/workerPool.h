@@ -0,0 +1,87 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace SirEngine {
+
+class StackAllocator;
+
+// A fixed set of worker threads executing parallel for loops. The tasks of a
+// loop are split evenly in one range per worker, a worker consumes its own
+// range from the front and when it runs dry it steals the back half of the
+// range of another worker, this keeps all the workers busy when tasks have
+// uneven cost without having to pick the right split upfront.
+// The calling thread takes part in the work as worker 0, a pool of N workers
+// spawns N-1 threads. Every worker owns a scratch stack allocator that gets
+// reset at the start of every parallel for.
+// A parallel for can only be issued from one thread at the time and can not
+// be nested.
+class WorkerPool final {
+ public:
+  static constexpr size_t DEFAULT_SCRATCH_SIZE_IN_BYTES = 1024 * 1024;
+
+  explicit WorkerPool(uint32_t workerCount,
+                      size_t scratchSizeInBytes = DEFAULT_SCRATCH_SIZE_IN_BYTES);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // calls func(taskIndex) for every task in [0, taskCount), returns when all
+  // of them are done
+  template <typename FUNC>
+  void parallelFor(const uint32_t taskCount, FUNC &&func) {
+    using FuncType = std::remove_reference_t<FUNC>;
+    auto trampoline = [](void *userData, const uint32_t taskIndex) {
+      (*static_cast<FuncType *>(userData))(taskIndex);
+    };
+    dispatch(taskCount, trampoline,
+             const_cast<std::remove_const_t<FuncType> *>(&func));
+  }
+
+  [[nodiscard]] uint32_t getWorkerCount() const { return m_workerCount; }
+  [[nodiscard]] StackAllocator &getScratchAllocator(uint32_t workerIndex);
+  // index of the worker running the calling thread, zero for any thread not
+  // belonging to a pool
+  [[nodiscard]] static uint32_t getCurrentWorkerIndex();
+
+ private:
+  using TaskFunction = void (*)(void *userData, uint32_t taskIndex);
+
+  // tasks still to be processed by a worker, the owner pops from the front
+  // while thieves split it from the back
+  struct alignas(64) TaskRange {
+    std::mutex mutex;
+    uint32_t begin = 0;
+    uint32_t end = 0;
+  };
+
+  void dispatch(uint32_t taskCount, TaskFunction function, void *userData);
+  void workerLoop(uint32_t workerIndex);
+  void runTasks(uint32_t workerIndex);
+  bool popTask(uint32_t workerIndex, uint32_t &outTask);
+  bool stealTasks(uint32_t workerIndex);
+
+ private:
+  uint32_t m_workerCount;
+  TaskRange *m_ranges = nullptr;
+  StackAllocator *m_scratchAllocators = nullptr;
+  std::vector<std::thread> m_threads;
+
+  TaskFunction m_function = nullptr;
+  void *m_userData = nullptr;
+  std::atomic<uint32_t> m_remainingTasks{0};
+
+  std::mutex m_wakeMutex;
+  std::condition_variable m_wakeCondition;
+  uint64_t m_generation = 0;
+  bool m_shutdown = false;
+};
+
+}  // namespace SirEngine
@@ -266,7 +266,7 @@ bool Dx12RenderingContext::initializeGraphicsDx12(BaseWindow *wnd,
   globals::INTEROP_DATA = new InteropData();
   globals::INTEROP_DATA->initialize();
 
-  globals::SKIN_MANAGER = new SkinClusterManager();
+  globals::SKIN_MANAGER = new SkinClusterManager(BUFFER_MANAGER);
   globals::SKIN_MANAGER->init();
 
   const bool isHeadless = (wnd == nullptr) | (width == 0) | (height == 0);
@@ -0,0 +1,285 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SirEngine/animation/animationManager.h"
+#include "SirEngine/animation/animationPlayer.h"
+#include "SirEngine/animation/clipCompression.h"
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/animation/skeleton.h"
+#include "animationTestUtils.h"
+#include "catch/catch.hpp"
+#include <glm/gtx/transform.hpp>
+
+using SirEngine::ANIM_FLAGS;
+using SirEngine::AnimationLodTier;
+using SirEngine::AnimationManager;
+using SirEngine::JointPose;
+using SirEngine::Skeleton;
+
+namespace {
+// every evaluation moves the animated joints 4 units further along x, in
+// local space
+class StepPlayer final : public SirEngine::AnimationPlayer {
+ public:
+  StepPlayer(const Skeleton &skeleton, const glm::vec3 &position)
+      : m_pose(skeleton) {
+    m_outPose = &m_pose.pose;
+    m_flags = ANIM_FLAGS::READY;
+    m_transform = glm::translate(glm::mat4(1.0f), position);
+  }
+  void evaluate(long long, SirEngine::StackAllocator &) override {
+    ++m_evaluations;
+    const uint32_t jointCount = getJointCount();
+    const uint32_t animated =
+        SirEngine::getAnimatedJointCount(jointCount, m_animatedJointCount);
+    float *translationX = SirEngine::getPoseStream(
+        m_pose.streams.data(), jointCount, SirEngine::POSE_STREAM::TRANS_X);
+    for (uint32_t j = 0; j < animated; ++j) {
+      translationX[j] = static_cast<float>(m_evaluations) * 4.0f;
+    }
+  }
+  uint32_t getJointCount() const override {
+    return m_pose.pose.m_skeleton->m_jointCount;
+  }
+  // local x translation of the joint as last turned into matrices
+  [[nodiscard]] float getJointOffset(const uint32_t joint) const {
+    return SirEngine::getPoseStream(m_pose.streams.data(), getJointCount(),
+                                    SirEngine::POSE_STREAM::TRANS_X)[joint];
+  }
+  [[nodiscard]] float getRootX() const { return m_pose.worldMat[0][3].x; }
+
+  int m_evaluations = 0;
+
+ private:
+  OwnedPose m_pose;
+};
+
+// a single chain, the depth of a joint is its index
+void buildChainSkeleton(const uint32_t jointCount, Skeleton &skeleton) {
+  skeleton.m_jointCount = jointCount;
+  skeleton.m_parentIds.resize(jointCount);
+  skeleton.m_jointsWolrdInv.resize(jointCount);
+  skeleton.m_names.resize(jointCount);
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    skeleton.m_parentIds[i] = static_cast<int>(i) - 1;
+    skeleton.m_jointsWolrdInv[i] = glm::mat4(1.0f);
+    skeleton.m_names[i] = "joint";
+  }
+}
+
+int getEvaluationCount(const std::vector<StepPlayer *> &players) {
+  int count = 0;
+  for (const StepPlayer *player : players) {
+    count += player->m_evaluations;
+  }
+  return count;
+}
+
+// every evaluation of the knight idle on the mannequin skeleton, compressed
+std::vector<char> compressKnightIdle(uint32_t &frameCount) {
+  uint32_t jointCount = 0;
+  const std::vector<JointPose> poses =
+      loadClipPoses("../testData/knightBIdle.json", jointCount);
+  frameCount = static_cast<uint32_t>(poses.size() / jointCount);
+  std::vector<char> compressed;
+  SirEngine::compressClip(poses.data(), jointCount, frameCount,
+                          SirEngine::ClipCompressionSettings{}, compressed);
+  return compressed;
+}
+
+// samples a compressed clip straight from the keys, like the state player
+// does, a frame further at every evaluation
+class ClipPlayer final : public SirEngine::AnimationPlayer {
+ public:
+  ClipPlayer(const Skeleton &skeleton, const void *compressed,
+             const uint32_t frameCount, const uint32_t startFrame)
+      : m_pose(skeleton), m_compressed(compressed), m_frameCount(frameCount),
+        m_frame(startFrame) {
+    m_outPose = &m_pose.pose;
+    m_flags = ANIM_FLAGS::READY;
+  }
+  void evaluate(long long, SirEngine::StackAllocator &) override {
+    m_frame = (m_frame + 1) % m_frameCount;
+    SirEngine::sampleCompressedClip(m_compressed, m_frame, 0.5f,
+                                    m_pose.streams.data(),
+                                    m_animatedJointCount);
+  }
+  uint32_t getJointCount() const override {
+    return m_pose.pose.m_skeleton->m_jointCount;
+  }
+
+ private:
+  OwnedPose m_pose;
+  const void *m_compressed;
+  uint32_t m_frameCount;
+  uint32_t m_frame;
+};
+}  // namespace
+
+TEST_CASE("animation lod spreads the updates over the frames",
+          "[animation]") {
+  Skeleton skeleton;
+  buildChainSkeleton(10, skeleton);
+  AnimationManager manager;
+  manager.init();
+  const AnimationLodTier tiers[SirEngine::ANIMATION_LOD_TIER_COUNT] = {
+      {10.0f, 1, false, -1},
+      {20.0f, 2, false, -1},
+      {30.0f, 4, false, -1},
+      {40.0f, 4, true, -1}};
+  manager.setLodTiers(tiers);
+
+  // 100 players in each tier, registered interleaved
+  std::vector<StepPlayer *> tierPlayers[SirEngine::ANIMATION_LOD_TIER_COUNT];
+  std::vector<std::unique_ptr<StepPlayer>> players;
+  for (uint32_t i = 0; i < 400; ++i) {
+    const uint32_t tier = i % 4;
+    players.push_back(std::make_unique<StepPlayer>(
+        skeleton, glm::vec3(0.0f, 0.0f, 5.0f + tier * 10.0f)));
+    tierPlayers[tier].push_back(players.back().get());
+    manager.registerState(players.back().get());
+  }
+
+  // the first frame evaluates everybody, there is nothing to hold yet
+  manager.evaluate();
+  for (uint32_t tier = 0; tier < SirEngine::ANIMATION_LOD_TIER_COUNT; ++tier) {
+    REQUIRE(getEvaluationCount(tierPlayers[tier]) == 100);
+    REQUIRE(manager.getPlayerLodTier(tier) == tier);
+  }
+  for (int frame = 0; frame < 8; ++frame) {
+    int before[SirEngine::ANIMATION_LOD_TIER_COUNT];
+    for (uint32_t tier = 0; tier < SirEngine::ANIMATION_LOD_TIER_COUNT;
+         ++tier) {
+      before[tier] = getEvaluationCount(tierPlayers[tier]);
+    }
+    for (auto &player : players) {
+      player->setFlags(ANIM_FLAGS::READY);
+    }
+    manager.evaluate();
+    REQUIRE(getEvaluationCount(tierPlayers[0]) - before[0] == 100);
+    REQUIRE(getEvaluationCount(tierPlayers[1]) - before[1] == 50);
+    REQUIRE(getEvaluationCount(tierPlayers[2]) - before[2] == 25);
+    REQUIRE(getEvaluationCount(tierPlayers[3]) - before[3] == 25);
+    // held poses produce no new matrices, interpolated ones do
+    for (uint32_t tier = 0; tier < SirEngine::ANIMATION_LOD_TIER_COUNT;
+         ++tier) {
+      int newMatrices = 0;
+      for (const StepPlayer *player : tierPlayers[tier]) {
+        newMatrices += player->getFlags() == ANIM_FLAGS::NEW_MATRICES;
+      }
+      REQUIRE(newMatrices == (tier == 3 ? 100
+                                        : getEvaluationCount(tierPlayers[tier]) -
+                                              before[tier]));
+    }
+  }
+}
+
+TEST_CASE("animation lod interpolates between updates", "[animation]") {
+  Skeleton skeleton;
+  buildChainSkeleton(3, skeleton);
+  AnimationManager manager;
+  manager.init();
+  const AnimationLodTier tiers[SirEngine::ANIMATION_LOD_TIER_COUNT] = {
+      {10.0f, 1, false, -1},
+      {20.0f, 4, true, -1},
+      {30.0f, 4, true, -1},
+      {40.0f, 4, true, -1}};
+  manager.setLodTiers(tiers);
+  StepPlayer player(skeleton, glm::vec3(15.0f, 0.0f, 0.0f));
+  manager.registerState(&player);
+
+  // evaluated every 4 frames, 4 units further each time, the pose trails one
+  // interval behind and moves a unit per frame in between
+  const float expected[] = {4, 4, 4, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+  for (const float x : expected) {
+    manager.evaluate();
+    REQUIRE(player.getRootX() == Approx(15.0f + x));
+  }
+  REQUIRE(player.m_evaluations == 4);
+
+  // back in the first tier the player is evaluated every frame, no lag
+  player.setTransform(glm::mat4(1.0f));
+  manager.evaluate();
+  REQUIRE(player.m_evaluations == 5);
+  REQUIRE(player.getRootX() == Approx(20.0f));
+}
+
+TEST_CASE("animation lod culls the deep joints", "[animation]") {
+  Skeleton skeleton;
+  buildChainSkeleton(20, skeleton);
+  REQUIRE(skeleton.getJointCountUpToDepth(3) == 4);
+  REQUIRE(skeleton.getJointCountUpToDepth(100) == 20);
+
+  AnimationManager manager;
+  manager.init();
+  const AnimationLodTier tiers[SirEngine::ANIMATION_LOD_TIER_COUNT] = {
+      {10.0f, 1, false, -1},
+      {20.0f, 1, false, 3},
+      {30.0f, 1, false, 3},
+      {40.0f, 1, false, 3}};
+  manager.setLodTiers(tiers);
+  StepPlayer player(skeleton, glm::vec3(0.0f));
+  manager.registerState(&player);
+  manager.evaluate();
+  REQUIRE(player.getAnimatedJointCount() == SirEngine::POSE_ALL_JOINTS);
+
+  // far away, depth 3 rounds up to the first 8 joints, the others keep the
+  // pose of the last full evaluation
+  player.setTransform(glm::translate(glm::mat4(1.0f), glm::vec3(15.0f, 0, 0)));
+  manager.evaluate();
+  manager.evaluate();
+  REQUIRE(player.getAnimatedJointCount() == 4);
+  for (uint32_t joint = 0; joint < 20; ++joint) {
+    REQUIRE(player.getJointOffset(joint) == (joint < 8 ? 12.0f : 4.0f));
+  }
+
+  // the mannequin is breadth first, up to the hands are the first 31 joints,
+  // the fingers and the weapon sockets come after
+  Skeleton mannequin;
+  REQUIRE(mannequin.loadFromFile("../testData/mannequin.json"));
+  REQUIRE(mannequin.getJointCountUpToDepth(8) == 31);
+  REQUIRE(std::string(mannequin.m_names[30]).find("lowerarm_twist_01_r") == 0);
+  REQUIRE(std::string(mannequin.m_names[31]).find("index_01_l") == 0);
+}
+
+TEST_CASE("animation lod per frame", "[.][benchmark]") {
+  // 500 knights playing the idle at different distances from the view
+  Skeleton skeleton;
+  skeleton.loadFromFile("../testData/mannequin.json");
+  uint32_t frameCount = 0;
+  const std::vector<char> compressed = compressKnightIdle(frameCount);
+  constexpr uint32_t playerCount = 500;
+  std::vector<std::unique_ptr<ClipPlayer>> players;
+  AnimationManager manager;
+  manager.init();
+  for (uint32_t i = 0; i < playerCount; ++i) {
+    players.push_back(std::make_unique<ClipPlayer>(
+        skeleton, compressed.data(), frameCount, i % frameCount));
+    manager.registerState(players.back().get());
+  }
+
+  // one distance per default tier
+  const float distances[] = {10.0f, 45.0f, 90.0f, 200.0f};
+  const auto placePlayers = [&](const uint32_t near, const uint32_t medium,
+                                const uint32_t far) {
+    for (uint32_t i = 0; i < playerCount; ++i) {
+      const uint32_t slot = i % 100;
+      const uint32_t tier = slot < near                   ? 0
+                            : slot < near + medium        ? 1
+                            : slot < near + medium + far ? 2
+                                                          : 3;
+      players[i]->setTransform(glm::translate(
+          glm::mat4(1.0f), glm::vec3(distances[tier], 0.0f, 0.0f)));
+    }
+  };
+
+  placePlayers(100, 0, 0);
+  BENCHMARK("500 players all near") { manager.evaluate(); };
+  placePlayers(25, 25, 25);
+  BENCHMARK("500 players a quarter per tier") { manager.evaluate(); };
+  placePlayers(10, 20, 30);
+  BENCHMARK("500 players mostly far") { manager.evaluate(); };
+  placePlayers(0, 0, 0);
+  BENCHMARK("500 players all past the last tier") { manager.evaluate(); };
+}
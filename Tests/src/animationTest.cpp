@@ -1,9 +1,18 @@
+#include <atomic>
+#include <string>
+#include <thread>
+
 #include "resourceProcessing/processor.h"
 #include "SirEngine/animation/animationClip.h"
+#include "SirEngine/animation/animationLoopPlayer.h"
 #include "SirEngine/animation/animationManager.h"
+#include "SirEngine/animation/animationPlayer.h"
 #include "SirEngine/io/argsUtils.h"
+#include "SirEngine/io/fileUtils.h"
 #include "SirEngine/log.h"
+#include "SirEngine/workerPool.h"
 #include "catch/catch.hpp"
+#include "nlohmann/json.hpp"
 
 void compileAnim(const char *in, const char *out) {
   SirEngine::ResourceProcessing::Processor p;
@@ -145,3 +154,78 @@ TEST_CASE("animation key 3 read from frame", "[animation]") {
       SirEngine::ANIM_CLIP_KEYWORDS::L_FOOT_DOWN, 9);
   REQUIRE(resultFrame == 9);
 }
+
+namespace {
+// records when and where it gets called
+class CountingPlayer final : public SirEngine::AnimationPlayer {
+ public:
+  void update(long long) override {
+    ++m_updates;
+    m_updateThread = std::this_thread::get_id();
+  }
+  void evaluate(long long, SirEngine::StackAllocator &scratch) override {
+    // the update of the frame is always done
+    m_updatedFirst = m_updatedFirst && m_updates == m_evaluations + 1;
+    scratch.allocate(256);
+    scratch.free(256);
+    ++m_evaluations;
+  }
+  uint32_t getJointCount() const override { return 0; }
+
+  int m_updates = 0;
+  std::atomic<int> m_evaluations{0};
+  std::thread::id m_updateThread;
+  bool m_updatedFirst = true;
+};
+}  // namespace
+
+TEST_CASE("animation players evaluated in parallel", "[animation]") {
+  SirEngine::AnimationManager animManager;
+  animManager.init();
+  constexpr int playerCount = 103;
+  std::vector<CountingPlayer> players(playerCount);
+  for (CountingPlayer &player : players) {
+    animManager.registerState(&player);
+  }
+
+  SirEngine::WorkerPool pool(4);
+  animManager.evaluate(&pool);
+  animManager.evaluate(&pool);
+  // without a pool everything runs serially on the manager scratch memory
+  animManager.evaluate();
+  for (const CountingPlayer &player : players) {
+    REQUIRE(player.m_updates == 3);
+    REQUIRE(player.m_evaluations == 3);
+    REQUIRE(player.m_updatedFirst);
+    REQUIRE(player.m_updateThread == std::this_thread::get_id());
+  }
+}
+
+TEST_CASE("animation players scaling", "[.][benchmark][animation]") {
+  compileAnim("../testData/idle1.json", "../testData/idle1.clip");
+  nlohmann::json config;
+  SirEngine::getJsonObj("../testData/idle1LoopConfig.json", config);
+
+  const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+  SirEngine::WorkerPool pool(hardwareThreads != 0 ? hardwareThreads : 1);
+  for (const int playerCount : {1, 10, 100, 1000}) {
+    SirEngine::AnimationManager animManager;
+    animManager.init();
+    SirEngine::globals::ANIMATION_MANAGER = &animManager;
+    for (int i = 0; i < playerCount; ++i) {
+      // the clip and the skeleton are shared by all the players
+      auto *player = new SirEngine::AnimationLoopPlayer();
+      player->init(&animManager, config);
+      animManager.registerState(player);
+    }
+
+    const std::string players = std::to_string(playerCount) + " players";
+    BENCHMARK("serial " + players) { animManager.evaluate(); };
+    BENCHMARK("worker pool " + players) { animManager.evaluate(&pool); };
+
+    for (uint32_t i = 0; i < animManager.getAnimStates().size(); ++i) {
+      delete animManager.getAnimStates()[i];
+    }
+  }
+  SirEngine::globals::ANIMATION_MANAGER = nullptr;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/animation/skeleton.h"
+#include "SirEngine/io/fileUtils.h"
+#include "nlohmann/json.hpp"
+
+// helpers shared by the animation tests
+
+// every frame of a clip json, as local poses back to back
+inline std::vector<SirEngine::JointPose> loadClipPoses(const std::string &path,
+                                                       uint32_t &jointCount) {
+  nlohmann::json jObj;
+  SirEngine::getJsonObj(path, jObj);
+  jointCount = jObj["bonesPerPose"].get<uint32_t>();
+  std::vector<SirEngine::JointPose> poses;
+  for (auto &pose : jObj["poses"]) {
+    for (auto &joint : pose) {
+      auto &quat = joint["quat"];
+      auto &pos = joint["pos"];
+      poses.push_back(SirEngine::JointPose{
+          glm::quat(quat[3].get<float>(), quat[0].get<float>(),
+                    quat[1].get<float>(), quat[2].get<float>()),
+          glm::vec3(pos[0].get<float>(), pos[1].get<float>(),
+                    pos[2].get<float>()),
+          1.0f});
+    }
+  }
+  return poses;
+}
+
+// a pose owning its memory, laid out like the animation manager does it and
+// starting from identities
+struct OwnedPose {
+  std::vector<SirEngine::JointPose> localPose;
+  std::vector<float> streams;
+  std::vector<glm::mat4> globalPose;
+  std::vector<glm::mat4> worldMat;
+  SirEngine::SkeletonPose pose{};
+
+  explicit OwnedPose(const SirEngine::Skeleton &skeleton)
+      : localPose(skeleton.m_jointCount,
+                  SirEngine::JointPose{glm::quat(1, 0, 0, 0), glm::vec3(0), 1}),
+        streams(SirEngine::getPoseStreamsSize(skeleton.m_jointCount)),
+        globalPose(skeleton.m_jointCount), worldMat(skeleton.m_jointCount) {
+    SirEngine::jointPosesToStreams(localPose.data(), skeleton.m_jointCount,
+                                   streams.data());
+    pose.m_skeleton = &skeleton;
+    pose.m_localPose = localPose.data();
+    pose.m_localStreams = streams.data();
+    pose.m_globalPose = globalPose.data();
+    pose.m_worldMat = worldMat.data();
+  }
+  // sets both the streams and the joint poses, as they come out of the
+  // streams
+  void setLocalPose(const SirEngine::JointPose *joints) {
+    const uint32_t jointCount = pose.m_skeleton->m_jointCount;
+    SirEngine::jointPosesToStreams(joints, jointCount, streams.data());
+    SirEngine::streamsToJointPoses(streams.data(), jointCount,
+                                   localPose.data());
+  }
+};
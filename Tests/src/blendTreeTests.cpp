@@ -0,0 +1,720 @@
+#include <cfloat>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SirEngine/animation/animationClip.h"
+#include "SirEngine/animation/animationManager.h"
+#include "SirEngine/animation/blendTree.h"
+#include "SirEngine/animation/blendTreePlayer.h"
+#include "SirEngine/animation/clipCompression.h"
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/animation/skeleton.h"
+#include "SirEngine/globals.h"
+#include "SirEngine/io/binaryFile.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "animationTestUtils.h"
+#include "catch/catch.hpp"
+#include "nlohmann/json.hpp"
+#include <glm/gtx/quaternion.hpp>
+
+using SirEngine::AnimationClip;
+using SirEngine::JointPose;
+using SirEngine::POSE_STREAM;
+
+namespace {
+constexpr uint32_t JOINT_COUNT = 20;
+
+// a clip owning its compressed poses the same way a loaded one does
+std::unique_ptr<AnimationClip> makeClip(const std::vector<JointPose> &poses,
+                                        const uint32_t jointCount) {
+  const auto frameCount = static_cast<uint32_t>(poses.size() / jointCount);
+  std::vector<char> compressed;
+  SirEngine::compressClip(poses.data(), jointCount, frameCount,
+                          SirEngine::ClipCompressionSettings{}, compressed);
+  auto clip = std::make_unique<AnimationClip>();
+  clip->m_compressedPoses =
+      SirEngine::globals::PERSISTENT_ALLOCATOR->allocate(compressed.size());
+  memcpy(clip->m_compressedPoses, compressed.data(), compressed.size());
+  clip->m_frameCount = static_cast<int>(frameCount);
+  clip->m_bonesPerFrame = static_cast<int>(jointCount);
+  clip->m_frameRate = 1.0f / 30.0f;
+  return clip;
+}
+
+// every joint holding the same pose for the whole clip
+std::unique_ptr<AnimationClip> makeConstantClip(const glm::quat &rotation,
+                                                const glm::vec3 &translation) {
+  const std::vector<JointPose> poses(JOINT_COUNT * 4,
+                                     JointPose{rotation, translation, 1.0f});
+  return makeClip(poses, JOINT_COUNT);
+}
+
+std::vector<char> compileTree(const char *source) {
+  std::vector<char> program;
+  REQUIRE(SirEngine::compileBlendTree(nlohmann::json::parse(source), program));
+  return program;
+}
+
+struct TreeEvaluation {
+  std::vector<const AnimationClip *> clips;
+  std::vector<float> parameters;
+  std::vector<float> streams;
+  SirEngine::StackAllocator scratch;
+  uint32_t sampledClips = 0;
+
+  explicit TreeEvaluation(const uint32_t jointCount)
+      : streams(SirEngine::getPoseStreamsSize(jointCount)) {
+    scratch.initialize(1024 * 1024);
+  }
+  void evaluate(const std::vector<char> &program,
+                const uint32_t jointCount = JOINT_COUNT,
+                const uint32_t animatedJointCount =
+                    SirEngine::POSE_ALL_JOINTS) {
+    parameters.resize(
+        SirEngine::getBlendTreeHeader(program.data())->parameterCount, 0.0f);
+    sampledClips = SirEngine::evaluateBlendTree(
+        program.data(), clips.data(), parameters.data(), 0, 0, jointCount,
+        streams.data(), scratch, animatedJointCount);
+    REQUIRE(scratch.getStackPtr() == scratch.getStartPtr());
+  }
+  [[nodiscard]] float get(const POSE_STREAM stream,
+                          const uint32_t joint) const {
+    return SirEngine::getPoseStream(streams.data(), JOINT_COUNT,
+                                    stream)[joint];
+  }
+  [[nodiscard]] glm::quat getRotation(const uint32_t joint) const {
+    return glm::quat(get(POSE_STREAM::ROT_W, joint),
+                     get(POSE_STREAM::ROT_X, joint),
+                     get(POSE_STREAM::ROT_Y, joint),
+                     get(POSE_STREAM::ROT_Z, joint));
+  }
+};
+
+SirEngine::BlendTreeInstruction *getInstructions(std::vector<char> &program) {
+  return reinterpret_cast<SirEngine::BlendTreeInstruction *>(
+      program.data() +
+      SirEngine::getBlendTreeHeader(program.data())->instructionsOffset);
+}
+
+// index of the first instruction doing op
+uint32_t findInstruction(std::vector<char> &program,
+                         const SirEngine::BLEND_TREE_OP op) {
+  const uint32_t count =
+      SirEngine::getBlendTreeHeader(program.data())->instructionCount;
+  const SirEngine::BlendTreeInstruction *instructions =
+      getInstructions(program);
+  uint32_t index = 0;
+  while (index < count && instructions[index].op != op) {
+    ++index;
+  }
+  REQUIRE(index < count);
+  return index;
+}
+
+void requireSameRotation(const glm::quat &expected, const glm::quat &result) {
+  REQUIRE(std::abs(glm::dot(expected, result)) ==
+          Approx(1.0f).margin(1e-4f));
+}
+
+glm::quat axisAngle(const float degrees, const glm::vec3 &axis) {
+  return glm::angleAxis(glm::radians(degrees), axis);
+}
+}  // namespace
+
+TEST_CASE("blend tree lerp and 1d blend space", "[animation]") {
+  const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
+  const auto still = makeConstantClip(glm::quat(1, 0, 0, 0), glm::vec3(0.0f));
+  const auto walk =
+      makeConstantClip(axisAngle(60.0f, yAxis), glm::vec3(10.0f, 0, 0));
+  const auto run =
+      makeConstantClip(axisAngle(90.0f, yAxis), glm::vec3(20.0f, 0, 0));
+  TreeEvaluation evaluation(JOINT_COUNT);
+  evaluation.clips = {still.get(), walk.get(), run.get()};
+  const char *clips =
+      R"("clips" : {"a_still" : "still.clip", "b_walk" : "walk.clip",
+                    "c_run" : "run.clip"})";
+
+  const std::vector<char> lerp = compileTree(
+      (std::string(R"({"parameters" : ["aim"], )") + clips + R"(,
+        "root" : {"type" : "lerp", "weight" : "aim", "inputs" : [
+          {"type" : "clip", "clip" : "a_still"},
+          {"type" : "clip", "clip" : "b_walk"}]}})")
+          .c_str());
+  REQUIRE(SirEngine::getBlendTreeParameterIndex(lerp.data(), "aim") == 0);
+  REQUIRE(SirEngine::getBlendTreeParameterIndex(lerp.data(), "speed") == -1);
+  REQUIRE(std::string(SirEngine::getBlendTreeClipPath(lerp.data(), 1)) ==
+          "walk.clip");
+  evaluation.parameters = {0.25f};
+  evaluation.evaluate(lerp);
+  REQUIRE(evaluation.sampledClips == 2);
+  for (uint32_t joint = 0; joint < JOINT_COUNT; ++joint) {
+    REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, joint) ==
+            Approx(2.5f).margin(1e-3f));
+    requireSameRotation(axisAngle(15.0f, yAxis),
+                        evaluation.getRotation(joint));
+  }
+
+  // the inputs get sorted by position
+  const std::vector<char> space = compileTree(
+      (std::string(R"({"parameters" : ["speed"], )") + clips + R"(,
+        "root" : {"type" : "blend1d", "parameter" : "speed", "inputs" : [
+          {"position" : 4.0, "node" : {"type" : "clip", "clip" : "c_run"}},
+          {"position" : 0.0, "node" : {"type" : "clip", "clip" : "a_still"}},
+          {"position" : 1.5, "node" : {"type" : "clip", "clip" : "b_walk"}}
+        ]}})")
+          .c_str());
+  evaluation.parameters = {2.75f};
+  evaluation.evaluate(space);
+  REQUIRE(evaluation.sampledClips == 2);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 3) ==
+          Approx(15.0f).margin(1e-3f));
+  requireSameRotation(axisAngle(75.0f, yAxis), evaluation.getRotation(3));
+
+  // past the ends the closest input is the only one sampled
+  evaluation.parameters = {-1.0f};
+  evaluation.evaluate(space);
+  REQUIRE(evaluation.sampledClips == 1);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 0) ==
+          Approx(0.0f).margin(1e-3f));
+  evaluation.parameters = {10.0f};
+  evaluation.evaluate(space);
+  REQUIRE(evaluation.sampledClips == 1);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 0) ==
+          Approx(20.0f).margin(1e-3f));
+
+  // reduced poses leave the joints past the animated ones alone
+  float *translationX = SirEngine::getPoseStream(
+      evaluation.streams.data(), JOINT_COUNT, POSE_STREAM::TRANS_X);
+  std::fill(translationX, translationX + JOINT_COUNT, -7.0f);
+  evaluation.parameters = {1.5f};
+  evaluation.evaluate(space, JOINT_COUNT, 5);
+  for (uint32_t joint = 0; joint < JOINT_COUNT; ++joint) {
+    REQUIRE(translationX[joint] ==
+            Approx(joint < 8 ? 10.0f : -7.0f).margin(1e-3f));
+  }
+}
+
+TEST_CASE("blend tree n-way and 2d blend space", "[animation]") {
+  const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
+  TreeEvaluation evaluation(JOINT_COUNT);
+
+  // direct blend, the weights get normalized
+  const auto still = makeConstantClip(glm::quat(1, 0, 0, 0), glm::vec3(0.0f));
+  const auto turn =
+      makeConstantClip(axisAngle(90.0f, yAxis), glm::vec3(8.0f, 0, 0));
+  evaluation.clips = {still.get(), turn.get()};
+  const std::vector<char> blend = compileTree(R"({
+    "parameters" : ["turn"],
+    "clips" : {"still" : "still.clip", "turn" : "turn.clip"},
+    "root" : {"type" : "blend", "inputs" : [
+      {"weight" : 2.0, "node" : {"type" : "clip", "clip" : "still"}},
+      {"weight" : "turn", "node" : {"type" : "clip", "clip" : "turn"}}]}})");
+  evaluation.parameters = {2.0f};
+  evaluation.evaluate(blend);
+  REQUIRE(evaluation.sampledClips == 2);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 7) ==
+          Approx(4.0f).margin(1e-3f));
+  requireSameRotation(axisAngle(45.0f, yAxis), evaluation.getRotation(7));
+  // zero weights are never sampled
+  evaluation.parameters = {0.0f};
+  evaluation.evaluate(blend);
+  REQUIRE(evaluation.sampledClips == 1);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 7) ==
+          Approx(0.0f).margin(1e-3f));
+
+  // a 3x3 grid, every clip translated by ten times its position
+  std::vector<std::unique_ptr<AnimationClip>> gridClips;
+  nlohmann::json tree;
+  tree["parameters"] = {"x", "y"};
+  tree["root"]["type"] = "blend2d";
+  tree["root"]["parameters"] = {"x", "y"};
+  evaluation.clips.clear();
+  for (int y = -1; y <= 1; ++y) {
+    for (int x = -1; x <= 1; ++x) {
+      gridClips.push_back(makeConstantClip(
+          glm::quat(1, 0, 0, 0),
+          glm::vec3(static_cast<float>(x) * 10.0f,
+                    static_cast<float>(y) * 10.0f, 0.0f)));
+      const std::string name = "clip" + std::to_string(gridClips.size() + 9);
+      tree["clips"][name] = name + ".clip";
+      nlohmann::json input;
+      input["position"] = {x, y};
+      input["node"] = {{"type", "clip"}, {"clip", name}};
+      tree["root"]["inputs"].push_back(input);
+      evaluation.clips.push_back(gridClips.back().get());
+    }
+  }
+  std::vector<char> grid;
+  REQUIRE(SirEngine::compileBlendTree(tree, grid));
+
+  // on an input it is the only one sampled
+  evaluation.parameters = {1.0f, -1.0f};
+  evaluation.evaluate(grid);
+  REQUIRE(evaluation.sampledClips == 1);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 0) ==
+          Approx(10.0f).margin(1e-3f));
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_Y, 0) ==
+          Approx(-10.0f).margin(1e-3f));
+  // in the middle of a cell the four corners share it
+  evaluation.parameters = {0.5f, 0.5f};
+  evaluation.evaluate(grid);
+  REQUIRE(evaluation.sampledClips == 4);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 0) ==
+          Approx(5.0f).margin(1e-3f));
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_Y, 0) ==
+          Approx(5.0f).margin(1e-3f));
+  // anywhere else only the neighbours contribute and the result moves with
+  // the parameters
+  float previousX = -FLT_MAX;
+  for (float x = -1.5f; x <= 1.5f; x += 0.125f) {
+    evaluation.parameters = {x, 0.3f};
+    evaluation.evaluate(grid);
+    REQUIRE(evaluation.sampledClips <= 4);
+    const float translationX = evaluation.get(POSE_STREAM::TRANS_X, 0);
+    REQUIRE(translationX >= previousX - 1e-3f);
+    REQUIRE(translationX >= -10.0f - 1e-3f);
+    REQUIRE(translationX <= 10.0f + 1e-3f);
+    previousX = translationX;
+  }
+}
+
+TEST_CASE("blend tree additive and masked nodes", "[animation]") {
+  const glm::vec3 xAxis(1.0f, 0.0f, 0.0f);
+  const glm::vec3 yAxis(0.0f, 1.0f, 0.0f);
+  const glm::vec3 zAxis(0.0f, 0.0f, 1.0f);
+  const auto base =
+      makeConstantClip(axisAngle(30.0f, yAxis), glm::vec3(1.0f, 0, 0));
+  const auto reference =
+      makeConstantClip(axisAngle(20.0f, zAxis), glm::vec3(2.0f, 0, 0));
+  const auto additive = makeConstantClip(
+      axisAngle(40.0f, xAxis) * axisAngle(20.0f, zAxis), glm::vec3(5.0f, 0, 0));
+  TreeEvaluation evaluation(JOINT_COUNT);
+  evaluation.clips = {additive.get(), base.get(), reference.get()};
+  const std::vector<char> tree = compileTree(R"({
+    "parameters" : ["weight"],
+    "clips" : {"additive" : "additive.clip", "base" : "base.clip",
+               "reference" : "reference.clip"},
+    "root" : {"type" : "additive", "weight" : "weight",
+              "base" : {"type" : "clip", "clip" : "base"},
+              "additive" : {"type" : "clip", "clip" : "additive"},
+              "reference" : {"type" : "clip", "clip" : "reference"}}})");
+  REQUIRE(SirEngine::getBlendTreeHeader(tree.data())->poseSlotCount == 3);
+  evaluation.parameters = {1.0f};
+  evaluation.evaluate(tree);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 2) ==
+          Approx(4.0f).margin(1e-3f));
+  requireSameRotation(axisAngle(40.0f, xAxis) * axisAngle(30.0f, yAxis),
+                      evaluation.getRotation(2));
+  evaluation.parameters = {0.5f};
+  evaluation.evaluate(tree);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 2) ==
+          Approx(2.5f).margin(1e-3f));
+  requireSameRotation(axisAngle(20.0f, xAxis) * axisAngle(30.0f, yAxis),
+                      evaluation.getRotation(2));
+  REQUIRE(evaluation.get(POSE_STREAM::SCALE, 2) == Approx(1.0f));
+
+  // the overlay only shows on the masked joints
+  const auto overlay =
+      makeConstantClip(axisAngle(80.0f, xAxis), glm::vec3(10.0f, 0, 0));
+  evaluation.clips = {base.get(), overlay.get()};
+  const std::vector<char> masked = compileTree(R"({
+    "parameters" : ["weight"],
+    "clips" : {"base" : "base.clip", "overlay" : "overlay.clip"},
+    "masks" : {"arms" : {"default" : 0.0, "joints" : {"1" : 1.0, "3" : 0.5}}},
+    "root" : {"type" : "mask", "mask" : "arms", "weight" : "weight",
+              "base" : {"type" : "clip", "clip" : "base"},
+              "overlay" : {"type" : "clip", "clip" : "overlay"}}})");
+  evaluation.parameters = {1.0f};
+  evaluation.evaluate(masked);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 0) ==
+          Approx(1.0f).margin(1e-3f));
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 1) ==
+          Approx(10.0f).margin(1e-3f));
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 3) ==
+          Approx(5.5f).margin(1e-3f));
+  requireSameRotation(axisAngle(30.0f, yAxis), evaluation.getRotation(0));
+  requireSameRotation(axisAngle(80.0f, xAxis), evaluation.getRotation(1));
+  requireSameRotation(glm::slerp(axisAngle(30.0f, yAxis),
+                                 axisAngle(80.0f, xAxis), 0.5f),
+                      evaluation.getRotation(3));
+  evaluation.parameters = {0.5f};
+  evaluation.evaluate(masked);
+  REQUIRE(evaluation.get(POSE_STREAM::TRANS_X, 1) ==
+          Approx(5.5f).margin(1e-3f));
+}
+
+TEST_CASE("blend tree compile errors", "[animation]") {
+  const char *sources[] = {
+      R"({"clips" : {"a" : "a.clip"}})",
+      R"({"clips" : {"a" : "a.clip"}, "root" : {"type" : "spline"}})",
+      R"({"clips" : {"a" : "a.clip"}, "root" : {"type" : "clip",
+          "clip" : "b"}})",
+      R"({"clips" : {"a" : "a.clip"}, "root" : {"type" : "lerp",
+          "weight" : "aim", "inputs" : [{"type" : "clip", "clip" : "a"},
+          {"type" : "clip", "clip" : "a"}]}})",
+      R"({"clips" : {"a" : "a.clip"}, "root" : {"type" : "mask",
+          "mask" : "arms", "base" : {"type" : "clip", "clip" : "a"},
+          "overlay" : {"type" : "clip", "clip" : "a"}}})",
+      R"({"parameters" : ["x"], "clips" : {"a" : "a.clip"},
+          "root" : {"type" : "blend1d", "parameter" : "x", "inputs" : [
+          {"position" : 1.0, "node" : {"type" : "clip", "clip" : "a"}},
+          {"position" : 1.0, "node" : {"type" : "clip", "clip" : "a"}}]}})"};
+  for (const char *source : sources) {
+    std::vector<char> program;
+    REQUIRE_FALSE(
+        SirEngine::compileBlendTree(nlohmann::json::parse(source), program));
+  }
+}
+
+TEST_CASE("corrupted blend tree programs fail validation", "[animation]") {
+  // every op of the program format
+  std::vector<char> program = compileTree(R"({
+    "parameters" : ["x", "aim"],
+    "clips" : {"a" : "a.clip", "b" : "b.clip"},
+    "masks" : {"arms" : {"default" : 0.0, "joints" : {"3" : 1.0}}},
+    "root" : {"type" : "mask", "mask" : "arms", "weight" : "aim",
+      "base" : {"type" : "blend1d", "parameter" : "x", "inputs" : [
+        {"position" : 0.0, "node" : {"type" : "clip", "clip" : "a"}},
+        {"position" : 1.0, "node" : {"type" : "clip", "clip" : "b"}}]},
+      "overlay" : {"type" : "blend", "inputs" : [
+        {"weight" : 1.0, "node" : {"type" : "additive",
+          "base" : {"type" : "clip", "clip" : "a"},
+          "additive" : {"type" : "clip", "clip" : "b"},
+          "reference" : {"type" : "clip", "clip" : "a"}}},
+        {"weight" : "aim", "node" : {"type" : "clip", "clip" : "b"}}]}}})");
+  const auto size = static_cast<uint32_t>(program.size());
+  REQUIRE(SirEngine::validateBlendTreeProgram(program.data(), size));
+  const SirEngine::BlendTreeProgramHeader header =
+      *SirEngine::getBlendTreeHeader(program.data());
+
+  using SirEngine::BLEND_TREE_OP;
+  using SirEngine::BlendTreeInstruction;
+  using SirEngine::BlendTreeProgramHeader;
+  // one corruption at a time on a copy of the program
+  const auto corruptHeader = [&](void (*change)(BlendTreeProgramHeader &)) {
+    std::vector<char> copy = program;
+    change(*reinterpret_cast<BlendTreeProgramHeader *>(copy.data()));
+    return SirEngine::validateBlendTreeProgram(copy.data(), size);
+  };
+  const auto corrupt = [&](const BLEND_TREE_OP op,
+                           void (*change)(BlendTreeInstruction &,
+                                          const BlendTreeProgramHeader &,
+                                          uint32_t)) {
+    std::vector<char> copy = program;
+    const uint32_t index = findInstruction(copy, op);
+    change(getInstructions(copy)[index], header, index);
+    return SirEngine::validateBlendTreeProgram(copy.data(), size);
+  };
+
+  REQUIRE_FALSE(SirEngine::validateBlendTreeProgram(program.data(), size - 4));
+  REQUIRE_FALSE(SirEngine::validateBlendTreeProgram(
+      program.data(), sizeof(BlendTreeProgramHeader) - 4));
+  // no output pose, the pose buffers size would underflow
+  REQUIRE_FALSE(
+      corruptHeader([](BlendTreeProgramHeader &h) { h.poseSlotCount = 0; }));
+  REQUIRE_FALSE(corruptHeader(
+      [](BlendTreeProgramHeader &h) { h.weightSlotCount = h.parameterCount; }));
+  REQUIRE_FALSE(corruptHeader(
+      [](BlendTreeProgramHeader &h) { h.instructionCount += 1; }));
+  REQUIRE_FALSE(
+      corruptHeader([](BlendTreeProgramHeader &h) { h.clipCount += 1; }));
+  REQUIRE_FALSE(
+      corruptHeader([](BlendTreeProgramHeader &h) { h.masksOffset += 4; }));
+  REQUIRE_FALSE(corruptHeader(
+      [](BlendTreeProgramHeader &h) { h.valuesOffset = h.stringsOffset + 4; }));
+  REQUIRE_FALSE(corruptHeader(
+      [](BlendTreeProgramHeader &h) { h.stringsOffset = h.sizeInBytes + 1; }));
+  REQUIRE_FALSE(corruptHeader([](BlendTreeProgramHeader &h) {
+    h.constantCount = (h.stringsOffset - h.valuesOffset) / 4 + 1;
+    h.weightSlotCount += h.constantCount;
+  }));
+  {
+    std::vector<char> copy = program;
+    copy.back() = 'x';
+    REQUIRE_FALSE(SirEngine::validateBlendTreeProgram(copy.data(), size));
+    copy = program;
+    auto *clips = reinterpret_cast<SirEngine::BlendTreeClip *>(
+        copy.data() + header.clipsOffset);
+    clips[1].pathOffset = size - header.stringsOffset;
+    REQUIRE_FALSE(SirEngine::validateBlendTreeProgram(copy.data(), size));
+    copy = program;
+    auto *masks = reinterpret_cast<SirEngine::BlendTreeMask *>(
+        copy.data() + header.masksOffset);
+    masks[0].entryCount += 1;
+    REQUIRE_FALSE(SirEngine::validateBlendTreeProgram(copy.data(), size));
+  }
+
+  // instructions
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::SAMPLE_CLIP,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &, uint32_t) {
+                          i.op = BLEND_TREE_OP::COUNT;
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::SAMPLE_CLIP,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.pose = static_cast<uint16_t>(h.poseSlotCount);
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::SAMPLE_CLIP,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.data = h.clipCount;
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::MASK,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.inputPose = static_cast<uint16_t>(h.poseSlotCount);
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::MASK,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.data = h.maskCount;
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::ADDITIVE,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.referencePose =
+                              static_cast<uint16_t>(h.poseSlotCount);
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::ACCUMULATE,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.weight = static_cast<uint16_t>(h.weightSlotCount);
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::COPY_WEIGHT,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.outWeight =
+                              static_cast<uint16_t>(h.weightSlotCount);
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::NORMALIZE_WEIGHTS,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &, uint32_t) {
+                          i.count = 0;
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::BLEND_SPACE_1D,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.outWeight =
+                              static_cast<uint16_t>(h.weightSlotCount - 1);
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::BLEND_SPACE_1D,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.data = (h.stringsOffset - h.valuesOffset) / 4 - 1;
+                        }));
+  // jumps only go forward and at most to the end of the program
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::SKIP_IF_ZERO,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &, uint32_t index) {
+                          i.data = index;
+                        }));
+  REQUIRE_FALSE(corrupt(BLEND_TREE_OP::SKIP_IF_ZERO,
+                        [](BlendTreeInstruction &i,
+                           const BlendTreeProgramHeader &h, uint32_t) {
+                          i.data = h.instructionCount + 1;
+                        }));
+  REQUIRE(corrupt(BLEND_TREE_OP::SKIP_IF_ZERO,
+                  [](BlendTreeInstruction &i, const BlendTreeProgramHeader &h,
+                     uint32_t) { i.data = h.instructionCount; }));
+}
+
+TEST_CASE("blend tree player rejects bad files", "[animation]") {
+  SirEngine::AnimationManager manager;
+  manager.init();
+  const SirEngine::Skeleton *skeleton =
+      manager.loadSkeleton("mannequin", "../testData/mannequin.json");
+  REQUIRE(skeleton != nullptr);
+
+  // a clip file the player can load, laid out like the animation compiler
+  // writes it, header, name, poses, metadata and mapper data
+  const std::filesystem::path clipPath =
+      std::filesystem::temp_directory_path() / "blendTreeClip.clip";
+  {
+    const uint32_t jointCount = skeleton->m_jointCount;
+    const std::vector<JointPose> poses(
+        jointCount * 4, JointPose{glm::quat(1, 0, 0, 0), glm::vec3(0), 1.0f});
+    std::vector<char> compressed;
+    SirEngine::compressClip(poses.data(), jointCount, 4,
+                            SirEngine::ClipCompressionSettings{}, compressed);
+    const char clipName[] = "blendTreeClip";
+    const SirEngine::AnimationMetadataKey key{
+        SirEngine::ANIM_CLIP_KEYWORDS::L_FOOT_DOWN, 0};
+    ClipMapperData clipMapper{};
+    clipMapper.nameSizeInByte = sizeof(clipName);
+    clipMapper.posesSizeInByte = static_cast<int>(compressed.size());
+    clipMapper.frameRate = 1.0f / 30.0f;
+    clipMapper.bonesPerFrame = static_cast<int>(jointCount);
+    clipMapper.frameCount = 4;
+    clipMapper.keyValueSizeInByte = sizeof(key);
+    BinaryFileHeader clipHeader;
+    clipHeader.fileType = BinaryFileType::ANIM;
+    clipHeader.version = SirEngine::COMPRESSED_CLIP_FILE_VERSION;
+    clipHeader.mapperDataOffsetInByte = static_cast<uint32_t>(
+        sizeof(BinaryFileHeader) + sizeof(clipName) + compressed.size() +
+        sizeof(key));
+    std::ofstream stream(clipPath, std::ios::binary);
+    stream.write(reinterpret_cast<const char *>(&clipHeader),
+                 sizeof(BinaryFileHeader));
+    stream.write(clipName, sizeof(clipName));
+    stream.write(compressed.data(),
+                 static_cast<std::streamsize>(compressed.size()));
+    stream.write(reinterpret_cast<const char *>(&key), sizeof(key));
+    stream.write(reinterpret_cast<const char *>(&clipMapper),
+                 sizeof(ClipMapperData));
+  }
+
+  // a compiled tree laid out like the compiler writes it, header, name,
+  // program and mapper data
+  nlohmann::json tree;
+  tree["clips"]["a"] = clipPath.string();
+  tree["root"]["type"] = "blend";
+  for (const float weight : {1.0f, 0.0f}) {
+    nlohmann::json input;
+    input["weight"] = weight;
+    input["node"] = {{"type", "clip"}, {"clip", "a"}};
+    tree["root"]["inputs"].push_back(input);
+  }
+  std::vector<char> program;
+  REQUIRE(SirEngine::compileBlendTree(tree, program));
+  const char name[] = "tree";
+  BinaryFileHeader header;
+  header.fileType = BinaryFileType::BLEND_TREE;
+  header.version = SirEngine::BLEND_TREE_FILE_VERSION;
+  header.mapperDataOffsetInByte =
+      sizeof(BinaryFileHeader) + sizeof(name) + program.size();
+  BlendTreeMapperData mapper{sizeof(name),
+                             static_cast<uint32_t>(program.size())};
+  const auto buildProgram = [&](const BinaryFileHeader &fileHeader,
+                                const BlendTreeMapperData &fileMapper,
+                                const std::vector<char> &fileProgram) {
+    std::vector<char> data(sizeof(BinaryFileHeader));
+    memcpy(data.data(), &fileHeader, sizeof(BinaryFileHeader));
+    data.insert(data.end(), name, name + sizeof(name));
+    data.insert(data.end(), fileProgram.begin(), fileProgram.end());
+    const auto *mapperBytes = reinterpret_cast<const char *>(&fileMapper);
+    data.insert(data.end(), mapperBytes,
+                mapperBytes + sizeof(BlendTreeMapperData));
+    return data;
+  };
+  const auto build = [&](const BinaryFileHeader &fileHeader,
+                         const BlendTreeMapperData &fileMapper) {
+    return buildProgram(fileHeader, fileMapper, program);
+  };
+
+  std::vector<std::vector<char>> files;
+  BinaryFileHeader wrongType = header;
+  wrongType.fileType = BinaryFileType::ECS_SNAPSHOT;
+  files.push_back(build(wrongType, mapper));
+  BinaryFileHeader wrongVersion = header;
+  wrongVersion.version = SirEngine::BLEND_TREE_FILE_VERSION + 1;
+  files.push_back(build(wrongVersion, mapper));
+  BinaryFileHeader pastTheEnd = header;
+  pastTheEnd.mapperDataOffsetInByte = 1 << 20;
+  files.push_back(build(pastTheEnd, mapper));
+  BlendTreeMapperData largerProgram = mapper;
+  largerProgram.programSizeInByte += 16;
+  files.push_back(build(header, largerProgram));
+  BlendTreeMapperData smallerProgram = mapper;
+  smallerProgram.programSizeInByte -= 4;
+  files.push_back(build(header, smallerProgram));
+  files.push_back(build(header, mapper));
+  files.back().resize(sizeof(BinaryFileHeader) - 4);
+  // well formed files whose program would evaluate out of bounds
+  std::vector<char> badSlot = program;
+  getInstructions(badSlot)[findInstruction(
+                               badSlot, SirEngine::BLEND_TREE_OP::ACCUMULATE)]
+      .inputPose = static_cast<uint16_t>(
+      SirEngine::getBlendTreeHeader(program.data())->poseSlotCount);
+  files.push_back(buildProgram(header, mapper, badSlot));
+  std::vector<char> badJump = program;
+  getInstructions(badJump)[findInstruction(
+                               badJump, SirEngine::BLEND_TREE_OP::SKIP_IF_ZERO)]
+      .data = 0;
+  files.push_back(buildProgram(header, mapper, badJump));
+
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "badBlendTree.tree";
+  nlohmann::json config;
+  config["name"] = "badTree";
+  config["skeleton"] = "../testData/mannequin.json";
+  config["blendTree"] = path.string();
+  const auto load = [&](const std::vector<char> &file) {
+    {
+      std::ofstream stream(path, std::ios::binary);
+      stream.write(file.data(), static_cast<std::streamsize>(file.size()));
+    }
+    SirEngine::BlendTreePlayer player;
+    return player.init(&manager, config);
+  };
+  // the untouched file loads, the failures come from the corruptions
+  REQUIRE(load(build(header, mapper)));
+  for (const std::vector<char> &file : files) {
+    REQUIRE_FALSE(load(file));
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(clipPath);
+  SirEngine::BlendTreePlayer missing;
+  REQUIRE_FALSE(missing.init(&manager, config));
+}
+
+TEST_CASE("blend tree locomotion blend space", "[.][benchmark]") {
+  // a 4x4 locomotion grid of knight clips, alternating idle and walk, every
+  // one with its own copy of the keys
+  uint32_t jointCount = 0;
+  const std::vector<JointPose> idle =
+      loadClipPoses("../testData/knightBIdle.json", jointCount);
+  const std::vector<JointPose> walk =
+      loadClipPoses("../testData/knightBWalk.json", jointCount);
+  std::vector<std::unique_ptr<AnimationClip>> clips;
+  std::vector<const AnimationClip *> clipPointers;
+  nlohmann::json space;
+  space["parameters"] = {"speed", "direction"};
+  space["root"]["type"] = "blend2d";
+  space["root"]["parameters"] = {"speed", "direction"};
+  nlohmann::json everything;
+  everything["parameters"] = {"speed", "direction"};
+  everything["root"]["type"] = "blend";
+  for (int i = 0; i < 16; ++i) {
+    clips.push_back(makeClip((i & 1) != 0 ? walk : idle, jointCount));
+    clipPointers.push_back(clips.back().get());
+    const std::string name = "clip" + std::to_string(i + 10);
+    space["clips"][name] = name + ".clip";
+    everything["clips"][name] = name + ".clip";
+    nlohmann::json input;
+    input["position"] = {i % 4, i / 4};
+    input["node"] = {{"type", "clip"}, {"clip", name}};
+    space["root"]["inputs"].push_back(input);
+    input["weight"] = 1.0f;
+    everything["root"]["inputs"].push_back(input);
+  }
+  std::vector<char> spaceProgram;
+  std::vector<char> everythingProgram;
+  SirEngine::compileBlendTree(space, spaceProgram);
+  SirEngine::compileBlendTree(everything, everythingProgram);
+
+  std::vector<float> streams(SirEngine::getPoseStreamsSize(jointCount));
+  SirEngine::StackAllocator scratch;
+  scratch.initialize(1024 * 1024);
+  long long stamp = 0;
+  float parameters[2]{};
+  BENCHMARK("16 clips blend space") {
+    // a frame further and moving around the grid
+    stamp += 16666666;
+    parameters[0] = static_cast<float>(stamp % 3000000000) / 1000000000.0f;
+    parameters[1] = static_cast<float>(stamp % 1700000000) / 600000000.0f;
+    return SirEngine::evaluateBlendTree(
+        spaceProgram.data(), clipPointers.data(), parameters, stamp, 0,
+        jointCount, streams.data(), scratch);
+  };
+  BENCHMARK("16 clips all blended") {
+    stamp += 16666666;
+    return SirEngine::evaluateBlendTree(
+        everythingProgram.data(), clipPointers.data(), parameters, stamp, 0,
+        jointCount, streams.data(), scratch);
+  };
+}
@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <vector>
+
+#include "SirEngine/ecs/archetypeAllocator.h"
+#include "SirEngine/ecs/ecs.h"
+#include "SirEngine/memory/cpu/chunkPool.h"
+#include "catch/catch.hpp"
+
+using SirEngine::ChunkPool;
+using SirEngine::ecs::ArchetypeAllocator;
+
+namespace {
+struct PoolPosition {
+  float x, y, z, w;
+};
+struct PoolVelocity {
+  float x, y, z;
+};
+struct PoolTag {
+  uint32_t value;
+};
+}  // namespace
+
+TEST_CASE("chunk pool allocation", "[memory]") {
+  ChunkPool pool(ChunkPool::PAGE_SIZE_IN_BYTES * 4, 4);
+  std::vector<void*> blocks;
+  for (uint32_t i = 0; i < 6; ++i) {
+    void* block = pool.allocate();
+    REQUIRE((reinterpret_cast<uintptr_t>(block) %
+             ChunkPool::PAGE_SIZE_IN_BYTES) == 0);
+    REQUIRE(pool.ownsBlock(block));
+    blocks.push_back(block);
+  }
+  REQUIRE(pool.getUsedBlockCount() == 6);
+  REQUIRE(pool.getSlabCount() == 2);
+  REQUIRE(pool.getReservedBlockCount() == 8);
+
+  // blocks of the same slab are contiguous
+  REQUIRE(static_cast<char*>(blocks[1]) - static_cast<char*>(blocks[0]) ==
+          ChunkPool::PAGE_SIZE_IN_BYTES * 4);
+}
+
+TEST_CASE("chunk pool free list reuse", "[memory]") {
+  ChunkPool pool(ChunkPool::PAGE_SIZE_IN_BYTES, 8);
+  void* a = pool.allocate();
+  void* b = pool.allocate();
+  pool.free(a);
+  pool.free(b);
+  REQUIRE(pool.getUsedBlockCount() == 0);
+  REQUIRE(pool.getPeakUsedBlockCount() == 2);
+
+  // last freed is the first handed out again, no new slab needed
+  REQUIRE(pool.allocate() == b);
+  REQUIRE(pool.allocate() == a);
+  for (uint32_t i = 0; i < 6; ++i) {
+    pool.allocate();
+  }
+  REQUIRE(pool.getSlabCount() == 1);
+  REQUIRE(pool.getUsedBlockCount() == 8);
+}
+
+TEST_CASE("chunk pool blocks smaller than a page", "[memory]") {
+  ChunkPool pool(1024, 16);
+  std::vector<void*> blocks;
+  for (uint32_t i = 0; i < 20; ++i) {
+    void* block = pool.allocate();
+    REQUIRE((reinterpret_cast<uintptr_t>(block) % 1024) == 0);
+    REQUIRE(pool.ownsBlock(block));
+    blocks.push_back(block);
+  }
+  REQUIRE(pool.getSlabCount() == 2);
+  REQUIRE(pool.getSlabSizeInBytes() == ChunkPool::PAGE_SIZE_IN_BYTES * 4);
+  REQUIRE(static_cast<char*>(blocks[1]) - static_cast<char*>(blocks[0]) ==
+          1024);
+  // pointers inside a block are not blocks
+  REQUIRE(!pool.ownsBlock(static_cast<char*>(blocks[0]) + 512));
+}
+
+TEST_CASE("archetype allocator size classes", "[memory]") {
+  REQUIRE(ArchetypeAllocator::getBlockSize(1) ==
+          ArchetypeAllocator::MIN_BLOCK_SIZE_IN_BYTES);
+  REQUIRE(ArchetypeAllocator::getBlockSize(
+              ArchetypeAllocator::MIN_BLOCK_SIZE_IN_BYTES + 1) ==
+          ArchetypeAllocator::MIN_BLOCK_SIZE_IN_BYTES * 2);
+  const size_t biggest = ArchetypeAllocator::getSizeClassBlockSize(
+      ArchetypeAllocator::SIZE_CLASS_COUNT - 1);
+  REQUIRE(ArchetypeAllocator::getBlockSize(biggest + 1) ==
+          biggest + ChunkPool::PAGE_SIZE_IN_BYTES);
+
+  ArchetypeAllocator allocator;
+  void* small = allocator.allocate(ArchetypeAllocator::MIN_BLOCK_SIZE_IN_BYTES);
+  void* large = allocator.allocate(biggest + ChunkPool::PAGE_SIZE_IN_BYTES);
+  REQUIRE(allocator.getLargeAllocationCount() == 1);
+  REQUIRE(allocator.getUsedBlockCount() == 2);
+  REQUIRE(allocator.getUsedSizeInBytes() ==
+          ArchetypeAllocator::MIN_BLOCK_SIZE_IN_BYTES + biggest +
+              ChunkPool::PAGE_SIZE_IN_BYTES);
+  allocator.free(large, biggest + ChunkPool::PAGE_SIZE_IN_BYTES);
+  allocator.free(small, ArchetypeAllocator::MIN_BLOCK_SIZE_IN_BYTES);
+  REQUIRE(allocator.getUsedSizeInBytes() == 0);
+  REQUIRE(allocator.getUsedBlockCount() == 0);
+  REQUIRE(allocator.getLargeAllocationCount() == 0);
+}
+
+TEST_CASE("archetype storage comes from the chunk pools", "[core,ecs]") {
+  ArchetypeAllocator allocator;
+  {
+    SirEngine::ecs::Registry registry(&allocator);
+    registry.createEntity(PoolPosition{1, 2, 3, 4}, PoolVelocity{0, 0, 0});
+    // a handful of entities fits in the smallest class
+    REQUIRE(allocator.getUsedSizeInBytes() ==
+            ArchetypeAllocator::MIN_BLOCK_SIZE_IN_BYTES);
+    REQUIRE(allocator.getPool(0).getUsedBlockCount() == 1);
+    // many small archetypes share the same slab
+    registry.createEntity(PoolPosition{1, 2, 3, 4});
+    registry.createEntity(PoolVelocity{0, 0, 0});
+    registry.createEntity(PoolTag{0});
+    REQUIRE(allocator.getPool(0).getUsedBlockCount() == 4);
+    REQUIRE(allocator.getPool(0).getSlabCount() == 1);
+
+    // growing moves the archetype to bigger blocks, the smaller ones go back
+    // to their pool
+    for (uint32_t i = 0; i < 10000; ++i) {
+      registry.createEntity(PoolPosition{static_cast<float>(i), 0, 0, 0},
+                            PoolVelocity{0, 0, 0});
+    }
+    REQUIRE(allocator.getPool(0).getUsedBlockCount() == 3);
+    REQUIRE(allocator.getPeakUsedSizeInBytes() >
+            allocator.getUsedSizeInBytes() / 2);
+
+    std::vector<std::tuple<size_t, PoolPosition*, PoolVelocity*>> query;
+    registry.populateComponentQuery(query);
+    REQUIRE(query.size() == 1);
+    REQUIRE(std::get<0>(query[0]) == 10001);
+    REQUIRE(std::get<1>(query[0])[10000].x == Approx(9999.0f));
+    // every column is cache line aligned
+    REQUIRE((reinterpret_cast<uintptr_t>(std::get<1>(query[0])) %
+             SirEngine::ecs::Archetype::COLUMN_ALIGNMENT) == 0);
+    REQUIRE((reinterpret_cast<uintptr_t>(std::get<2>(query[0])) %
+             SirEngine::ecs::Archetype::COLUMN_ALIGNMENT) == 0);
+  }
+  // destroyed archetypes give all their storage back
+  REQUIRE(allocator.getUsedSizeInBytes() == 0);
+  REQUIRE(allocator.getUsedBlockCount() == 0);
+  const size_t reserved = allocator.getReservedSizeInBytes();
+
+  // a new registry of the same shape reuses the chunks, nothing new is
+  // requested to the system
+  {
+    SirEngine::ecs::Registry registry(&allocator);
+    for (uint32_t i = 0; i < 10000; ++i) {
+      const auto id = registry.createEntity(PoolPosition{0, 0, 0, 0},
+                                            PoolVelocity{0, 0, 0});
+      registry.addComponent(id, PoolTag{i});
+    }
+    registry.clear();
+    REQUIRE(allocator.getUsedSizeInBytes() == 0);
+  }
+  REQUIRE(allocator.getReservedSizeInBytes() == reserved);
+}
@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SirEngine/animation/animationClip.h"
+#include "SirEngine/animation/clipCompression.h"
+#include "SirEngine/animation/clipCursor.h"
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/animation/skeleton.h"
+#include "SirEngine/io/binaryFile.h"
+#include "animationTestUtils.h"
+#include "catch/catch.hpp"
+
+using SirEngine::ClipCompressionSettings;
+using SirEngine::ClipCompressionStats;
+using SirEngine::JointPose;
+
+namespace {
+// joint 0 is a root travelling far, 1 never moves, the others swing around
+// smoothly with a bit of noise like mocap data would
+std::vector<JointPose> syntheticClip(const uint32_t jointCount,
+                                     const uint32_t frameCount) {
+  std::mt19937 generator(11);
+  std::uniform_real_distribution<float> noise(-0.00005f, 0.00005f);
+  std::vector<JointPose> poses(jointCount * frameCount);
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    const float time = static_cast<float>(frame) / 30.0f;
+    for (uint32_t joint = 0; joint < jointCount; ++joint) {
+      JointPose &pose = poses[frame * jointCount + joint];
+      pose.m_scale = 1.0f;
+      if (joint == 1) {
+        pose.m_rot = glm::angleAxis(0.3f, glm::vec3(0.0f, 1.0f, 0.0f));
+        pose.m_trans = glm::vec3(0.0f, 10.0f, 0.0f);
+        continue;
+      }
+      const float phase = static_cast<float>(joint) * 0.37f;
+      const glm::vec3 axis = glm::normalize(
+          glm::vec3(std::sin(phase), 1.0f, std::cos(phase * 2.0f)));
+      pose.m_rot = glm::angleAxis(
+          std::sin(time * 2.0f + phase) * 1.2f + noise(generator), axis);
+      pose.m_trans = glm::vec3(0.0f, 10.0f, 0.0f);
+    }
+    poses[frame * jointCount].m_trans =
+        glm::vec3(time * 150.0f, 90.0f + std::sin(time * 6.0f), 0.0f);
+  }
+  return poses;
+}
+
+// in double, acos of a float dot product is too coarse for the tolerances,
+// same goes for the length of the source rotations
+double rotationError(const glm::quat &a, const glm::quat &b) {
+  double dot = 0.0;
+  double lengthSqA = 0.0;
+  double lengthSqB = 0.0;
+  for (int i = 0; i < 4; ++i) {
+    dot += static_cast<double>(a[i]) * b[i];
+    lengthSqA += static_cast<double>(a[i]) * a[i];
+    lengthSqB += static_cast<double>(b[i]) * b[i];
+  }
+  const double cosHalfAngle = std::abs(dot) / std::sqrt(lengthSqA * lengthSqB);
+  return 2.0 * std::acos(std::min(1.0, cosHalfAngle));
+}
+
+// the rotation of a joint in the streams
+glm::quat getRotation(const std::vector<float> &streams,
+                      const uint32_t jointCount, const uint32_t joint) {
+  const uint32_t stride = SirEngine::getPoseStreamStride(jointCount);
+  return glm::quat(streams[stride * 3 + joint], streams[joint],
+                   streams[stride + joint], streams[stride * 2 + joint]);
+}
+}  // namespace
+
+TEST_CASE("clip compression stays within tolerance", "[animation]") {
+  constexpr uint32_t jointCount = 20;
+  constexpr uint32_t frameCount = 240;
+  const std::vector<JointPose> poses = syntheticClip(jointCount, frameCount);
+  ClipCompressionSettings settings;
+  std::vector<char> compressed;
+  const ClipCompressionStats stats = SirEngine::compressClip(
+      poses.data(), jointCount, frameCount, settings, compressed);
+
+  REQUIRE(stats.compressedSizeInBytes == compressed.size());
+  REQUIRE(stats.rawSizeInBytes == sizeof(JointPose) * jointCount * frameCount);
+  REQUIRE(stats.compressedSizeInBytes * 4 < stats.rawSizeInBytes);
+  // tracks are counted per segment: all the scales, the translations but the
+  // root and the still joint
+  const uint32_t segmentCount =
+      reinterpret_cast<const SirEngine::CompressedClipHeader *>(
+          compressed.data())
+          ->segmentCount;
+  REQUIRE(segmentCount == frameCount / settings.segmentFrameCount + 1);
+  REQUIRE(stats.constantTracks == (jointCount + jointCount) * segmentCount);
+  // the root covers too much ground for 16 bits
+  REQUIRE(stats.rawTracks == segmentCount);
+  REQUIRE(stats.maxRotationError <= settings.rotationTolerance);
+  REQUIRE(stats.maxTranslationError <= settings.translationTolerance);
+  REQUIRE(stats.maxScaleError <= settings.scaleTolerance);
+
+  // sampling in between frames lands in between the source frames
+  std::vector<float> streams(SirEngine::getPoseStreamsSize(jointCount));
+  SirEngine::sampleCompressedClip(compressed.data(), 100, 0.5f,
+                                  streams.data());
+  for (uint32_t joint = 0; joint < jointCount; ++joint) {
+    const glm::quat expected =
+        glm::slerp(poses[100 * jointCount + joint].m_rot,
+                   poses[101 * jointCount + joint].m_rot, 0.5f);
+    REQUIRE(rotationError(getRotation(streams, jointCount, joint), expected) <
+            0.002f);
+  }
+  const uint32_t stride = SirEngine::getPoseStreamStride(jointCount);
+  REQUIRE(streams[stride * 4] ==
+          Approx((poses[100 * jointCount].m_trans.x +
+                  poses[101 * jointCount].m_trans.x) *
+                 0.5f));
+
+  // past the last frame the clip loops back to the first one
+  SirEngine::sampleCompressedClip(compressed.data(), frameCount - 1, 0.5f,
+                                  streams.data());
+  REQUIRE(streams[stride * 4] ==
+          Approx(poses[(frameCount - 1) * jointCount].m_trans.x * 0.5f));
+  // padding joints are identities
+  REQUIRE(streams[stride * 3 + jointCount] == 1.0f);
+  REQUIRE(streams[stride * 7 + stride - 1] == 1.0f);
+}
+
+TEST_CASE("clip compression per joint tolerances", "[animation]") {
+  constexpr uint32_t jointCount = 8;
+  constexpr uint32_t frameCount = 120;
+  const std::vector<JointPose> poses = syntheticClip(jointCount, frameCount);
+  ClipCompressionSettings loose;
+  loose.rotationTolerance = 0.01f;
+  std::vector<char> compressed;
+  const ClipCompressionStats looseStats = SirEngine::compressClip(
+      poses.data(), jointCount, frameCount, loose, compressed);
+
+  // same clip with the last joint held to a much tighter tolerance
+  ClipCompressionSettings tight = loose;
+  tight.jointRotationTolerances.assign(jointCount, loose.rotationTolerance);
+  tight.jointRotationTolerances[jointCount - 1] = 0.0002f;
+  const ClipCompressionStats tightStats = SirEngine::compressClip(
+      poses.data(), jointCount, frameCount, tight, compressed);
+  REQUIRE(tightStats.keyCount > looseStats.keyCount);
+
+  std::vector<float> streams(SirEngine::getPoseStreamsSize(jointCount));
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    SirEngine::sampleCompressedClip(compressed.data(), frame, 0.0f,
+                                    streams.data());
+    for (uint32_t joint = 0; joint < jointCount; ++joint) {
+      const double error =
+          rotationError(getRotation(streams, jointCount, joint),
+                        poses[frame * jointCount + joint].m_rot);
+      REQUIRE(error <= tight.jointRotationTolerances[joint] + 1e-5);
+    }
+  }
+}
+
+TEST_CASE("clip compression of the test clips", "[animation]") {
+  // the smallest ratio each clip is expected to compress by, with some
+  // headroom, noMetaAnim is a handful of frames where the segment overhead
+  // dominates
+  struct ClipExpectation {
+    const char *name;
+    float minRatio;
+  };
+  for (const ClipExpectation &clip : {ClipExpectation{"idle1", 10.0f},
+                                      ClipExpectation{"idle2", 10.0f},
+                                      ClipExpectation{"knightBWalk", 6.0f},
+                                      ClipExpectation{"knightBIdle", 10.0f},
+                                      ClipExpectation{"noMetaAnim", 2.0f}}) {
+    const char *name = clip.name;
+    uint32_t jointCount = 0;
+    const std::vector<JointPose> poses =
+        loadClipPoses(std::string("../testData/") + name + ".json", jointCount);
+    const auto frameCount = static_cast<uint32_t>(poses.size() / jointCount);
+    REQUIRE(poses.size() == jointCount * frameCount);
+
+    const ClipCompressionSettings settings;
+    std::vector<char> compressed;
+    const ClipCompressionStats stats = SirEngine::compressClip(
+        poses.data(), jointCount, frameCount, settings, compressed);
+    REQUIRE(stats.compressedSizeInBytes == compressed.size());
+
+    // decoding every frame back, the errors are measured here rather than
+    // trusting the ones the compressor reports
+    std::vector<float> streams(SirEngine::getPoseStreamsSize(jointCount));
+    const uint32_t stride = SirEngine::getPoseStreamStride(jointCount);
+    double maxRotationError = 0.0;
+    double maxTranslationError = 0.0;
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+      SirEngine::sampleCompressedClip(compressed.data(), frame, 0.0f,
+                                      streams.data());
+      for (uint32_t joint = 0; joint < jointCount; ++joint) {
+        const JointPose &source = poses[frame * jointCount + joint];
+        maxRotationError = std::max(
+            maxRotationError,
+            rotationError(getRotation(streams, jointCount, joint),
+                          source.m_rot));
+        const glm::vec3 translation(streams[stride * 4 + joint],
+                                    streams[stride * 5 + joint],
+                                    streams[stride * 6 + joint]);
+        maxTranslationError =
+            std::max(maxTranslationError,
+                     static_cast<double>(
+                         glm::length(translation - source.m_trans)));
+      }
+    }
+    const float ratio = static_cast<float>(stats.rawSizeInBytes) /
+                        static_cast<float>(stats.compressedSizeInBytes);
+    INFO(name << " ratio " << ratio << " max rotation error "
+              << maxRotationError << " max translation error "
+              << maxTranslationError);
+    REQUIRE(ratio >= clip.minRatio);
+    REQUIRE(maxRotationError <= settings.rotationTolerance + 1e-5);
+    REQUIRE(maxTranslationError <= settings.translationTolerance + 1e-5);
+  }
+}
+
+TEST_CASE("clip cursor plays segment after segment", "[animation]") {
+  constexpr uint32_t jointCount = 20;
+  constexpr uint32_t frameCount = 1000;
+  const std::vector<JointPose> poses = syntheticClip(jointCount, frameCount);
+  ClipCompressionSettings settings;
+  settings.segmentFrameCount = 16;
+  std::vector<char> compressed;
+  const ClipCompressionStats stats = SirEngine::compressClip(
+      poses.data(), jointCount, frameCount, settings, compressed);
+  REQUIRE(stats.maxRotationError <= settings.rotationTolerance);
+  REQUIRE(stats.maxTranslationError <= settings.translationTolerance);
+  const auto *header =
+      reinterpret_cast<const SirEngine::CompressedClipHeader *>(
+          compressed.data());
+  REQUIRE(header->segmentCount == 63);
+
+  SirEngine::ClipCursor cursor;
+  cursor.initialize(compressed.data());
+  const uint32_t size = SirEngine::getPoseStreamsSize(jointCount);
+  const uint32_t stride = SirEngine::getPoseStreamStride(jointCount);
+  std::vector<float> expected(size);
+  std::vector<float> result(size);
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    for (const float fraction : {0.0f, 0.25f}) {
+      // the synthetic clip does not loop, the wrap from the last frame to the
+      // first is a wide jump the two paths interpolate differently
+      if (frame + 1 == frameCount && fraction > 0.0f) {
+        continue;
+      }
+      SirEngine::sampleCompressedClip(compressed.data(), frame, fraction,
+                                      expected.data());
+      cursor.sample(frame, fraction, result.data());
+      // decoded frames are interpolated instead of the keys, the two only
+      // match exactly on the frames
+      const double tolerance = fraction == 0.0f ? 1e-4 : 2e-3;
+      for (uint32_t joint = 0; joint < jointCount; ++joint) {
+        REQUIRE(rotationError(getRotation(expected, jointCount, joint),
+                              getRotation(result, jointCount, joint)) <=
+                tolerance);
+        REQUIRE(result[stride * 4 + joint] ==
+                Approx(expected[stride * 4 + joint]).margin(tolerance));
+      }
+    }
+  }
+  // every segment once, plus the first one again looping around
+  REQUIRE(cursor.getDecodeCount() == header->segmentCount + 1);
+
+  // seeking decodes the target segment and the one after it
+  cursor.sample(500, 0.5f, result.data());
+  REQUIRE(cursor.getDecodeCount() == header->segmentCount + 3);
+  SirEngine::sampleCompressedClip(compressed.data(), 500, 0.5f,
+                                  expected.data());
+  REQUIRE(result[stride * 4] == Approx(expected[stride * 4]));
+
+  // the memory held does not depend on the length of the clip
+  const std::vector<JointPose> longPoses =
+      syntheticClip(jointCount, frameCount * 4);
+  std::vector<char> longCompressed;
+  SirEngine::compressClip(longPoses.data(), jointCount, frameCount * 4,
+                          settings, longCompressed);
+  SirEngine::ClipCursor longCursor;
+  longCursor.initialize(longCompressed.data());
+  REQUIRE(longCursor.getDecodedSizeInBytes() ==
+          cursor.getDecodedSizeInBytes());
+  REQUIRE(cursor.getDecodedSizeInBytes() ==
+          sizeof(float) * size * (settings.segmentFrameCount + 1) * 2);
+}
+
+TEST_CASE("clip reduced poses only decode the leading joints",
+          "[animation]") {
+  constexpr uint32_t jointCount = 20;
+  constexpr uint32_t frameCount = 100;
+  const std::vector<JointPose> poses = syntheticClip(jointCount, frameCount);
+  ClipCompressionSettings settings;
+  settings.segmentFrameCount = 16;
+  std::vector<char> compressed;
+  SirEngine::compressClip(poses.data(), jointCount, frameCount, settings,
+                          compressed);
+
+  // 5 joints get rounded up to a whole simd group, the others are untouched
+  constexpr float untouched = 123.0f;
+  const uint32_t size = SirEngine::getPoseStreamsSize(jointCount);
+  const uint32_t stride = SirEngine::getPoseStreamStride(jointCount);
+  REQUIRE(SirEngine::getAnimatedJointCount(jointCount, 5) == 8);
+  REQUIRE(SirEngine::getAnimatedJointCount(jointCount, 17) == jointCount);
+  std::vector<float> expected(size);
+  std::vector<float> result(size, untouched);
+  SirEngine::sampleCompressedClip(compressed.data(), 40, 0.5f,
+                                  expected.data());
+  SirEngine::sampleCompressedClip(compressed.data(), 40, 0.5f, result.data(),
+                                  5);
+  for (uint32_t stream = 0; stream < SirEngine::POSE_STREAM_COUNT; ++stream) {
+    for (uint32_t joint = 0; joint < jointCount; ++joint) {
+      const uint32_t i = stream * stride + joint;
+      REQUIRE(result[i] == (joint < 8 ? expected[i] : untouched));
+    }
+  }
+
+  // a cursor holding reduced segments decodes them again for a full pose
+  SirEngine::ClipCursor cursor;
+  cursor.initialize(compressed.data());
+  std::fill(result.begin(), result.end(), untouched);
+  cursor.sample(40, 0.0f, result.data(), 5);
+  REQUIRE(cursor.getDecodeCount() == 2);
+  REQUIRE(result[stride * 4 + 8] == untouched);
+  cursor.sample(41, 0.0f, result.data(), 5);
+  REQUIRE(cursor.getDecodeCount() == 2);
+  cursor.sample(41, 0.0f, result.data());
+  REQUIRE(cursor.getDecodeCount() == 4);
+  SirEngine::sampleCompressedClip(compressed.data(), 41, 0.0f,
+                                  expected.data());
+  for (uint32_t joint = 0; joint < jointCount; ++joint) {
+    REQUIRE(result[stride * 4 + joint] ==
+            Approx(expected[stride * 4 + joint]).margin(1e-4));
+  }
+}
+
+TEST_CASE("corrupted compressed clips fail validation", "[animation]") {
+  constexpr uint32_t jointCount = 6;
+  constexpr uint32_t frameCount = 70;
+  const std::vector<JointPose> poses = syntheticClip(jointCount, frameCount);
+  ClipCompressionSettings settings;
+  settings.segmentFrameCount = 32;
+  std::vector<char> compressed;
+  SirEngine::compressClip(poses.data(), jointCount, frameCount, settings,
+                          compressed);
+  const auto size = static_cast<uint32_t>(compressed.size());
+  REQUIRE(SirEngine::validateCompressedClip(compressed.data(), size));
+  REQUIRE_FALSE(SirEngine::validateCompressedClip(compressed.data(), 12));
+  REQUIRE_FALSE(SirEngine::validateCompressedClip(compressed.data(), size - 1));
+
+  // the fields are patched in a copy, at the offsets the layout puts them
+  const auto corrupt = [&](const size_t offset, const auto value) {
+    std::vector<char> copy = compressed;
+    memcpy(copy.data() + offset, &value, sizeof(value));
+    return SirEngine::validateCompressedClip(copy.data(), size);
+  };
+  using SirEngine::CompressedClipHeader;
+  using SirEngine::CompressedSegmentHeader;
+  REQUIRE_FALSE(corrupt(offsetof(CompressedClipHeader, frameCount), 0u));
+  REQUIRE_FALSE(
+      corrupt(offsetof(CompressedClipHeader, segmentFrameCount), 0u));
+  REQUIRE_FALSE(
+      corrupt(offsetof(CompressedClipHeader, segmentFrameCount), 16u));
+  REQUIRE_FALSE(corrupt(offsetof(CompressedClipHeader, segmentCount), 4u));
+  REQUIRE_FALSE(corrupt(offsetof(CompressedClipHeader, segmentCount),
+                        0x40000000u));
+
+  // the table of the segment offsets
+  uint32_t offset;
+  memcpy(&offset, compressed.data() + sizeof(CompressedClipHeader),
+         sizeof(uint32_t));
+  REQUIRE_FALSE(corrupt(sizeof(CompressedClipHeader), size + 64));
+  REQUIRE_FALSE(corrupt(sizeof(CompressedClipHeader), offset + 2));
+  REQUIRE_FALSE(corrupt(sizeof(CompressedClipHeader), 0u));
+
+  // the first segment
+  CompressedSegmentHeader segment;
+  memcpy(&segment, compressed.data() + offset,
+         sizeof(CompressedSegmentHeader));
+  REQUIRE(segment.frameCount == settings.segmentFrameCount + 1);
+  REQUIRE_FALSE(
+      corrupt(offset + offsetof(CompressedSegmentHeader, frameCount), 0u));
+  REQUIRE_FALSE(corrupt(
+      offset + offsetof(CompressedSegmentHeader, sizeInBytes), size));
+  REQUIRE_FALSE(corrupt(
+      offset + offsetof(CompressedSegmentHeader, valuesOffsetInBytes),
+      segment.sizeInBytes + 1));
+  REQUIRE_FALSE(corrupt(
+      offset + offsetof(CompressedSegmentHeader, sizeInBytes),
+      segment.valuesOffsetInBytes + 1));
+
+  // the root rotation is animated, its inner key frames come first
+  SirEngine::CompressedTrack track;
+  const size_t trackOffset = offset + sizeof(CompressedSegmentHeader);
+  memcpy(&track, compressed.data() + trackOffset, sizeof(track));
+  REQUIRE(track.keyCount > 2);
+  SirEngine::CompressedTrack badTrack = track;
+  badTrack.keyCount = 0x3FFF;
+  REQUIRE_FALSE(corrupt(trackOffset, badTrack));
+  badTrack = track;
+  badTrack.format = static_cast<uint16_t>(SirEngine::TRACK_FORMAT::CONSTANT);
+  REQUIRE_FALSE(corrupt(trackOffset, badTrack));
+  const size_t keyFramesOffset = offset + segment.keyFramesOffsetInBytes;
+  REQUIRE_FALSE(corrupt(keyFramesOffset, uint8_t{0}));
+  REQUIRE_FALSE(
+      corrupt(keyFramesOffset, static_cast<uint8_t>(segment.frameCount)));
+}
+
+TEST_CASE("animation clip rejects corrupted compressed poses",
+          "[animation]") {
+  constexpr uint32_t jointCount = 6;
+  constexpr uint32_t frameCount = 70;
+  const std::vector<JointPose> poses = syntheticClip(jointCount, frameCount);
+  std::vector<char> compressed;
+  SirEngine::compressClip(poses.data(), jointCount, frameCount,
+                          ClipCompressionSettings{}, compressed);
+
+  // laid out like the animation compiler writes it, header, name, poses,
+  // metadata and mapper data
+  const char name[] = "clip";
+  const SirEngine::AnimationMetadataKey key{
+      SirEngine::ANIM_CLIP_KEYWORDS::L_FOOT_DOWN, 3};
+  ClipMapperData mapper{};
+  mapper.nameSizeInByte = sizeof(name);
+  mapper.posesSizeInByte = static_cast<int>(compressed.size());
+  mapper.frameRate = 1.0f / 30.0f;
+  mapper.bonesPerFrame = jointCount;
+  mapper.frameCount = frameCount;
+  mapper.keyValueSizeInByte = sizeof(key);
+  const auto build = [&](const std::vector<char> &clipPoses,
+                         const ClipMapperData &fileMapper) {
+    BinaryFileHeader header;
+    header.fileType = BinaryFileType::ANIM;
+    header.version = SirEngine::COMPRESSED_CLIP_FILE_VERSION;
+    header.mapperDataOffsetInByte = sizeof(BinaryFileHeader) + sizeof(name) +
+                                    clipPoses.size() + sizeof(key);
+    std::vector<char> data(sizeof(BinaryFileHeader));
+    memcpy(data.data(), &header, sizeof(BinaryFileHeader));
+    data.insert(data.end(), name, name + sizeof(name));
+    data.insert(data.end(), clipPoses.begin(), clipPoses.end());
+    const auto *keyBytes = reinterpret_cast<const char *>(&key);
+    data.insert(data.end(), keyBytes, keyBytes + sizeof(key));
+    const auto *mapperBytes = reinterpret_cast<const char *>(&fileMapper);
+    data.insert(data.end(), mapperBytes, mapperBytes + sizeof(ClipMapperData));
+    return data;
+  };
+  const std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "badClip.clip";
+  const auto load = [&](const std::vector<char> &file) {
+    {
+      std::ofstream stream(path, std::ios::binary);
+      stream.write(file.data(), static_cast<std::streamsize>(file.size()));
+    }
+    SirEngine::AnimationClip clip;
+    return clip.initialize(path.string().c_str());
+  };
+  REQUIRE(load(build(compressed, mapper)));
+
+  // zero frames everywhere, the counts still agree with each other
+  std::vector<char> noFrames = compressed;
+  const uint32_t zero = 0;
+  memcpy(noFrames.data() +
+             offsetof(SirEngine::CompressedClipHeader, frameCount),
+         &zero, sizeof(uint32_t));
+  ClipMapperData noFramesMapper = mapper;
+  noFramesMapper.frameCount = 0;
+  REQUIRE_FALSE(load(build(noFrames, noFramesMapper)));
+  // a segment past the end of the poses
+  std::vector<char> badSegment = compressed;
+  const auto pastTheEnd = static_cast<uint32_t>(compressed.size());
+  memcpy(badSegment.data() + sizeof(SirEngine::CompressedClipHeader),
+         &pastTheEnd, sizeof(uint32_t));
+  REQUIRE_FALSE(load(build(badSegment, mapper)));
+  ClipMapperData noFrameRate = mapper;
+  noFrameRate.frameRate = 0.0f;
+  REQUIRE_FALSE(load(build(compressed, noFrameRate)));
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("clip sampling per frame", "[.][benchmark]") {
+  constexpr uint32_t jointCount = 63;
+  constexpr uint32_t frameCount = 1000;
+  const std::vector<JointPose> poses = syntheticClip(jointCount, frameCount);
+  std::vector<char> compressed;
+  SirEngine::compressClip(poses.data(), jointCount, frameCount,
+                          ClipCompressionSettings{}, compressed);
+  const uint32_t size = SirEngine::getPoseStreamsSize(jointCount);
+  std::vector<float> raw(size * frameCount);
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    SirEngine::jointPosesToStreams(poses.data() + frame * jointCount,
+                                   jointCount, raw.data() + frame * size);
+  }
+  std::vector<float> streams(size);
+
+  uint32_t frame = 0;
+  BENCHMARK("raw streams interpolation") {
+    frame = (frame + 7) % (frameCount - 1);
+    SirEngine::interpolatePoseStreams(raw.data() + frame * size,
+                                      raw.data() + (frame + 1) * size, 0.3f,
+                                      jointCount, streams.data());
+    return streams[0];
+  };
+  BENCHMARK("compressed clip sampling") {
+    frame = (frame + 7) % (frameCount - 1);
+    SirEngine::sampleCompressedClip(compressed.data(), frame, 0.3f,
+                                    streams.data());
+    return streams[0];
+  };
+  // playback moving forward, as a player would
+  SirEngine::ClipCursor cursor;
+  cursor.initialize(compressed.data());
+  BENCHMARK("compressed clip cursor") {
+    frame = (frame + 1) % frameCount;
+    cursor.sample(frame, 0.3f, streams.data());
+    return streams[0];
+  };
+}
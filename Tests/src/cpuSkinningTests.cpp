@@ -0,0 +1,215 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "SirEngine/animation/cpuSkinning.h"
+#include "SirEngine/workerPool.h"
+#include "catch/catch.hpp"
+#include <glm/gtx/transform.hpp>
+
+using SirEngine::CpuSkinning;
+using SirEngine::SKINNING_MODE;
+using SirEngine::SkinningOutput;
+using SirEngine::SkinningVertexData;
+using SirEngine::VERTEX_INFLUENCE_COUNT;
+
+namespace {
+// vertex data owning its memory, random positions and normals, every vertex
+// influenced by random joints with weights summing to one
+struct TestMesh {
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<int> influences;
+  std::vector<float> weights;
+
+  TestMesh(std::mt19937 &generator, const uint32_t vertexCount,
+           const uint32_t jointCount)
+      : positions(vertexCount * 4), normals(vertexCount * 4),
+        influences(vertexCount * VERTEX_INFLUENCE_COUNT),
+        weights(vertexCount * VERTEX_INFLUENCE_COUNT) {
+    std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int> joint(0, jointCount - 1);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+      const glm::vec3 normal = glm::normalize(
+          glm::vec3(coordinate(generator), coordinate(generator), 1.0f));
+      for (uint32_t c = 0; c < 3; ++c) {
+        positions[v * 4 + c] = coordinate(generator);
+        normals[v * 4 + c] = normal[c];
+      }
+      positions[v * 4 + 3] = 1.0f;
+      float total = 0.0f;
+      for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+        influences[v * VERTEX_INFLUENCE_COUNT + i] = joint(generator);
+        weights[v * VERTEX_INFLUENCE_COUNT + i] = unit(generator);
+        total += weights[v * VERTEX_INFLUENCE_COUNT + i];
+      }
+      for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+        weights[v * VERTEX_INFLUENCE_COUNT + i] /= total;
+      }
+    }
+  }
+
+  [[nodiscard]] SkinningVertexData getVertexData() const {
+    SkinningVertexData data;
+    data.positions = positions.data();
+    data.normals = normals.data();
+    data.influences = influences.data();
+    data.weights = weights.data();
+    data.vertexCount = static_cast<uint32_t>(positions.size() / 4);
+    return data;
+  }
+};
+
+// rigid transforms, as skin matrices of a skeleton without scale are
+std::vector<glm::mat4> randomMatrices(std::mt19937 &generator,
+                                      const uint32_t count) {
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  std::vector<glm::mat4> matrices(count);
+  for (glm::mat4 &matrix : matrices) {
+    const glm::vec3 axis =
+        glm::normalize(glm::vec3(value(generator), value(generator), 1.0f));
+    matrix = glm::translate(glm::mat4(1.0f),
+                            glm::vec3(value(generator), value(generator),
+                                      value(generator)) *
+                                10.0f) *
+             glm::rotate(glm::mat4(1.0f), value(generator) * 0.5f, axis);
+  }
+  return matrices;
+}
+
+struct OutputBuffers {
+  std::vector<float> positions;
+  std::vector<float> normals;
+  explicit OutputBuffers(const uint32_t vertexCount)
+      : positions(vertexCount * 4), normals(vertexCount * 4) {}
+  SkinningOutput get() { return {positions.data(), normals.data()}; }
+};
+}  // namespace
+
+TEST_CASE("cpu linear blend skinning matches the shader", "[animation]") {
+  std::mt19937 generator(5);
+  constexpr uint32_t vertexCount = 5000;
+  const TestMesh mesh(generator, vertexCount, 40);
+  const std::vector<glm::mat4> matrices = randomMatrices(generator, 40);
+  const SkinningVertexData vertices = mesh.getVertexData();
+
+  OutputBuffers expected(vertexCount);
+  SirEngine::skinVerticesLinearBlendScalar(vertices, matrices.data(),
+                                           expected.get());
+  CpuSkinning skinning;
+  skinning.setMatrices(matrices.data(), 40, SKINNING_MODE::LINEAR_BLEND);
+  OutputBuffers serial(vertexCount);
+  skinning.skin(vertices, serial.get());
+  SirEngine::WorkerPool pool(4);
+  OutputBuffers parallel(vertexCount);
+  skinning.skin(vertices, parallel.get(), &pool);
+
+  for (uint32_t i = 0; i < vertexCount * 4; ++i) {
+    REQUIRE(serial.positions[i] ==
+            Approx(expected.positions[i]).margin(1e-3f));
+    REQUIRE(serial.normals[i] == Approx(expected.normals[i]).margin(1e-5f));
+    REQUIRE(parallel.positions[i] == serial.positions[i]);
+    REQUIRE(parallel.normals[i] == serial.normals[i]);
+  }
+  REQUIRE(serial.positions[3] == 1.0f);
+  REQUIRE(serial.normals[3] == 0.0f);
+}
+
+TEST_CASE("cpu dual quaternion skinning", "[animation]") {
+  std::mt19937 generator(9);
+  constexpr uint32_t vertexCount = 2000;
+  TestMesh mesh(generator, vertexCount, 20);
+  const std::vector<glm::mat4> matrices = randomMatrices(generator, 20);
+
+  // with a single influence both modes are a plain rigid transform
+  for (uint32_t v = 0; v < vertexCount; ++v) {
+    for (uint32_t i = 0; i < VERTEX_INFLUENCE_COUNT; ++i) {
+      mesh.weights[v * VERTEX_INFLUENCE_COUNT + i] = i == 0 ? 1.0f : 0.0f;
+    }
+  }
+  CpuSkinning linear;
+  linear.setMatrices(matrices.data(), 20, SKINNING_MODE::LINEAR_BLEND);
+  CpuSkinning dual;
+  dual.setMatrices(matrices.data(), 20, SKINNING_MODE::DUAL_QUATERNION);
+  OutputBuffers linearOut(vertexCount);
+  OutputBuffers dualOut(vertexCount);
+  linear.skin(mesh.getVertexData(), linearOut.get());
+  SirEngine::WorkerPool pool(3);
+  dual.skin(mesh.getVertexData(), dualOut.get(), &pool);
+  for (uint32_t i = 0; i < vertexCount * 4; ++i) {
+    REQUIRE(dualOut.positions[i] ==
+            Approx(linearOut.positions[i]).margin(1e-3f));
+    REQUIRE(dualOut.normals[i] == Approx(linearOut.normals[i]).margin(1e-4f));
+  }
+
+  // half way between a joint and the same joint twisted by 160 degrees, the
+  // linear blend collapses the vertex toward the axis, the dual quaternion
+  // keeps it on the circle
+  const glm::mat4 twist[2] = {
+      glm::mat4(1.0f),
+      glm::rotate(glm::mat4(1.0f), glm::radians(160.0f),
+                  glm::vec3(1.0f, 0.0f, 0.0f))};
+  const float position[4] = {0.0f, 1.0f, 0.0f, 1.0f};
+  const float normal[4] = {0.0f, 1.0f, 0.0f, 0.0f};
+  const int influences[VERTEX_INFLUENCE_COUNT] = {0, 1, 0, 0, 0, 0};
+  const float weights[VERTEX_INFLUENCE_COUNT] = {0.5f, 0.5f, 0, 0, 0, 0};
+  SkinningVertexData vertex;
+  vertex.positions = position;
+  vertex.normals = normal;
+  vertex.influences = influences;
+  vertex.weights = weights;
+  vertex.vertexCount = 1;
+  float outPosition[4];
+  float outNormal[4];
+  linear.setMatrices(twist, 2, SKINNING_MODE::LINEAR_BLEND);
+  linear.skin(vertex, {outPosition, outNormal});
+  const float linearRadius = std::sqrt(outPosition[1] * outPosition[1] +
+                                       outPosition[2] * outPosition[2]);
+  dual.setMatrices(twist, 2, SKINNING_MODE::DUAL_QUATERNION);
+  dual.skin(vertex, {outPosition, outNormal});
+  const float dualRadius = std::sqrt(outPosition[1] * outPosition[1] +
+                                     outPosition[2] * outPosition[2]);
+  REQUIRE(linearRadius < 0.2f);
+  REQUIRE(dualRadius == Approx(1.0f).margin(1e-4f));
+}
+
+TEST_CASE("cpu skinning vertices per second", "[.][benchmark]") {
+  // a few characters worth of vertices on a mannequin sized skeleton
+  std::mt19937 generator(1);
+  constexpr uint32_t vertexCount = 256 * 1024;
+  constexpr uint32_t jointCount = 64;
+  const TestMesh mesh(generator, vertexCount, jointCount);
+  const std::vector<glm::mat4> matrices =
+      randomMatrices(generator, jointCount);
+  const SkinningVertexData vertices = mesh.getVertexData();
+  OutputBuffers output(vertexCount);
+  CpuSkinning linear;
+  linear.setMatrices(matrices.data(), jointCount, SKINNING_MODE::LINEAR_BLEND);
+  CpuSkinning dual;
+  dual.setMatrices(matrices.data(), jointCount,
+                   SKINNING_MODE::DUAL_QUATERNION);
+  SirEngine::WorkerPool pool(4);
+
+  BENCHMARK("scalar linear blend 256k vertices") {
+    SirEngine::skinVerticesLinearBlendScalar(vertices, matrices.data(),
+                                             output.get());
+    return output.positions[0];
+  };
+  BENCHMARK("simd linear blend 256k vertices") {
+    linear.skin(vertices, output.get());
+    return output.positions[0];
+  };
+  BENCHMARK("simd linear blend 256k vertices 4 workers") {
+    linear.skin(vertices, output.get(), &pool);
+    return output.positions[0];
+  };
+  BENCHMARK("simd dual quaternion 256k vertices") {
+    dual.skin(vertices, output.get());
+    return output.positions[0];
+  };
+  BENCHMARK("simd dual quaternion 256k vertices 4 workers") {
+    dual.skin(vertices, output.get(), &pool);
+    return output.positions[0];
+  };
+}
@@ -0,0 +1,530 @@
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "SirEngine/ecs/ecs.h"
+#include "SirEngine/ecs/ecsSnapshot.h"
+#include "SirEngine/ecs/transformHierarchy.h"
+#include "SirEngine/graphics/renderExtraction.h"
+#include "SirEngine/graphics/spatialIndex.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "SirEngine/workerPool.h"
+#include "catch/catch.hpp"
+
+// benchmarks are hidden by default, run them with: Tests.exe [benchmark]
+namespace {
+struct BenchTransform {
+  float m[16];
+};
+// index in the mirrored buffer, mimics a render or skin matrix slot
+struct BenchMirrorSlot {
+  uint32_t slot;
+};
+
+using SirEngine::ecs::EntityId;
+using SirEngine::ecs::Registry;
+
+constexpr uint32_t BENCH_ENTITY_COUNT = 100000;
+// 1% of the entities change every frame
+constexpr uint32_t BENCH_CHANGE_STRIDE = 100;
+
+void createBenchEntities(Registry& registry, std::vector<EntityId>& ids) {
+  ids.reserve(BENCH_ENTITY_COUNT);
+  for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; ++i) {
+    BenchTransform t{};
+    t.m[0] = static_cast<float>(i);
+    ids.push_back(registry.createEntity(t, BenchMirrorSlot{i}));
+  }
+}
+
+// writes to 1% of the entities spread evenly, worst case for chunk
+// granularity since every write lands in a different chunk
+void simulateFrame(Registry& registry, const std::vector<EntityId>& ids,
+                   const uint32_t frame) {
+  const uint32_t offset = frame % BENCH_CHANGE_STRIDE;
+  for (uint32_t i = offset; i < BENCH_ENTITY_COUNT; i += BENCH_CHANGE_STRIDE) {
+    registry.getComponent<BenchTransform>(ids[i]).m[12] += 1.0f;
+  }
+}
+}  // namespace
+
+TEST_CASE("ecs change detection 1% of 100k", "[.][benchmark][ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  createBenchEntities(registry, ids);
+  std::vector<BenchTransform> mirror(BENCH_ENTITY_COUNT);
+  std::vector<std::tuple<size_t, const BenchTransform*, const BenchMirrorSlot*>>
+      query;
+
+  uint32_t frame = 0;
+  BENCHMARK("mirror all entities") {
+    simulateFrame(registry, ids, frame++);
+    registry.populateComponentQuery(query);
+    size_t copied = 0;
+    for (const auto& q : query) {
+      const size_t count = std::get<0>(q);
+      const BenchTransform* transforms = std::get<1>(q);
+      const BenchMirrorSlot* slots = std::get<2>(q);
+      for (size_t i = 0; i < count; ++i) {
+        mirror[slots[i].slot] = transforms[i];
+      }
+      copied += count;
+    }
+    return copied;
+  };
+
+  uint32_t lastSeen = registry.advanceVersion();
+  BENCHMARK("mirror changed entities only") {
+    simulateFrame(registry, ids, frame++);
+    registry.populateChangedComponentQuery<BenchTransform>(query, lastSeen);
+    lastSeen = registry.advanceVersion();
+    size_t copied = 0;
+    for (const auto& q : query) {
+      const size_t count = std::get<0>(q);
+      const BenchTransform* transforms = std::get<1>(q);
+      const BenchMirrorSlot* slots = std::get<2>(q);
+      for (size_t i = 0; i < count; ++i) {
+        mirror[slots[i].slot] = transforms[i];
+      }
+      copied += count;
+    }
+    return copied;
+  };
+}
+
+TEST_CASE("ecs snapshot restore 100k", "[.][benchmark][ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  createBenchEntities(registry, ids);
+  std::vector<char> data;
+  SirEngine::ecs::serializeRegistrySnapshot(registry, data);
+
+  BENCHMARK("create entities one by one") {
+    Registry created;
+    std::vector<EntityId> createdIds;
+    createBenchEntities(created, createdIds);
+    return createdIds.size();
+  };
+
+  BENCHMARK_ADVANCED("restore from snapshot")
+  (Catch::Benchmark::Chronometer meter) {
+    Registry restored;
+    meter.measure([&] {
+      return SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                     data.size());
+    });
+  };
+}
+
+namespace {
+struct BenchArchetypeTag {
+  uint32_t value;
+};
+struct BenchSparseTag {
+  uint32_t value;
+};
+}  // namespace
+SE_ECS_SPARSE_COMPONENT(BenchSparseTag)
+
+// toggling a tag on 1% of the entities every frame
+TEST_CASE("ecs tag toggle 1% of 100k", "[.][benchmark][ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  createBenchEntities(registry, ids);
+
+  BENCHMARK("archetype tag") {
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; i += BENCH_CHANGE_STRIDE) {
+      registry.addComponent(ids[i], BenchArchetypeTag{i});
+    }
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; i += BENCH_CHANGE_STRIDE) {
+      registry.removeComponent<BenchArchetypeTag>(ids[i]);
+    }
+    return ids.size();
+  };
+  BENCHMARK("sparse tag") {
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; i += BENCH_CHANGE_STRIDE) {
+      registry.addComponent(ids[i], BenchSparseTag{i});
+    }
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; i += BENCH_CHANGE_STRIDE) {
+      registry.removeComponent<BenchSparseTag>(ids[i]);
+    }
+    return ids.size();
+  };
+}
+
+namespace {
+using SirEngine::ecs::LocalTransform;
+using SirEngine::ecs::TransformHierarchy;
+
+constexpr uint32_t BENCH_HIERARCHY_COUNT = 10000;
+
+void touchLocal(Registry& registry, const EntityId eid) {
+  registry.getComponent<LocalTransform>(eid).matrix[3][0] += 1.0f;
+}
+}  // namespace
+
+TEST_CASE("ecs transform hierarchy 10k", "[.][benchmark][ecs]") {
+  const LocalTransform identity{glm::mat4(1.0f)};
+
+  // a single deep chain, worst case for depth
+  Registry deepRegistry;
+  TransformHierarchy deep;
+  std::vector<EntityId> deepIds;
+  for (uint32_t i = 0; i < BENCH_HIERARCHY_COUNT; ++i) {
+    deepIds.push_back(deepRegistry.createEntity(identity));
+    deep.addEntity(deepRegistry, deepIds.back(),
+                   i == 0 ? TransformHierarchy::NO_PARENT : deepIds[i - 1]);
+  }
+  deep.update(deepRegistry);
+
+  // a shallow and wide forest, 100 roots with 99 children each
+  Registry wideRegistry;
+  TransformHierarchy wide;
+  std::vector<EntityId> wideIds;
+  EntityId root{};
+  for (uint32_t i = 0; i < BENCH_HIERARCHY_COUNT; ++i) {
+    wideIds.push_back(wideRegistry.createEntity(identity));
+    const bool isRoot = (i % 100) == 0;
+    wide.addEntity(wideRegistry, wideIds.back(),
+                   isRoot ? TransformHierarchy::NO_PARENT : root);
+    root = isRoot ? wideIds.back() : root;
+  }
+  wide.update(wideRegistry);
+
+  BENCHMARK("deep, root changed") {
+    touchLocal(deepRegistry, deepIds[0]);
+    deep.update(deepRegistry);
+    return deep.getLastUpdatedCount();
+  };
+  BENCHMARK("deep, leaf changed") {
+    touchLocal(deepRegistry, deepIds.back());
+    deep.update(deepRegistry);
+    return deep.getLastUpdatedCount();
+  };
+  BENCHMARK("wide, one root changed") {
+    touchLocal(wideRegistry, wideIds[0]);
+    wide.update(wideRegistry);
+    return wide.getLastUpdatedCount();
+  };
+  BENCHMARK("wide, 1% of leaves changed") {
+    for (uint32_t i = 1; i < BENCH_HIERARCHY_COUNT; i += 100) {
+      touchLocal(wideRegistry, wideIds[i]);
+    }
+    wide.update(wideRegistry);
+    return wide.getLastUpdatedCount();
+  };
+  BENCHMARK("wide, re-parent and rebuild") {
+    wide.setParent(wideRegistry, wideIds[1], wideIds[100]);
+    wide.update(wideRegistry);
+    return wide.getLastUpdatedCount();
+  };
+}
+
+namespace {
+struct BenchPosition {
+  float x, y, z;
+};
+struct BenchVelocity {
+  float x, y, z;
+};
+}  // namespace
+
+// integrates 200k entities, the same work split over more and more workers
+TEST_CASE("ecs parallel for each scaling 200k", "[.][benchmark][ecs]") {
+  constexpr uint32_t entityCount = BENCH_ENTITY_COUNT * 2;
+  Registry registry;
+  for (uint32_t i = 0; i < entityCount; ++i) {
+    const auto f = static_cast<float>(i);
+    registry.createEntity(BenchPosition{f, 0, 0}, BenchVelocity{1, f, 0.5f});
+  }
+  const auto integrate = [](EntityId, BenchPosition& p, const BenchVelocity& v) {
+    // a bit of math to make it worth splitting
+    for (uint32_t s = 0; s < 8; ++s) {
+      p.x += v.x * 0.016f;
+      p.y = std::sqrt(p.y * p.y + v.y * 0.016f);
+      p.z += std::sin(p.x) * v.z;
+    }
+  };
+
+  BENCHMARK("single thread for each") {
+    registry.forEach<BenchPosition, const BenchVelocity>(integrate);
+    return entityCount;
+  };
+  for (const uint32_t workerCount : {1u, 2u, 4u, 8u}) {
+    SirEngine::WorkerPool pool(workerCount);
+    BENCHMARK("parallel for each, " + std::to_string(workerCount) +
+              " workers") {
+      registry.parallelForEach<BenchPosition, const BenchVelocity>(pool,
+                                                                   integrate);
+      return entityCount;
+    };
+  }
+}
+
+TEST_CASE("render extraction 200k", "[.][benchmark][ecs]") {
+  constexpr uint32_t entityCount = BENCH_ENTITY_COUNT * 2;
+  Registry registry;
+  for (uint32_t i = 0; i < entityCount; ++i) {
+    glm::mat4 matrix(1.0f);
+    matrix[3] = glm::vec4(static_cast<float>(i % 1000) - 500.0f,
+                          static_cast<float>(i / 1000), 0.0f, 1.0f);
+    const EntityId eid = registry.createEntity(
+        SirEngine::ecs::WorldTransform{matrix},
+        SirEngine::RenderBounds{glm::vec3(0.0f), 1.0f});
+    registry.setSharedComponent(
+        eid, SirEngine::MeshRenderer{SirEngine::MeshHandle{1 + i % 16},
+                                     SirEngine::MaterialHandle{1 + i % 4}});
+  }
+  // keeps roughly half of the entities
+  Plane frustum[6];
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      const float sign = side == 0 ? 1.0f : -1.0f;
+      Plane& plane = frustum[axis * 2 + side];
+      plane.normal = glm::vec4(0.0f);
+      plane.normal[axis] = sign;
+      plane.position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+      plane.position[axis] = sign * 250.0f;
+    }
+  }
+  SirEngine::StackAllocator frameAllocator;
+  frameAllocator.initialize(sizeof(SirEngine::DrawPacket) * entityCount + 64);
+  SirEngine::RenderExtractor extractor;
+
+  BENCHMARK("extraction, no culling") {
+    frameAllocator.reset();
+    return extractor.extract(registry, frameAllocator, nullptr, nullptr).count;
+  };
+  BENCHMARK("extraction, culling") {
+    frameAllocator.reset();
+    return extractor.extract(registry, frameAllocator, frustum, nullptr).count;
+  };
+  for (const uint32_t workerCount : {2u, 4u, 8u}) {
+    SirEngine::WorkerPool pool(workerCount);
+    BENCHMARK("extraction, culling, " + std::to_string(workerCount) +
+              " workers") {
+      frameAllocator.reset();
+      return extractor.extract(registry, frameAllocator, frustum, &pool).count;
+    };
+  }
+}
+
+namespace {
+template <uint32_t N>
+struct BenchVariant {
+  float value;
+};
+constexpr uint32_t BENCH_VARIANT_COUNT = 9;
+
+template <size_t... N>
+void addBenchVariants(Registry& registry, const EntityId eid,
+                      const uint32_t bits, std::index_sequence<N...>) {
+  ((bits & (1u << N) ? registry.addComponent(eid, BenchVariant<N>{1.0f})
+                     : void()),
+   ...);
+}
+}  // namespace
+
+// every combination of the variants is an archetype, 512 of them
+TEST_CASE("ecs query matching 512 archetypes", "[.][benchmark][ecs]") {
+  Registry registry;
+  constexpr uint32_t combinationCount = 1u << BENCH_VARIANT_COUNT;
+  for (uint32_t bits = 0; bits < combinationCount; ++bits) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      const EntityId eid = registry.createEntity(
+          BenchPosition{static_cast<float>(i), 0, 0}, BenchVelocity{1, 1, 1});
+      addBenchVariants(registry, eid, bits,
+                       std::make_index_sequence<BENCH_VARIANT_COUNT>{});
+    }
+  }
+  REQUIRE(registry.getArchetypeCount() >= combinationCount);
+
+  std::vector<std::tuple<size_t, BenchPosition*, const BenchVelocity*,
+                         const BenchVariant<3>*, const BenchVariant<7>*>>
+      query;
+  BENCHMARK("bitset matching") {
+    registry.populateComponentQuery(query);
+    return query.size();
+  };
+
+  // what the matching used to be, the hashes of the query compared against
+  // the component array of every archetype
+  const std::vector<size_t> ids{
+      SirEngine::ecs::MultiHash<BenchPosition>::hash,
+      SirEngine::ecs::MultiHash<BenchVelocity>::hash,
+      SirEngine::ecs::MultiHash<BenchVariant<3>>::hash,
+      SirEngine::ecs::MultiHash<BenchVariant<7>>::hash};
+  BENCHMARK("hash array matching") {
+    size_t matching = 0;
+    for (uint32_t a = 0; a < registry.getArchetypeCount(); ++a) {
+      const SirEngine::ecs::Archetype* arch = registry.getArchetype(a);
+      matching += ((arch->entityCount != 0) &&
+                   arch->hasComponentFromHashes(ids))
+                      ? 1
+                      : 0;
+    }
+    return matching;
+  };
+
+  BENCHMARK("structural change, add and remove") {
+    const EntityId eid =
+        registry.createEntity(BenchPosition{}, BenchVelocity{});
+    registry.addComponent(eid, BenchVariant<5>{});
+    registry.addComponent(eid, BenchVariant<1>{});
+    registry.removeComponent<BenchVariant<5>>(eid);
+    registry.deleteEntity(eid);
+    return eid.index;
+  };
+}
+
+namespace {
+// a crowd agent, a few components with a shared mesh
+struct BenchAgentState {
+  float speed;
+  uint32_t animation;
+  uint32_t flags;
+};
+struct BenchAgentMesh {
+  uint32_t handle;
+};
+}  // namespace
+SE_ECS_SHARED_COMPONENT(BenchAgentMesh)
+
+TEST_CASE("ecs prefab instantiate 100k", "[.][benchmark][ecs]") {
+  BenchTransform transform{};
+  transform.m[0] = 1.0f;
+  const BenchPosition position{1, 2, 3};
+  const BenchVelocity velocity{0, 0, 1};
+  const BenchAgentState state{1.5f, 3, 0};
+
+  BENCHMARK("create entity and add components") {
+    Registry registry;
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; ++i) {
+      const EntityId eid = registry.createEntity(transform);
+      registry.addComponent(eid, position);
+      registry.addComponent(eid, velocity);
+      registry.addComponent(eid, state);
+      registry.setSharedComponent(eid, BenchAgentMesh{7});
+    }
+    return registry.getAliveEntityCount();
+  };
+
+  BENCHMARK("create entity with all components") {
+    Registry registry;
+    for (uint32_t i = 0; i < BENCH_ENTITY_COUNT; ++i) {
+      const EntityId eid =
+          registry.createEntity(transform, position, velocity, state);
+      registry.setSharedComponent(eid, BenchAgentMesh{7});
+    }
+    return registry.getAliveEntityCount();
+  };
+
+  SirEngine::ecs::Prefab prefab;
+  prefab.set(transform).set(position).set(velocity).set(state).set(
+      BenchAgentMesh{7});
+  std::vector<EntityId> ids(BENCH_ENTITY_COUNT);
+  BENCHMARK("instantiate prefab") {
+    Registry registry;
+    registry.instantiate(prefab, BENCH_ENTITY_COUNT, ids.data());
+    return registry.getAliveEntityCount();
+  };
+}
+
+TEST_CASE("spatial index 1M static 10k dynamic", "[.][benchmark][ecs]") {
+  constexpr uint32_t staticCount = 1000000;
+  constexpr uint32_t dynamicCount = 10000;
+  Registry registry;
+  SirEngine::SpatialIndex index;
+  std::vector<EntityId> dynamicIds;
+  // a 2km wide world, ten meters tall
+  const auto placeEntity = [&](const uint32_t i, const float offset) {
+    glm::mat4 matrix(1.0f);
+    matrix[3] = glm::vec4(static_cast<float>(i % 1000) * 2.0f - 1000.0f,
+                          static_cast<float>(i % 10),
+                          static_cast<float>(i / 1000 % 1000) * 2.0f - 1000.0f +
+                              offset,
+                          1.0f);
+    return SirEngine::ecs::WorldTransform{matrix};
+  };
+  for (uint32_t i = 0; i < staticCount + dynamicCount; ++i) {
+    const EntityId eid = registry.createEntity(
+        placeEntity(i * 7919u % staticCount, 0.0f),
+        SirEngine::RenderBounds{glm::vec3(0.0f), 1.0f});
+    index.addEntity(registry, eid);
+    if (i >= staticCount) {
+      dynamicIds.push_back(eid);
+    }
+  }
+  index.update(registry);
+
+  float offset = 0.0f;
+  BENCHMARK("move 10k dynamic entities and update the index") {
+    offset += 0.5f;
+    for (uint32_t i = 0; i < dynamicCount; ++i) {
+      registry.getComponent<SirEngine::ecs::WorldTransform>(dynamicIds[i]) =
+          placeEntity(i * 7919u % staticCount, offset);
+    }
+    index.update(registry);
+    return index.getLastUpdatedCount();
+  };
+
+  // a 100m box in the middle of the world
+  const glm::vec3 minCorner(-50.0f, -10.0f, -50.0f);
+  const glm::vec3 maxCorner(50.0f, 10.0f, 50.0f);
+  std::vector<EntityId> result;
+  BENCHMARK("aabb query, index") {
+    index.queryAabb(minCorner, maxCorner, result);
+    return result.size();
+  };
+  std::vector<std::tuple<size_t, const SirEngine::ecs::WorldTransform*,
+                         const SirEngine::RenderBounds*>>
+      query;
+  BENCHMARK("aabb query, brute force") {
+    registry.populateComponentQuery(query);
+    size_t count = 0;
+    for (const auto& q : query) {
+      for (size_t i = 0; i < std::get<0>(q); ++i) {
+        glm::vec3 center;
+        float radius;
+        SirEngine::getWorldBoundingSphere(std::get<1>(q)[i].matrix,
+                                          std::get<2>(q)[i], center, radius);
+        const glm::vec3 delta =
+            center - glm::min(glm::max(center, minCorner), maxCorner);
+        count += glm::dot(delta, delta) <= radius * radius ? 1 : 0;
+      }
+    }
+    return count;
+  };
+
+  // a 200m frustum shaped box
+  Plane frustum[6];
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      const float sign = side == 0 ? 1.0f : -1.0f;
+      Plane& plane = frustum[axis * 2 + side];
+      plane.normal = glm::vec4(0.0f);
+      plane.normal[axis] = sign;
+      plane.position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+      plane.position[axis] = sign * 100.0f;
+    }
+  }
+  BENCHMARK("frustum query, index") {
+    index.queryFrustum(frustum, result);
+    return result.size();
+  };
+  BENCHMARK("frustum query, brute force") {
+    registry.populateComponentQuery(query);
+    size_t count = 0;
+    for (const auto& q : query) {
+      for (size_t i = 0; i < std::get<0>(q); ++i) {
+        glm::vec3 center;
+        float radius;
+        SirEngine::getWorldBoundingSphere(std::get<1>(q)[i].matrix,
+                                          std::get<2>(q)[i], center, radius);
+        count += SirEngine::isSphereInFrustum(frustum, center, radius) ? 1 : 0;
+      }
+    }
+    return count;
+  };
+}
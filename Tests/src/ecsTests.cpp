@@ -1,5 +1,12 @@
+#include <filesystem>
+
 #include "SirEngine/ecs/ecs.h"
+#include "SirEngine/ecs/ecsSnapshot.h"
+#include "SirEngine/ecs/ecsStats.h"
+#include "SirEngine/io/binaryFile.h"
+#include "SirEngine/workerPool.h"
 #include "catch/catch.hpp"
+#include "nlohmann/json.hpp"
 
 struct Position {
   float x, y, z, w;
@@ -13,6 +20,32 @@ struct Dummy {
   uint16_t d, e;
 };
 
+struct Selected {
+  uint32_t frame;
+};
+SE_ECS_SPARSE_COMPONENT(Selected)
+
+struct Hidden {
+  uint32_t reason;
+};
+SE_ECS_SPARSE_COMPONENT(Hidden)
+
+// stand in for a mesh handle shared by many renderables
+struct SharedMesh {
+  uint32_t handle;
+};
+SE_ECS_SHARED_COMPONENT(SharedMesh)
+
+struct SharedMaterial {
+  uint32_t handle;
+};
+SE_ECS_SHARED_COMPONENT(SharedMaterial)
+
+struct FrameSettings {
+  float deltaTime;
+  uint32_t frame;
+};
+
 using SirEngine::ecs::Archetype;
 using SirEngine::ecs::Entity;
 using SirEngine::ecs::EntityId;
@@ -606,3 +639,1023 @@ TEST_CASE("delete empty entity", "[core,ecs]") {
   registry.removeComponent<Position>(eid);
   registry.deleteEntity(eid);
 }
+
+TEST_CASE("delete after moving between archetypes", "[core,ecs]") {
+  Registry registry;
+  Position p{0, 1, 2, 3};
+  Position p2{4, 5, 6, 7};
+
+  // both entities get migrated, then the first one is deleted, the second
+  // one plugs the hole and needs to be patched correctly
+  EntityId eid = registry.createEntity(p);
+  EntityId eid2 = registry.createEntity(p2);
+  registry.addComponent(eid, Health{10});
+  registry.addComponent(eid2, Health{20});
+  registry.removeComponent<Health>(eid);
+  registry.deleteEntity(eid);
+
+  REQUIRE(registry.isEntityValid(eid2));
+  registry.removeComponent<Health>(eid2);
+  const Position& outPos = registry.getComponent<Position>(eid2);
+  REQUIRE(outPos.x == Approx(p2.x));
+  REQUIRE(outPos.w == Approx(p2.w));
+}
+
+TEST_CASE("change detection on write access", "[core,ecs]") {
+  Registry registry;
+  const int toCreate = Archetype::VERSION_CHUNK_SIZE * 4;
+  std::vector<EntityId> ids;
+  for (int i = 0; i < toCreate; ++i) {
+    ids.push_back(registry.createEntity(Position{static_cast<float>(i), 0, 0, 0},
+                                        Health{static_cast<float>(i)}));
+  }
+
+  // everything is new for somebody that never looked at the data
+  std::vector<std::tuple<size_t, const Position*>> query;
+  registry.populateChangedComponentQuery<Position>(query, 0);
+  REQUIRE(query.size() == 1);
+  REQUIRE(std::get<0>(query[0]) == toCreate);
+
+  // closing the version, nothing should be changed after that
+  uint32_t lastSeen = registry.advanceVersion();
+  registry.populateChangedComponentQuery<Position>(query, lastSeen);
+  REQUIRE(query.empty());
+
+  // const access is not a write
+  const Registry& constRegistry = registry;
+  REQUIRE(constRegistry.getComponent<Position>(ids[10]).x == Approx(10));
+  registry.populateChangedComponentQuery<Position>(query, lastSeen);
+  REQUIRE(query.empty());
+
+  // writing to one entity only flags its chunk
+  const int toChange = Archetype::VERSION_CHUNK_SIZE * 2 + 3;
+  registry.getComponent<Position>(ids[toChange]).y = 99;
+  registry.populateChangedComponentQuery<Position>(query, lastSeen);
+  REQUIRE(query.size() == 1);
+  REQUIRE(std::get<0>(query[0]) == Archetype::VERSION_CHUNK_SIZE);
+  const Position* changed = std::get<1>(query[0]);
+  REQUIRE(changed[0].x == Approx(Archetype::VERSION_CHUNK_SIZE * 2));
+  REQUIRE(changed[3].y == Approx(99));
+
+  // health was not touched
+  std::vector<std::tuple<size_t, const Health*>> healthQuery;
+  registry.populateChangedComponentQuery<Health>(healthQuery, lastSeen);
+  REQUIRE(healthQuery.empty());
+
+  // adjacent chunks get merged in a single range
+  registry.markComponentChanged<Position>(ids[Archetype::VERSION_CHUNK_SIZE]);
+  registry.populateChangedComponentQuery<Position>(query, lastSeen);
+  REQUIRE(query.size() == 1);
+  REQUIRE(std::get<0>(query[0]) == Archetype::VERSION_CHUNK_SIZE * 2);
+  REQUIRE(std::get<1>(query[0])[0].x == Approx(Archetype::VERSION_CHUNK_SIZE));
+
+  lastSeen = registry.advanceVersion();
+  registry.populateChangedComponentQuery<Position>(query, lastSeen);
+  REQUIRE(query.empty());
+
+  // a mutable query is a write to the whole column
+  std::vector<std::tuple<size_t, Position*>> writeQuery;
+  registry.populateComponentQuery(writeQuery);
+  registry.populateChangedComponentQuery<Position>(query, lastSeen);
+  REQUIRE(query.size() == 1);
+  REQUIRE(std::get<0>(query[0]) == toCreate);
+}
+
+TEST_CASE("change detection on structural changes", "[core,ecs]") {
+  Registry registry;
+  const int toCreate = Archetype::VERSION_CHUNK_SIZE * 3;
+  std::vector<EntityId> ids;
+  for (int i = 0; i < toCreate; ++i) {
+    ids.push_back(
+        registry.createEntity(Position{static_cast<float>(i), 0, 0, 0}));
+  }
+  uint32_t lastSeen = registry.advanceVersion();
+
+  // deleting the first entity moves the last one in its row, which is now
+  // considered changed
+  registry.deleteEntity(ids[0]);
+  std::vector<std::tuple<size_t, const Position*>> query;
+  registry.populateChangedComponentQuery<Position>(query, lastSeen);
+  REQUIRE(query.size() == 1);
+  REQUIRE(std::get<1>(query[0])[0].x == Approx(toCreate - 1));
+
+  // adding a component moves the entity to a new archetype where it shows up
+  // as changed
+  lastSeen = registry.advanceVersion();
+  registry.addComponent(ids[5], Health{10});
+  std::vector<std::tuple<size_t, const Position*, const Health*>> query2;
+  registry.populateChangedComponentQuery<Health>(query2, lastSeen);
+  REQUIRE(query2.size() == 1);
+  REQUIRE(std::get<0>(query2[0]) == 1);
+  REQUIRE(std::get<1>(query2[0])[0].x == Approx(5));
+  REQUIRE(std::get<2>(query2[0])[0].hp == Approx(10));
+}
+
+TEST_CASE("snapshot round trip", "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (int i = 0; i < 100; ++i) {
+    Position p{static_cast<float>(i), 1, 2, 3};
+    if ((i % 3) == 0) {
+      ids.push_back(registry.createEntity(p));
+    } else if ((i % 3) == 1) {
+      ids.push_back(registry.createEntity(p, Health{static_cast<float>(i)}));
+    } else {
+      Dummy d{i, -i, 0.5f, 1, 2};
+      ids.push_back(registry.createEntity(p, Health{static_cast<float>(i)}, d));
+    }
+  }
+  // making sure the free list and the entity versions are part of the snapshot
+  registry.deleteEntity(ids[10]);
+  registry.deleteEntity(ids[50]);
+
+  std::vector<char> data;
+  SirEngine::ecs::serializeRegistrySnapshot(registry, data);
+
+  Registry restored;
+  REQUIRE(SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                  data.size()));
+  REQUIRE(restored.getArchetypeCount() == registry.getArchetypeCount());
+  for (int i = 0; i < 100; ++i) {
+    if ((i == 10) | (i == 50)) {
+      REQUIRE(!restored.isEntityValid(ids[i]));
+      continue;
+    }
+    REQUIRE(restored.isEntityValid(ids[i]));
+    REQUIRE(restored.getComponent<Position>(ids[i]).x ==
+            Approx(static_cast<float>(i)));
+    REQUIRE(restored.hasComponent<Health>(ids[i]) == ((i % 3) != 0));
+    REQUIRE(restored.hasComponent<Dummy>(ids[i]) == ((i % 3) == 2));
+    if ((i % 3) != 0) {
+      REQUIRE(restored.getComponent<Health>(ids[i]).hp ==
+              Approx(static_cast<float>(i)));
+    }
+    if ((i % 3) == 2) {
+      const Dummy& d = restored.getComponent<Dummy>(ids[i]);
+      REQUIRE(d.a == i);
+      REQUIRE(d.b == -i);
+      REQUIRE(d.c == Approx(0.5f));
+      REQUIRE(d.d == 1);
+      REQUIRE(d.e == 2);
+    }
+  }
+
+  std::vector<std::tuple<size_t, const Position*, const Health*>> query;
+  restored.populateComponentQuery(query);
+  REQUIRE(query.size() == 2);
+  REQUIRE(std::get<0>(query[0]) + std::get<0>(query[1]) == 64);
+
+  // the restored registry must keep working as the original one, no duplicated
+  // archetype and freed entities get recycled
+  EntityId newId = restored.createEntity(Position{}, Health{});
+  REQUIRE(restored.getArchetypeCount() == registry.getArchetypeCount());
+  REQUIRE(((newId.index == ids[10].index) | (newId.index == ids[50].index)));
+  restored.addComponent(ids[0], Health{42});
+  REQUIRE(restored.getArchetypeCount() == registry.getArchetypeCount());
+  REQUIRE(restored.getComponent<Health>(ids[0]).hp == Approx(42));
+
+  // same thing going through disk
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "ecsSnapshot.bin").string();
+  REQUIRE(SirEngine::ecs::writeRegistrySnapshot(registry, path.c_str()));
+  Registry loaded;
+  const bool loadedFromDisk =
+      SirEngine::ecs::loadRegistrySnapshot(loaded, path.c_str());
+  std::filesystem::remove(path);
+  REQUIRE(loadedFromDisk);
+  REQUIRE(loaded.getComponent<Position>(ids[99]).x == Approx(99));
+  REQUIRE(loaded.getComponent<Dummy>(ids[98]).a == 98);
+}
+
+TEST_CASE("snapshot rejects corrupted data", "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (int i = 0; i < 20; ++i) {
+    ids.push_back(registry.createEntity(Position{static_cast<float>(i), 0, 0, 0},
+                                        Health{static_cast<float>(i)}));
+  }
+  registry.addComponent(ids[3], Selected{7});
+  std::vector<char> data;
+  SirEngine::ecs::serializeRegistrySnapshot(registry, data);
+
+  // a rejected snapshot leaves the registry as it was
+  Registry restored;
+  const EntityId kept = restored.createEntity(Position{42, 0, 0, 0});
+
+  // cut anywhere, the header, the bulk data or the mapper
+  for (const size_t size : {size_t(0), sizeof(BinaryFileHeader) - 1,
+                            sizeof(BinaryFileHeader) + 8, data.size() / 2,
+                            data.size() - 1}) {
+    REQUIRE(!SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                     size));
+  }
+
+  // offsets and counts pointing past the data
+  const auto *header = reinterpret_cast<const BinaryFileHeader *>(data.data());
+  const size_t mapperOffset = header->mapperDataOffsetInByte;
+  const auto corrupt = [&](const auto &patch) {
+    std::vector<char> corrupted = data;
+    patch(*reinterpret_cast<EcsSnapshotMapperData *>(corrupted.data() +
+                                                     mapperOffset));
+    return SirEngine::ecs::restoreRegistrySnapshot(restored, corrupted.data(),
+                                                   corrupted.size());
+  };
+  REQUIRE(
+      !corrupt([](EcsSnapshotMapperData &m) { m.archetypeCount += 1000; }));
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &m) { m.columnsOffset = ~0ull; }));
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &m) {
+    m.entitiesOffset = m.singletonsOffset;
+    m.entityCount = 0x7FFFFFFF;
+  }));
+  REQUIRE(
+      !corrupt([](EcsSnapshotMapperData &m) { m.componentTypeCount = 0; }));
+
+  REQUIRE(restored.isEntityValid(kept));
+  REQUIRE(restored.getComponent<Position>(kept).x == Approx(42));
+  REQUIRE(SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                  data.size()));
+  REQUIRE(restored.getComponent<Selected>(ids[3]).frame == 7);
+}
+
+TEST_CASE("snapshot rejects inconsistent data", "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (uint32_t i = 0; i < 10; ++i) {
+    ids.push_back(registry.createEntity(Position{static_cast<float>(i)},
+                                        Health{1.0f}));
+    registry.setSharedComponent(ids.back(), SharedMesh{i % 2});
+  }
+  registry.setSharedComponent(ids[0], SharedMaterial{3});
+  registry.addComponent(ids[1], Selected{1});
+  registry.addComponent(ids[2], Hidden{2});
+  // two dead entities in the free list
+  registry.deleteEntity(ids[8]);
+  registry.deleteEntity(ids[9]);
+  std::vector<char> data;
+  SirEngine::ecs::serializeRegistrySnapshot(registry, data);
+
+  Registry restored;
+  const EntityId kept = restored.createEntity(Position{42, 0, 0, 0});
+
+  // the tables as ecsSnapshot.cpp lays them out in the bulk data
+  struct Type {
+    uint64_t hash;
+    uint64_t sizeInByte;
+  };
+  struct SharedRef {
+    uint32_t componentType;
+    uint32_t valueIndex;
+  };
+  struct SharedStore {
+    uint32_t componentType;
+    uint32_t count;
+    uint64_t dataOffset;
+  };
+  struct SparseSet {
+    uint32_t componentType;
+    uint32_t count;
+    uint64_t entityIndicesOffset;
+    uint64_t dataOffset;
+  };
+  const auto *header = reinterpret_cast<const BinaryFileHeader *>(data.data());
+  const size_t mapperOffset = header->mapperDataOffsetInByte;
+  const auto corrupt = [&](const auto &patch) {
+    std::vector<char> corrupted = data;
+    char *bulk = corrupted.data() + sizeof(BinaryFileHeader);
+    auto &mapper = *reinterpret_cast<EcsSnapshotMapperData *>(
+        corrupted.data() + mapperOffset);
+    const auto table = [&](auto *typed, const uint64_t offset) {
+      return reinterpret_cast<decltype(typed)>(bulk + offset);
+    };
+    patch(mapper, table(static_cast<Type *>(nullptr),
+                        mapper.componentTypesOffset),
+          table(static_cast<SharedRef *>(nullptr), mapper.sharedRefsOffset),
+          table(static_cast<SharedStore *>(nullptr),
+                mapper.sharedStoresOffset),
+          table(static_cast<SparseSet *>(nullptr), mapper.sparseSetsOffset),
+          table(static_cast<Entity *>(nullptr), mapper.entitiesOffset));
+    return SirEngine::ecs::restoreRegistrySnapshot(restored, corrupted.data(),
+                                                   corrupted.size());
+  };
+  const auto findType = [&](const Type *types, const size_t hash) {
+    uint32_t i = 0;
+    while (types[i].hash != hash) {
+      ++i;
+    }
+    return i;
+  };
+  const size_t positionHash = SirEngine::ecs::MultiHash<Position>::hash;
+
+  // shared values past the end of their store, or with no store at all
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &, Type *, SharedRef *refs,
+                      SharedStore *, SparseSet *,
+                      Entity *) { refs[0].valueIndex = 1000; }));
+  REQUIRE(!corrupt([&](EcsSnapshotMapperData &, Type *types, SharedRef *refs,
+                       SharedStore *, SparseSet *, Entity *) {
+    refs[0].componentType = findType(types, positionHash);
+  }));
+
+  // free list ends out of range, with a single end, through a live entity
+  // and looping on itself
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &m, Type *, SharedRef *,
+                      SharedStore *, SparseSet *,
+                      Entity *) { m.freeListHead = m.entityCount; }));
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &m, Type *, SharedRef *,
+                      SharedStore *, SparseSet *, Entity *) {
+    m.freeListTail = Registry::INVALID_ENTITY_INDEX;
+  }));
+  REQUIRE(!corrupt([&](EcsSnapshotMapperData &m, Type *, SharedRef *,
+                       SharedStore *, SparseSet *,
+                       Entity *) { m.freeListHead = ids[0].index; }));
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &m, Type *, SharedRef *,
+                      SharedStore *, SparseSet *, Entity *entities) {
+    entities[m.freeListTail].localIndex = m.freeListHead;
+  }));
+
+  // two sparse sets, shared stores or types for the same component
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &, Type *, SharedRef *,
+                      SharedStore *, SparseSet *sets, Entity *) {
+    sets[1].componentType = sets[0].componentType;
+  }));
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &, Type *, SharedRef *,
+                      SharedStore *stores, SparseSet *, Entity *) {
+    stores[1].componentType = stores[0].componentType;
+  }));
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &, Type *types, SharedRef *,
+                      SharedStore *, SparseSet *,
+                      Entity *) { types[1].hash = types[0].hash; }));
+
+  // more archetypes than the 16 bits entity index can address
+  REQUIRE(!corrupt([](EcsSnapshotMapperData &m, Type *, SharedRef *,
+                      SharedStore *, SparseSet *, Entity *) {
+    m.archetypeCount = Registry::INVALID_ARCHETYPE + 1u;
+  }));
+
+  // a type already registered by the target registry with another size, or
+  // a type without size
+  REQUIRE(!corrupt([&](EcsSnapshotMapperData &, Type *types, SharedRef *,
+                       SharedStore *, SparseSet *, Entity *) {
+    types[findType(types, positionHash)].sizeInByte = sizeof(float);
+  }));
+  REQUIRE(!corrupt([&](EcsSnapshotMapperData &, Type *types, SharedRef *,
+                       SharedStore *, SparseSet *, Entity *) {
+    types[findType(types, positionHash)].sizeInByte = 0;
+  }));
+
+  REQUIRE(restored.isEntityValid(kept));
+  REQUIRE(restored.getComponent<Position>(kept).x == Approx(42));
+  REQUIRE(SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                  data.size()));
+  REQUIRE(restored.getComponent<Hidden>(ids[2]).reason == 2);
+  REQUIRE(restored.getComponent<SharedMaterial>(ids[0]).handle == 3);
+  // the restored free list hands out the dead slots
+  REQUIRE(restored.createEntity(Position{}).index == ids[8].index);
+  REQUIRE(restored.createEntity(Position{}).index == ids[9].index);
+}
+
+TEST_CASE("sparse component add remove", "[core,ecs]") {
+  Registry registry;
+  EntityId eid = registry.createEntity(Position{0, 1, 2, 3}, Health{10});
+  EntityId eid2 = registry.createEntity(Position{4, 5, 6, 7}, Health{20});
+  const uint32_t archetypeCount = registry.getArchetypeCount();
+
+  // toggling a sparse component does not move the entity
+  const Entity before = registry.getEntity(eid);
+  registry.addComponent(eid, Selected{1});
+  registry.addComponent(eid2, Selected{2});
+  REQUIRE(registry.getArchetypeCount() == archetypeCount);
+  REQUIRE(registry.getEntity(eid).archetypeIndex == before.archetypeIndex);
+  REQUIRE(registry.getEntity(eid).localIndex == before.localIndex);
+  REQUIRE(registry.hasComponent<Selected>(eid));
+  REQUIRE(registry.getComponent<Selected>(eid).frame == 1);
+  REQUIRE(registry.getComponent<Selected>(eid2).frame == 2);
+
+  registry.removeComponent<Selected>(eid);
+  REQUIRE(!registry.hasComponent<Selected>(eid));
+  REQUIRE(registry.hasComponent<Selected>(eid2));
+  REQUIRE(registry.getComponent<Selected>(eid2).frame == 2);
+  REQUIRE(registry.getComponent<Position>(eid).x == Approx(0.0f));
+
+  // deleting the entity cleans up the sparse set, a recycled entity must not
+  // inherit the tag
+  registry.deleteEntity(eid2);
+  EntityId eid3 = registry.createEntity(Position{}, Health{});
+  REQUIRE(eid3.index == eid2.index);
+  REQUIRE(!registry.hasComponent<Selected>(eid3));
+}
+
+TEST_CASE("sparse component for each", "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (int i = 0; i < 20; ++i) {
+    Position p{static_cast<float>(i), 0, 0, 0};
+    ids.push_back((i % 2) == 0 ? registry.createEntity(p)
+                               : registry.createEntity(p, Health{1}));
+  }
+  for (int i = 0; i < 20; i += 3) {
+    registry.addComponent(ids[i], Selected{static_cast<uint32_t>(i)});
+  }
+
+  // mixing archetype and sparse components
+  int count = 0;
+  registry.forEach<const Position, Health, const Selected>(
+      [&](const EntityId eid, const Position& p, Health& h,
+          const Selected& s) {
+        REQUIRE(p.x == Approx(static_cast<float>(s.frame)));
+        REQUIRE(eid.index == ids[s.frame].index);
+        h.hp = 100;
+        ++count;
+      });
+  // 3, 9, 15
+  REQUIRE(count == 3);
+  REQUIRE(registry.getComponent<Health>(ids[9]).hp == Approx(100));
+  REQUIRE(registry.getComponent<Health>(ids[11]).hp == Approx(1));
+
+  // archetype only iteration
+  count = 0;
+  registry.forEach<Position>([&](const EntityId eid, Position& p) {
+    REQUIRE(p.x == Approx(registry.getComponent<Position>(eid).x));
+    ++count;
+  });
+  REQUIRE(count == 20);
+
+  // sparse set never created, nothing to iterate
+  Registry empty;
+  empty.createEntity(Position{});
+  count = 0;
+  empty.forEach<Position, Selected>(
+      [&](const EntityId, Position&, Selected&) { ++count; });
+  REQUIRE(count == 0);
+}
+
+TEST_CASE("snapshot round trip with sparse components", "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (int i = 0; i < 50; ++i) {
+    ids.push_back(registry.createEntity(Position{static_cast<float>(i)}));
+    if ((i % 4) == 0) {
+      registry.addComponent(ids.back(), Selected{static_cast<uint32_t>(i)});
+    }
+  }
+  registry.deleteEntity(ids[8]);
+
+  std::vector<char> data;
+  SirEngine::ecs::serializeRegistrySnapshot(registry, data);
+  Registry restored;
+  REQUIRE(SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                  data.size()));
+  for (int i = 0; i < 50; ++i) {
+    if (i == 8) {
+      continue;
+    }
+    REQUIRE(restored.hasComponent<Selected>(ids[i]) == ((i % 4) == 0));
+    if ((i % 4) == 0) {
+      REQUIRE(restored.getComponent<Selected>(ids[i]).frame ==
+              static_cast<uint32_t>(i));
+    }
+  }
+  restored.removeComponent<Selected>(ids[0]);
+  REQUIRE(restored.getComponent<Selected>(ids[4]).frame == 4);
+}
+
+TEST_CASE("entity recycling under churn", "[core,ecs]") {
+  Registry registry;
+  constexpr uint32_t LIVE_COUNT = 1024;
+  constexpr uint32_t CYCLE_COUNT = 8192;
+  std::vector<EntityId> live;
+  for (uint32_t i = 0; i < LIVE_COUNT; ++i) {
+    live.push_back(registry.createEntity(Position{static_cast<float>(i)}));
+  }
+
+  // spawn and despawn like particles would, keeping a sample of stale ids
+  std::vector<EntityId> stale;
+  uint32_t seed = 12345;
+  for (uint32_t c = 0; c < CYCLE_COUNT; ++c) {
+    seed = seed * 1664525u + 1013904223u;
+    const uint32_t slot = (seed >> 8) % LIVE_COUNT;
+    registry.deleteEntity(live[slot]);
+    if ((c % 64) == 0) {
+      stale.push_back(live[slot]);
+    }
+    live[slot] = registry.createEntity(Position{static_cast<float>(c)});
+  }
+
+  // memory footprint is bounded by the peak of alive entities
+  REQUIRE(registry.getEntities().size() == LIVE_COUNT);
+  REQUIRE(registry.getAliveEntityCount() == LIVE_COUNT);
+  for (const EntityId eid : live) {
+    REQUIRE(registry.isEntityValid(eid));
+  }
+  bool anyStaleValid = false;
+  for (const EntityId eid : stale) {
+    anyStaleValid |= registry.isEntityValid(eid);
+  }
+  REQUIRE(!anyStaleValid);
+
+  std::vector<std::tuple<size_t, const Position*>> query;
+  registry.populateComponentQuery(query);
+  REQUIRE(query.size() == 1);
+  REQUIRE(std::get<0>(query[0]) == LIVE_COUNT);
+}
+
+// same churn as above for long enough to catch a slow leak, hidden to keep the
+// default run short, run it with "[stress]"
+TEST_CASE("entity recycling under 1M cycles of churn", "[.][stress][ecs]") {
+  Registry registry;
+  constexpr uint32_t LIVE_COUNT = 1024;
+  constexpr uint32_t CYCLE_COUNT = 1u << 20;
+  std::vector<EntityId> live;
+  for (uint32_t i = 0; i < LIVE_COUNT; ++i) {
+    live.push_back(registry.createEntity(Position{static_cast<float>(i)}));
+  }
+  SirEngine::ecs::RegistryStats startStats;
+  SirEngine::ecs::collectRegistryStats(registry, startStats);
+
+  std::vector<EntityId> stale;
+  uint32_t notReusedCount = 0;
+  uint32_t seed = 12345;
+  for (uint32_t c = 0; c < CYCLE_COUNT; ++c) {
+    seed = seed * 1664525u + 1013904223u;
+    const uint32_t slot = (seed >> 8) % LIVE_COUNT;
+    const EntityId old = live[slot];
+    registry.deleteEntity(old);
+    if ((c % 4096) == 0) {
+      stale.push_back(old);
+    }
+    live[slot] = registry.createEntity(Position{static_cast<float>(c)});
+    // the only free slot is the one just released, it has to be picked up
+    // again with a newer version
+    notReusedCount += (live[slot].index != old.index) ||
+                      (live[slot].version == old.version);
+  }
+  REQUIRE(notReusedCount == 0);
+
+  // neither the entity table nor the archetype storage grew
+  REQUIRE(registry.getEntities().size() == LIVE_COUNT);
+  REQUIRE(registry.getAliveEntityCount() == LIVE_COUNT);
+  REQUIRE(registry.getFreeListHead() == Registry::INVALID_ENTITY_INDEX);
+  SirEngine::ecs::RegistryStats endStats;
+  SirEngine::ecs::collectRegistryStats(registry, endStats);
+  REQUIRE(endStats.archetypeCount == startStats.archetypeCount);
+  REQUIRE(endStats.storageSizeInBytes == startStats.storageSizeInBytes);
+  REQUIRE(endStats.structuralChanges.deletedEntities == CYCLE_COUNT);
+
+  for (const EntityId eid : live) {
+    REQUIRE(registry.isEntityValid(eid));
+  }
+  bool anyStaleValid = false;
+  for (const EntityId eid : stale) {
+    anyStaleValid |= registry.isEntityValid(eid);
+  }
+  REQUIRE(!anyStaleValid);
+}
+
+TEST_CASE("entity version wrap around", "[core,ecs]") {
+  Registry registry;
+  // zero initialized and out of range ids are never valid
+  REQUIRE(!registry.isEntityValid(EntityId{}));
+  EntityId eid = registry.createEntity(Position{});
+  REQUIRE(!registry.isEntityValid(EntityId{eid.index + 10, eid.version, 0}));
+
+  // starting close to the end of the 16 bit version range rather than
+  // recycling the entity tens of thousands of times
+  std::vector<Entity> entities = registry.getEntities();
+  entities[eid.index].version = static_cast<uint16_t>(-1) - 100;
+  registry.restoreEntities(entities.data(), entities.size(),
+                           registry.getFreeListHead(),
+                           registry.getFreeListTail());
+  eid.version = entities[eid.index].version;
+  REQUIRE(registry.isEntityValid(eid));
+
+  // going past the range, version zero must be skipped
+  bool sawZero = false;
+  bool wrapped = false;
+  bool staleValid = false;
+  for (uint32_t i = 0; i < 200; ++i) {
+    const EntityId previous = eid;
+    registry.deleteEntity(eid);
+    staleValid |= registry.isEntityValid(previous);
+    eid = registry.createEntity(Position{});
+    sawZero |= eid.version == 0;
+    wrapped |= eid.version < previous.version;
+  }
+  REQUIRE(wrapped);
+  REQUIRE(!sawZero);
+  REQUIRE(!staleValid);
+  REQUIRE(registry.getEntities().size() == 1);
+  REQUIRE(registry.isEntityValid(eid));
+}
+
+TEST_CASE("shared components partition archetypes", "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (uint32_t i = 0; i < 30; ++i) {
+    ids.push_back(registry.createEntity(Position{static_cast<float>(i)}));
+    registry.setSharedComponent(ids.back(), SharedMesh{i % 3});
+  }
+  // one plain archetype plus one partition per mesh
+  REQUIRE(registry.getArchetypeCount() == 4);
+  REQUIRE(registry.hasComponent<SharedMesh>(ids[4]));
+  REQUIRE(registry.getComponent<SharedMesh>(ids[4]).handle == 1);
+  REQUIRE(registry.getSharedStores().begin()->second.count == 3);
+
+  // entities with the same mesh come out together, ready to be batched
+  std::vector<std::tuple<size_t, const SharedMesh*, const Position*>> query;
+  registry.populateSharedComponentQuery(query);
+  REQUIRE(query.size() == 3);
+  for (uint32_t q = 0; q < 3; ++q) {
+    REQUIRE(std::get<0>(query[q]) == 10);
+    REQUIRE(std::get<1>(query[q])->handle == q);
+    const Position* positions = std::get<2>(query[q]);
+    for (uint32_t i = 0; i < 10; ++i) {
+      REQUIRE(static_cast<uint32_t>(positions[i].x) % 3 == q);
+    }
+  }
+
+  // changing value moves to the other partition, data follows
+  registry.setSharedComponent(ids[4], SharedMesh{2});
+  REQUIRE(registry.getComponent<SharedMesh>(ids[4]).handle == 2);
+  REQUIRE(registry.getComponent<Position>(ids[4]).x == Approx(4.0f));
+  registry.populateSharedComponentQuery(query);
+  REQUIRE(std::get<0>(query[1]) == 9);
+  REQUIRE(std::get<0>(query[2]) == 11);
+
+  // adding an archetype component keeps the shared value
+  registry.addComponent(ids[4], Health{5});
+  REQUIRE(registry.getComponent<SharedMesh>(ids[4]).handle == 2);
+  REQUIRE(registry.getComponent<Health>(ids[4]).hp == Approx(5.0f));
+
+  int count = 0;
+  registry.forEach<const SharedMesh, Position>(
+      [&](const EntityId, const SharedMesh& mesh, Position& p) {
+        const auto i = static_cast<uint32_t>(p.x);
+        REQUIRE(mesh.handle == (i == 4 ? 2 : i % 3));
+        ++count;
+      });
+  REQUIRE(count == 30);
+
+  registry.removeComponent<SharedMesh>(ids[4]);
+  REQUIRE(!registry.hasComponent<SharedMesh>(ids[4]));
+  REQUIRE(registry.getComponent<Health>(ids[4]).hp == Approx(5.0f));
+  REQUIRE(registry.getComponent<Position>(ids[4]).x == Approx(4.0f));
+}
+
+TEST_CASE("singleton components", "[core,ecs]") {
+  Registry registry;
+  REQUIRE(!registry.hasSingleton<FrameSettings>());
+  registry.setSingleton(FrameSettings{0.016f, 1});
+  REQUIRE(registry.hasSingleton<FrameSettings>());
+  registry.getSingleton<FrameSettings>().frame += 1;
+  REQUIRE(registry.getSingleton<FrameSettings>().frame == 2);
+  registry.removeSingleton<FrameSettings>();
+  REQUIRE(!registry.hasSingleton<FrameSettings>());
+}
+
+TEST_CASE("snapshot round trip with shared and singleton components",
+          "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (uint32_t i = 0; i < 20; ++i) {
+    ids.push_back(registry.createEntity(Position{static_cast<float>(i)}));
+    registry.setSharedComponent(ids.back(), SharedMesh{100 + (i % 2)});
+  }
+  registry.setSingleton(FrameSettings{0.5f, 42});
+
+  std::vector<char> data;
+  SirEngine::ecs::serializeRegistrySnapshot(registry, data);
+  Registry restored;
+  REQUIRE(SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                  data.size()));
+  REQUIRE(restored.getSingleton<FrameSettings>().frame == 42);
+  for (uint32_t i = 0; i < 20; ++i) {
+    REQUIRE(restored.getComponent<SharedMesh>(ids[i]).handle == 100 + (i % 2));
+  }
+  // the restored partitions are reused, no duplicated archetypes
+  const uint32_t archetypeCount = restored.getArchetypeCount();
+  EntityId eid = restored.createEntity(Position{});
+  restored.setSharedComponent(eid, SharedMesh{101});
+  REQUIRE(restored.getArchetypeCount() == archetypeCount);
+}
+
+TEST_CASE("parallel for each visits every entity once", "[core,ecs]") {
+  SirEngine::WorkerPool pool(4);
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (uint32_t i = 0; i < 5000; ++i) {
+    const auto f = static_cast<float>(i);
+    ids.push_back((i % 3) == 0 ? registry.createEntity(Position{f, 0, 0, 0})
+                               : registry.createEntity(Position{f, 0, 0, 0},
+                                                       Health{f}));
+  }
+  for (uint32_t i = 0; i < 5000; i += 5) {
+    registry.setSharedComponent(ids[i], SharedMesh{i % 2});
+  }
+
+  const uint32_t before = registry.advanceVersion();
+  // small batches to spread the work over many tasks
+  registry.parallelForEach<Position>(
+      pool, [](EntityId, Position& p) { p.y += 1.0f; }, 64);
+  registry.parallelForEach<Position, const Health>(
+      pool, [](EntityId, Position& p, const Health& h) { p.z = h.hp; }, 64);
+  registry.parallelForEach<Position, const SharedMesh>(
+      pool,
+      [](EntityId, Position& p, const SharedMesh& mesh) {
+        p.w = static_cast<float>(mesh.handle + 1);
+      },
+      64);
+  for (uint32_t i = 0; i < 5000; ++i) {
+    const Position& p = registry.getComponent<Position>(ids[i]);
+    REQUIRE(p.y == Approx(1.0f));
+    REQUIRE(p.z == Approx((i % 3) == 0 ? 0.0f : static_cast<float>(i)));
+    REQUIRE(p.w == Approx((i % 5) == 0 ? static_cast<float>(i % 2 + 1) : 0));
+  }
+
+  // write access is recorded as in the serial version
+  std::vector<std::tuple<size_t, const Position*>> changed;
+  registry.populateChangedComponentQuery<Position>(changed, before);
+  size_t changedCount = 0;
+  for (const auto& q : changed) {
+    changedCount += std::get<0>(q);
+  }
+  REQUIRE(changedCount == 5000);
+}
+
+TEST_CASE("parallel for each with sparse components", "[core,ecs]") {
+  SirEngine::WorkerPool pool(3);
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (uint32_t i = 0; i < 3000; ++i) {
+    ids.push_back(registry.createEntity(Health{static_cast<float>(i)}));
+    if ((i % 4) == 0) {
+      registry.addComponent(ids.back(), Selected{0});
+    }
+  }
+  std::vector<uint32_t> visits(ids.size(), 0);
+  registry.parallelForEach<Selected, const Health>(
+      pool,
+      [&](const EntityId eid, Selected& selected, const Health& health) {
+        selected.frame = static_cast<uint32_t>(health.hp);
+        ++visits[eid.index];
+      },
+      16);
+  for (uint32_t i = 0; i < ids.size(); ++i) {
+    REQUIRE(visits[i] == ((i % 4) == 0 ? 1u : 0u));
+    if ((i % 4) == 0) {
+      REQUIRE(registry.getComponent<Selected>(ids[i]).frame == i);
+    }
+  }
+}
+
+TEST_CASE("registry stats", "[core,ecs]") {
+  Registry registry;
+  std::vector<EntityId> ids;
+  for (uint32_t i = 0; i < 100; ++i) {
+    ids.push_back(registry.createEntity(Position{}, Health{}));
+  }
+  // a handful of entities with an extra component, a fragmented archetype
+  for (uint32_t i = 0; i < 3; ++i) {
+    registry.addComponent(ids[i], Dummy{});
+  }
+  registry.addComponent(ids[10], Selected{1});
+  registry.setSharedComponent(ids[20], SharedMesh{1});
+  registry.setSingleton(FrameSettings{0.016f, 1});
+  registry.deleteEntity(ids[99]);
+
+  SirEngine::ecs::RegistryStats stats;
+  SirEngine::ecs::collectRegistryStats(registry, stats);
+  REQUIRE(stats.aliveEntityCount == 99);
+  REQUIRE(stats.freeEntityCount == 1);
+  REQUIRE(stats.archetypeCount == 3);
+  REQUIRE(stats.emptyArchetypeCount == 0);
+  // the big archetype fills most of its block, the two small ones do not
+  REQUIRE(stats.fragmentedArchetypeCount == 2);
+  REQUIRE(stats.sharedValueCount == 1);
+  REQUIRE(stats.singletonCount == 1);
+  REQUIRE(stats.storageSizeInBytes ==
+          stats.usedSizeInBytes + stats.unusedSizeInBytes);
+  REQUIRE(stats.sparseSizeInBytes != 0);
+
+  // biggest archetype first
+  const SirEngine::ecs::ArchetypeStats& biggest = stats.archetypes[0];
+  REQUIRE(biggest.entityCount == 95);
+  REQUIRE(biggest.columns.size() == 2);
+  REQUIRE(biggest.usedSizeInBytes ==
+          95 * (sizeof(Position) + sizeof(Health) + sizeof(size_t)));
+  for (const auto& column : biggest.columns) {
+    REQUIRE(((column.name == "Position") || (column.name == "Health")));
+    REQUIRE(column.usedSizeInBytes == column.typeSizeInBytes * 95);
+    REQUIRE(column.capacitySizeInBytes ==
+            column.typeSizeInBytes * biggest.capacity);
+  }
+
+  // Position and Health are spread over all the archetypes
+  REQUIRE(stats.components[0].archetypeCount == 3);
+  REQUIRE(stats.components[0].entityCount == 99);
+  bool foundSparse = false;
+  bool foundShared = false;
+  for (const auto& cmp : stats.components) {
+    if (cmp.name == "Selected") {
+      foundSparse = true;
+      REQUIRE(cmp.storage == SirEngine::ecs::ComponentStorage::SPARSE_SET);
+      REQUIRE(cmp.entityCount == 1);
+    }
+    if (cmp.name == "SharedMesh") {
+      foundShared = true;
+      REQUIRE(cmp.storage == SirEngine::ecs::ComponentStorage::SHARED);
+      REQUIRE(cmp.archetypeCount == 1);
+      REQUIRE(cmp.entityCount == 1);
+    }
+  }
+  REQUIRE(foundSparse);
+  REQUIRE(foundShared);
+
+  const auto& changes = stats.structuralChanges;
+  REQUIRE(changes.createdEntities == 100);
+  REQUIRE(changes.deletedEntities == 1);
+  REQUIRE(changes.archetypeMoves == 4);
+  REQUIRE(changes.sparseAdds == 1);
+  REQUIRE(changes.createdArchetypes == 3);
+  registry.resetStructuralChanges();
+  REQUIRE(registry.getStructuralChanges().createdEntities == 0);
+
+  const std::string report = SirEngine::ecs::formatRegistryStats(stats);
+  REQUIRE(report.find("Position (16 bytes)") != std::string::npos);
+  nlohmann::json jobj;
+  SirEngine::ecs::registryStatsToJson(stats, jobj);
+  REQUIRE(jobj["archetypes"].size() == 3);
+  REQUIRE(jobj["archetypes"][0]["entityCount"].get<uint32_t>() == 95);
+  REQUIRE(jobj["structuralChanges"]["archetypeMoves"].get<uint32_t>() == 4);
+}
+
+TEST_CASE("registry stats of restored snapshot", "[core,ecs]") {
+  Registry registry;
+  registry.createEntity(Position{}, Health{});
+  std::vector<char> data;
+  SirEngine::ecs::serializeRegistrySnapshot(registry, data);
+  Registry restored;
+  REQUIRE(SirEngine::ecs::restoreRegistrySnapshot(restored, data.data(),
+                                                  data.size()));
+
+  // types only known by hash are reported by hash
+  SirEngine::ecs::RegistryStats stats;
+  SirEngine::ecs::collectRegistryStats(restored, stats);
+  REQUIRE(stats.archetypes.size() == 1);
+  for (const auto& column : stats.archetypes[0].columns) {
+    REQUIRE(column.name.rfind("0x", 0) == 0);
+  }
+}
+
+TEST_CASE("component type indices and masks", "[core,ecs]") {
+  using SirEngine::ecs::ComponentMask;
+  using SirEngine::ecs::ComponentStorage;
+  const uint32_t positionIdx =
+      SirEngine::ecs::getComponentTypeIndex<Position>();
+  const uint32_t healthIdx = SirEngine::ecs::getComponentTypeIndex<Health>();
+  REQUIRE(positionIdx != healthIdx);
+  REQUIRE(positionIdx < SirEngine::ecs::MAX_COMPONENT_TYPES);
+  // the hash only path resolves to the same index
+  REQUIRE(SirEngine::ecs::registerComponentTypeIndex(
+              SirEngine::ecs::MultiHash<Position>::hash) == positionIdx);
+  REQUIRE(SirEngine::ecs::findComponentTypeIndex(0xdeadbeef) ==
+          SirEngine::ecs::INVALID_COMPONENT_TYPE_INDEX);
+
+  // query types are accepted, only the requested storage ends up in the mask
+  const ComponentMask& mask =
+      SirEngine::ecs::getComponentMask<ComponentStorage::ARCHETYPE,
+                                       const Position*, Health, SharedMesh>();
+  REQUIRE(mask.test(positionIdx));
+  REQUIRE(mask.test(healthIdx));
+  REQUIRE(!mask.test(SirEngine::ecs::getComponentTypeIndex<SharedMesh>()));
+
+  ComponentMask single;
+  REQUIRE(single.empty());
+  single.set(healthIdx);
+  single.set(200);
+  REQUIRE(!mask.contains(single));
+  single.reset(200);
+  REQUIRE(mask.contains(single));
+  REQUIRE(!single.contains(mask));
+  std::vector<uint32_t> bits;
+  mask.forEachSet([&bits](const uint32_t idx) { bits.push_back(idx); });
+  REQUIRE(bits.size() == 2);
+  REQUIRE(bits[0] == std::min(positionIdx, healthIdx));
+}
+
+TEST_CASE("archetypes do not depend on the component order", "[core,ecs]") {
+  Registry registry;
+  const EntityId a = registry.createEntity(Position{1}, Health{1});
+  const EntityId b = registry.createEntity(Health{2}, Position{2});
+  REQUIRE(registry.getArchetypeCount() == 1);
+
+  // reaching the same set of components by adding and removing
+  const EntityId c = registry.createEntity(Health{3});
+  registry.addComponent(c, Position{3});
+  registry.addComponent(b, Dummy{4, 5});
+  registry.removeComponent<Dummy>(b);
+  REQUIRE(registry.getArchetypeCount() == 3);
+
+  std::vector<std::tuple<size_t, Position*, const Health*>> query;
+  registry.populateComponentQuery(query);
+  REQUIRE(query.size() == 1);
+  REQUIRE(std::get<0>(query[0]) == 3);
+  REQUIRE(registry.getComponent<Position>(a).x == Approx(1.0f));
+  REQUIRE(registry.getComponent<Health>(b).hp == Approx(2.0f));
+  REQUIRE(registry.getComponent<Position>(c).x == Approx(3.0f));
+
+  // shared partitions are found again regardless of the path
+  registry.setSharedComponent(a, SharedMesh{7});
+  registry.addComponent(b, Dummy{});
+  registry.setSharedComponent(b, SharedMesh{7});
+  registry.removeComponent<Dummy>(b);
+  const std::vector<Entity>& entities = registry.getEntities();
+  REQUIRE(entities[a.index].archetypeIndex ==
+          entities[b.index].archetypeIndex);
+}
+
+TEST_CASE("prefab instantiation", "[core,ecs]") {
+  Registry registry;
+  // an entity already living in the target archetype
+  const EntityId existing = registry.createEntity(Position{-1}, Health{-1});
+  registry.setSharedComponent(existing, SharedMesh{3});
+  const uint32_t lastSeen = registry.advanceVersion();
+
+  SirEngine::ecs::Prefab prefab;
+  prefab.set(Position{1, 2, 3, 4}).set(Health{50}).set(SharedMesh{3});
+  prefab.set(Selected{9});
+  prefab.set(Health{75});
+  REQUIRE(prefab.has<Selected>());
+  REQUIRE(!prefab.has<Dummy>());
+  REQUIRE(prefab.get<Health>().hp == Approx(75.0f));
+
+  const uint32_t archetypeCount = registry.getArchetypeCount();
+  std::vector<EntityId> ids(1000);
+  registry.instantiate(prefab, 1000, ids.data());
+  REQUIRE(registry.getArchetypeCount() == archetypeCount);
+  REQUIRE(registry.getAliveEntityCount() == 1001);
+  REQUIRE(registry.getStructuralChanges().archetypeMoves == 1);
+  for (const EntityId id : ids) {
+    REQUIRE(registry.isEntityValid(id));
+    REQUIRE(registry.getComponent<Position>(id).z == Approx(3.0f));
+    REQUIRE(registry.getComponent<Health>(id).hp == Approx(75.0f));
+    REQUIRE(registry.getComponent<SharedMesh>(id).handle == 3);
+    REQUIRE(registry.getComponent<Selected>(id).frame == 9);
+  }
+  REQUIRE(!registry.hasComponent<Selected>(existing));
+
+  // new data for anybody mirroring the registry
+  std::vector<std::tuple<size_t, const Position*>> changed;
+  registry.populateChangedComponentQuery<Position>(changed, lastSeen);
+  size_t changedCount = 0;
+  for (const auto& q : changed) {
+    changedCount += std::get<0>(q);
+  }
+  REQUIRE(changedCount >= 1000);
+
+  // instances are regular entities
+  registry.deleteEntity(ids[10]);
+  registry.getComponent<Health>(ids[11]).hp = 1.0f;
+  REQUIRE(registry.getComponent<Health>(ids[12]).hp == Approx(75.0f));
+  REQUIRE(registry.getComponent<Health>(existing).hp == Approx(-1.0f));
+  int selectedCount = 0;
+  registry.forEach<const Selected, const Position>(
+      [&](EntityId, const Selected&, const Position&) { ++selectedCount; });
+  REQUIRE(selectedCount == 999);
+
+  // recycled ids are used first
+  EntityId recycled;
+  registry.instantiate(prefab, 1, &recycled);
+  REQUIRE(recycled.index == ids[10].index);
+  REQUIRE(recycled.version != ids[10].version);
+}
+
+TEST_CASE("entity cloning", "[core,ecs]") {
+  Registry registry;
+  const EntityId source = registry.createEntity(Position{5, 6, 7, 8});
+  registry.addComponent(source, Selected{2});
+  registry.setSharedComponent(source, SharedMesh{1});
+
+  SirEngine::ecs::Prefab prefab;
+  registry.createPrefab(source, prefab);
+  REQUIRE(prefab.getComponents().size() == 3);
+  REQUIRE(prefab.get<Position>().y == Approx(6.0f));
+
+  std::vector<EntityId> clones(40);
+  registry.cloneEntity(source, 40, clones.data());
+  REQUIRE(registry.getAliveEntityCount() == 41);
+  for (const EntityId id : clones) {
+    REQUIRE(registry.getComponent<Position>(id).w == Approx(8.0f));
+    REQUIRE(registry.getComponent<Selected>(id).frame == 2);
+    REQUIRE(registry.getComponent<SharedMesh>(id).handle == 1);
+  }
+  registry.getComponent<Position>(clones[0]).x = 0.0f;
+  REQUIRE(registry.getComponent<Position>(source).x == Approx(5.0f));
+
+  // a prefab can be instantiated in a different registry
+  Registry other;
+  std::vector<EntityId> otherIds(3);
+  other.instantiate(prefab, 3, otherIds.data());
+  REQUIRE(other.getComponent<Selected>(otherIds[2]).frame == 2);
+  REQUIRE(std::string(SirEngine::ecs::getComponentTypeName(
+              other, SirEngine::ecs::MultiHash<Position>::hash)) ==
+          "Position");
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <vector>
+
+#include "SirEngine/events/event.h"
+#include "SirEngine/events/eventBus.h"
+#include "SirEngine/workerPool.h"
+#include "catch/catch.hpp"
+
+using SirEngine::EventBus;
+using SirEngine::EventSpan;
+
+namespace {
+struct KeyEvent {
+  uint32_t key;
+  bool pressed;
+};
+struct MouseMoveEvent {
+  float x;
+  float y;
+};
+struct NeverSentEvent {
+  int value;
+};
+}  // namespace
+
+TEST_CASE("event bus double buffers the channels", "[core]") {
+  EventBus bus;
+  bus.send(KeyEvent{1, true});
+  bus.send(KeyEvent{2, false});
+  const MouseMoveEvent moves[3] = {{1, 1}, {2, 2}, {3, 3}};
+  bus.sendBatch(moves, 3);
+
+  // nothing is readable before the frame boundary
+  REQUIRE(bus.read<KeyEvent>().empty());
+  REQUIRE(bus.getPendingCount<KeyEvent>() == 2);
+  REQUIRE(bus.read<NeverSentEvent>().empty());
+
+  bus.swap();
+  const EventSpan<KeyEvent> keys = bus.read<KeyEvent>();
+  REQUIRE(keys.count == 2);
+  REQUIRE(keys[0].key == 1);
+  REQUIRE(keys[1].key == 2);
+  REQUIRE(!keys[1].pressed);
+  float sum = 0.0f;
+  for (const MouseMoveEvent &move : bus.read<MouseMoveEvent>()) {
+    sum += move.x;
+  }
+  REQUIRE(sum == Approx(6.0f));
+  REQUIRE(bus.getPendingCount<KeyEvent>() == 0);
+
+  // events sent while reading go to the next frame
+  bus.send(KeyEvent{3, true});
+  REQUIRE(bus.read<KeyEvent>().count == 2);
+  bus.swap();
+  REQUIRE(bus.read<KeyEvent>().count == 1);
+  REQUIRE(bus.read<KeyEvent>()[0].key == 3);
+  REQUIRE(bus.read<MouseMoveEvent>().empty());
+  bus.swap();
+  REQUIRE(bus.read<KeyEvent>().empty());
+
+  // the type indices are shared between buses
+  EventBus other;
+  other.send(NeverSentEvent{4});
+  other.swap();
+  REQUIRE(other.read<NeverSentEvent>()[0].value == 4);
+  REQUIRE(EventBus::getEventTypeIndex<KeyEvent>() !=
+          EventBus::getEventTypeIndex<NeverSentEvent>());
+}
+
+TEST_CASE("event bus accepts events from many threads", "[core]") {
+  EventBus bus;
+  SirEngine::WorkerPool pool(4);
+  constexpr uint32_t eventCount = 5000;
+  pool.parallelFor(eventCount, [&](const uint32_t task) {
+    bus.send(KeyEvent{task, true});
+    if (task % 10 == 0) {
+      bus.send(MouseMoveEvent{static_cast<float>(task), 0.0f});
+    }
+  });
+  bus.swap();
+  const EventSpan<KeyEvent> keys = bus.read<KeyEvent>();
+  REQUIRE(keys.count == eventCount);
+  std::vector<uint32_t> received;
+  for (const KeyEvent &key : keys) {
+    received.push_back(key.key);
+  }
+  std::sort(received.begin(), received.end());
+  for (uint32_t i = 0; i < eventCount; ++i) {
+    REQUIRE(received[i] == i);
+  }
+  REQUIRE(bus.read<MouseMoveEvent>().count == eventCount / 10);
+}
+
+// the legacy path, heap allocated events dispatched through virtual calls
+namespace {
+class LegacyKeyEvent final : public SirEngine::Event {
+ public:
+  LegacyKeyEvent(const uint32_t key, const bool pressed)
+      : m_key(key), m_pressed(pressed) {}
+  static SirEngine::EventType getStaticType() {
+    return SirEngine::EventType::KeyPressed;
+  }
+  SirEngine::EventType getEventType() const override {
+    return getStaticType();
+  }
+  const char *getName() const override { return "KeyPressed"; }
+  int getCategoryFlags() const override {
+    return SirEngine::EventCategoryInput | SirEngine::EventCategoryKeyboard;
+  }
+  uint32_t m_key;
+  bool m_pressed;
+};
+
+class LegacyMouseMoveEvent final : public SirEngine::Event {
+ public:
+  LegacyMouseMoveEvent(const float x, const float y) : m_x(x), m_y(y) {}
+  static SirEngine::EventType getStaticType() {
+    return SirEngine::EventType::MouseMoved;
+  }
+  SirEngine::EventType getEventType() const override {
+    return getStaticType();
+  }
+  const char *getName() const override { return "MouseMoved"; }
+  int getCategoryFlags() const override {
+    return SirEngine::EventCategoryInput | SirEngine::EventCategoryMouse;
+  }
+  float m_x;
+  float m_y;
+};
+
+constexpr uint32_t BENCH_EVENT_COUNT = 10000;
+}  // namespace
+
+TEST_CASE("event bus 10k events per frame", "[.][benchmark]") {
+  std::vector<SirEngine::Event *> queue;
+  queue.reserve(BENCH_EVENT_COUNT);
+  BENCHMARK("heap allocated events and dispatcher") {
+    for (uint32_t i = 0; i < BENCH_EVENT_COUNT; ++i) {
+      if (i % 2 == 0) {
+        queue.push_back(new LegacyKeyEvent(i, true));
+      } else {
+        queue.push_back(new LegacyMouseMoveEvent(static_cast<float>(i), 1));
+      }
+    }
+    float result = 0.0f;
+    for (SirEngine::Event *event : queue) {
+      SirEngine::EventDispatcher dispatcher(*event);
+      dispatcher.dispatch<LegacyKeyEvent>([&](LegacyKeyEvent &e) {
+        result += static_cast<float>(e.m_key);
+        return true;
+      });
+      dispatcher.dispatch<LegacyMouseMoveEvent>([&](LegacyMouseMoveEvent &e) {
+        result += e.m_x;
+        return true;
+      });
+      delete event;
+    }
+    queue.clear();
+    return result;
+  };
+
+  EventBus bus;
+  BENCHMARK("event bus channels") {
+    for (uint32_t i = 0; i < BENCH_EVENT_COUNT; ++i) {
+      if (i % 2 == 0) {
+        bus.send(KeyEvent{i, true});
+      } else {
+        bus.send(MouseMoveEvent{static_cast<float>(i), 1});
+      }
+    }
+    bus.swap();
+    float result = 0.0f;
+    for (const KeyEvent &e : bus.read<KeyEvent>()) {
+      result += static_cast<float>(e.key);
+    }
+    for (const MouseMoveEvent &e : bus.read<MouseMoveEvent>()) {
+      result += e.x;
+    }
+    return result;
+  };
+}
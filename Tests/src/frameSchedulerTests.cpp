@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "SirEngine/ecs/transformHierarchy.h"
+#include "SirEngine/frameScheduler.h"
+#include "SirEngine/graphics/renderExtraction.h"
+#include "SirEngine/graphics/spatialIndex.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "SirEngine/workerPool.h"
+#include "catch/catch.hpp"
+
+using SirEngine::FrameContext;
+using SirEngine::FramePhase;
+using SirEngine::FrameScheduler;
+using SirEngine::SystemAccess;
+using SirEngine::WorkerPool;
+using SirEngine::ecs::EntityId;
+using SirEngine::ecs::LocalTransform;
+using SirEngine::ecs::Registry;
+using SirEngine::ecs::WorldTransform;
+
+namespace {
+struct Velocity {
+  glm::vec3 value;
+};
+struct Health {
+  float value;
+};
+struct Score {
+  int value;
+};
+}  // namespace
+
+TEST_CASE("frame scheduler orders conflicting systems", "[core]") {
+  WorkerPool pool(4);
+  FrameScheduler scheduler(&pool);
+  std::vector<std::string> order;
+  std::mutex orderMutex;
+  const auto record = [&](const char *name) {
+    return [&, name](const FrameContext &) {
+      std::lock_guard<std::mutex> lock(orderMutex);
+      order.emplace_back(name);
+    };
+  };
+
+  // registered out of phase order on purpose
+  scheduler.addSystem("submit", FramePhase::SUBMIT, SystemAccess().mainThread(),
+                      record("submit"));
+  scheduler.addSystem("move", FramePhase::SIMULATION,
+                      SystemAccess().read<Velocity>().write<LocalTransform>(),
+                      record("move"));
+  scheduler.addSystem("damage", FramePhase::SIMULATION,
+                      SystemAccess().write<Health>(), record("damage"));
+  scheduler.addSystem("score", FramePhase::SIMULATION,
+                      SystemAccess().read<Health>().write<Score>(),
+                      record("score"));
+  scheduler.addSystem("steer", FramePhase::SIMULATION,
+                      SystemAccess().write<Velocity>(), record("steer"));
+  scheduler.addSystem("input", FramePhase::INPUT,
+                      SystemAccess().write<Velocity>(), record("input"));
+
+  // move and damage run together, score waits for damage and steer for move
+  REQUIRE(scheduler.getWaveCount(FramePhase::SIMULATION) == 2);
+  REQUIRE(scheduler.getWaveCount(FramePhase::INPUT) == 1);
+  REQUIRE(scheduler.getWaveCount(FramePhase::ANIMATION) == 0);
+
+  scheduler.runFrame(16);
+  REQUIRE(order.size() == 6);
+  REQUIRE(order.front() == "input");
+  REQUIRE(order.back() == "submit");
+  const auto position = [&](const char *name) {
+    return std::find(order.begin(), order.end(), name) - order.begin();
+  };
+  REQUIRE(position("move") < position("steer"));
+  REQUIRE(position("damage") < position("score"));
+  REQUIRE(position("move") < position("score"));
+  REQUIRE(position("damage") < position("steer"));
+  REQUIRE(scheduler.getFrameIndex() == 1);
+
+  // a main thread system splits the waves around it
+  scheduler.addSystem("debug draw", FramePhase::SIMULATION,
+                      SystemAccess().mainThread(), record("debug draw"));
+  scheduler.addSystem("late", FramePhase::SIMULATION,
+                      SystemAccess().read<Score>(), record("late"));
+  REQUIRE(scheduler.getWaveCount(FramePhase::SIMULATION) == 4);
+}
+
+TEST_CASE("frame scheduler gives the pool to lonely systems", "[core]") {
+  WorkerPool pool(4);
+  FrameScheduler scheduler(&pool);
+  std::atomic<int> withPool{0};
+  std::atomic<int> withoutPool{0};
+  const auto count = [&](const FrameContext &context) {
+    ++(context.pool != nullptr ? withPool : withoutPool);
+  };
+  scheduler.addSystem("alone", FramePhase::ANIMATION,
+                      SystemAccess().write<Health>(), count);
+  scheduler.addSystem("a", FramePhase::SIMULATION,
+                      SystemAccess().write<Health>(), count);
+  scheduler.addSystem("b", FramePhase::SIMULATION,
+                      SystemAccess().write<Score>(), count);
+  scheduler.runFrame(16);
+  REQUIRE(withPool == 1);
+  REQUIRE(withoutPool == 2);
+
+  // without a pool everything runs on the calling thread
+  FrameScheduler serial(nullptr);
+  serial.addSystem("a", FramePhase::SIMULATION, SystemAccess().write<Health>(),
+                   count);
+  serial.addSystem("b", FramePhase::SIMULATION, SystemAccess().write<Score>(),
+                   count);
+  serial.runFrame(16);
+  REQUIRE(withoutPool == 4);
+}
+
+TEST_CASE("frame scheduler runs headless frames", "[core]") {
+  // a small game frame without window nor gpu: entities move, the hierarchy
+  // and the spatial index follow and the renderables get extracted
+  Registry registry;
+  SirEngine::ecs::TransformHierarchy hierarchy;
+  SirEngine::SpatialIndex spatialIndex;
+  SirEngine::RenderExtractor extractor;
+  SirEngine::StackAllocator frameAllocator;
+  frameAllocator.initialize(1024 * 1024);
+
+  constexpr uint32_t entityCount = 1000;
+  EntityId tracked{};
+  for (uint32_t i = 0; i < entityCount; ++i) {
+    glm::mat4 matrix(1.0f);
+    matrix[3] = glm::vec4(static_cast<float>(i), 0.0f, 0.0f, 1.0f);
+    const EntityId eid =
+        registry.createEntity(LocalTransform{matrix}, Velocity{{0, 1, 0}});
+    hierarchy.addEntity(registry, eid);
+    if (i == 10) {
+      tracked = eid;
+    }
+    registry.addComponent(eid,
+                          SirEngine::RenderBounds{glm::vec3(0.0f), 1.0f});
+    registry.setSharedComponent(
+        eid, SirEngine::MeshRenderer{SirEngine::MeshHandle{1 + i % 4},
+                                     SirEngine::MaterialHandle{1}});
+    spatialIndex.addEntity(registry, eid);
+  }
+
+  WorkerPool pool(4);
+  FrameScheduler scheduler(&pool);
+  uint32_t extracted = 0;
+  scheduler.addSystem("begin frame", FramePhase::INPUT,
+                      SystemAccess().mainThread(),
+                      [&](const FrameContext &) { frameAllocator.reset(); });
+  scheduler.addSystem(
+      "move", FramePhase::SIMULATION,
+      SystemAccess().read<Registry, Velocity>().write<LocalTransform>(),
+      [&](const FrameContext &context) {
+        const float dt = static_cast<float>(context.deltaTimeNs) * 1e-9f;
+        registry.forEach<LocalTransform, const Velocity>(
+            [dt](EntityId, LocalTransform &local, const Velocity &velocity) {
+              local.matrix[3] += glm::vec4(velocity.value * dt, 0.0f);
+            });
+      });
+  scheduler.addSystem(
+      "transform hierarchy", FramePhase::SIMULATION,
+      SystemAccess().read<LocalTransform>().write<Registry, WorldTransform>(),
+      [&](const FrameContext &) { hierarchy.update(registry); });
+  scheduler.addSystem(
+      "spatial index", FramePhase::SIMULATION,
+      SystemAccess().read<WorldTransform>().write<Registry,
+                                                  SirEngine::SpatialIndex>(),
+      [&](const FrameContext &) { spatialIndex.update(registry); });
+  scheduler.addSystem(
+      "render extraction", FramePhase::RENDER_EXTRACTION,
+      SystemAccess()
+          .read<Registry, WorldTransform>()
+          .write<SirEngine::DrawList>(),
+      [&](const FrameContext &context) {
+        extracted = extractor
+                        .extract(registry, frameAllocator, nullptr,
+                                 context.pool)
+                        .count;
+      });
+
+  // the hierarchy and the index close registry versions, nothing else
+  // touching the registry can run next to them
+  REQUIRE(scheduler.getWaveCount(FramePhase::SIMULATION) == 3);
+  constexpr uint32_t frameCount = 60;
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    // 1/60 of a second
+    scheduler.runFrame(16666667);
+  }
+  REQUIRE(scheduler.getFrameIndex() == frameCount);
+  REQUIRE(extracted == entityCount);
+  REQUIRE(spatialIndex.getLastUpdatedCount() == entityCount);
+  const glm::mat4 &world = hierarchy.getWorldMatrix(tracked);
+  REQUIRE(world[3].x == Approx(10.0f));
+  REQUIRE(world[3].y == Approx(1.0f).epsilon(0.01));
+
+  std::vector<EntityId> found;
+  spatialIndex.querySphere(glm::vec3(500.0f, 1.0f, 0.0f), 2.5f, found);
+  REQUIRE(found.size() == 7);
+  REQUIRE(scheduler.getPhaseTimeNs(FramePhase::SIMULATION) > 0);
+}
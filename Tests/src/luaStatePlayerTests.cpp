@@ -0,0 +1,150 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "SirEngine/animation/animationManager.h"
+#include "SirEngine/animation/luaStatePlayer.h"
+#include "SirEngine/globals.h"
+#include "SirEngine/input.h"
+#include "SirEngine/io/fileUtils.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "SirEngine/memory/cpu/threeSizesPool.h"
+#include "SirEngine/scripting/scriptingContext.h"
+#include "catch/catch.hpp"
+#include "nlohmann/json.hpp"
+#include "resourceProcessing/processor.h"
+
+extern "C" {
+#include <lua/lua.h>
+}
+
+// counting the operator new calls means replacing it for the whole test
+// executable, it is opt in through the SE_TESTS_COUNT_NEW_CALLS cmake option,
+// without it only the lua heap and the engine pools are checked
+static std::atomic<uint64_t> NEW_CALL_COUNT{0};
+
+#ifdef SE_TESTS_COUNT_NEW_CALLS
+void *operator new(const size_t size) {
+  ++NEW_CALL_COUNT;
+  void *ptr = malloc(size != 0 ? size : 1);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+#endif
+
+namespace {
+constexpr uint32_t UP_ARROW = 38;
+constexpr long long FRAME_NS = 16 * 1000000ll;
+
+void compileKnightClip(const char *in, const char *out) {
+  SirEngine::ResourceProcessing::Processor p;
+  p.initialize();
+  p.process("animationCompilerPlugin", in, out, "");
+}
+
+struct AllocationCounts {
+  uint64_t newCalls;
+  // lua heap in bytes, the collector is stopped while counting
+  uint64_t luaBytes;
+  uint32_t persistentAllocs;
+};
+
+AllocationCounts getAllocationCounts(lua_State *state) {
+  const SirEngine::ThreeSizesPool *pool =
+      SirEngine::globals::PERSISTENT_ALLOCATOR;
+  return {NEW_CALL_COUNT.load(),
+          static_cast<uint64_t>(lua_gc(state, LUA_GCCOUNT, 0)) * 1024u +
+              static_cast<uint64_t>(lua_gc(state, LUA_GCCOUNTB, 0)),
+          pool->getSmallAllocCount() + pool->getMediumAllocCount() +
+              pool->getLargeAllocCount()};
+}
+
+// a player frame as the engine runs it
+void runFrames(SirEngine::LuaStatePlayer &player, SirEngine::Input &input,
+               SirEngine::StackAllocator &scratch, long long &stampNS,
+               const int frameCount) {
+  for (int i = 0; i < frameCount; ++i) {
+    stampNS += FRAME_NS;
+    player.update(stampNS);
+    player.evaluate(stampNS, scratch);
+    input.swapFrameKey();
+  }
+}
+
+// walks forward until the state machine settled on walking, then goes back
+// to idle, long enough for both transitions to wait for their key and blend
+void walkAndStop(SirEngine::LuaStatePlayer &player, SirEngine::Input &input,
+                 SirEngine::StackAllocator &scratch, long long &stampNS,
+                 glm::vec3 &walkDistance) {
+  const glm::vec3 start(player.getTransform()[3]);
+  input.keyDown(UP_ARROW);
+  runFrames(player, input, scratch, stampNS, 1500);
+  walkDistance = glm::vec3(player.getTransform()[3]) - start;
+  input.keyUp(UP_ARROW);
+  runFrames(player, input, scratch, stampNS, 1500);
+}
+}  // namespace
+
+TEST_CASE("lua state player steady state does not allocate", "[animation]") {
+  compileKnightClip("../testData/knightBIdle.json",
+                    "../testData/knightBIdle.clip");
+  compileKnightClip("../testData/knightBWalk.json",
+                    "../testData/knightBWalk.clip");
+
+  SirEngine::ScriptingContext ctx;
+  REQUIRE(ctx.init());
+  SirEngine::globals::SCRIPTING_CONTEXT = &ctx;
+  SirEngine::Input input;
+  input.init();
+  SirEngine::globals::INPUT = &input;
+  SirEngine::AnimationManager animManager;
+  animManager.init();
+  SirEngine::globals::ANIMATION_MANAGER = &animManager;
+
+  {
+    nlohmann::json config;
+    SirEngine::getJsonObj("../testData/knightBStateConfig.json", config);
+    SirEngine::LuaStatePlayer player;
+    player.init(&animManager, config);
+    SirEngine::StackAllocator scratch;
+    scratch.initialize(1024 * 1024);
+
+    lua_State *state = ctx.getContext();
+    lua_gc(state, LUA_GCCOLLECT, 0);
+    lua_gc(state, LUA_GCSTOP, 0);
+
+    // the first round trip grows the lua stacks to what the state machine
+    // needs
+    long long stampNS = animManager.getAnimClock().getTicks();
+    glm::vec3 walkDistance;
+    walkAndStop(player, input, scratch, stampNS, walkDistance);
+    REQUIRE(glm::length(walkDistance) > 1.0f);
+
+    // nothing gets checked until the end, the checks themselves could
+    // allocate
+    const AllocationCounts before = getAllocationCounts(state);
+    const glm::vec3 idlePosition(player.getTransform()[3]);
+    runFrames(player, input, scratch, stampNS, 500);
+    const glm::vec3 idleDistance =
+        glm::vec3(player.getTransform()[3]) - idlePosition;
+    // both transitions played again, queued and resolved by id
+    walkAndStop(player, input, scratch, stampNS, walkDistance);
+    const AllocationCounts after = getAllocationCounts(state);
+
+    REQUIRE(glm::length(idleDistance) < 0.0001f);
+    REQUIRE(glm::length(walkDistance) > 1.0f);
+    REQUIRE(after.newCalls == before.newCalls);
+    REQUIRE(after.luaBytes == before.luaBytes);
+    REQUIRE(after.persistentAllocs == before.persistentAllocs);
+
+    lua_gc(state, LUA_GCRESTART, 0);
+  }
+
+  SirEngine::globals::ANIMATION_MANAGER = nullptr;
+  SirEngine::globals::INPUT = nullptr;
+  SirEngine::globals::SCRIPTING_CONTEXT = nullptr;
+}
@@ -0,0 +1,171 @@
+#include <random>
+#include <vector>
+
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/animation/skeleton.h"
+#include "catch/catch.hpp"
+
+using SirEngine::JointPose;
+using SirEngine::POSE_STREAM;
+
+namespace {
+glm::quat randomRotation(std::mt19937 &generator) {
+  std::normal_distribution<float> distribution;
+  return glm::normalize(glm::quat(distribution(generator),
+                                  distribution(generator),
+                                  distribution(generator),
+                                  distribution(generator)));
+}
+
+// a rotation close to the given one, like two consecutive keys
+glm::quat nearbyRotation(std::mt19937 &generator, const glm::quat &rot,
+                         const float maxAngle) {
+  std::uniform_real_distribution<float> angle(-maxAngle, maxAngle);
+  const glm::vec3 axis =
+      glm::normalize(glm::vec3(angle(generator), angle(generator), 1.0f));
+  return glm::normalize(rot * glm::angleAxis(angle(generator), axis));
+}
+
+void randomPoses(std::mt19937 &generator, std::vector<JointPose> &a,
+                 std::vector<JointPose> &b, const float maxAngle) {
+  std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i].m_rot = randomRotation(generator);
+    b[i].m_rot = maxAngle > 0.0f
+                     ? nearbyRotation(generator, a[i].m_rot, maxAngle)
+                     : randomRotation(generator);
+    // the kernel must be sign agnostic
+    if (i % 3 == 0) {
+      b[i].m_rot = -b[i].m_rot;
+    }
+    a[i].m_trans = glm::vec3(position(generator), position(generator),
+                             position(generator));
+    b[i].m_trans = glm::vec3(position(generator), position(generator),
+                             position(generator));
+    a[i].m_scale = 1.0f;
+    b[i].m_scale = 2.0f;
+  }
+}
+
+void requireSameStreams(const std::vector<float> &expected,
+                        const std::vector<float> &result,
+                        const float tolerance) {
+  REQUIRE(expected.size() == result.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    REQUIRE(result[i] == Approx(expected[i]).margin(tolerance));
+  }
+}
+}  // namespace
+
+TEST_CASE("pose streams round trip", "[animation]") {
+  std::mt19937 generator(42);
+  constexpr uint32_t jointCount = 13;
+  std::vector<JointPose> poses(jointCount);
+  std::vector<JointPose> unused(jointCount);
+  randomPoses(generator, poses, unused, 0.1f);
+
+  REQUIRE(SirEngine::getPoseStreamStride(jointCount) == 16);
+  REQUIRE(SirEngine::getPoseStreamStride(16) == 16);
+  std::vector<float> streams(SirEngine::getPoseStreamsSize(jointCount));
+  SirEngine::jointPosesToStreams(poses.data(), jointCount, streams.data());
+  REQUIRE(SirEngine::getPoseStream(streams.data(), jointCount,
+                                   POSE_STREAM::TRANS_Y)[3] ==
+          poses[3].m_trans.y);
+  // padding joints are identities
+  REQUIRE(SirEngine::getPoseStream(streams.data(), jointCount,
+                                   POSE_STREAM::ROT_W)[jointCount] == 1.0f);
+  REQUIRE(SirEngine::getPoseStream(streams.data(), jointCount,
+                                   POSE_STREAM::SCALE)[15] == 1.0f);
+
+  std::vector<JointPose> back(jointCount);
+  SirEngine::streamsToJointPoses(streams.data(), jointCount, back.data());
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    REQUIRE(back[i].m_rot.x == poses[i].m_rot.x);
+    REQUIRE(back[i].m_rot.w == poses[i].m_rot.w);
+    REQUIRE(back[i].m_trans.z == poses[i].m_trans.z);
+    REQUIRE(back[i].m_scale == poses[i].m_scale);
+  }
+}
+
+TEST_CASE("pose streams interpolation matches slerp", "[animation]") {
+  std::mt19937 generator(7);
+  constexpr uint32_t jointCount = 61;
+  std::vector<JointPose> posesA(jointCount);
+  std::vector<JointPose> posesB(jointCount);
+  const uint32_t size = SirEngine::getPoseStreamsSize(jointCount);
+  std::vector<float> a(size);
+  std::vector<float> b(size);
+  std::vector<float> expected(size);
+  std::vector<float> result(size);
+
+  // keys a few degrees apart take the nlerp path, random rotations mostly
+  // take the slerp fallback
+  for (const float maxAngle : {0.05f, 0.3f, -1.0f}) {
+    randomPoses(generator, posesA, posesB, maxAngle);
+    SirEngine::jointPosesToStreams(posesA.data(), jointCount, a.data());
+    SirEngine::jointPosesToStreams(posesB.data(), jointCount, b.data());
+    for (const float factor : {0.0f, 0.21f, 0.5f, 0.79f, 1.0f}) {
+      SirEngine::interpolatePoseStreamsScalar(a.data(), b.data(), factor,
+                                              jointCount, expected.data());
+      SirEngine::interpolatePoseStreams(a.data(), b.data(), factor,
+                                        jointCount, result.data());
+      // the scalar path does not touch the padding
+      for (uint32_t s = 0; s < SirEngine::POSE_STREAM_COUNT; ++s) {
+        for (uint32_t i = jointCount; i < 64; ++i) {
+          expected[s * 64 + i] = result[s * 64 + i];
+        }
+      }
+      requireSameStreams(expected, result, 1e-3f);
+    }
+  }
+
+  // in place, the output aliasing the first input
+  SirEngine::interpolatePoseStreamsScalar(a.data(), b.data(), 0.3f, jointCount,
+                                          expected.data());
+  SirEngine::interpolatePoseStreams(a.data(), b.data(), 0.3f, jointCount,
+                                    a.data());
+  std::vector<JointPose> blended(jointCount);
+  std::vector<JointPose> reference(jointCount);
+  SirEngine::streamsToJointPoses(a.data(), jointCount, blended.data());
+  SirEngine::streamsToJointPoses(expected.data(), jointCount,
+                                 reference.data());
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    REQUIRE(glm::length(blended[i].m_rot) == Approx(1.0f).margin(1e-5f));
+    REQUIRE(std::abs(glm::dot(blended[i].m_rot, reference[i].m_rot)) ==
+            Approx(1.0f).margin(1e-5f));
+  }
+}
+
+TEST_CASE("pose interpolation per joint", "[.][benchmark]") {
+  // many knights worth of joints, keys a few degrees apart like in a clip
+  std::mt19937 generator(3);
+  constexpr uint32_t jointCount = 64 * 1024;
+  std::vector<JointPose> posesA(jointCount);
+  std::vector<JointPose> posesB(jointCount);
+  std::vector<JointPose> output(jointCount);
+  randomPoses(generator, posesA, posesB, 0.05f);
+  const uint32_t size = SirEngine::getPoseStreamsSize(jointCount);
+  std::vector<float> a(size);
+  std::vector<float> b(size);
+  std::vector<float> result(size);
+  SirEngine::jointPosesToStreams(posesA.data(), jointCount, a.data());
+  SirEngine::jointPosesToStreams(posesB.data(), jointCount, b.data());
+
+  BENCHMARK("array of structures glm::slerp 64k joints") {
+    for (uint32_t i = 0; i < jointCount; ++i) {
+      output[i].m_rot = glm::slerp(posesA[i].m_rot, posesB[i].m_rot, 0.3f);
+      output[i].m_trans = glm::mix(posesA[i].m_trans, posesB[i].m_trans, 0.3f);
+    }
+    return output[0].m_rot.x;
+  };
+  BENCHMARK("streams scalar 64k joints") {
+    SirEngine::interpolatePoseStreamsScalar(a.data(), b.data(), 0.3f,
+                                            jointCount, result.data());
+    return result[0];
+  };
+  BENCHMARK("streams simd 64k joints") {
+    SirEngine::interpolatePoseStreams(a.data(), b.data(), 0.3f, jointCount,
+                                      result.data());
+    return result[0];
+  };
+}
@@ -0,0 +1,163 @@
+#include <cstring>
+#include <vector>
+
+#include "SirEngine/graphics/renderExtraction.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "SirEngine/workerPool.h"
+#include "catch/catch.hpp"
+
+using SirEngine::DrawList;
+using SirEngine::DrawPacket;
+using SirEngine::MeshRenderer;
+using SirEngine::RenderBounds;
+using SirEngine::RenderExtractor;
+using SirEngine::StackAllocator;
+using SirEngine::WorkerPool;
+using SirEngine::ecs::EntityId;
+using SirEngine::ecs::Registry;
+using SirEngine::ecs::WorldTransform;
+
+static EntityId createRenderable(Registry &registry, const float x,
+                                 const uint32_t mesh, const uint32_t material,
+                                 const float radius = 1.0f) {
+  glm::mat4 matrix(1.0f);
+  matrix[3] = glm::vec4(x, 0.0f, 0.0f, 1.0f);
+  const EntityId eid = registry.createEntity(
+      WorldTransform{matrix}, RenderBounds{glm::vec3(0.0f), radius});
+  registry.setSharedComponent(
+      eid, MeshRenderer{SirEngine::MeshHandle{mesh},
+                        SirEngine::MaterialHandle{material}});
+  return eid;
+}
+
+// axis aligned box from -extent to extent, normals pointing outward
+static void makeBoxFrustum(Plane *planes, const float extent) {
+  for (int axis = 0; axis < 3; ++axis) {
+    for (int side = 0; side < 2; ++side) {
+      const float sign = side == 0 ? 1.0f : -1.0f;
+      Plane &plane = planes[axis * 2 + side];
+      plane.normal = glm::vec4(0.0f);
+      plane.normal[axis] = sign;
+      plane.position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+      plane.position[axis] = sign * extent;
+    }
+  }
+}
+
+TEST_CASE("render extraction builds contiguous runs", "[graphics,ecs]") {
+  Registry registry;
+  for (uint32_t i = 0; i < 60; ++i) {
+    createRenderable(registry, static_cast<float>(i), 1 + i % 3, 10 + i % 2);
+  }
+  // not a renderable, no bounds
+  registry.createEntity(WorldTransform{glm::mat4(1.0f)});
+
+  StackAllocator allocator;
+  allocator.initialize(64 * 1024);
+  RenderExtractor extractor;
+  const DrawList list =
+      extractor.extract(registry, allocator, nullptr, nullptr);
+  REQUIRE(list.count == 60);
+  REQUIRE(list.extractedCount == 60);
+  REQUIRE(reinterpret_cast<size_t>(list.packets) % 16 == 0);
+  // the unused part of the worst case allocation went back to the allocator
+  REQUIRE(allocator.getStackPtr() == list.packets + list.count);
+
+  // six mesh/material pairs, each of them a single run of ten packets
+  uint32_t runCount = 0;
+  std::vector<bool> seen(60, false);
+  for (uint32_t start = 0; start < list.count;) {
+    const uint32_t end = SirEngine::getDrawRunEnd(list, start);
+    REQUIRE(end - start == 10);
+    for (uint32_t i = start; i < end; ++i) {
+      const DrawPacket &packet = list.packets[i];
+      const auto x = static_cast<uint32_t>(packet.worldMatrix[3].x);
+      REQUIRE(packet.mesh.handle == 1 + x % 3);
+      REQUIRE(packet.material.handle == 10 + x % 2);
+      REQUIRE(!seen[x]);
+      seen[x] = true;
+    }
+    start = end;
+    ++runCount;
+  }
+  REQUIRE(runCount == 6);
+
+  // reading the components for the extraction is not a change
+  std::vector<std::tuple<size_t, const WorldTransform *>> changed;
+  const uint32_t lastSeen = registry.advanceVersion();
+  extractor.extract(registry, allocator, nullptr, nullptr);
+  registry.populateChangedComponentQuery<WorldTransform>(changed, lastSeen);
+  REQUIRE(changed.empty());
+}
+
+TEST_CASE("render extraction culls against the frustum", "[graphics,ecs]") {
+  Registry registry;
+  // fully inside, straddling the border, outside, scaled up until it touches
+  createRenderable(registry, 0.0f, 1, 1);
+  createRenderable(registry, 10.5f, 1, 1);
+  createRenderable(registry, 20.0f, 1, 1);
+  const EntityId scaled = createRenderable(registry, 15.0f, 2, 1);
+  const EntityId unbounded =
+      createRenderable(registry, 100.0f, 2, 1, RenderBounds::UNBOUNDED_RADIUS);
+
+  Plane frustum[6];
+  makeBoxFrustum(frustum, 10.0f);
+  StackAllocator allocator;
+  allocator.initialize(64 * 1024);
+  RenderExtractor extractor;
+  DrawList list = extractor.extract(registry, allocator, frustum, nullptr);
+  REQUIRE(list.extractedCount == 5);
+  REQUIRE(list.count == 3);
+  REQUIRE(list.packets[0].worldMatrix[3].x == Approx(0.0f));
+  REQUIRE(list.packets[1].worldMatrix[3].x == Approx(10.5f));
+  REQUIRE(list.packets[2].worldMatrix[3].x == Approx(100.0f));
+
+  glm::mat4 matrix(1.0f);
+  matrix[0] *= 5.0f;
+  matrix[3] = glm::vec4(15.0f, 0.0f, 0.0f, 1.0f);
+  registry.getComponent<WorldTransform>(scaled).matrix = matrix;
+  registry.deleteEntity(unbounded);
+  allocator.reset();
+  list = extractor.extract(registry, allocator, frustum, nullptr);
+  REQUIRE(list.count == 3);
+  REQUIRE(list.packets[2].worldMatrix[3].x == Approx(15.0f));
+  REQUIRE(list.packets[2].mesh.handle == 2);
+}
+
+TEST_CASE("render extraction in parallel matches the serial one",
+          "[graphics,ecs]") {
+  Registry registry;
+  for (uint32_t i = 0; i < 5000; ++i) {
+    // half of them out of the frustum, interleaved to leave gaps in every
+    // batch
+    const float x = static_cast<float>(i % 40) - 20.0f;
+    createRenderable(registry, x * (i % 2 == 0 ? 1.0f : 4.0f), 1 + i % 7, 1,
+                     0.5f);
+  }
+  Plane frustum[6];
+  makeBoxFrustum(frustum, 30.0f);
+
+  StackAllocator serialAllocator;
+  serialAllocator.initialize(1024 * 1024);
+  StackAllocator parallelAllocator;
+  parallelAllocator.initialize(1024 * 1024);
+  RenderExtractor extractor;
+  const DrawList serial =
+      extractor.extract(registry, serialAllocator, frustum, nullptr, 64);
+  REQUIRE(serial.count < serial.extractedCount);
+
+  WorkerPool pool(4);
+  const DrawList parallel =
+      extractor.extract(registry, parallelAllocator, frustum, &pool, 64);
+  REQUIRE(parallel.count == serial.count);
+  REQUIRE(memcmp(parallel.packets, serial.packets,
+                 sizeof(DrawPacket) * serial.count) == 0);
+
+  // nothing to draw does not touch the allocator
+  Registry empty;
+  parallelAllocator.reset();
+  const DrawList none = extractor.extract(empty, parallelAllocator, frustum,
+                                          &pool);
+  REQUIRE(none.count == 0);
+  REQUIRE(parallelAllocator.getStackPtr() == parallelAllocator.getStartPtr());
+}
@@ -0,0 +1,140 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "SirEngine/animation/poseStreams.h"
+#include "SirEngine/animation/skeleton.h"
+#include "animationTestUtils.h"
+#include "catch/catch.hpp"
+#include <glm/gtx/transform.hpp>
+
+using SirEngine::JointPose;
+using SirEngine::Skeleton;
+
+namespace {
+glm::quat randomRotation(std::mt19937 &generator) {
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  return glm::normalize(glm::quat(value(generator), value(generator),
+                                  value(generator), value(generator)));
+}
+
+glm::vec3 randomTranslation(std::mt19937 &generator) {
+  std::uniform_real_distribution<float> value(-20.0f, 20.0f);
+  return glm::vec3(value(generator), value(generator), value(generator));
+}
+
+// a random tree, every joint parented to any joint before it
+void buildRandomSkeleton(std::mt19937 &generator, const uint32_t jointCount,
+                         Skeleton &skeleton) {
+  skeleton.m_jointCount = jointCount;
+  skeleton.m_parentIds.resize(jointCount);
+  skeleton.m_jointsWolrdInv.resize(jointCount);
+  skeleton.m_names.resize(jointCount);
+  for (uint32_t i = 0; i < jointCount; ++i) {
+    std::uniform_int_distribution<int> parent(0, static_cast<int>(i) - 1);
+    skeleton.m_parentIds[i] = i == 0 ? -1 : parent(generator);
+    glm::mat4 bind = glm::toMat4(randomRotation(generator));
+    bind[3] = glm::vec4(randomTranslation(generator), 1.0f);
+    skeleton.m_jointsWolrdInv[i] = glm::inverse(bind);
+    skeleton.m_names[i] = "joint";
+  }
+}
+
+void requireSameMatrices(const std::vector<glm::mat4> &expected,
+                         const std::vector<glm::mat4> &result) {
+  REQUIRE(expected.size() == result.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    for (uint32_t column = 0; column < 4; ++column) {
+      for (uint32_t row = 0; row < 4; ++row) {
+        REQUIRE(result[i][column][row] ==
+                Approx(expected[i][column][row]).margin(1e-3f));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST_CASE("skeleton global pose matches the reference", "[animation]") {
+  std::mt19937 generator(11);
+  Skeleton skeleton;
+  buildRandomSkeleton(generator, 150, skeleton);
+  std::vector<JointPose> joints(skeleton.m_jointCount);
+  for (JointPose &joint : joints) {
+    joint = JointPose{randomRotation(generator), randomTranslation(generator),
+                      1.0f};
+  }
+  const glm::mat4 transform =
+      glm::translate(glm::mat4(1.0f), glm::vec3(5.0f, -3.0f, 12.0f)) *
+      glm::rotate(glm::mat4(1.0f), 0.7f, glm::vec3(0.0f, 1.0f, 0.0f));
+
+  OwnedPose expected(skeleton);
+  expected.setLocalPose(joints.data());
+  expected.pose.updateGlobalFromLocalScalar(transform);
+  OwnedPose result(skeleton);
+  result.setLocalPose(joints.data());
+  result.pose.updateGlobalFromLocal(transform);
+  requireSameMatrices(expected.worldMat, result.worldMat);
+  requireSameMatrices(expected.globalPose, result.globalPose);
+}
+
+TEST_CASE("skeleton global pose on the knight clips", "[animation]") {
+  Skeleton skeleton;
+  REQUIRE(skeleton.loadFromFile("../testData/mannequin.json"));
+  uint32_t jointCount = 0;
+  const std::vector<JointPose> poses =
+      loadClipPoses("../testData/knightBWalk.json", jointCount);
+  REQUIRE(jointCount == skeleton.m_jointCount);
+
+  const glm::mat4 transform =
+      glm::translate(glm::mat4(1.0f), glm::vec3(100.0f, 0.0f, -40.0f));
+  OwnedPose expected(skeleton);
+  OwnedPose result(skeleton);
+  const auto frameCount = static_cast<uint32_t>(poses.size() / jointCount);
+  for (uint32_t frame = 0; frame < frameCount; frame += 7) {
+    expected.setLocalPose(poses.data() + frame * jointCount);
+    expected.pose.updateGlobalFromLocalScalar(transform);
+    result.setLocalPose(poses.data() + frame * jointCount);
+    result.pose.updateGlobalFromLocal(transform);
+    requireSameMatrices(expected.worldMat, result.worldMat);
+    requireSameMatrices(expected.globalPose, result.globalPose);
+  }
+}
+
+TEST_CASE("skeleton global pose per frame", "[.][benchmark]") {
+  // every frame of the knight idle on its 63 joints skeleton
+  Skeleton skeleton;
+  skeleton.loadFromFile("../testData/mannequin.json");
+  uint32_t jointCount = 0;
+  const std::vector<JointPose> poses =
+      loadClipPoses("../testData/knightBIdle.json", jointCount);
+  const auto frameCount = static_cast<uint32_t>(poses.size() / jointCount);
+  std::vector<float> frames(SirEngine::getPoseStreamsSize(jointCount) *
+                            frameCount);
+  for (uint32_t frame = 0; frame < frameCount; ++frame) {
+    SirEngine::jointPosesToStreams(
+        poses.data() + frame * jointCount, jointCount,
+        frames.data() + frame * SirEngine::getPoseStreamsSize(jointCount));
+  }
+  OwnedPose pose(skeleton);
+  const glm::mat4 transform(1.0f);
+
+  BENCHMARK("glm matrices from the joint poses") {
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+      pose.pose.m_localStreams =
+          frames.data() + frame * SirEngine::getPoseStreamsSize(jointCount);
+      SirEngine::streamsToJointPoses(pose.pose.m_localStreams, jointCount,
+                                     pose.pose.m_localPose);
+      pose.pose.updateGlobalFromLocalScalar(transform);
+    }
+    return pose.globalPose[jointCount - 1][3][3];
+  };
+  BENCHMARK("simd affine matrices from the streams") {
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+      pose.pose.m_localStreams =
+          frames.data() + frame * SirEngine::getPoseStreamsSize(jointCount);
+      pose.pose.updateGlobalFromLocal(transform);
+    }
+    return pose.globalPose[jointCount - 1][3][3];
+  };
+}
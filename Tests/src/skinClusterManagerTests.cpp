@@ -0,0 +1,179 @@
+#include <cstring>
+#include <vector>
+
+#include "SirEngine/animation/animationPlayer.h"
+#include "SirEngine/animation/skeleton.h"
+#include "SirEngine/bufferManager.h"
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "SirEngine/skinClusterManager.h"
+#include "catch/catch.hpp"
+
+using SirEngine::ANIM_FLAGS;
+using SirEngine::BufferHandle;
+using SirEngine::SkinClusterManager;
+
+namespace {
+// buffers are plain cpu memory, always mapped
+class CpuBufferManager final : public SirEngine::BufferManager {
+ public:
+  void initialize() override {}
+  void cleanup() override { m_buffers.clear(); }
+  void free(const BufferHandle handle) override {
+    m_buffers[handle.handle - 1].clear();
+  }
+  BufferHandle allocate(const uint32_t sizeInBytes, void *initData,
+                        const char *, int, int, BUFFER_FLAGS) override {
+    m_buffers.emplace_back(sizeInBytes, 0);
+    if (initData != nullptr) {
+      memcpy(m_buffers.back().data(), initData, sizeInBytes);
+    }
+    return {static_cast<uint32_t>(m_buffers.size())};
+  }
+  void transitionBuffer(const BufferHandle,
+                        const BufferTransition &) override {}
+  void *getMappedData(const BufferHandle handle) const override {
+    return const_cast<char *>(m_buffers[handle.handle - 1].data());
+  }
+  void update(const BufferHandle handle, void *inData, const int offset,
+              const int size) override {
+    memcpy(m_buffers[handle.handle - 1].data() + offset, inData, size);
+  }
+
+ private:
+  std::vector<std::vector<char>> m_buffers;
+};
+
+// hands out a fixed pose, every matrix filled with the given value
+class FixedPosePlayer final : public SirEngine::AnimationPlayer {
+ public:
+  explicit FixedPosePlayer(const uint32_t jointCount)
+      : m_matrices(jointCount, glm::mat4(0.0f)) {
+    m_pose.m_globalPose = m_matrices.data();
+    m_outPose = &m_pose;
+    m_flags = ANIM_FLAGS::READY;
+  }
+  void evaluate(long long, SirEngine::StackAllocator &) override {
+    m_flags = ANIM_FLAGS::NEW_MATRICES;
+  }
+  uint32_t getJointCount() const override {
+    return static_cast<uint32_t>(m_matrices.size());
+  }
+  void setValue(const float value) {
+    for (glm::mat4 &matrix : m_matrices) {
+      matrix = glm::mat4(value);
+    }
+  }
+
+ private:
+  std::vector<glm::mat4> m_matrices;
+  SirEngine::SkeletonPose m_pose{};
+};
+
+// value on the diagonal of the matrix in the shared buffer
+float getUploadedValue(const CpuBufferManager &buffers,
+                       const SkinClusterManager &skins,
+                       const uint32_t matrix) {
+  const auto *matrices = static_cast<const glm::mat4 *>(
+      buffers.getMappedData(skins.getMatricesBuffer()));
+  return matrices[matrix][0][0];
+}
+}  // namespace
+
+TEST_CASE("skin upload only copies dirty skins", "[animation]") {
+  CpuBufferManager buffers;
+  SkinClusterManager skins(&buffers);
+  skins.init();
+  std::vector<FixedPosePlayer> players;
+  std::vector<SirEngine::SkinHandle> handles;
+  players.reserve(5);
+  for (uint32_t i = 0; i < 5; ++i) {
+    players.emplace_back(10 + i);
+    handles.push_back(skins.registerSkinCluster({}, {}, {i + 1}, &players[i]));
+  }
+  SirEngine::StackAllocator scratch;
+
+  // nothing evaluated yet
+  skins.uploadDirtyMatrices();
+  REQUIRE(skins.getUploadedRanges().size() == 0);
+
+  // skins 0,1 and 3 evaluate, 0 and 1 are next to each other in the buffer
+  for (const uint32_t i : {0u, 1u, 3u}) {
+    players[i].setValue(static_cast<float>(i + 1));
+    players[i].evaluate(0, scratch);
+  }
+  players[2].setValue(100.0f);
+  skins.uploadDirtyMatrices();
+  const auto &ranges = skins.getUploadedRanges();
+  REQUIRE(ranges.size() == 2);
+  REQUIRE(ranges[0].offset == 0);
+  REQUIRE(ranges[0].count == 10 + 11);
+  REQUIRE(ranges[1].offset == skins.getSkinData(handles[3]).matricesOffset);
+  REQUIRE(ranges[1].count == 13);
+  REQUIRE(getUploadedValue(buffers, skins, 0) == 1.0f);
+  REQUIRE(getUploadedValue(buffers, skins, 10) == 2.0f);
+  // skin 2 changed its matrices without evaluating, it is not uploaded
+  REQUIRE(getUploadedValue(buffers, skins, 21) == 0.0f);
+  REQUIRE(getUploadedValue(buffers, skins, 33) == 4.0f);
+  for (const FixedPosePlayer &player : players) {
+    REQUIRE(player.getFlags() == ANIM_FLAGS::READY);
+  }
+
+  // the next frame without any evaluation uploads nothing
+  skins.uploadDirtyMatrices();
+  REQUIRE(skins.getUploadedRanges().size() == 0);
+
+  // everything evaluating is a single range over the whole buffer
+  for (FixedPosePlayer &player : players) {
+    player.evaluate(0, scratch);
+  }
+  skins.uploadDirtyMatrices();
+  REQUIRE(skins.getUploadedRanges().size() == 1);
+  REQUIRE(skins.getUploadedRanges()[0].count == 10 + 11 + 12 + 13 + 14);
+  REQUIRE(getUploadedValue(buffers, skins, 21) == 100.0f);
+  skins.cleanup();
+}
+
+TEST_CASE("skin upload with skins sharing a player", "[animation]") {
+  CpuBufferManager buffers;
+  SkinClusterManager skins(&buffers);
+  skins.init();
+  FixedPosePlayer player(8);
+  const SirEngine::SkinHandle first =
+      skins.registerSkinCluster({}, {}, {1}, &player);
+  const SirEngine::SkinHandle second =
+      skins.registerSkinCluster({}, {}, {1}, &player);
+  REQUIRE(skins.getSkinData(second).matricesOffset ==
+          skins.getSkinData(first).matricesOffset + 8);
+
+  player.setValue(3.0f);
+  SirEngine::StackAllocator scratch;
+  player.evaluate(0, scratch);
+  skins.uploadDirtyMatrices();
+  // both skins are written even though the player flag gets cleared
+  REQUIRE(skins.getUploadedRanges().size() == 1);
+  REQUIRE(skins.getUploadedRanges()[0].count == 16);
+  REQUIRE(getUploadedValue(buffers, skins, 0) == 3.0f);
+  REQUIRE(getUploadedValue(buffers, skins, 8) == 3.0f);
+  REQUIRE(player.getFlags() == ANIM_FLAGS::READY);
+  skins.cleanup();
+}
+
+TEST_CASE("skin registration fails when out of matrices", "[animation]") {
+  CpuBufferManager buffers;
+  SkinClusterManager skins(&buffers);
+  skins.init();
+  FixedPosePlayer big(SkinClusterManager::MAX_SKIN_MATRICES - 4);
+  FixedPosePlayer small(8);
+  FixedPosePlayer fitting(4);
+  REQUIRE(skins.registerSkinCluster({}, {}, {1}, &big).isHandleValid());
+  REQUIRE(!skins.registerSkinCluster({}, {}, {2}, &small).isHandleValid());
+
+  // a failed registration takes no room in the buffer
+  const SirEngine::SkinHandle last =
+      skins.registerSkinCluster({}, {}, {3}, &fitting);
+  REQUIRE(last.isHandleValid());
+  REQUIRE(skins.getSkinData(last).matricesOffset ==
+          SkinClusterManager::MAX_SKIN_MATRICES - 4);
+  REQUIRE(!skins.registerSkinCluster({}, {}, {4}, &fitting).isHandleValid());
+  skins.cleanup();
+}
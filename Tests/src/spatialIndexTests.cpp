@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "SirEngine/graphics/spatialIndex.h"
+#include "catch/catch.hpp"
+
+using SirEngine::RenderBounds;
+using SirEngine::SpatialIndex;
+using SirEngine::SpatialNode;
+using SirEngine::ecs::EntityId;
+using SirEngine::ecs::Registry;
+using SirEngine::ecs::WorldTransform;
+
+static WorldTransform makeWorld(const glm::vec3 &position,
+                                const float scale = 1.0f) {
+  glm::mat4 matrix(scale);
+  matrix[3] = glm::vec4(position, 1.0f);
+  return {matrix};
+}
+
+static std::vector<uint32_t> toSortedIndices(
+    const std::vector<EntityId> &entities) {
+  std::vector<uint32_t> indices;
+  for (const EntityId eid : entities) {
+    indices.push_back(eid.index);
+  }
+  std::sort(indices.begin(), indices.end());
+  return indices;
+}
+
+// brute force reference, walks every entity of the registry
+template <typename TEST>
+static std::vector<uint32_t> queryBruteForce(Registry &registry, TEST &&test) {
+  std::vector<uint32_t> indices;
+  registry.forEach<const WorldTransform, const RenderBounds, const SpatialNode>(
+      [&](const EntityId eid, const WorldTransform &world,
+          const RenderBounds &bounds, const SpatialNode &) {
+        glm::vec3 center;
+        float radius;
+        SirEngine::getWorldBoundingSphere(world.matrix, bounds, center,
+                                          radius);
+        if (test(center, radius)) {
+          indices.push_back(eid.index);
+        }
+      });
+  std::sort(indices.begin(), indices.end());
+  return indices;
+}
+
+static void checkQueries(Registry &registry, const SpatialIndex &index,
+                         std::mt19937 &generator) {
+  std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+  std::uniform_real_distribution<float> size(0.0f, 60.0f);
+  std::vector<EntityId> result;
+  for (int i = 0; i < 20; ++i) {
+    const glm::vec3 minCorner(position(generator), position(generator),
+                              position(generator));
+    const glm::vec3 maxCorner =
+        minCorner + glm::vec3(size(generator), size(generator),
+                              size(generator));
+    index.queryAabb(minCorner, maxCorner, result);
+    REQUIRE(toSortedIndices(result) ==
+            queryBruteForce(registry, [&](const glm::vec3 &c, const float r) {
+              const glm::vec3 closest =
+                  glm::min(glm::max(c, minCorner), maxCorner);
+              const glm::vec3 delta = c - closest;
+              return glm::dot(delta, delta) <= r * r;
+            }));
+
+    const float radius = size(generator);
+    index.querySphere(minCorner, radius, result);
+    REQUIRE(toSortedIndices(result) ==
+            queryBruteForce(registry, [&](const glm::vec3 &c, const float r) {
+              const glm::vec3 delta = c - minCorner;
+              return glm::dot(delta, delta) <= (r + radius) * (r + radius);
+            }));
+
+    // a box shaped frustum, normals pointing out
+    Plane frustum[6];
+    for (int axis = 0; axis < 3; ++axis) {
+      for (int side = 0; side < 2; ++side) {
+        Plane &plane = frustum[axis * 2 + side];
+        plane.normal = glm::vec4(0.0f);
+        plane.normal[axis] = side == 0 ? 1.0f : -1.0f;
+        plane.position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        plane.position[axis] = side == 0 ? maxCorner[axis] : minCorner[axis];
+      }
+    }
+    index.queryFrustum(frustum, result);
+    REQUIRE(toSortedIndices(result) ==
+            queryBruteForce(registry, [&](const glm::vec3 &c, const float r) {
+              return SirEngine::isSphereInFrustum(frustum, c, r);
+            }));
+  }
+}
+
+TEST_CASE("spatial index queries match brute force", "[graphics,ecs]") {
+  Registry registry;
+  SpatialIndex index(8.0f);
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> radius(0.0f, 3.0f);
+  std::vector<EntityId> ids;
+  for (int i = 0; i < 3000; ++i) {
+    const glm::vec3 p(position(generator), position(generator),
+                      position(generator));
+    // a few entities bigger than a cell, they go in the large list
+    const float r = i % 100 == 0 ? 20.0f : radius(generator);
+    ids.push_back(registry.createEntity(
+        makeWorld(p), RenderBounds{glm::vec3(0.0f), r}));
+    index.addEntity(registry, ids.back());
+  }
+  ids.push_back(registry.createEntity(
+      makeWorld(glm::vec3(1000.0f)),
+      RenderBounds{glm::vec3(0.0f), RenderBounds::UNBOUNDED_RADIUS}));
+  index.addEntity(registry, ids.back());
+  // not indexed, never returned
+  registry.createEntity(makeWorld(glm::vec3(0.0f)),
+                        RenderBounds{glm::vec3(0.0f), 1.0f});
+  index.update(registry);
+  REQUIRE(index.getEntityCount() == 3001);
+  REQUIRE(index.getLastUpdatedCount() == 0);
+  checkQueries(registry, index, generator);
+
+  // moving some entities, scaling others and removing a few
+  for (size_t i = 0; i < ids.size(); i += 7) {
+    registry.getComponent<WorldTransform>(ids[i]) =
+        makeWorld(glm::vec3(position(generator), position(generator),
+                            position(generator)),
+                  i % 2 == 0 ? 1.0f : 3.0f);
+  }
+  for (size_t i = 3; i < ids.size(); i += 50) {
+    registry.getComponent<RenderBounds>(ids[i]).radius = 6.0f;
+  }
+  for (size_t i = 5; i < ids.size(); i += 31) {
+    index.removeEntity(registry, ids[i]);
+    registry.deleteEntity(ids[i]);
+  }
+  index.update(registry);
+  REQUIRE(index.getLastUpdatedCount() > 0);
+  checkQueries(registry, index, generator);
+}
+
+TEST_CASE("spatial index follows the registry changes", "[graphics,ecs]") {
+  Registry registry;
+  SpatialIndex index(10.0f);
+  const EntityId a = registry.createEntity(
+      makeWorld(glm::vec3(5.0f, 5.0f, 5.0f)),
+      RenderBounds{glm::vec3(0.0f), 1.0f});
+  const EntityId b = registry.createEntity(
+      makeWorld(glm::vec3(-50.0f, 0.0f, 0.0f)),
+      RenderBounds{glm::vec3(0.0f), 1.0f});
+  index.addEntity(registry, a);
+  index.addEntity(registry, b);
+  REQUIRE(registry.hasComponent<SpatialNode>(a));
+  index.update(registry);
+
+  std::vector<EntityId> result;
+  index.querySphere(glm::vec3(0.0f), 10.0f, result);
+  REQUIRE(result.size() == 1);
+  REQUIRE(result[0].index == a.index);
+
+  // nothing moved, nothing to do
+  index.update(registry);
+  REQUIRE(index.getLastUpdatedCount() == 0);
+
+  registry.getComponent<WorldTransform>(b) =
+      makeWorld(glm::vec3(0.0f, 0.0f, -3.0f));
+  registry.getComponent<WorldTransform>(a) =
+      makeWorld(glm::vec3(40.0f, 0.0f, 0.0f));
+  index.update(registry);
+  REQUIRE(index.getLastUpdatedCount() == 2);
+  index.querySphere(glm::vec3(0.0f), 10.0f, result);
+  REQUIRE(result.size() == 1);
+  REQUIRE(result[0].index == b.index);
+
+  // the bounds in local space get moved by the transform
+  registry.getComponent<RenderBounds>(a).center = glm::vec3(-38.0f, 0, 0);
+  index.update(registry);
+  index.queryAabb(glm::vec3(1.0f, -1.0f, -1.0f), glm::vec3(3.0f, 1.0f, 1.0f),
+                  result);
+  REQUIRE(result.size() == 1);
+  REQUIRE(result[0].index == a.index);
+
+  // removing the first slot moves the last entity in its place
+  index.removeEntity(registry, a);
+  REQUIRE(!registry.hasComponent<SpatialNode>(a));
+  REQUIRE(index.getEntityCount() == 1);
+  const Registry &constRegistry = registry;
+  REQUIRE(constRegistry.getComponent<SpatialNode>(b).slot == 0);
+  index.update(registry);
+  index.querySphere(glm::vec3(0.0f), 100.0f, result);
+  REQUIRE(result.size() == 1);
+  REQUIRE(result[0].index == b.index);
+}
+
+TEST_CASE("spatial index reuses cells and shrinks the radius",
+          "[graphics,ecs]") {
+  Registry registry;
+  SpatialIndex index(10.0f);
+  std::vector<EntityId> ids;
+  for (int i = 0; i < 8; ++i) {
+    ids.push_back(registry.createEntity(
+        makeWorld(glm::vec3(static_cast<float>(i) * 20.0f + 5.0f, 5.0f, 5.0f)),
+        RenderBounds{glm::vec3(0.0f), 1.0f}));
+    index.addEntity(registry, ids.back());
+  }
+  // a bigger one sharing the first cell
+  const EntityId big = registry.createEntity(
+      makeWorld(glm::vec3(6.0f, 5.0f, 5.0f)),
+      RenderBounds{glm::vec3(0.0f), 4.0f});
+  index.addEntity(registry, big);
+  index.update(registry);
+  REQUIRE(index.getCellCount() == 8);
+  REQUIRE(index.getMaxGridRadius() == 4.0f);
+
+  // getting smaller in place
+  registry.getComponent<RenderBounds>(big).radius = 2.0f;
+  index.update(registry);
+  REQUIRE(index.getMaxGridRadius() == 2.0f);
+
+  // moving away to its own cell keeps the radius, removing it drops it
+  registry.getComponent<WorldTransform>(big) =
+      makeWorld(glm::vec3(5.0f, 25.0f, 5.0f));
+  index.update(registry);
+  REQUIRE(index.getCellCount() == 9);
+  REQUIRE(index.getMaxGridRadius() == 2.0f);
+  index.removeEntity(registry, big);
+  registry.deleteEntity(big);
+  REQUIRE(index.getCellCount() == 8);
+  index.update(registry);
+  REQUIRE(index.getMaxGridRadius() == 1.0f);
+
+  // emptying the index frees every cell, moving around does not leak them
+  for (int i = 0; i < 4; ++i) {
+    index.removeEntity(registry, ids[i]);
+    registry.deleteEntity(ids[i]);
+  }
+  REQUIRE(index.getCellCount() == 4);
+  for (int frame = 0; frame < 100; ++frame) {
+    for (int i = 4; i < 8; ++i) {
+      registry.getComponent<WorldTransform>(ids[i]) = makeWorld(
+          glm::vec3(static_cast<float>(frame * 8 + i) * 20.0f, 5.0f, 5.0f));
+    }
+    index.update(registry);
+    REQUIRE(index.getCellCount() == 4);
+  }
+  std::vector<EntityId> result;
+  index.queryAabb(glm::vec3(-1e6f), glm::vec3(1e6f), result);
+  REQUIRE(result.size() == 4);
+  for (int i = 4; i < 8; ++i) {
+    index.removeEntity(registry, ids[i]);
+  }
+  REQUIRE(index.getCellCount() == 0);
+  index.update(registry);
+  REQUIRE(index.getMaxGridRadius() == 0.0f);
+  index.querySphere(glm::vec3(0.0f), 1e6f, result);
+  REQUIRE(result.empty());
+}
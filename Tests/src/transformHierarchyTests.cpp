@@ -0,0 +1,148 @@
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SirEngine/ecs/transformHierarchy.h"
+#include "catch/catch.hpp"
+
+using SirEngine::ecs::EntityId;
+using SirEngine::ecs::LocalTransform;
+using SirEngine::ecs::Registry;
+using SirEngine::ecs::TransformHierarchy;
+using SirEngine::ecs::TransformNode;
+using SirEngine::ecs::WorldTransform;
+
+static LocalTransform makeTranslation(const float x, const float y,
+                                      const float z) {
+  return {glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z))};
+}
+
+static glm::vec3 getWorldPosition(Registry &registry, const EntityId eid) {
+  const Registry &constRegistry = registry;
+  const glm::mat4 &m =
+      constRegistry.getComponent<WorldTransform>(eid).matrix;
+  return glm::vec3(m[3][0], m[3][1], m[3][2]);
+}
+
+TEST_CASE("transform hierarchy chain", "[core,ecs]") {
+  Registry registry;
+  TransformHierarchy hierarchy;
+
+  // adding children before parents on purpose, the sort needs to fix it
+  const EntityId root = registry.createEntity(makeTranslation(1, 0, 0));
+  const EntityId child = registry.createEntity(makeTranslation(0, 1, 0));
+  const EntityId grandChild = registry.createEntity(makeTranslation(0, 0, 1));
+  hierarchy.addEntity(registry, grandChild, child);
+  hierarchy.addEntity(registry, child, root);
+  hierarchy.addEntity(registry, root);
+  hierarchy.update(registry);
+
+  REQUIRE(hierarchy.getNodeCount() == 3);
+  REQUIRE(hierarchy.getLastUpdatedCount() == 3);
+  REQUIRE(registry.getComponent<TransformNode>(root).slot == 0);
+  REQUIRE(registry.getComponent<TransformNode>(child).slot == 1);
+  REQUIRE(registry.getComponent<TransformNode>(grandChild).slot == 2);
+
+  glm::vec3 pos = getWorldPosition(registry, grandChild);
+  REQUIRE(pos.x == Approx(1.0f));
+  REQUIRE(pos.y == Approx(1.0f));
+  REQUIRE(pos.z == Approx(1.0f));
+
+  // nothing changed, nothing gets recomputed
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getLastUpdatedCount() == 0);
+
+  // moving the middle node only touches its subtree
+  registry.getComponent<LocalTransform>(child) = makeTranslation(0, 5, 0);
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getLastUpdatedCount() == 2);
+  pos = getWorldPosition(registry, grandChild);
+  REQUIRE(pos.y == Approx(5.0f));
+  REQUIRE(hierarchy.getWorldMatrix(child)[3][1] == Approx(5.0f));
+  REQUIRE(getWorldPosition(registry, root).y == Approx(0.0f));
+}
+
+TEST_CASE("transform hierarchy structural changes", "[core,ecs]") {
+  Registry registry;
+  TransformHierarchy hierarchy;
+
+  const EntityId rootA = registry.createEntity(makeTranslation(10, 0, 0));
+  const EntityId rootB = registry.createEntity(makeTranslation(20, 0, 0));
+  const EntityId child = registry.createEntity(makeTranslation(1, 0, 0));
+  const EntityId leaf = registry.createEntity(makeTranslation(1, 0, 0));
+  hierarchy.addEntity(registry, rootA);
+  hierarchy.addEntity(registry, rootB);
+  hierarchy.addEntity(registry, child, rootA);
+  hierarchy.addEntity(registry, leaf, child);
+  hierarchy.update(registry);
+  REQUIRE(getWorldPosition(registry, leaf).x == Approx(12.0f));
+
+  // re-parenting
+  hierarchy.setParent(registry, child, rootB);
+  hierarchy.update(registry);
+  REQUIRE(getWorldPosition(registry, child).x == Approx(21.0f));
+  REQUIRE(getWorldPosition(registry, leaf).x == Approx(22.0f));
+
+  // removing the middle node turns the leaf into a root
+  hierarchy.removeEntity(registry, child);
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getNodeCount() == 3);
+  REQUIRE(!registry.hasComponent<WorldTransform>(child));
+  REQUIRE(!registry.hasComponent<TransformNode>(child));
+  REQUIRE(registry.hasComponent<LocalTransform>(child));
+  REQUIRE(getWorldPosition(registry, leaf).x == Approx(1.0f));
+
+  // changes on an entity not in the hierarchy are ignored
+  registry.getComponent<LocalTransform>(child) = makeTranslation(3, 0, 0);
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getLastUpdatedCount() == 0);
+
+  // a write not changing the value does not trigger a recompute
+  registry.getComponent<LocalTransform>(rootA) = makeTranslation(10, 0, 0);
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getLastUpdatedCount() == 0);
+}
+
+TEST_CASE("transform hierarchy entity destroyed and recycled", "[core,ecs]") {
+  Registry registry;
+  TransformHierarchy hierarchy;
+
+  const EntityId parent = registry.createEntity(makeTranslation(10, 0, 0));
+  const EntityId child = registry.createEntity(makeTranslation(1, 0, 0));
+  hierarchy.addEntity(registry, parent);
+  hierarchy.addEntity(registry, child, parent);
+  hierarchy.update(registry);
+  REQUIRE(getWorldPosition(registry, child).x == Approx(11.0f));
+
+  // destroying the parent without removing it from the hierarchy first, the
+  // new entity gets the same index back with a different version
+  registry.deleteEntity(parent);
+  const EntityId recycled = registry.createEntity(makeTranslation(5, 0, 0));
+  REQUIRE(recycled.index == parent.index);
+  REQUIRE(recycled.version != parent.version);
+  REQUIRE(!hierarchy.isInHierarchy(recycled));
+
+  // the dead parent is dropped on its own
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getNodeCount() == 1);
+  REQUIRE(!hierarchy.isInHierarchy(parent));
+  REQUIRE(getWorldPosition(registry, child).x == Approx(1.0f));
+
+  hierarchy.addEntity(registry, recycled);
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getNodeCount() == 2);
+  REQUIRE(hierarchy.isInHierarchy(recycled));
+  REQUIRE(hierarchy.getWorldMatrix(recycled)[3].x == Approx(5.0f));
+  REQUIRE(getWorldPosition(registry, recycled).x == Approx(5.0f));
+  // the child still points at the dead parent, it stays a root
+  REQUIRE(getWorldPosition(registry, child).x == Approx(1.0f));
+
+  // destroying and recycling in between two updates
+  registry.deleteEntity(recycled);
+  const EntityId again = registry.createEntity(makeTranslation(7, 0, 0));
+  REQUIRE(again.index == recycled.index);
+  hierarchy.addEntity(registry, again);
+  hierarchy.setParent(registry, child, again);
+  hierarchy.update(registry);
+  REQUIRE(hierarchy.getNodeCount() == 2);
+  REQUIRE(getWorldPosition(registry, again).x == Approx(7.0f));
+  REQUIRE(getWorldPosition(registry, child).x == Approx(8.0f));
+}
@@ -0,0 +1,82 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "SirEngine/memory/cpu/stackAllocator.h"
+#include "SirEngine/workerPool.h"
+#include "catch/catch.hpp"
+
+using SirEngine::WorkerPool;
+
+TEST_CASE("worker pool runs every task once", "[core]") {
+  for (const uint32_t workerCount : {1u, 2u, 5u}) {
+    WorkerPool pool(workerCount);
+    REQUIRE(pool.getWorkerCount() == workerCount);
+    for (const uint32_t taskCount : {0u, 1u, 3u, 1000u}) {
+      std::vector<std::atomic<uint32_t>> runs(taskCount);
+      pool.parallelFor(taskCount, [&](const uint32_t task) { ++runs[task]; });
+      for (uint32_t i = 0; i < taskCount; ++i) {
+        REQUIRE(runs[i].load() == 1);
+      }
+    }
+  }
+}
+
+TEST_CASE("worker pool steals from busy workers", "[core]") {
+  // the first task the calling thread runs blocks until every other task is
+  // done, which can only happen if the other workers take the rest of its
+  // range
+  constexpr uint32_t taskCount = 64;
+  WorkerPool pool(4);
+  std::vector<uint32_t> taskWorker(taskCount, ~0u);
+  std::atomic<uint32_t> completed{0};
+  std::atomic<bool> blocked{false};
+  pool.parallelFor(taskCount, [&](const uint32_t task) {
+    const uint32_t worker = WorkerPool::getCurrentWorkerIndex();
+    taskWorker[task] = worker;
+    if ((worker == 0) && !blocked.exchange(true)) {
+      while (completed.load() != taskCount - 1) {
+        std::this_thread::yield();
+      }
+      return;
+    }
+    ++completed;
+  });
+  uint32_t onFirst = 0;
+  for (uint32_t i = 0; i < taskCount; ++i) {
+    REQUIRE(taskWorker[i] < 4);
+    onFirst += taskWorker[i] == 0 ? 1 : 0;
+  }
+  // 16 tasks started in the range of the first worker, it ran a single one
+  REQUIRE(blocked.load());
+  REQUIRE(onFirst == 1);
+}
+
+TEST_CASE("worker pool scratch allocators", "[core]") {
+  WorkerPool pool(3, 4096);
+  std::vector<void*> firstAllocation(64, nullptr);
+  pool.parallelFor(64, [&](const uint32_t task) {
+    const uint32_t worker = WorkerPool::getCurrentWorkerIndex();
+    auto* scratch = static_cast<uint32_t*>(
+        pool.getScratchAllocator(worker).allocate(sizeof(uint32_t) * 4));
+    scratch[0] = task;
+    firstAllocation[task] = scratch;
+  });
+  for (uint32_t i = 0; i < 64; ++i) {
+    REQUIRE(*static_cast<uint32_t*>(firstAllocation[i]) == i);
+  }
+  // scratch memory is reset on every loop, the usage is recorded per task
+  // and checked once the loop is done
+  std::vector<ptrdiff_t> usedBefore(3, -1);
+  pool.parallelFor(3, [&](const uint32_t task) {
+    const uint32_t worker = WorkerPool::getCurrentWorkerIndex();
+    SirEngine::StackAllocator& scratch = pool.getScratchAllocator(worker);
+    usedBefore[task] = static_cast<char*>(scratch.getStackPtr()) -
+                       static_cast<char*>(scratch.getStartPtr());
+    scratch.allocate(sizeof(uint32_t) * 4);
+  });
+  for (const ptrdiff_t used : usedBefore) {
+    REQUIRE(used >= 0);
+    REQUIRE(used <= static_cast<ptrdiff_t>(sizeof(uint32_t) * 4 * 2));
+  }
+}
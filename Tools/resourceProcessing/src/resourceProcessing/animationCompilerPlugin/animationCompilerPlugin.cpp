@@ -6,6 +6,7 @@
 #include "cxxopts/cxxopts.hpp"
 
 #include "SirEngine/animation/animationManager.h"
+#include "SirEngine/animation/clipCompression.h"
 #include "SirEngine/animation/skeleton.h"
 #include <filesystem>
 #include "nlohmann/json.hpp"
@@ -14,8 +15,11 @@ using namespace std::string_literals;
 
 const std::string PLUGIN_NAME = "animationCompilerPlugin";
 const unsigned int VERSION_MAJOR = 0;
-const unsigned int VERSION_MINOR = 1;
+const unsigned int VERSION_MINOR = 3;
 const unsigned int VERSION_PATCH = 0;
+static_assert(((VERSION_MAJOR << 16) | (VERSION_MINOR << 8) | VERSION_PATCH) ==
+                  SirEngine::COMPRESSED_CLIP_FILE_VERSION,
+              "the runtime only loads clips of its own version");
 
 struct AnimData {
   std::string name;
@@ -24,6 +28,7 @@ struct AnimData {
   int bonesPerFrame;
   int frameCount;
   bool isLoopable;
+  SirEngine::ClipCompressionSettings compression;
   // holds the metadata for the animation, where the first int is
   // the keyword and the vector is the frames affected by that keyword
   std::unordered_map<int, std::vector<int>> animationKeywordToFrame;
@@ -39,7 +44,7 @@ bool isNumber(const std::string &s) {
                          return !std::isdigit(c);
                        }) == s.end();
 }
-void convertAnim(const std::string &path, AnimData &data) {
+bool convertAnim(const std::string &path, AnimData &data) {
 
   nlohmann::json jObj;
   SirEngine::getJsonObj(path, jObj);
@@ -95,13 +100,57 @@ void convertAnim(const std::string &path, AnimData &data) {
     ++poseCounter;
   }
 
+  // optional compression settings, per joint overrides are keyed by the
+  // joint index: "compression" : {"rotationTolerance" : 0.0005,
+  // "translationTolerance" : 0.001, "segmentFrameCount" : 32,
+  // "joints" : {"0" : [0.0001, 0.0001]}}
+  if (jObj.find("compression") != jObj.end()) {
+    const auto &compression = jObj["compression"];
+    SirEngine::ClipCompressionSettings &settings = data.compression;
+    settings.rotationTolerance =
+        compression.value("rotationTolerance", settings.rotationTolerance);
+    settings.translationTolerance = compression.value(
+        "translationTolerance", settings.translationTolerance);
+    // key frames are stored in a byte, a segment can't be longer than that
+    const int64_t segmentFrameCount = compression.value(
+        "segmentFrameCount",
+        static_cast<int64_t>(settings.segmentFrameCount));
+    if (segmentFrameCount < 1 ||
+        segmentFrameCount > SirEngine::MAX_SEGMENT_FRAME_COUNT) {
+      SE_CORE_ERROR(
+          "[Animation Compiler] : segmentFrameCount {0} out of range, it "
+          "needs to be between 1 and {1}",
+          segmentFrameCount, SirEngine::MAX_SEGMENT_FRAME_COUNT);
+      return false;
+    }
+    settings.segmentFrameCount = static_cast<uint32_t>(segmentFrameCount);
+    if (compression.find("joints") != compression.end()) {
+      settings.jointRotationTolerances.assign(data.bonesPerFrame,
+                                              settings.rotationTolerance);
+      settings.jointTranslationTolerances.assign(
+          data.bonesPerFrame, settings.translationTolerance);
+      for (auto &joint : compression["joints"].items()) {
+        const int jointIndex = std::stoi(joint.key());
+        if (jointIndex < 0 || jointIndex >= data.bonesPerFrame) {
+          SE_CORE_WARN("Compression tolerance for out of range joint {0}",
+                       jointIndex);
+          continue;
+        }
+        settings.jointRotationTolerances[jointIndex] =
+            joint.value()[0].get<float>();
+        settings.jointTranslationTolerances[jointIndex] =
+            joint.value()[1].get<float>();
+      }
+    }
+  }
+
   // processing metadata
   // auto reString = R"("(\d+)-?(\d+)?")";
   auto reString = R"((\d+)-?(\d+)?)";
   std::regex re(reString);
   if (jObj.find("metadata") == jObj.end()) {
     // no metadata just return
-    return;
+    return true;
   }
   auto metadata = jObj["metadata"];
   for (auto keyValue : metadata) {
@@ -177,6 +226,7 @@ void convertAnim(const std::string &path, AnimData &data) {
   for (auto &keyValue : data.animationKeywordToFrame) {
     std::sort(keyValue.second.begin(), keyValue.second.end());
   }
+  return true;
 }
 
 bool processAnim(const std::string &assetPath, const std::string &outputPath,
@@ -205,7 +255,10 @@ bool processAnim(const std::string &assetPath, const std::string &outputPath,
 
   // loading the obj
   AnimData data{};
-  convertAnim(assetPath, data);
+  if (!convertAnim(assetPath, data)) {
+    SE_CORE_ERROR("[Animation Compiler] : could not convert {0}", assetPath);
+    return false;
+  }
 
   // need to flatten out the key value map
   struct KeyValue {
@@ -229,11 +282,21 @@ bool processAnim(const std::string &assetPath, const std::string &outputPath,
   const std::string fileName = inp.stem().string();
   request.outPath = outputPath.c_str();
 
+  // the poses are stored compressed, sampled in place by the runtime
+  std::vector<char> compressedPoses;
+  const SirEngine::ClipCompressionStats stats = SirEngine::compressClip(
+      data.poses.data(), data.bonesPerFrame, data.frameCount,
+      data.compression, compressedPoses);
+  SE_CORE_INFO(
+      "[Animation Compiler] : {0} compressed {1} -> {2} bytes, max rotation "
+      "error {3} max translation error {4}",
+      data.name, stats.rawSizeInBytes, stats.compressedSizeInBytes,
+      stats.maxRotationError, stats.maxTranslationError);
+
   // need to merge the data, name and poses
   std::vector<char> outputData;
   const int nameSize = static_cast<int>(data.name.size() + 1);
-  const int posesSize =
-      static_cast<int>(data.poses.size() * sizeof(SirEngine::JointPose));
+  const int posesSize = static_cast<int>(compressedPoses.size());
   const int keyValueSize =
       static_cast<int>(sizeof(KeyValue) * keyValueVector.size());
   const int totalSize = nameSize + posesSize + keyValueSize;
@@ -241,7 +304,7 @@ bool processAnim(const std::string &assetPath, const std::string &outputPath,
 
   // copying the data over
   memcpy(outputData.data(), data.name.data(), nameSize);
-  memcpy(outputData.data() + nameSize, data.poses.data(), posesSize);
+  memcpy(outputData.data() + nameSize, compressedPoses.data(), posesSize);
   memcpy(outputData.data() + nameSize + posesSize, keyValueVector.data(),
          keyValueSize);
 
@@ -250,8 +313,7 @@ bool processAnim(const std::string &assetPath, const std::string &outputPath,
 
   ClipMapperData mapperData;
   mapperData.nameSizeInByte = static_cast<int>(data.name.size() + 1);
-  mapperData.posesSizeInByte =
-      static_cast<int>(data.poses.size()) * sizeof(SirEngine::JointPose);
+  mapperData.posesSizeInByte = posesSize;
   mapperData.frameRate = data.frameRate;
   mapperData.bonesPerFrame = data.bonesPerFrame;
   mapperData.frameCount = data.frameCount;
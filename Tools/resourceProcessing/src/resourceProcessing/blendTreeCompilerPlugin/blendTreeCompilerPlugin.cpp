@@ -0,0 +1,84 @@
+#include "blendTreeCompilerPlugin.h"
+
+#include <cstring>
+#include <filesystem>
+
+#include "SirEngine/animation/blendTree.h"
+#include "SirEngine/io/binaryFile.h"
+#include "SirEngine/io/fileUtils.h"
+#include "SirEngine/log.h"
+#include "nlohmann/json.hpp"
+
+const std::string PLUGIN_NAME = "blendTreeCompilerPlugin";
+const unsigned int VERSION_MAJOR = 0;
+const unsigned int VERSION_MINOR = 1;
+const unsigned int VERSION_PATCH = 0;
+static_assert(((VERSION_MAJOR << 16) | (VERSION_MINOR << 8) | VERSION_PATCH) ==
+                  SirEngine::BLEND_TREE_FILE_VERSION,
+              "the runtime only loads trees of its own version");
+
+bool processBlendTree(const std::string &assetPath,
+                      const std::string &outputPath, const std::string &) {
+  // checking IO files exits
+  bool exits = SirEngine::fileExists(assetPath);
+  if (!exits) {
+    SE_CORE_ERROR("[Blend Tree Compiler] : could not find path/file {0}",
+                  assetPath);
+    return false;
+  }
+
+  exits = SirEngine::filePathExists(outputPath);
+  if (!exits) {
+    SE_CORE_ERROR("[Blend Tree Compiler] : could not find path/file {0}",
+                  outputPath);
+  }
+
+  // the whole tree gets flattened in a program, the runtime only has to
+  // copy it
+  nlohmann::json jObj;
+  SirEngine::getJsonObj(assetPath, jObj);
+  std::vector<char> program;
+  if (!SirEngine::compileBlendTree(jObj, program)) {
+    SE_CORE_ERROR("[Blend Tree Compiler] : could not compile {0}", assetPath);
+    return false;
+  }
+  const SirEngine::BlendTreeProgramHeader *header =
+      SirEngine::getBlendTreeHeader(program.data());
+  SE_CORE_INFO(
+      "[Blend Tree Compiler] : {0} instructions, {1} clips, {2} pose slots",
+      header->instructionCount, header->clipCount, header->poseSlotCount);
+
+  // writing binary file
+  BinaryFileWriteRequest request;
+  request.fileType = BinaryFileType::BLEND_TREE;
+  request.version =
+      ((VERSION_MAJOR << 16) | (VERSION_MINOR << 8) | VERSION_PATCH);
+  request.outPath = outputPath.c_str();
+
+  // need to merge the data, name and program
+  const std::string name = std::filesystem::path(assetPath).stem().string();
+  std::vector<char> outputData;
+  const int nameSize = static_cast<int>(name.size() + 1);
+  const int programSize = static_cast<int>(program.size());
+  const int totalSize = nameSize + programSize;
+  outputData.resize(totalSize);
+
+  // copying the data over
+  memcpy(outputData.data(), name.data(), nameSize);
+  memcpy(outputData.data() + nameSize, program.data(), programSize);
+
+  request.bulkData = outputData.data();
+  request.bulkDataSizeInByte = totalSize;
+
+  BlendTreeMapperData mapperData;
+  mapperData.nameSizeInByte = nameSize;
+  mapperData.programSizeInByte = programSize;
+  request.mapperData = &mapperData;
+  request.mapperDataSizeInByte = sizeof(BlendTreeMapperData);
+
+  writeBinaryFile(request);
+
+  SE_CORE_INFO("blend tree successfully compiled ---> {0}", outputPath);
+
+  return true;
+}
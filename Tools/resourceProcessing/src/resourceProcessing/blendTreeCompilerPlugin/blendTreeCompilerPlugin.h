@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+
+extern "C" {
+bool processBlendTree(const std::string &assetPath,
+                      const std::string &outputPath, const std::string &args);
+}
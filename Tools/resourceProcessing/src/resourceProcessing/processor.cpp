@@ -2,6 +2,7 @@
 
 #include "SirEngine/log.h"
 #include "resourceProcessing/animationCompilerPlugin/animationCompilerPlugin.h"
+#include "resourceProcessing/blendTreeCompilerPlugin/blendTreeCompilerPlugin.h"
 #include "resourceProcessing/obj/modelCompilerPlugin.h"
 #include "resourceProcessing/pointTilerCompilerPlugin/pointTilerCompilerPlugin.h"
 #include "resourceProcessing/psoCompilerPlugin/PSOCompilerPlugin.h"
@@ -16,6 +17,7 @@ void Processor::initialize() {
   registerFunction("shaderCompilerPlugin", processShader);
   registerFunction("vkShaderCompilerPlugin", processVkShader);
   registerFunction("animationCompilerPlugin", processAnim);
+  registerFunction("blendTreeCompilerPlugin", processBlendTree);
   registerFunction("textureCompilerPlugin", processTexture);
   registerFunction("PSOCompilerPlugin", processPSO);
 }
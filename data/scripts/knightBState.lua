@@ -2,8 +2,7 @@ package.path = package.path .. ";../data/scripts/?.lua"
 
 -- transition functions
 function idleToWalk()
-    spaceButton = 32;
-    upArrow = 38;
+	local upArrow = 38;
 	if inputButtonWentDownThisFrame(upArrow) == true then
 		print("lets go walking!");
 		return true;
@@ -12,8 +11,7 @@ function idleToWalk()
 end
 
 function walkToIdle()
-    spaceButton = 32;
-    upArrow = 38;
+	local upArrow = 38;
 	if inputButtonDown(upArrow) == false then
 		print("lets go idle");
 		return true;
@@ -32,42 +30,67 @@ states = {
 -- transitions
 transitions = {
 				-- idle transitions
-				idle = {{targetState="walk", transitionKey="l_foot_down", 
+				idle = {{targetState="walk", transitionKey="l_foot_down",
 				         transitionLenInSeconds=0.3, logic=idleToWalk,
 						 cogSpeed = 0.0115}},
 				-- walk transitions
-				walk = {{targetState="idle", transitionKey="l_foot_down", 
+				walk = {{targetState="idle", transitionKey="l_foot_down",
 						 transitionLenInSeconds=0.3, logic=walkToIdle,
 						 cogSpeed=0.0}},
 			  },
 }
 
+-- the state machine above resolved to ids by start, indexed by state id
+local resolvedStates = {};
+
 function evaluate(currentState)
-	-- lets get the current state
-	stateMap = stateMachine.states[currentState];
-	
-	-- lets get the transitions and start to iterate over them
-	transitions = stateMachine.transitions[currentState];
-	for state,transition in pairs(transitions) do
-		result = transition.logic(); 
-		if result == true then
+	-- lets get the transitions of the current state and start to iterate over
+	-- them
+	local transitions = resolvedStates[currentState].transitions;
+	for _,transition in ipairs(transitions) do
+		if transition.logic() == true then
 			-- the transition was taken!! we need to perform the transition
-			targetState = stateMachine.states[transition.targetState]; 
-			targetAnim = targetState.animation;
-			sourceAnim = stateMap.animation; 
-			transitionKey = transition.transitionKey;
-			transitionLen = transition.transitionLenInSeconds;
-			speed = transition.cogSpeed;
-			-- need to push the transition
-			return transition.targetState, sourceAnim,targetAnim,transitionKey, transitionLen,speed;
+			return transition.targetState, transition.targetClip,
+			       transition.transitionKey, transition.transitionLenInSeconds,
+			       transition.cogSpeed;
 		end
 	end
-	return currentState,nil,nil,nil,nil,nil;
+	return currentState,nil,nil,nil,nil;
 end
 
--- returns the starting animation and state we wish to use
-function start()
-	startState = "idle";
-	stateMap = stateMachine.states[startState];
-	return startState ,stateMap.animation, 0.0;
+-- gets the clip name to clip id and keyword name to keyword id tables, the
+-- names get resolved once here, evaluate only deals with ids.
+-- returns the starting state, its clip id and the cog speed
+function start(clips, keywords)
+	local stateIds = {};
+	local stateCount = 0;
+	for name,_ in pairs(stateMachine.states) do
+		stateCount = stateCount + 1;
+		stateIds[name] = stateCount;
+	end
+
+	for name,state in pairs(stateMachine.states) do
+		local clip = clips[state.animation];
+		assert(clip ~= nil, "state machine clip not in the config: " .. state.animation);
+		local transitions = {};
+		for i,transition in ipairs(stateMachine.transitions[name]) do
+			local targetState = stateIds[transition.targetState];
+			assert(targetState ~= nil, "unknown target state: " .. transition.targetState);
+			local key = nil;
+			if transition.transitionKey ~= nil then
+				key = keywords[transition.transitionKey];
+				assert(key ~= nil, "unknown transition key: " .. transition.transitionKey);
+			end
+			transitions[i] = {targetState = targetState,
+			                  targetClip = clips[stateMachine.states[transition.targetState].animation],
+			                  transitionKey = key,
+			                  transitionLenInSeconds = transition.transitionLenInSeconds,
+			                  logic = transition.logic,
+			                  cogSpeed = transition.cogSpeed};
+		end
+		resolvedStates[stateIds[name]] = {clip = clip, transitions = transitions};
+	end
+
+	local startState = stateIds["idle"];
+	return startState, resolvedStates[startState].clip, 0.0;
 end
@@ -9,7 +9,11 @@ struct FullSkinResult {
 	float3 tan;
 };
 
-FullSkinResult skinFullPoint(int vid, float4 position, float3 normal,float3 tangent) {
+// g_matrices is the skin cluster manager shared buffer, every skin owns a range
+// of it, matricesOffset is the first matrix of the skin being drawn, see
+// SkinData::matricesOffset
+FullSkinResult skinFullPoint(int vid, float4 position, float3 normal,float3 tangent,
+                             uint matricesOffset) {
 
   FullSkinResult result;
   int id = vid * NUMBER_OF_INFLUENCES;
@@ -21,12 +25,12 @@ FullSkinResult skinFullPoint(int vid, float4 position, float3 normal,float3 tang
   float4 temp;
   float3 tempVec3;
   for (int i = 0; i < NUMBER_OF_INFLUENCES; ++i) {
-    temp = mul(position, g_matrices[g_influences[id + i]]);
+    float4x4 skinMatrix = g_matrices[matricesOffset + g_influences[id + i]];
+    temp = mul(position, skinMatrix);
     skinPos += (g_weights[id + i] * temp);
-    tempVec3 = mul(normal, (float3x3)g_matrices[g_influences[id + i]]);
+    tempVec3 = mul(normal, (float3x3)skinMatrix);
     skinNormal += (g_weights[id + i] * tempVec3);
-    tempVec3 =
-        mul(tangent, (float3x3)g_matrices[g_influences[id + i]]);
+    tempVec3 = mul(tangent, (float3x3)skinMatrix);
     skinTan += (g_weights[id + i] * tempVec3);
   }
   skinPos.w = 1.0f;